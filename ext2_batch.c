@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "ext2_batch.h"
+#include "ext2_session.h"
+#include "ext2_commands.h"
+
+struct batch_cmd {
+    char *line;
+    unsigned long line_no;
+    char *out, *err;      // Saída capturada (modo paralelo)
+    size_t out_len, err_len;
+    double ms;
+};
+
+struct batch_group {
+    ext2_fs *fs;
+    const ext2_session *session;
+    struct batch_cmd cmds[EXT2_BATCH_GROUP];
+    size_t count;
+    size_t next;          // Próximo comando a ser pego (atômico)
+};
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void report_time(const struct batch_cmd *c) {
+    fprintf(stderr, "[%5lu] %10.3f ms  %.*s\n", c->line_no, c->ms,
+            (int)strcspn(c->line, "\n"), c->line);
+}
+
+// Consultas que não dependem umas das outras nem mudam a sessão ou o handle.
+// Lista fechada: um comando novo só roda em paralelo se for incluído aqui
+// (cd muda a sessão, cp grava no host, stats reset e trace mudam o handle)
+static const char *parallel_queries[] = {
+    "info", "ls", "pwd", "attr", "cat", "print", "du", "find", "freefrag", NULL
+};
+
+static int is_parallel_query(const char *line) {
+    char cmd[32] = {0};
+    sscanf(line, "%31s", cmd);
+    for (int i = 0; parallel_queries[i]; i++) {
+        if (strcmp(cmd, parallel_queries[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static void *group_worker(void *arg) {
+    struct batch_group *g = arg;
+    for (;;) {
+        size_t i = __atomic_fetch_add(&g->next, 1, __ATOMIC_RELAXED);
+        if (i >= g->count) break;
+        struct batch_cmd *c = &g->cmds[i];
+
+        // Consultas não alteram a sessão, mas cada thread usa sua cópia
+        ext2_session session = *g->session;
+        FILE *out = open_memstream(&c->out, &c->out_len);
+        FILE *err = open_memstream(&c->err, &c->err_len);
+        double start = now_ms();
+        if (out && err) session_execute(g->fs, &session, c->line, out, err);
+        c->ms = now_ms() - start;
+        commands_set_output(NULL, NULL);
+        if (out) fclose(out);
+        if (err) fclose(err);
+    }
+    return NULL;
+}
+
+// Executa as consultas acumuladas e imprime as saídas na ordem do script
+static void run_group(struct batch_group *g, int jobs, int timing) {
+    if (g->count == 0) return;
+
+    int nthreads = jobs < (int)g->count ? jobs : (int)g->count;
+    pthread_t threads[nthreads];
+    int started = 0;
+    g->next = 0;
+    for (int t = 1; t < nthreads; t++) {
+        if (pthread_create(&threads[started], NULL, group_worker, g) == 0) started++;
+    }
+    group_worker(g); // A thread principal também trabalha
+    for (int t = 0; t < started; t++) pthread_join(threads[t], NULL);
+
+    for (size_t i = 0; i < g->count; i++) {
+        struct batch_cmd *c = &g->cmds[i];
+        if (c->out) fwrite(c->out, 1, c->out_len, stdout);
+        if (c->err) fwrite(c->err, 1, c->err_len, stderr);
+        if (timing) report_time(c);
+        free(c->out);
+        free(c->err);
+        free(c->line);
+    }
+    fflush(stdout);
+    memset(g->cmds, 0, g->count * sizeof(struct batch_cmd));
+    g->count = 0;
+}
+
+long batch_run(ext2_fs *fs, FILE *script, int jobs, int timing) {
+    ext2_session session;
+    session_init(&session);
+
+    struct batch_group *group = calloc(1, sizeof(struct batch_group));
+    if (!group) jobs = 1;
+    else {
+        group->fs = fs;
+        group->session = &session;
+    }
+
+    ext2_set_deferred_flush(fs, 1);
+    double total_start = now_ms();
+    unsigned long executed = 0, line_no = 0;
+    int failed = 0;
+    char *line = NULL;
+    size_t cap = 0;
+
+    while (getline(&line, &cap, script) != -1) {
+        line_no++;
+        char *p = line + strspn(line, " \t");
+        if (*p == '\n' || *p == '\0' || *p == '#') continue;
+        executed++;
+
+        if (jobs > 1 && is_parallel_query(p)) {
+            struct batch_cmd *c = &group->cmds[group->count];
+            c->line = strdup(p);
+            if (!c->line) {
+                fprintf(stderr, "batch: sem memória na linha %lu\n", line_no);
+                failed = 1;
+                break;
+            }
+            c->line_no = line_no;
+            group->count++;
+            if (group->count == EXT2_BATCH_GROUP) run_group(group, jobs, timing);
+            continue;
+        }
+
+        // Barreira: termina as consultas pendentes antes do próximo comando
+        if (group) run_group(group, jobs, timing);
+
+        struct batch_cmd c = { p, line_no, NULL, NULL, 0, 0, 0 };
+        double start = now_ms();
+        int quit = session_execute(fs, &session, p, stdout, stderr);
+        c.ms = now_ms() - start;
+        if (timing) report_time(&c);
+        if (quit) break;
+    }
+    if (group) run_group(group, jobs, timing);
+
+    ext2_set_deferred_flush(fs, 0);
+    if (timing) {
+        fprintf(stderr, "Total: %lu comandos em %.3f ms\n", executed, now_ms() - total_start);
+    }
+
+    free(line);
+    free(group);
+    return failed ? -1 : (long)executed;
+}
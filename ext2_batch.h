@@ -0,0 +1,29 @@
+#ifndef _EXT2_BATCH_H_
+#define _EXT2_BATCH_H_
+
+#include <stdio.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Máximo de consultas consecutivas executadas juntas em paralelo
+#define EXT2_BATCH_GROUP 256
+
+/*
+function: Executa um script de comandos do shell sem prompt.
+param:
+  - script: Arquivo com um comando por linha (linhas vazias e '#' são ignoradas).
+  - jobs: Threads para consultas consecutivas (1 = tudo sequencial).
+  - timing: Se diferente de 0, imprime o tempo de cada comando em stderr.
+return:
+  - Quantidade de comandos executados ou -1 se faltou memória (o script é
+    interrompido depois das consultas já enfileiradas).
+observações:
+  - Superbloco e descritores de grupo são gravados só no fim do script
+    (ext2_set_deferred_flush), não a cada comando.
+  - Consultas consecutivas (info, ls, pwd, attr, cat, print, du, find,
+    freefrag) rodam em paralelo e a saída é impressa na ordem do script.
+    Todos os outros comandos funcionam como barreira e rodam sozinhos.
+*/
+long batch_run(ext2_fs *fs, FILE *script, int jobs, int timing);
+
+#endif
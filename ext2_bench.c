@@ -0,0 +1,419 @@
+#define _XOPEN_SOURCE 700 // nftw
+#include <time.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+#include "ext2_file.h"
+#include "ext2_session.h"
+#include "ext2_journal.h"
+#include "ext2_stats.h"
+
+// Gerador de cargas sobre uma imagem recém-criada (make bench). A forma da
+// imagem (diretório grande, árvore profunda, arquivo grande) é gerada no host
+// e copiada com import; os arquivos fragmentados são gravados intercalando
+// dois arquivos. Cada carga mede a latência de cada operação e imprime uma
+// linha JSON com vazão e percentis; a última linha traz as estatísticas de
+// E/S da sessão (stats json).
+
+struct bench_config {
+    unsigned int files;        // Entradas do diretório grande (import, resolve_flat, ls_flat)
+    unsigned int creates;      // Arquivos criados com touch (e removidos com rm)
+    unsigned int dirs;         // Diretórios criados com mkdir
+    unsigned int depth;        // Profundidade da árvore (resolve_deep)
+    unsigned int file_mib;     // Tamanho dos arquivos grandes
+    unsigned int repeat;       // Repetições das cargas de leitura
+    unsigned int lookups;      // Buscas de caminho por carga
+    int journal;
+    const char *image;
+};
+
+// Amostras de uma carga
+struct bench_run {
+    const char *name;
+    uint64_t *ns;
+    size_t count, cap;
+    uint64_t bytes;
+    uint64_t start;
+};
+
+static FILE *sink;             // Saída dos comandos (descartada)
+static FILE *report;
+static char host_tmp[] = "/tmp/ext2bench.XXXXXX";
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void run_begin(struct bench_run *r, const char *name) {
+    memset(r, 0, sizeof(*r));
+    r->name = name;
+    r->start = now_ns();
+}
+
+static void run_sample(struct bench_run *r, uint64_t ns, uint64_t bytes) {
+    if (r->count == r->cap) {
+        r->cap = r->cap ? r->cap * 2 : 1024;
+        r->ns = realloc(r->ns, r->cap * sizeof(uint64_t));
+    }
+    r->ns[r->count++] = ns;
+    r->bytes += bytes;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Percentil pelo posto mais próximo (amostras já ordenadas)
+static double percentile_us(const struct bench_run *r, unsigned int pct) {
+    size_t rank = (r->count * pct + 99) / 100;
+    return r->ns[rank ? rank - 1 : 0] / 1e3;
+}
+
+static void run_end(struct bench_run *r) {
+    double total = (now_ns() - r->start) / 1e9;
+    if (r->count == 0) {
+        fprintf(report, "{\"workload\":\"%s\",\"ops\":0}\n", r->name);
+        return;
+    }
+    qsort(r->ns, r->count, sizeof(uint64_t), cmp_u64);
+    uint64_t busy = 0;
+    for (size_t i = 0; i < r->count; i++) busy += r->ns[i];
+
+    // Vazão sobre o tempo das operações (sem o custo do próprio gerador)
+    fprintf(report, "{\"workload\":\"%s\",\"ops\":%zu,\"seconds\":%.6f,\"ops_per_sec\":%.1f",
+            r->name, r->count, busy / 1e9, r->count / (busy / 1e9));
+    if (r->bytes > 0) {
+        fprintf(report, ",\"bytes\":%llu,\"mb_per_sec\":%.2f", (unsigned long long)r->bytes,
+                r->bytes / (1024.0 * 1024.0) / (busy / 1e9));
+    }
+    fprintf(report, ",\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,\"wall_seconds\":%.6f}\n",
+            percentile_us(r, 50), percentile_us(r, 99), r->ns[r->count - 1] / 1e3, total);
+    fflush(report);
+    free(r->ns);
+}
+
+// Executa uma linha do shell e devolve a duração
+static uint64_t timed(ext2_fs *fs, ext2_session *s, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+static uint64_t timed(ext2_fs *fs, ext2_session *s, const char *fmt, ...) {
+    char line[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    uint64_t start = now_ns();
+    session_execute(fs, s, line, sink, sink);
+    return now_ns() - start;
+}
+
+// Entradas com nomes de 7 caracteres que cabem em `blocks` blocos de diretório
+static unsigned int dir_capacity(ext2_fs *fs, unsigned int blocks) {
+    return blocks * (ext2_block_size(fs) / 16) - 2;
+}
+
+// --- Forma da imagem ---
+
+static int write_host_file(const char *path, const char *buf, size_t chunk, uint64_t size) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+    for (uint64_t done = 0; done < size;) {
+        size_t n = size - done < chunk ? size - done : chunk;
+        if (write(fd, buf, n) != (ssize_t)n) break;
+        done += n;
+    }
+    return close(fd);
+}
+
+// Gera <host_tmp>/tree: flat/ com `files` arquivos pequenos, deep/ com
+// `depth` níveis e contig com `file_mib` MiB. Retorna os bytes gerados.
+static uint64_t build_host_tree(const struct bench_config *c, const char *buf, size_t chunk) {
+    char path[4096];
+    uint64_t bytes = 0;
+    snprintf(path, sizeof(path), "%s/tree", host_tmp);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s/tree/flat", host_tmp);
+    mkdir(path, 0755);
+    for (unsigned int i = 0; i < c->files; i++) {
+        snprintf(path, sizeof(path), "%s/tree/flat/f%06u", host_tmp, i);
+        write_host_file(path, buf + i % 1024, chunk, 64);
+        bytes += 64;
+    }
+
+    int len = snprintf(path, sizeof(path), "%s/tree/deep", host_tmp);
+    mkdir(path, 0755);
+    for (unsigned int i = 0; i < c->depth; i++) {
+        len += snprintf(path + len, sizeof(path) - len, "/d%02u", i);
+        mkdir(path, 0755);
+    }
+    snprintf(path + len, sizeof(path) - len, "/leaf");
+    write_host_file(path, buf, chunk, 64);
+
+    snprintf(path, sizeof(path), "%s/tree/contig", host_tmp);
+    write_host_file(path, buf, chunk, (uint64_t)c->file_mib * chunk);
+    return bytes + 64 + (uint64_t)c->file_mib * chunk;
+}
+
+static int remove_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st; (void)flag; (void)ftw;
+    return remove(path);
+}
+
+static void bench_import(ext2_fs *fs, const struct bench_config *c, const char *buf, size_t chunk) {
+    ext2_session s;
+    struct bench_run r;
+    session_init(&s);
+    uint64_t bytes = build_host_tree(c, buf, chunk);
+    timed(fs, &s, "mkdir bench");
+
+    run_begin(&r, "import");
+    run_sample(&r, timed(fs, &s, "import %s/tree bench", host_tmp), bytes);
+    run_end(&r);
+}
+
+// --- Cargas ---
+
+static void bench_lookup(ext2_fs *fs, const struct bench_config *c) {
+    struct bench_run r;
+    char path[1024];
+    unsigned int seed = 42;
+
+    // Caminho mais profundo: /bench/deep/d00/d01/.../leaf
+    int len = snprintf(path, sizeof(path), "/bench/deep");
+    for (unsigned int i = 0; i < c->depth; i++) len += snprintf(path + len, sizeof(path) - len, "/d%02u", i);
+    snprintf(path + len, sizeof(path) - len, "/leaf");
+    run_begin(&r, "resolve_deep");
+    for (unsigned int i = 0; i < c->lookups; i++) {
+        uint64_t start = now_ns();
+        if (find_inode_by_path(fs, path, EXT2_ROOT_INO) == 0) fprintf(stderr, "bench: '%s' não encontrado\n", path);
+        run_sample(&r, now_ns() - start, 0);
+    }
+    run_end(&r);
+
+    // Nomes sorteados (semente fixa) no diretório grande
+    run_begin(&r, "resolve_flat");
+    for (unsigned int i = 0; i < c->lookups && c->files > 0; i++) {
+        snprintf(path, sizeof(path), "/bench/flat/f%06u", rand_r(&seed) % c->files);
+        uint64_t start = now_ns();
+        if (find_inode_by_path(fs, path, EXT2_ROOT_INO) == 0) fprintf(stderr, "bench: '%s' não encontrado\n", path);
+        run_sample(&r, now_ns() - start, 0);
+    }
+    run_end(&r);
+
+    ext2_session s;
+    session_init(&s);
+    timed(fs, &s, "cd /bench/flat");
+    run_begin(&r, "ls_flat");
+    for (unsigned int i = 0; i < c->repeat; i++) run_sample(&r, timed(fs, &s, "ls"), 0);
+    run_end(&r);
+}
+
+// Cria `count` entradas com `cmd` (touch ou mkdir) em /bench/<top>/gNNNN, um
+// bloco de diretório por grupo (diretórios criados pelo shell não crescem)
+static void bench_create(ext2_fs *fs, const char *workload, const char *cmd, const char *top,
+                         char prefix, unsigned int count) {
+    ext2_session s;
+    struct bench_run r;
+    unsigned int per_dir = dir_capacity(fs, 1);
+    session_init(&s);
+    timed(fs, &s, "cd /bench");
+    timed(fs, &s, "mkdir %s", top);
+
+    run_begin(&r, workload);
+    for (unsigned int i = 0; i < count; i++) {
+        if (i % per_dir == 0) {
+            timed(fs, &s, "cd /bench/%s", top);
+            timed(fs, &s, "mkdir g%04u", i / per_dir);
+            timed(fs, &s, "cd g%04u", i / per_dir);
+        }
+        run_sample(&r, timed(fs, &s, "%s %c%06u", cmd, prefix, i), 0);
+    }
+    run_end(&r);
+}
+
+// Arquivo novo em /bench com o inode aberto para escrita
+static ext2_file *create_file(ext2_fs *fs, ext2_session *s, const char *name) {
+    timed(fs, s, "touch %s", name);
+    unsigned int ino = find_inode_by_path(fs, name, s->current_inode);
+    return ino ? ext2_file_open(fs, ino) : NULL;
+}
+
+static void close_file(ext2_fs *fs, ext2_file *f) {
+    if (!f) return;
+    ext2_journal_begin(fs);
+    ext2_file_close(f);
+    ext2_journal_end(fs);
+}
+
+static void bench_files(ext2_fs *fs, const struct bench_config *c, const char *buf, size_t chunk) {
+    ext2_session s;
+    struct bench_run r;
+    session_init(&s);
+    timed(fs, &s, "cd /bench");
+
+    // Acréscimos de 1 MiB; a alocação contígua acontece no flush
+    ext2_file *f = create_file(fs, &s, "appended");
+    run_begin(&r, "append_contig");
+    for (unsigned int i = 0; f && i < c->file_mib; i++) {
+        uint64_t start = now_ns();
+        ext2_journal_begin(fs);
+        ext2_append(f, buf, chunk);
+        if (i + 1 == c->file_mib) ext2_file_flush(f);
+        ext2_journal_end(fs);
+        run_sample(&r, now_ns() - start, chunk);
+    }
+    run_end(&r);
+    close_file(fs, f);
+
+    // Fragmentado: dois arquivos intercalados, flush a cada 16 KiB
+    ext2_file *a = create_file(fs, &s, "frag");
+    ext2_file *b = create_file(fs, &s, "frag_pair");
+    size_t piece = 16 * 1024;
+    run_begin(&r, "append_frag");
+    for (size_t done = 0; a && b && done < (size_t)c->file_mib * chunk; done += piece) {
+        uint64_t start = now_ns();
+        ext2_journal_begin(fs);
+        ext2_append(a, buf + done % chunk, piece);
+        ext2_file_flush(a);
+        ext2_append(b, buf + done % chunk, piece);
+        ext2_file_flush(b);
+        ext2_journal_end(fs);
+        run_sample(&r, now_ns() - start, 2 * piece);
+    }
+    run_end(&r);
+    close_file(fs, a);
+    close_file(fs, b);
+
+    uint64_t bytes = (uint64_t)c->file_mib * chunk;
+    const char *names[] = { "contig", "frag" };
+    for (int k = 0; k < 2; k++) {
+        char workload[32];
+        snprintf(workload, sizeof(workload), "cat_%s", names[k]);
+        run_begin(&r, workload);
+        for (unsigned int i = 0; i < c->repeat; i++) run_sample(&r, timed(fs, &s, "cat %s", names[k]), bytes);
+        run_end(&r);
+
+        snprintf(workload, sizeof(workload), "cp_%s", names[k]);
+        run_begin(&r, workload);
+        for (unsigned int i = 0; i < c->repeat; i++) {
+            run_sample(&r, timed(fs, &s, "cp %s %s/out", names[k], host_tmp), bytes);
+        }
+        run_end(&r);
+    }
+}
+
+static void bench_remove(ext2_fs *fs, const struct bench_config *c) {
+    ext2_session s;
+    struct bench_run r;
+    unsigned int per_dir = dir_capacity(fs, 1);
+    session_init(&s);
+
+    run_begin(&r, "rm");
+    for (unsigned int i = 0; i < c->creates; i++) {
+        if (i % per_dir == 0) timed(fs, &s, "cd /bench/files/g%04u", i / per_dir);
+        run_sample(&r, timed(fs, &s, "rm f%06u", i), 0);
+    }
+    run_end(&r);
+
+    run_begin(&r, "rm_large");
+    timed(fs, &s, "cd /bench");
+    const char *names[] = { "contig", "appended", "frag", "frag_pair" };
+    for (int k = 0; k < 4; k++) run_sample(&r, timed(fs, &s, "rm %s", names[k]), 0);
+    run_end(&r);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [-n <entradas>] [-c <touch>] [-m <mkdir>] [-d <profundidade>] [-f <MiB>]\n"
+                    "       [-r <repetições>] [-l <buscas>] [-J] [-o <saida.jsonl>] <imagem_nova>\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    struct bench_config c = { .files = 500, .creates = 2000, .dirs = 500, .depth = 32, .file_mib = 64,
+                              .repeat = 5, .lookups = 20000 };
+    const char *out_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) c.files = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) c.creates = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) c.dirs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) c.depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) c.file_mib = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) c.repeat = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) c.lookups = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) out_path = argv[++i];
+        else if (strcmp(argv[i], "-J") == 0) c.journal = 1;
+        else if (!c.image && argv[i][0] != '-') c.image = argv[i];
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!c.image) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    report = out_path ? fopen(out_path, "w") : stdout;
+    sink = fopen("/dev/null", "w");
+    if (!report || !sink || !mkdtemp(host_tmp)) {
+        perror("bench");
+        return 1;
+    }
+
+    ext2_fs *fs = ext2_init(c.image);
+    if (!fs) return 1;
+    if (c.journal && ext2_journal_enable(fs) != 0) {
+        ext2_exit(fs);
+        return 1;
+    }
+    if (search_directory(fs, EXT2_ROOT_INO, "bench")) {
+        fprintf(stderr, "bench: a imagem já tem /bench; use uma imagem nova (make bench)\n");
+        ext2_exit(fs);
+        return 1;
+    }
+
+    // Buscas só olham os 12 blocos diretos de um diretório: limita as cargas
+    unsigned int flat_max = dir_capacity(fs, 12), group_max = dir_capacity(fs, 1);
+    if (c.files > flat_max) {
+        fprintf(stderr, "bench: diretório grande limitado a %u entradas com blocos de %u bytes\n",
+                flat_max, ext2_block_size(fs));
+        c.files = flat_max;
+    }
+    if (c.creates > group_max * group_max) c.creates = group_max * group_max;
+    if (c.dirs > group_max * group_max) c.dirs = group_max * group_max;
+    if (c.depth > 200) c.depth = 200;
+
+    fprintf(report, "{\"image\":\"%s\",\"block_size\":%u,\"journal\":%s,\"files\":%u,\"creates\":%u,\"dirs\":%u,"
+                    "\"depth\":%u,\"file_mib\":%u,\"repeat\":%u,\"lookups\":%u}\n",
+            c.image, ext2_block_size(fs), c.journal ? "true" : "false", c.files, c.creates, c.dirs, c.depth,
+            c.file_mib, c.repeat, c.lookups);
+
+    // Conteúdo pseudoaleatório com semente fixa: execuções comparáveis
+    size_t chunk = 1024 * 1024;
+    char *buf = malloc(chunk);
+    unsigned int seed = 7;
+    for (size_t i = 0; buf && i < chunk; i++) buf[i] = rand_r(&seed);
+
+    if (buf) {
+        bench_import(fs, &c, buf, chunk);
+        bench_lookup(fs, &c);
+        bench_create(fs, "mkdir", "mkdir", "dirs", 'd', c.dirs);
+        bench_create(fs, "touch", "touch", "files", 'f', c.creates);
+        bench_files(fs, &c, buf, chunk);
+        bench_remove(fs, &c);
+    }
+    free(buf);
+
+    ext2_stats_json(fs, report);
+    ext2_exit(fs);
+
+    nftw(host_tmp, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    fclose(sink);
+    if (report != stdout) fclose(report);
+    return 0;
+}
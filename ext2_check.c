@@ -0,0 +1,648 @@
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include "ext2_check.h"
+#include "ext2_internal.h"
+
+// Diretório encontrado na passada 1
+struct check_dir {
+    uint32_t ino;
+    uint32_t dotdot;      // Inode da entrada ".." (passada 2)
+    uint32_t parent;      // Diretório que tem uma entrada para este (passada 2, atômico)
+    ext2_inode inode;
+};
+
+// Estado de um grupo de blocos. Só a thread que processa o grupo o altera.
+struct check_group {
+    FILE *log;            // Relatório da passada atual (impresso na ordem dos grupos)
+    char *log_buf;
+    size_t log_len;
+    unsigned int problems, fixed;
+    struct check_dir *dirs;
+    size_t ndirs, dirs_cap;
+    uint32_t free_blocks, free_inodes, used_dirs; // Valores calculados
+};
+
+struct check_state {
+    ext2_fs *fs;
+    int repair;
+    uint32_t first_ino;
+    unsigned int lost_found;
+
+    // Uso real montado nas passadas 0 e 1 (um bit por bloco / inode, atômicos)
+    uint8_t *block_used;
+    uint8_t *inode_used;
+    uint8_t *inode_dir;
+    uint16_t *links;      // i_links_count lido de cada inode
+    uint16_t *refs;       // Entradas de diretório que apontam para cada inode (atômico)
+
+    struct check_dir **dirs; // Todos os diretórios, ordenados por inode (após a passada 1)
+    size_t ndirs;
+
+    struct check_group *groups;
+    unsigned int next;    // Próximo grupo a ser processado (atômico)
+    void (*pass)(struct check_state *st, unsigned int group);
+};
+
+// --- Bitmaps em memória ---
+
+static int test_bit(const uint8_t *map, uint32_t bit) {
+    return (__atomic_load_n(&map[bit >> 3], __ATOMIC_RELAXED) >> (bit & 7)) & 1;
+}
+
+// Marca o bit e retorna o valor anterior
+static int test_and_set_bit(uint8_t *map, uint32_t bit) {
+    uint8_t mask = 1 << (bit & 7);
+    return (__atomic_fetch_or(&map[bit >> 3], mask, __ATOMIC_RELAXED) & mask) != 0;
+}
+
+// --- Relatório ---
+
+static void report(struct check_state *st, unsigned int group, int fixed, const char *fmt, ...) {
+    struct check_group *g = &st->groups[group];
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(g->log, fmt, ap);
+    va_end(ap);
+    fputs(fixed ? " (corrigido)\n" : "\n", g->log);
+    g->problems++;
+    g->fixed += fixed != 0;
+}
+
+static int open_logs(struct check_state *st) {
+    for (unsigned int g = 0; g < st->fs->group_count; g++) {
+        st->groups[g].log = open_memstream(&st->groups[g].log_buf, &st->groups[g].log_len);
+        if (!st->groups[g].log) return -1;
+    }
+    return 0;
+}
+
+// Imprime os relatórios da passada na ordem dos grupos e os reabre vazios
+static int flush_logs(struct check_state *st, FILE *out) {
+    for (unsigned int g = 0; g < st->fs->group_count; g++) {
+        struct check_group *grp = &st->groups[g];
+        fclose(grp->log);
+        fwrite(grp->log_buf, 1, grp->log_len, out);
+        free(grp->log_buf);
+        grp->log_buf = NULL;
+        grp->log = NULL;
+    }
+    fflush(out);
+    return open_logs(st);
+}
+
+// --- Leitura ---
+
+// Lê `count` blocos seguidos com um único pread (versões do journal têm prioridade)
+static int read_blocks(ext2_fs *fs, uint32_t first, uint32_t count, char *buf, enum ext2_io_cat cat) {
+    size_t len = (size_t)count * fs->block_size;
+    stats_calls(fs, 0, 1);
+    if (image_pread(fs, buf, len, (off_t)first * fs->block_size) != 0) return -1;
+    stats_blocks(fs, 0, first, count, cat);
+    if (fs->journal) {
+        for (uint32_t i = 0; i < count; i++) journal_read(fs, first + i, buf + (size_t)i * fs->block_size);
+    }
+    return 0;
+}
+
+// --- Geometria ---
+
+static uint32_t group_first_block(ext2_fs *fs, unsigned int group) {
+    return fs->sb.s_first_data_block + group * fs->sb.s_blocks_per_group;
+}
+
+static uint32_t group_blocks(ext2_fs *fs, unsigned int group) {
+    uint32_t first = group_first_block(fs, group);
+    uint32_t n = fs->sb.s_blocks_count - first;
+    return n < fs->sb.s_blocks_per_group ? n : fs->sb.s_blocks_per_group;
+}
+
+static struct check_dir *find_dir(struct check_state *st, uint32_t ino) {
+    size_t lo = 0, hi = st->ndirs;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (st->dirs[mid]->ino < ino) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < st->ndirs && st->dirs[lo]->ino == ino) ? st->dirs[lo] : NULL;
+}
+
+// --- Passada 0: metadados dos grupos ---
+
+static void claim_metadata(struct check_state *st, unsigned int group, uint32_t first, uint32_t count, const char *what) {
+    for (uint32_t b = first; b < first + count; b++) {
+        if (b >= st->fs->sb.s_blocks_count) {
+            report(st, group, 0, "Grupo %u: %s no bloco %u, fora da imagem", group, what, b);
+            return;
+        }
+        if (test_and_set_bit(st->block_used, b)) {
+            report(st, group, 0, "Grupo %u: %s no bloco %u, sobreposto a outro metadado", group, what, b);
+        }
+    }
+}
+
+static void pass_metadata(struct check_state *st, unsigned int group) {
+    ext2_fs *fs = st->fs;
+    if (group_has_super(fs, group)) {
+        uint32_t gdt_blocks = (fs->group_count * sizeof(ext2_group_desc) + fs->block_size - 1) / fs->block_size;
+        if (fs->sb.s_feature_compat & EXT2_FEATURE_COMPAT_RESIZE_INODE) gdt_blocks += fs->sb.s_reserved_gdt_blocks;
+        claim_metadata(st, group, group_first_block(fs, group), 1 + gdt_blocks, "superbloco/GDT");
+    }
+    uint32_t itb = (fs->sb.s_inodes_per_group + fs->inodes_per_block - 1) / fs->inodes_per_block;
+    claim_metadata(st, group, fs->gd[group].bg_block_bitmap, 1, "bitmap de blocos");
+    claim_metadata(st, group, fs->gd[group].bg_inode_bitmap, 1, "bitmap de inodes");
+    claim_metadata(st, group, fs->gd[group].bg_inode_table, itb, "tabela de inodes");
+}
+
+// --- Passada 1: tabelas de inodes e mapas de blocos ---
+
+// Marca um bloco do inode. Retorna 0 se o ponteiro é válido.
+static int claim_block(struct check_state *st, unsigned int group, uint32_t ino, uint32_t blk, int shared) {
+    if (blk < st->fs->sb.s_first_data_block || blk >= st->fs->sb.s_blocks_count) {
+        report(st, group, 0, "Inode %u: ponteiro para o bloco %u, fora da imagem", ino, blk);
+        return -1;
+    }
+    if (test_and_set_bit(st->block_used, blk) && !shared) {
+        report(st, group, 0, "Inode %u: bloco %u já pertence a outro inode ou metadado", ino, blk);
+    }
+    return 0;
+}
+
+// Marca o bloco e, se for indireto, tudo o que ele aponta. Retorna os blocos marcados.
+static uint64_t walk_map(struct check_state *st, unsigned int group, uint32_t ino,
+                         uint32_t blk, int level, char *bufs) {
+    if (blk == 0 || claim_block(st, group, ino, blk, 0) != 0) return 0;
+    if (level == 0) return 1;
+
+    ext2_fs *fs = st->fs;
+    uint32_t *ptrs = (uint32_t *)(bufs + (size_t)(level - 1) * fs->block_size);
+    if (read_block_as(fs, blk, ptrs, EXT2_IO_INDIRECT) != 0) return 1;
+    uint64_t count = 1;
+    for (unsigned int i = 0; i < fs->block_size / 4; i++) {
+        count += walk_map(st, group, ino, ptrs[i], level - 1, bufs);
+    }
+    return count;
+}
+
+static void add_dir(struct check_group *g, uint32_t ino, const ext2_inode *inode) {
+    if (g->ndirs == g->dirs_cap) {
+        g->dirs_cap = g->dirs_cap ? g->dirs_cap * 2 : 64;
+        g->dirs = realloc(g->dirs, g->dirs_cap * sizeof(struct check_dir));
+    }
+    g->dirs[g->ndirs++] = (struct check_dir){ ino, 0, 0, *inode };
+}
+
+static void pass_inodes(struct check_state *st, unsigned int group) {
+    ext2_fs *fs = st->fs;
+    struct check_group *g = &st->groups[group];
+    uint32_t ipg = fs->sb.s_inodes_per_group;
+    uint32_t itb = (ipg + fs->inodes_per_block - 1) / fs->inodes_per_block;
+    char *table = malloc((size_t)itb * fs->block_size);
+    char *bufs = malloc(3 * (size_t)fs->block_size);
+
+    if (!table || !bufs || read_blocks(fs, fs->gd[group].bg_inode_table, itb, table, EXT2_IO_INODE) != 0) {
+        report(st, group, 0, "Grupo %u: falha ao ler a tabela de inodes", group);
+        free(table);
+        free(bufs);
+        return;
+    }
+
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < ipg; i++) {
+        uint32_t ino = group * ipg + i + 1;
+        if (ino > fs->sb.s_inodes_count) break;
+        ext2_inode *inode = (ext2_inode *)(table + (size_t)i * sizeof(ext2_inode));
+        int reserved = ino < st->first_ino;
+        if (!reserved && inode->i_links_count == 0) {
+            // Inode liberado sem dtime (o e2fsck o trata como apagado pela metade)
+            if (inode->i_mode && inode->i_dtime == 0) {
+                if (st->repair) {
+                    ext2_inode fresh;
+                    get_inode(fs, ino, &fresh);
+                    fresh.i_dtime = (uint32_t)time(NULL);
+                    write_inode(fs, ino, &fresh);
+                }
+                report(st, group, st->repair, "Inode %u: livre, mas com dtime zero", ino);
+            }
+            continue;
+        }
+
+        used++;
+        test_and_set_bit(st->inode_used, ino - 1);
+        st->links[ino - 1] = inode->i_links_count;
+
+        uint16_t type = inode->i_mode & EXT2_S_IFMT;
+        if (type == EXT2_S_IFDIR) {
+            test_and_set_bit(st->inode_dir, ino - 1);
+            add_dir(g, ino, inode);
+        }
+
+        uint32_t acl_sectors = inode->i_file_acl ? fs->block_size / 512 : 0;
+        if (inode->i_file_acl) claim_block(st, group, ino, inode->i_file_acl, 1); // Bloco de atributos pode ser compartilhado
+
+        if (ino == EXT2_RESIZE_INO && (fs->sb.s_feature_compat & EXT2_FEATURE_COMPAT_RESIZE_INODE)) {
+            // Os blocos de GDT reservados já foram marcados na passada 0
+            if (inode->i_block[EXT2_DIND_BLOCK]) claim_block(st, group, ino, inode->i_block[EXT2_DIND_BLOCK], 0);
+            continue;
+        }
+        // Links simbólicos rápidos guardam o destino em i_block; dispositivos, o número
+        int has_map = type == EXT2_S_IFREG || type == EXT2_S_IFDIR || reserved ||
+                      (type == EXT2_S_IFLNK && inode->i_blocks > acl_sectors);
+        if (!has_map) continue;
+
+        uint64_t count = 0;
+        for (int b = 0; b < EXT2_NDIR_BLOCKS; b++) count += walk_map(st, group, ino, inode->i_block[b], 0, bufs);
+        for (int level = 1; level <= 3; level++) {
+            count += walk_map(st, group, ino, inode->i_block[EXT2_IND_BLOCK + level - 1], level, bufs);
+        }
+
+        uint64_t sectors = count * (fs->block_size / 512) + acl_sectors;
+        if (!reserved && sectors != inode->i_blocks) {
+            int fixed = 0;
+            if (st->repair) {
+                ext2_inode fresh;
+                get_inode(fs, ino, &fresh);
+                fresh.i_blocks = (uint32_t)sectors;
+                write_inode(fs, ino, &fresh);
+                fixed = 1;
+            }
+            report(st, group, fixed, "Inode %u: i_blocks %u, mas o mapa tem %llu setores",
+                   ino, inode->i_blocks, (unsigned long long)sectors);
+        }
+    }
+
+    g->free_inodes = ipg - used;
+    g->used_dirs = (uint32_t)g->ndirs;
+    free(table);
+    free(bufs);
+}
+
+// --- Passada 2: diretórios ---
+
+struct dir_walk {
+    struct check_state *st;
+    unsigned int group;
+    struct check_dir *dir;
+    char *buf;
+};
+
+static int check_dir_block(ext2_fs *fs, uint32_t blk, uint64_t lblk, void *arg) {
+    struct dir_walk *w = arg;
+    struct check_state *st = w->st;
+    struct check_dir *dir = w->dir;
+    if (blk == 0) {
+        report(st, w->group, 0, "Diretório %u: bloco lógico %llu sem bloco físico", dir->ino, (unsigned long long)lblk);
+        return 0;
+    }
+    if (read_block_as(fs, blk, w->buf, EXT2_IO_DIR) != 0) return 0;
+
+    int modified = 0;
+    unsigned int index = 0;
+    for (unsigned int off = 0; off < fs->block_size; index++) {
+        ext2_dir_entry_2 *de = (ext2_dir_entry_2 *)(w->buf + off);
+        if (de->rec_len < 8 || de->rec_len % 4 != 0 || off + de->rec_len > fs->block_size ||
+            de->name_len + 8u > de->rec_len) {
+            report(st, w->group, 0, "Diretório %u: entrada inválida no bloco %u (offset %u)", dir->ino, blk, off);
+            break;
+        }
+        int is_dot = lblk == 0 && index == 0;
+        int is_dotdot = lblk == 0 && index == 1;
+        off += de->rec_len;
+
+        if (is_dot && (de->name_len != 1 || de->name[0] != '.' || de->inode != dir->ino)) {
+            report(st, w->group, 0, "Diretório %u: primeira entrada não é \".\"", dir->ino);
+        }
+        if (is_dotdot && (de->name_len != 2 || memcmp(de->name, "..", 2) != 0)) {
+            report(st, w->group, 0, "Diretório %u: segunda entrada não é \"..\"", dir->ino);
+            is_dotdot = 0;
+        }
+        if (de->inode == 0) continue;
+
+        if (de->inode > fs->sb.s_inodes_count || !test_bit(st->inode_used, de->inode - 1)) {
+            int fixed = st->repair && !is_dot && !is_dotdot;
+            report(st, w->group, fixed, "Diretório %u: entrada '%.*s' aponta para o inode livre %u",
+                   dir->ino, de->name_len, de->name, de->inode);
+            if (fixed) {
+                de->inode = 0;
+                modified = 1;
+            }
+            continue;
+        }
+
+        __atomic_fetch_add(&st->refs[de->inode - 1], 1, __ATOMIC_RELAXED);
+        if (is_dotdot) {
+            dir->dotdot = de->inode;
+        } else if (!is_dot && test_bit(st->inode_dir, de->inode - 1)) {
+            struct check_dir *child = find_dir(st, de->inode);
+            uint32_t expected = 0;
+            if (child && !__atomic_compare_exchange_n(&child->parent, &expected, dir->ino, 0,
+                                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                report(st, w->group, 0, "Diretório %u: também tem entrada em %u e %u",
+                       de->inode, expected, dir->ino);
+            }
+        }
+    }
+    if (modified) write_block(fs, blk, w->buf);
+    return 0;
+}
+
+static void pass_dirs(struct check_state *st, unsigned int group) {
+    ext2_fs *fs = st->fs;
+    struct check_group *g = &st->groups[group];
+    struct dir_walk w = { st, group, NULL, malloc(fs->block_size) };
+    if (!w.buf) return;
+
+    for (size_t i = 0; i < g->ndirs; i++) {
+        w.dir = &g->dirs[i];
+        uint64_t nblocks = inode_file_size(fs, &w.dir->inode) / fs->block_size;
+        walk_file_blocks(fs, &w.dir->inode, nblocks, check_dir_block, &w);
+    }
+    free(w.buf);
+}
+
+// --- Passada 3: ".." ---
+
+static int rewrite_dotdot(struct check_state *st, struct check_dir *dir, uint32_t parent) {
+    ext2_fs *fs = st->fs;
+    uint32_t blk = inode_bmap(fs, &dir->inode, 0);
+    char buf[fs->block_size];
+    if (blk == 0 || read_block_as(fs, blk, buf, EXT2_IO_DIR) != 0) return 0;
+
+    ext2_dir_entry_2 *dot = (ext2_dir_entry_2 *)buf;
+    if (dot->rec_len < 8 || dot->rec_len + 12u > fs->block_size) return 0;
+    ext2_dir_entry_2 *dotdot = (ext2_dir_entry_2 *)(buf + dot->rec_len);
+    if (dotdot->name_len != 2 || memcmp(dotdot->name, "..", 2) != 0) return 0;
+    dotdot->inode = parent;
+    write_block(fs, blk, buf);
+    return 1;
+}
+
+static void pass_dotdot(struct check_state *st, unsigned int group) {
+    struct check_group *g = &st->groups[group];
+    for (size_t i = 0; i < g->ndirs; i++) {
+        struct check_dir *dir = &g->dirs[i];
+        uint32_t parent = dir->ino == EXT2_ROOT_INO ? EXT2_ROOT_INO : dir->parent;
+        if (parent == 0) {
+            report(st, group, 0, "Diretório %u: nenhum diretório tem entrada para ele", dir->ino);
+            continue;
+        }
+        if (dir->dotdot == parent) continue;
+
+        int fixed = st->repair && rewrite_dotdot(st, dir, parent);
+        report(st, group, fixed, "Diretório %u: \"..\" aponta para %u, mas o pai é %u", dir->ino, dir->dotdot, parent);
+        if (fixed) {
+            if (dir->dotdot) __atomic_fetch_sub(&st->refs[dir->dotdot - 1], 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&st->refs[parent - 1], 1, __ATOMIC_RELAXED);
+            dir->dotdot = parent;
+        }
+    }
+}
+
+// --- Passada 4: links, bitmaps e contadores ---
+
+static void check_links(struct check_state *st, unsigned int group) {
+    ext2_fs *fs = st->fs;
+    uint32_t ipg = fs->sb.s_inodes_per_group;
+    for (uint32_t i = 0; i < ipg; i++) {
+        uint32_t ino = group * ipg + i + 1;
+        if (ino > fs->sb.s_inodes_count) break;
+        if (!test_bit(st->inode_used, ino - 1) || (ino < st->first_ino && ino != EXT2_ROOT_INO)) continue;
+
+        uint16_t refs = __atomic_load_n(&st->refs[ino - 1], __ATOMIC_RELAXED);
+        if (refs == 0 && !test_bit(st->inode_dir, ino - 1)) {
+            // Arquivo sem nenhuma entrada: vai para /lost+found/#<inode>
+            ext2_inode inode;
+            get_inode(fs, ino, &inode);
+            char name[16];
+            snprintf(name, sizeof(name), "#%u", ino);
+            uint8_t type = (inode.i_mode & EXT2_S_IFMT) == EXT2_S_IFREG ? EXT2_FT_REG_FILE : EXT2_FT_UNKNOWN;
+            int fixed = st->repair && st->lost_found &&
+                        add_dir_entry(fs, st->lost_found, ino, name, type) == 0;
+            report(st, group, fixed, "Inode %u: em uso, mas sem nenhuma entrada de diretório", ino);
+            if (!fixed) continue;
+            refs = 1;
+        }
+
+        if (refs != st->links[ino - 1]) {
+            int fixed = 0;
+            if (st->repair) {
+                ext2_inode inode;
+                get_inode(fs, ino, &inode);
+                inode.i_links_count = refs;
+                if (refs == 0) inode.i_dtime = (uint32_t)time(NULL);   // Sem entradas: o inode é liberado
+                write_inode(fs, ino, &inode);
+                fixed = 1;
+            }
+            report(st, group, fixed, "Inode %u: contador de links %u, mas há %u entradas", ino, st->links[ino - 1], refs);
+        }
+    }
+}
+
+// Compara os `nbits` primeiros bits; retorna quantos diferem e quantos estão marcados em calc
+static uint32_t diff_bits(const uint8_t *disk, const uint8_t *calc, uint32_t nbits, uint32_t *calc_set) {
+    uint32_t diff = 0, set = 0;
+    for (uint32_t i = 0; i < nbits; i++) {
+        int d = (disk[i >> 3] >> (i & 7)) & 1;
+        int c = (calc[i >> 3] >> (i & 7)) & 1;
+        diff += d != c;
+        set += c;
+    }
+    *calc_set = set;
+    return diff;
+}
+
+static void check_bitmaps(struct check_state *st, unsigned int group) {
+    ext2_fs *fs = st->fs;
+    struct check_group *g = &st->groups[group];
+    uint8_t disk[fs->block_size], calc[fs->block_size];
+    uint32_t set;
+
+    // Bitmap de blocos: bits além do fim do grupo ficam marcados, como no mke2fs
+    uint32_t first = group_first_block(fs, group), nblocks = group_blocks(fs, group);
+    memset(calc, 0xFF, fs->block_size);
+    for (uint32_t i = 0; i < nblocks; i++) {
+        if (!test_bit(st->block_used, first + i)) calc[i >> 3] &= ~(1 << (i & 7));
+    }
+    read_block(fs, fs->gd[group].bg_block_bitmap, disk);
+    uint32_t diff = diff_bits(disk, calc, nblocks, &set);
+    g->free_blocks = nblocks - set;
+    if (diff) {
+        if (st->repair) {
+            pthread_mutex_lock(&fs->group_locks[group]);
+            write_block(fs, fs->gd[group].bg_block_bitmap, calc);
+            pthread_mutex_unlock(&fs->group_locks[group]);
+        }
+        report(st, group, st->repair, "Grupo %u: bitmap de blocos difere do uso real em %u blocos", group, diff);
+    }
+
+    // Bitmap de inodes
+    uint32_t ipg = fs->sb.s_inodes_per_group;
+    memset(calc, 0xFF, fs->block_size);
+    for (uint32_t i = 0; i < ipg; i++) {
+        if (!test_bit(st->inode_used, group * ipg + i)) calc[i >> 3] &= ~(1 << (i & 7));
+    }
+    read_block(fs, fs->gd[group].bg_inode_bitmap, disk);
+    diff = diff_bits(disk, calc, ipg, &set);
+    if (diff) {
+        if (st->repair) {
+            pthread_mutex_lock(&fs->group_locks[group]);
+            write_block(fs, fs->gd[group].bg_inode_bitmap, calc);
+            pthread_mutex_unlock(&fs->group_locks[group]);
+        }
+        report(st, group, st->repair, "Grupo %u: bitmap de inodes difere do uso real em %u inodes", group, diff);
+    }
+
+    // Contadores do descritor
+    pthread_mutex_lock(&fs->group_locks[group]);
+    ext2_group_desc *gd = &fs->gd[group];
+    uint32_t disk_free_blocks = gd->bg_free_blocks_count;
+    uint32_t disk_free_inodes = gd->bg_free_inodes_count;
+    uint32_t disk_dirs = gd->bg_used_dirs_count;
+    int counters = disk_free_blocks != g->free_blocks || disk_free_inodes != g->free_inodes || disk_dirs != g->used_dirs;
+    if (counters && st->repair) {
+        gd->bg_free_blocks_count = g->free_blocks;
+        gd->bg_free_inodes_count = g->free_inodes;
+        gd->bg_used_dirs_count = g->used_dirs;
+    }
+    pthread_mutex_unlock(&fs->group_locks[group]);
+    if (counters) {
+        report(st, group, st->repair, "Grupo %u: contadores (livres/inodes livres/diretórios) %u/%u/%u, reais %u/%u/%u",
+               group, disk_free_blocks, disk_free_inodes, disk_dirs, g->free_blocks, g->free_inodes, g->used_dirs);
+    }
+}
+
+static void pass_counts(struct check_state *st, unsigned int group) {
+    check_links(st, group);
+    check_bitmaps(st, group);
+}
+
+// --- Execução ---
+
+static void *pass_worker(void *arg) {
+    struct check_state *st = arg;
+    for (;;) {
+        unsigned int group = __atomic_fetch_add(&st->next, 1, __ATOMIC_RELAXED);
+        if (group >= st->fs->group_count) break;
+        st->pass(st, group);
+    }
+    return NULL;
+}
+
+static int run_pass(struct check_state *st, void (*pass)(struct check_state *, unsigned int),
+                    int threads, FILE *out) {
+    pthread_t tids[threads];
+    int started = 0;
+    st->pass = pass;
+    st->next = 0;
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&tids[started], NULL, pass_worker, st) == 0) started++;
+    }
+    pass_worker(st); // A thread principal também trabalha
+    for (int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+    return flush_logs(st, out);
+}
+
+// Junta os diretórios de todos os grupos em um índice ordenado por inode
+static int index_dirs(struct check_state *st) {
+    size_t total = 0;
+    for (unsigned int g = 0; g < st->fs->group_count; g++) total += st->groups[g].ndirs;
+    st->dirs = malloc((total + 1) * sizeof(struct check_dir *));
+    if (!st->dirs) return -1;
+    for (unsigned int g = 0; g < st->fs->group_count; g++) {
+        for (size_t i = 0; i < st->groups[g].ndirs; i++) st->dirs[st->ndirs++] = &st->groups[g].dirs[i];
+    }
+    return 0;
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+int ext2_check(ext2_fs *fs, int repair, int threads, FILE *out) {
+    double start = now_ms();
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    if ((unsigned int)threads > fs->group_count) threads = (int)fs->group_count;
+
+    uint32_t nblocks = fs->sb.s_blocks_count, ninodes = fs->sb.s_inodes_count;
+    struct check_state st = {0};
+    st.fs = fs;
+    st.repair = repair;
+    st.first_ino = fs->sb.s_rev_level >= 1 ? fs->sb.s_first_ino : 11;
+    st.block_used = calloc(nblocks / 8 + 1, 1);
+    st.inode_used = calloc(ninodes / 8 + 1, 1);
+    st.inode_dir = calloc(ninodes / 8 + 1, 1);
+    st.links = calloc(ninodes, sizeof(uint16_t));
+    st.refs = calloc(ninodes, sizeof(uint16_t));
+    st.groups = calloc(fs->group_count, sizeof(struct check_group));
+
+    int ret = -1;
+    if (!st.block_used || !st.inode_used || !st.inode_dir || !st.links || !st.refs || !st.groups ||
+        open_logs(&st) != 0) {
+        fprintf(out, "check: memória insuficiente\n");
+        goto out;
+    }
+    if (repair) st.lost_found = search_directory(fs, EXT2_ROOT_INO, "lost+found");
+
+    fprintf(out, "Verificando %u grupos com %d threads...\n", fs->group_count, threads);
+    if (run_pass(&st, pass_metadata, threads, out) != 0 ||
+        run_pass(&st, pass_inodes, threads, out) != 0 || index_dirs(&st) != 0 ||
+        run_pass(&st, pass_dirs, threads, out) != 0 ||
+        run_pass(&st, pass_dotdot, threads, out) != 0 ||
+        run_pass(&st, pass_counts, threads, out) != 0) {
+        fprintf(out, "check: memória insuficiente\n");
+        goto out;
+    }
+
+    // Totais do superbloco
+    uint32_t free_blocks = 0, free_inodes = 0;
+    unsigned int problems = 0, fixed = 0;
+    for (unsigned int g = 0; g < fs->group_count; g++) {
+        free_blocks += st.groups[g].free_blocks;
+        free_inodes += st.groups[g].free_inodes;
+        problems += st.groups[g].problems;
+        fixed += st.groups[g].fixed;
+    }
+    uint32_t sb_blocks = __atomic_load_n(&fs->free_blocks, __ATOMIC_RELAXED);
+    uint32_t sb_inodes = __atomic_load_n(&fs->free_inodes, __ATOMIC_RELAXED);
+    if (sb_blocks != free_blocks || sb_inodes != free_inodes) {
+        problems++;
+        if (repair) {
+            __atomic_store_n(&fs->free_blocks, free_blocks, __ATOMIC_RELAXED);
+            __atomic_store_n(&fs->free_inodes, free_inodes, __ATOMIC_RELAXED);
+            fixed++;
+        }
+        fprintf(out, "Superbloco: %u blocos e %u inodes livres, reais %u e %u%s\n",
+                sb_blocks, sb_inodes, free_blocks, free_inodes, repair ? " (corrigido)" : "");
+    }
+    if (repair && fixed > 0) {
+        write_group_descriptors(fs);
+        write_superblock(fs);
+    }
+
+    fprintf(out, "%u/%u inodes, %u/%u blocos em uso, %zu diretórios\n",
+            ninodes - free_inodes, ninodes, nblocks - free_blocks, nblocks, st.ndirs);
+    if (problems == 0) fprintf(out, "Nenhum problema encontrado");
+    else fprintf(out, "%u problemas encontrados, %u corrigidos", problems, fixed);
+    fprintf(out, " (%.1f s)\n", (now_ms() - start) / 1000.0);
+    ret = (int)problems;
+
+out:
+    if (st.groups) {
+        for (unsigned int g = 0; g < fs->group_count; g++) {
+            if (st.groups[g].log) fclose(st.groups[g].log);
+            free(st.groups[g].log_buf);
+            free(st.groups[g].dirs);
+        }
+    }
+    free(st.groups);
+    free(st.dirs);
+    free(st.block_used);
+    free(st.inode_used);
+    free(st.inode_dir);
+    free(st.links);
+    free(st.refs);
+    return ret;
+}
@@ -0,0 +1,36 @@
+#ifndef _EXT2_CHECK_H_
+#define _EXT2_CHECK_H_
+
+#include <stdio.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+/*
+function: Verifica a consistência do sistema de arquivos (como o e2fsck).
+param:
+  - repair: 1 para corrigir o que for possível, 0 para apenas relatar.
+  - threads: Quantidade de threads (0 = uma por CPU).
+  - out: Onde o relatório é escrito.
+return:
+  - Quantidade de problemas encontrados (0 = consistente) ou -1 em erro.
+observações:
+  - Cada passada é distribuída entre as threads por grupo de blocos:
+    0. Metadados de cada grupo (superbloco, GDT, bitmaps, tabela de inodes).
+    1. Tabelas de inodes (lidas inteiras, em sequência) e mapas de blocos:
+       monta em memória os bitmaps de uso reais, conferindo blocos fora da
+       imagem, blocos com dois donos e i_blocks.
+    2. Diretórios: entradas válidas, "." e "..", e quantas entradas apontam
+       para cada inode.
+    3. ".." de cada diretório contra o diretório que o contém.
+    4. Contadores de links, bitmaps e contadores livres dos grupos; por fim,
+       os totais do superbloco.
+  - Com repair: grava bitmaps e contadores calculados, corrige i_links_count,
+    i_blocks e "..", remove entradas que apontam para inodes livres e liga
+    arquivos sem nenhuma entrada em /lost+found. Blocos com dois donos ou fora
+    da imagem são apenas relatados.
+  - Não deve rodar junto com comandos que alteram a imagem (no servidor e no
+    modo lote o comando check é executado com exclusividade).
+*/
+int ext2_check(ext2_fs *fs, int repair, int threads, FILE *out);
+
+#endif
@@ -1,26 +1,52 @@
+#include <errno.h>
 #include "ext2_commands.h"
+#include "ext2_file.h"
+#include "ext2_check.h"
+#include "ext2_defrag.h"
+#include "ext2_freefrag.h"
+#include "ext2_du.h"
+#include "ext2_populate.h"
+
+// Saída dos comandos da thread atual (NULL = stdout/stderr)
+static __thread FILE *out_stream;
+static __thread FILE *err_stream;
+
+void commands_set_output(FILE *out, FILE *err) {
+    out_stream = out;
+    err_stream = err;
+}
+
+static FILE *cmd_out(void) {
+    return out_stream ? out_stream : stdout;
+}
+
+static FILE *cmd_err(void) {
+    return err_stream ? err_stream : stderr;
+}
 
 // --- Comandos de Leitura ---
 
-void do_info() {
-
-    printf("\nVolume name.....: %s\n", sb.s_volume_name);
-    printf("Image size......: %lu bytes\n", block_size * sb.s_blocks_count * 1UL);
-    printf("Free space......: %u KiB\n", (sb.s_free_blocks_count * block_size) / 1024);
-    printf("Free inodes.....: %u\n", sb.s_free_inodes_count);
-    printf("Free blocks.....: %u\n", sb.s_free_blocks_count);
-    printf("Block size......: %u bytes\n", block_size);
-    printf("Inode size......: %lu bytes\n", sizeof(ext2_inode));
-    printf("Groups count....: %u\n", sb.s_blocks_count / sb.s_blocks_per_group);
-    printf("Groups size.....: %u blocks\n", sb.s_blocks_per_group);
-    printf("Groups inodes...: %u inodes\n", sb.s_inodes_per_group);
-    printf("Inodetable size.: %lu blocks\n\n", (sb.s_inodes_per_group * sizeof(ext2_inode)) / block_size);
+void do_info(ext2_fs *fs) {
+    const ext2_super_block *sb = ext2_superblock(fs);
+    unsigned int block_size = ext2_block_size(fs);
+
+    fprintf(cmd_out(), "\nVolume name.....: %s\n", sb->s_volume_name);
+    fprintf(cmd_out(), "Image size......: %lu bytes\n", (unsigned long)block_size * sb->s_blocks_count);
+    fprintf(cmd_out(), "Free space......: %lu KiB\n", ((unsigned long)sb->s_free_blocks_count * block_size) / 1024);
+    fprintf(cmd_out(), "Free inodes.....: %u\n", sb->s_free_inodes_count);
+    fprintf(cmd_out(), "Free blocks.....: %u\n", sb->s_free_blocks_count);
+    fprintf(cmd_out(), "Block size......: %u bytes\n", block_size);
+    fprintf(cmd_out(), "Inode size......: %lu bytes\n", sizeof(ext2_inode));
+    fprintf(cmd_out(), "Groups count....: %u\n", sb->s_blocks_count / sb->s_blocks_per_group);
+    fprintf(cmd_out(), "Groups size.....: %u blocks\n", sb->s_blocks_per_group);
+    fprintf(cmd_out(), "Groups inodes...: %u inodes\n", sb->s_inodes_per_group);
+    fprintf(cmd_out(), "Inodetable size.: %lu blocks\n\n", (sb->s_inodes_per_group * sizeof(ext2_inode)) / block_size);
 }
 
-void do_attr(unsigned int inode_num) {
+void do_attr(ext2_fs *fs, unsigned int inode_num) {
     ext2_inode inode;
-    if (get_inode(inode_num, &inode) != 0) {
-        printf("Erro: Não foi possível obter o inode %u\n", inode_num);
+    if (get_inode(fs, inode_num, &inode) != 0) {
+        fprintf(cmd_out(), "Erro: Não foi possível obter o inode %u\n", inode_num);
         return;
     }
 
@@ -40,18 +66,21 @@ void do_attr(unsigned int inode_num) {
 
     // Formatar tamanho (sempre em KiB para diretórios)
     char size_str[32];
-    if (inode.i_size < 1024) {
-        snprintf(size_str, sizeof(size_str), "%u bytes", inode.i_size);
-    } else if (inode.i_size < 1024 * 1024) {
-        snprintf(size_str, sizeof(size_str), "%.1f KiB", inode.i_size / 1024.0);
+    uint64_t size = inode_file_size(fs, &inode);
+    if (size < 1024) {
+        snprintf(size_str, sizeof(size_str), "%lu bytes", (unsigned long)size);
+    } else if (size < 1024 * 1024) {
+        snprintf(size_str, sizeof(size_str), "%.1f KiB", size / 1024.0);
+    } else if (size < 1024ULL * 1024 * 1024) {
+        snprintf(size_str, sizeof(size_str), "%.1f MiB", size / (1024.0 * 1024.0));
     } else {
-        snprintf(size_str, sizeof(size_str), "%.1f MiB", inode.i_size / (1024.0 * 1024.0));
+        snprintf(size_str, sizeof(size_str), "%.1f GiB", size / (1024.0 * 1024.0 * 1024.0));
     }
 
     // Formatar data (corrigindo fuso horário)
     char date_buf[64];
     if (inode.i_mtime == 0) {
-        printf("%d", inode.i_mtime);
+        fprintf(cmd_out(), "%d", inode.i_mtime);
         strcpy(date_buf, "não modificado");
     } else {
         time_t mtime = inode.i_mtime;
@@ -60,21 +89,22 @@ void do_attr(unsigned int inode_num) {
     }
 
     // Saída formatada exatamente como solicitado
-    printf("Permissões UID    GID    Tamanho      Modificado em    \n");
-    printf("%-11s %-6u %-6u %-12s %s\n", 
+    fprintf(cmd_out(), "Permissões UID    GID    Tamanho      Modificado em    \n");
+    fprintf(cmd_out(), "%-11s %-6u %-6u %-12s %s\n", 
            permissions, inode.i_uid, inode.i_gid, size_str, date_buf);
 }
 
-void do_ls(unsigned int dir_inode_num) {
+void do_ls(ext2_fs *fs, unsigned int dir_inode_num) {
+    unsigned int block_size = ext2_block_size(fs);
     ext2_inode dir_inode;
-    get_inode(dir_inode_num, &dir_inode);
+    get_inode(fs, dir_inode_num, &dir_inode);
     if (!(dir_inode.i_mode & EXT2_S_IFDIR)) {
-        printf("ls: não é um diretório\n");
+        fprintf(cmd_out(), "ls: não é um diretório\n");
         return;
     }
     char block_buf[block_size];
     for (int i = 0; i < 12 && dir_inode.i_block[i] != 0; ++i) {
-        read_block(dir_inode.i_block[i], block_buf);
+        read_block_as(fs, dir_inode.i_block[i], block_buf, EXT2_IO_DIR);
         ext2_dir_entry_2 *entry = (  ext2_dir_entry_2 *)block_buf;
         unsigned int offset = 0;
         while (offset < block_size && entry->rec_len > 0) {
@@ -82,119 +112,47 @@ void do_ls(unsigned int dir_inode_num) {
                 char name[entry->name_len + 1];
                 memcpy(name, entry->name, entry->name_len);
                 name[entry->name_len] = '\0';
-                printf("%s\n", name);
-                printf("inode: %u\n", entry->inode);
-                printf("record length: %u\n", entry->rec_len);
-                printf("name length: %u\n", entry->name_len);
-                printf("file type: %u\n\n", entry->file_type);
+                fprintf(cmd_out(), "%s\n", name);
+                fprintf(cmd_out(), "inode: %u\n", entry->inode);
+                fprintf(cmd_out(), "record length: %u\n", entry->rec_len);
+                fprintf(cmd_out(), "name length: %u\n", entry->name_len);
+                fprintf(cmd_out(), "file type: %u\n\n", entry->file_type);
             }
             offset += entry->rec_len;
             entry = (  ext2_dir_entry_2 *)((char *)block_buf + offset);
         }
     }
-    printf("\n");
+    fprintf(cmd_out(), "\n");
 }
 
-void do_cat(unsigned int file_inode_num) {
+void do_cat(ext2_fs *fs, unsigned int file_inode_num) {
     ext2_inode file_inode;
-    if (get_inode(file_inode_num, &file_inode) != 0) {
-        printf("Erro: Não foi possível ler o inode %u\n", file_inode_num);
+    if (get_inode(fs, file_inode_num, &file_inode) != 0) {
+        fprintf(cmd_out(), "Erro: Não foi possível ler o inode %u\n", file_inode_num);
         return;
     }
 
     if (!(file_inode.i_mode & EXT2_S_IFREG)) {
-        printf("cat: %u não é um arquivo regular\n", file_inode_num);
+        fprintf(cmd_out(), "cat: %u não é um arquivo regular\n", file_inode_num);
         return;
     }
 
-    char *block_buf = malloc(block_size);
-    if (!block_buf) {
-        printf("Erro: Falha ao alocar memória\n");
+    if (copy_inode_to_file(fs, &file_inode, cmd_out()) != 0) {
+        fprintf(cmd_out(), "Erro: Falha ao ler o conteúdo do inode %u\n", file_inode_num);
         return;
     }
-
-    unsigned int bytes_remaining = file_inode.i_size;
-    
-    // 1. Ler blocos diretos (0-11)
-    for (int i = 0; i < 12 && file_inode.i_block[i] != 0 && bytes_remaining > 0; i++) {
-        read_block(file_inode.i_block[i], block_buf);
-        unsigned int bytes_to_write = (bytes_remaining > block_size) ? block_size : bytes_remaining;
-        fwrite(block_buf, 1, bytes_to_write, stdout);
-        bytes_remaining -= bytes_to_write;
-    }
-
-    // 2. Ler bloco indireto simples (12)
-    if (bytes_remaining > 0 && file_inode.i_block[12] != 0) {
-        uint32_t *indirect_block = malloc(block_size);
-        if (!indirect_block) {
-            free(block_buf);
-            printf("Erro: Falha ao alocar memória para bloco indireto\n");
-            return;
-        }
-
-        read_block(file_inode.i_block[12], (char *)indirect_block);
-        
-        int entries_per_block = block_size / sizeof(uint32_t);
-        for (int i = 0; i < entries_per_block && indirect_block[i] != 0 && bytes_remaining > 0; i++) {
-            read_block(indirect_block[i], block_buf);
-            unsigned int bytes_to_write = (bytes_remaining > block_size) ? block_size : bytes_remaining;
-            fwrite(block_buf, 1, bytes_to_write, stdout);
-            bytes_remaining -= bytes_to_write;
-        }
-        
-        free(indirect_block);
-    }
-
-    if (bytes_remaining > 0 && file_inode.i_block[13] != 0) {
-        uint32_t *double_indirect = malloc(block_size);
-        if (!double_indirect) {
-            free(block_buf);
-            printf("Erro: Falha ao alocar memória para bloco duplamente indireto\n");
-            return;
-        }
-
-        read_block(file_inode.i_block[13], (char *)double_indirect);
-        int entries_per_block = block_size / sizeof(uint32_t);
-
-        for (int i = 0; i < entries_per_block && bytes_remaining > 0; i++) {
-            if (double_indirect[i] == 0) continue;
-
-            uint32_t *indirect = malloc(block_size);
-            if (!indirect) {
-                free(double_indirect);
-                free(block_buf);
-                printf("Erro: Falha ao alocar memória para nível 2\n");
-                return;
-            }
-
-            read_block(double_indirect[i], (char *)indirect);
-            for (int j = 0; j < entries_per_block && bytes_remaining > 0; j++) {
-                if (indirect[j] == 0) continue;
-
-                read_block(indirect[j], block_buf);
-                unsigned int bytes_to_write = (bytes_remaining > block_size) ? block_size : bytes_remaining;
-                fwrite(block_buf, 1, bytes_to_write, stdout);
-                bytes_remaining -= bytes_to_write;
-            }
-            free(indirect);
-        }
-
-        free(double_indirect);
-    }
-
-    free(block_buf);
-    printf("\n"); // Adiciona nova linha no final
+    fprintf(cmd_out(), "\n"); // Adiciona nova linha no final
 }
 
-void do_touch(unsigned int parent_inode_num, const char* filename) {
-    if (find_inode_by_path(filename, parent_inode_num) != 0) {
-        fprintf(stderr, "touch: arquivo '%s' já existe\n", filename);
+void do_touch(ext2_fs *fs, unsigned int parent_inode_num, const char* filename) {
+    if (find_inode_by_path(fs, filename, parent_inode_num) != 0) {
+        fprintf(cmd_err(), "touch: arquivo '%s' já existe\n", filename);
         return;
     }
 
-    unsigned int new_inode_num = alloc_inode();
+    unsigned int new_inode_num = alloc_inode(fs);
     if (new_inode_num == 0) {
-        fprintf(stderr, "touch: falha ao alocar inode\n");
+        fprintf(cmd_err(), "touch: falha ao alocar inode\n");
         return;
     }
 
@@ -206,32 +164,35 @@ void do_touch(unsigned int parent_inode_num, const char* filename) {
     new_inode.i_mtime = now;
     new_inode.i_atime = now;
 
-    write_inode(new_inode_num, &new_inode);
+    write_inode(fs, new_inode_num, &new_inode);
 
-    if (add_dir_entry(parent_inode_num, new_inode_num, filename, EXT2_FT_REG_FILE) != 0) {
-        fprintf(stderr, "touch: falha ao adicionar entrada no diretório\n");
-        free_inode_resource(new_inode_num); 
+    if (add_dir_entry(fs, parent_inode_num, new_inode_num, filename, EXT2_FT_REG_FILE) != 0) {
+        fprintf(cmd_err(), "touch: falha ao adicionar entrada no diretório\n");
+        free_inode_resource(fs, new_inode_num); 
         return;
     }
 
-    printf("Arquivo '%s' criado.\n", filename);
+    fprintf(cmd_out(), "Arquivo '%s' criado.\n", filename);
 }
 
-void do_mkdir(unsigned int parent_inode_num, const char* dirname) {
-    if (find_inode_by_path(dirname, parent_inode_num) != 0) {
-        fprintf(stderr, "mkdir: diretório '%s' já existe\n", dirname);
+void do_mkdir(ext2_fs *fs, unsigned int parent_inode_num, const char* dirname) {
+    unsigned int block_size = ext2_block_size(fs);
+    if (find_inode_by_path(fs, dirname, parent_inode_num) != 0) {
+        fprintf(cmd_err(), "mkdir: diretório '%s' já existe\n", dirname);
         return;
     }
 
-    unsigned int new_inode_num = alloc_inode();
-    unsigned int new_block_num = alloc_block();
+    unsigned int new_inode_num = alloc_inode(fs);
+    unsigned int new_block_num = alloc_block(fs);
     if (new_inode_num == 0 || new_block_num == 0) {
-        fprintf(stderr, "mkdir: falha ao alocar recursos\n");
-        if (new_inode_num) free_inode_resource(new_inode_num);
-        if (new_block_num) free_block_resource(new_block_num);
+        fprintf(cmd_err(), "mkdir: falha ao alocar recursos\n");
+        if (new_inode_num) free_inode_resource(fs, new_inode_num);
+        if (new_block_num) free_block_resource(fs, new_block_num);
         return;
     }
 
+    adjust_used_dirs(fs, new_inode_num, +1);
+
     time_t now = time(NULL);
     ext2_inode new_dir_inode = {0};
     new_dir_inode.i_mode = EXT2_S_IFDIR | 0755;
@@ -243,7 +204,7 @@ void do_mkdir(unsigned int parent_inode_num, const char* dirname) {
     new_dir_inode.i_blocks = block_size / 512;
     new_dir_inode.i_block[0] = new_block_num;
 
-    write_inode(new_inode_num, &new_dir_inode);
+    write_inode(fs, new_inode_num, &new_dir_inode);
 
     // Preencher blocos com . e ..
     char block_buf[block_size];
@@ -263,295 +224,347 @@ void do_mkdir(unsigned int parent_inode_num, const char* dirname) {
     parent_entry->file_type = EXT2_FT_DIR;
     strcpy(parent_entry->name, "..");
 
-    write_block(new_block_num, block_buf);
+    write_block(fs, new_block_num, block_buf);
 
-    if (add_dir_entry(parent_inode_num, new_inode_num, dirname, EXT2_FT_DIR) != 0) return;
+    if (add_dir_entry(fs, parent_inode_num, new_inode_num, dirname, EXT2_FT_DIR) != 0) return;
 
     ext2_inode parent_inode;
-    get_inode(parent_inode_num, &parent_inode);
+    get_inode(fs, parent_inode_num, &parent_inode);
     parent_inode.i_links_count++;
-    write_inode(parent_inode_num, &parent_inode);
+    write_inode(fs, parent_inode_num, &parent_inode);
 
-    printf("Diretório '%s' criado.\n", dirname);
+    fprintf(cmd_out(), "Diretório '%s' criado.\n", dirname);
 }
 
 
-void do_rm(unsigned int parent_inode_num, const char *filename) {
-    unsigned int target_inode_num = find_inode_by_path(filename, parent_inode_num);
+void do_rm(ext2_fs *fs, unsigned int parent_inode_num, const char *filename) {
+    unsigned int target_inode_num = find_inode_by_path(fs, filename, parent_inode_num);
     if (target_inode_num == 0) {
-        fprintf(stderr, "rm: arquivo '%s' não encontrado\n", filename);
+        fprintf(cmd_err(), "rm: arquivo '%s' não encontrado\n", filename);
         return;
     }
 
     ext2_inode target_inode;
-    get_inode(target_inode_num, &target_inode);
+    get_inode(fs, target_inode_num, &target_inode);
 
     if (target_inode.i_mode & EXT2_S_IFDIR) {
-        fprintf(stderr, "rm: '%s' é um diretório. Use rmdir.\n", filename);
+        fprintf(cmd_err(), "rm: '%s' é um diretório. Use rmdir.\n", filename);
         return;
     }
 
-    if (remove_dir_entry(parent_inode_num, filename) != 0) {
-        fprintf(stderr, "rm: falha ao remover entrada de diretório\n");
+    if (remove_dir_entry(fs, parent_inode_num, filename) != 0) {
+        fprintf(cmd_err(), "rm: falha ao remover entrada de diretório\n");
         return;
     }
 
     target_inode.i_links_count--;
     if (target_inode.i_links_count == 0) {
-        free_all_blocks(&target_inode);
-        free_inode_resource(target_inode_num);
+        free_all_blocks(fs, &target_inode);
+        target_inode.i_dtime = time(NULL);
+        write_inode(fs, target_inode_num, &target_inode);
+        free_inode_resource(fs, target_inode_num);
     } else {
-        write_inode(target_inode_num, &target_inode);
+        write_inode(fs, target_inode_num, &target_inode);
     }
 
-    printf("Arquivo '%s' removido.\n", filename);
+    fprintf(cmd_out(), "Arquivo '%s' removido.\n", filename);
+}
+
+void do_rm_recursive(ext2_fs *fs, unsigned int parent_inode_num, const char *name) {
+    unsigned int files = 0, dirs = 0;
+    if (remove_tree(fs, parent_inode_num, name, &files, &dirs) != 0) {
+        fprintf(cmd_err(), "rm: não foi possível remover '%s'\n", name);
+        return;
+    }
+    fprintf(cmd_out(), "'%s' removido (%u arquivos, %u diretórios).\n", name, files, dirs);
 }
 
-void do_rmdir(unsigned int parent_inode_num, const char *dirname) {
-    unsigned int target_inode_num = find_inode_by_path(dirname, parent_inode_num);
+void do_rmdir(ext2_fs *fs, unsigned int parent_inode_num, const char *dirname) {
+    unsigned int target_inode_num = find_inode_by_path(fs, dirname, parent_inode_num);
     if (target_inode_num == 0) {
-        fprintf(stderr, "rmdir: diretório '%s' não encontrado\n", dirname);
+        fprintf(cmd_err(), "rmdir: diretório '%s' não encontrado\n", dirname);
         return;
     }
 
     ext2_inode target_inode;
-    get_inode(target_inode_num, &target_inode);
+    get_inode(fs, target_inode_num, &target_inode);
     if (!(target_inode.i_mode & EXT2_S_IFDIR)) {
-        fprintf(stderr, "rmdir: '%s' não é um diretório\n", dirname);
+        fprintf(cmd_err(), "rmdir: '%s' não é um diretório\n", dirname);
         return;
     }
 
-    if (!is_directory_empty(target_inode_num)) {
-        fprintf(stderr, "rmdir: falha ao remover '%s': Diretório não vazio\n", dirname);
+    if (!is_directory_empty(fs, target_inode_num)) {
+        fprintf(cmd_err(), "rmdir: falha ao remover '%s': Diretório não vazio\n", dirname);
         return;
     }
 
-    if (remove_dir_entry(parent_inode_num, dirname) != 0) {
-        fprintf(stderr, "rmdir: erro ao remover entrada do diretório pai\n");
+    if (remove_dir_entry(fs, parent_inode_num, dirname) != 0) {
+        fprintf(cmd_err(), "rmdir: erro ao remover entrada do diretório pai\n");
         return;
     }
 
-    free_block_resource(target_inode.i_block[0]); // Liberar bloco do diretório
-    free_inode_resource(target_inode_num);       // Liberar inode do diretório
+    free_block_resource(fs, target_inode.i_block[0]); // Liberar bloco do diretório
+    target_inode.i_links_count = 0;
+    target_inode.i_dtime = time(NULL);
+    write_inode(fs, target_inode_num, &target_inode);
+    free_inode_resource(fs, target_inode_num);       // Liberar inode do diretório
+    adjust_used_dirs(fs, target_inode_num, -1);
 
     ext2_inode parent_inode;
-    get_inode(parent_inode_num, &parent_inode);
+    get_inode(fs, parent_inode_num, &parent_inode);
     parent_inode.i_links_count--;
-    write_inode(parent_inode_num, &parent_inode);
+    write_inode(fs, parent_inode_num, &parent_inode);
 
-    printf("Diretório '%s' removido com sucesso.\n", dirname);
+    fprintf(cmd_out(), "Diretório '%s' removido com sucesso.\n", dirname);
 }
 
-void do_rename(unsigned int parent_inode_num, const char* oldname, const char* newname) {
-    unsigned int target_inode_num = find_inode_by_path(oldname, parent_inode_num);
+void do_rename(ext2_fs *fs, unsigned int parent_inode_num, const char* oldname, const char* newname) {
+    unsigned int target_inode_num = find_inode_by_path(fs, oldname, parent_inode_num);
     if (target_inode_num == 0) {
-        fprintf(stderr, "rename: '%s' não encontrado.\n", oldname);
+        fprintf(cmd_err(), "rename: '%s' não encontrado.\n", oldname);
         return;
     }
-    if (find_inode_by_path(newname, parent_inode_num) != 0) {
-        fprintf(stderr, "rename: '%s' já existe.\n", newname);
+    if (find_inode_by_path(fs, newname, parent_inode_num) != 0) {
+        fprintf(cmd_err(), "rename: '%s' já existe.\n", newname);
         return;
     }
       ext2_inode target_inode;
-    get_inode(target_inode_num, &target_inode);
+    get_inode(fs, target_inode_num, &target_inode);
     uint8_t ftype = (target_inode.i_mode & EXT2_S_IFDIR) ? EXT2_FT_DIR : EXT2_FT_REG_FILE;
 
-    if (add_dir_entry(parent_inode_num, target_inode_num, newname, ftype) != 0) return;
-    if (remove_dir_entry(parent_inode_num, oldname) != 0) return;
+    if (add_dir_entry(fs, parent_inode_num, target_inode_num, newname, ftype) != 0) return;
+    if (remove_dir_entry(fs, parent_inode_num, oldname) != 0) return;
     
-    printf("'%s' renomeado para '%s'.\n", oldname, newname);
+    fprintf(cmd_out(), "'%s' renomeado para '%s'.\n", oldname, newname);
 }
 
-void do_cp(unsigned int current_dir_inode, const char* source_in_image, const char* dest_on_host) {
-    unsigned int source_inode_num = find_inode_by_path(source_in_image, current_dir_inode);
-    if (source_inode_num == 0) {
-        printf("cp: arquivo de origem '%s' não encontrado na imagem.\n", source_in_image);
+void do_append(ext2_fs *fs, unsigned int parent_inode_num, const char *filename, const char *text) {
+    unsigned int target_inode_num = find_inode_by_path(fs, filename, parent_inode_num);
+    if (target_inode_num == 0) {
+        fprintf(cmd_err(), "append: arquivo '%s' não encontrado\n", filename);
         return;
     }
 
-      ext2_inode source_inode;
-    get_inode(source_inode_num, &source_inode);
+    ext2_file *f = ext2_file_open(fs, target_inode_num);
+    if (!f) {
+        fprintf(cmd_err(), "append: '%s' não é um arquivo regular\n", filename);
+        return;
+    }
 
-    if (!(source_inode.i_mode & EXT2_S_IFREG)) {
-        printf("cp: '%s' não é um arquivo regular.\n", source_in_image);
+    size_t len = strlen(text);
+    if (ext2_append(f, text, len) != (ssize_t)len || ext2_append(f, "\n", 1) != 1) {
+        fprintf(cmd_err(), "append: falha ao escrever em '%s'\n", filename);
+    }
+    if (ext2_file_close(f) != 0) {
+        fprintf(cmd_err(), "append: falha ao gravar '%s' no disco\n", filename);
         return;
     }
 
-    FILE* dest_file = fopen(dest_on_host, "wb");
-    if (!dest_file) {
-        perror("cp: falha ao abrir arquivo de destino no sistema");
+    fprintf(cmd_out(), "%zu bytes acrescentados a '%s'.\n", len + 1, filename);
+}
+
+void do_truncate(ext2_fs *fs, unsigned int parent_inode_num, const char *filename, uint64_t new_size) {
+    unsigned int target_inode_num = find_inode_by_path(fs, filename, parent_inode_num);
+    if (target_inode_num == 0) {
+        fprintf(cmd_err(), "truncate: arquivo '%s' não encontrado\n", filename);
         return;
     }
 
-    char *block_buf = malloc(block_size);
-    unsigned int bytes_remaining = source_inode.i_size;
+    if (ext2_truncate(fs, target_inode_num, new_size) != 0) {
+        fprintf(cmd_err(), "truncate: '%s' não é um arquivo regular\n", filename);
+        return;
+    }
 
-    //Diretos
-    for (int i = 0; i < 12 && bytes_remaining > 0; i++) {
-        if (source_inode.i_block[i] != 0) {
-            copy_block_to_file(source_inode.i_block[i], dest_file, &bytes_remaining, block_buf);
-        }
+    fprintf(cmd_out(), "Arquivo '%s' truncado para %lu bytes.\n", filename, (unsigned long)new_size);
+}
+
+void do_defrag(ext2_fs *fs, unsigned int inode_num, const char *path, int dry_run) {
+    if (ext2_defrag(fs, inode_num, path, dry_run, cmd_out()) < 0) {
+        fprintf(cmd_err(), "defrag: '%s' não é um arquivo regular nem um diretório\n", path);
     }
+}
 
-    //Indireto
-    if (bytes_remaining > 0 && source_inode.i_block[12] != 0) {
-        uint32_t *indirect_blocks = malloc(block_size);
-        read_block(source_inode.i_block[12], (char*)indirect_blocks);
-        int num_ptrs = block_size / sizeof(uint32_t);
+void do_check(ext2_fs *fs, int repair, int threads) {
+    if (ext2_check(fs, repair, threads, cmd_out()) < 0) {
+        fprintf(cmd_err(), "check: verificação interrompida\n");
+    }
+}
 
-        for (int i = 0; i < num_ptrs && bytes_remaining > 0; i++) {
-            if (indirect_blocks[i] != 0) {
-                copy_block_to_file(indirect_blocks[i], dest_file, &bytes_remaining, block_buf);
-            }
-        }
+void do_du(ext2_fs *fs, unsigned int inode_num, const char *path, int threads) {
+    if (ext2_du(fs, inode_num, path, threads, cmd_out()) < 0) {
+        fprintf(cmd_err(), "du: não foi possível percorrer '%s'\n", path);
+    }
+}
 
-        free(indirect_blocks);
+void do_freefrag(ext2_fs *fs, unsigned int alloc_blocks, int per_group) {
+    if (ext2_freefrag(fs, alloc_blocks, per_group, cmd_out()) < 0) {
+        fprintf(cmd_err(), "freefrag: não foi possível ler os bitmaps\n");
     }
+}
 
-    //Duplamente indireto
-    if (bytes_remaining > 0 && source_inode.i_block[13] != 0) {
-        uint32_t *double_indirect = malloc(block_size);
-        read_block(source_inode.i_block[13], (char*)double_indirect);
-        int num_ptrs = block_size / sizeof(uint32_t);
+void do_find(ext2_fs *fs, unsigned int inode_num, const char *path, const struct ext2_find_query *q,
+             enum ext2_find_mode mode, int threads) {
+    if (ext2_find(fs, inode_num, path, q, mode, threads, cmd_out()) < 0) {
+        fprintf(cmd_err(), "find: não foi possível percorrer '%s'\n", path);
+    }
+}
 
-        for (int i = 0; i < num_ptrs && bytes_remaining > 0; i++) {
-            if (double_indirect[i] != 0) {
-                uint32_t *indirect = malloc(block_size);
-                read_block(double_indirect[i], (char*)indirect);
+void do_verify(ext2_fs *fs, enum ext2_verify_mode mode, int threads) {
+    if (ext2_verify(fs, NULL, mode, threads, cmd_out()) < 0) {
+        fprintf(cmd_err(), "verify: verificação interrompida\n");
+    }
+}
 
-                for (int j = 0; j < num_ptrs && bytes_remaining > 0; j++) {
-                    if (indirect[j] != 0) {
-                        copy_block_to_file(indirect[j], dest_file, &bytes_remaining, block_buf);
-                    }
-                }
+void do_import(ext2_fs *fs, unsigned int dest_inode_num, const char *host_dir, const char *dest_path) {
+    ext2_inode dest;
+    if (get_inode(fs, dest_inode_num, &dest) != 0 || (dest.i_mode & EXT2_S_IFMT) != EXT2_S_IFDIR) {
+        fprintf(cmd_err(), "import: '%s' não é um diretório\n", dest_path);
+        return;
+    }
+    if (ext2_populate(fs, host_dir, dest_inode_num, cmd_out()) < 0) {
+        fprintf(cmd_err(), "import: cópia de '%s' interrompida\n", host_dir);
+    }
+}
 
-                free(indirect);
-            }
-        }
+void do_cp(ext2_fs *fs, unsigned int current_dir_inode, const char* source_in_image, const char* dest_on_host) {
+    unsigned int source_inode_num = find_inode_by_path(fs, source_in_image, current_dir_inode);
+    if (source_inode_num == 0) {
+        fprintf(cmd_out(), "cp: arquivo de origem '%s' não encontrado na imagem.\n", source_in_image);
+        return;
+    }
+
+      ext2_inode source_inode;
+    get_inode(fs, source_inode_num, &source_inode);
+
+    if (!(source_inode.i_mode & EXT2_S_IFREG)) {
+        fprintf(cmd_out(), "cp: '%s' não é um arquivo regular.\n", source_in_image);
+        return;
+    }
+
+    FILE* dest_file = fopen(dest_on_host, "wb");
+    if (!dest_file) {
+        fprintf(cmd_err(), "cp: falha ao abrir arquivo de destino no sistema: %s\n", strerror(errno));
+        return;
+    }
 
-        free(double_indirect);
+    if (copy_inode_to_file(fs, &source_inode, dest_file) != 0) {
+        fprintf(cmd_err(), "cp: erro ao ler '%s' da imagem.\n", source_in_image);
     }
 
-    free(block_buf);
     fclose(dest_file);
-    printf("Arquivo '%s' copiado para '%s'.\n", source_in_image, dest_on_host);
+    fprintf(cmd_out(), "Arquivo '%s' copiado para '%s'.\n", source_in_image, dest_on_host);
 }
 
-void cmd_print_superblock() {
+void cmd_print_superblock(ext2_fs *fs) {
     ext2_super_block sb;
-    read_superblock(&sb);
-
-    printf("inodes count: %u\n", sb.s_inodes_count);
-    printf("blocks count: %u\n", sb.s_blocks_count);
-    printf("reserved blocks count: %u\n", sb.s_r_blocks_count);
-    printf("free blocks count: %u\n", sb.s_free_blocks_count);
-    printf("free inodes count: %u\n", sb.s_free_inodes_count);
-    printf("first data block: %u\n", sb.s_first_data_block);
-    printf("block size: %u\n", 1024 << sb.s_log_block_size);
-    printf("fragment size: %u\n", 1024 << sb.s_log_frag_size);
-    printf("blocks per group: %u\n", sb.s_blocks_per_group);
-    printf("fragments per group: %u\n", sb.s_frags_per_group);
-    printf("inodes per group: %u\n", sb.s_inodes_per_group);
-    printf("mount time: %u\n", sb.s_mtime);
-    printf("write time: %u\n", sb.s_wtime);
-    printf("mount count: %u\n", sb.s_mnt_count);
-    printf("max mount count: %u\n", sb.s_max_mnt_count);
-    printf("magic signature: 0x%x\n", sb.s_magic);
-    printf("file system state: %u\n", sb.s_state);
-    printf("errors: %u\n", sb.s_errors);
-    printf("minor revision level: %u\n", sb.s_minor_rev_level);
+    read_superblock(fs, &sb);
+
+    fprintf(cmd_out(), "inodes count: %u\n", sb.s_inodes_count);
+    fprintf(cmd_out(), "blocks count: %u\n", sb.s_blocks_count);
+    fprintf(cmd_out(), "reserved blocks count: %u\n", sb.s_r_blocks_count);
+    fprintf(cmd_out(), "free blocks count: %u\n", sb.s_free_blocks_count);
+    fprintf(cmd_out(), "free inodes count: %u\n", sb.s_free_inodes_count);
+    fprintf(cmd_out(), "first data block: %u\n", sb.s_first_data_block);
+    fprintf(cmd_out(), "block size: %u\n", 1024 << sb.s_log_block_size);
+    fprintf(cmd_out(), "fragment size: %u\n", 1024 << sb.s_log_frag_size);
+    fprintf(cmd_out(), "blocks per group: %u\n", sb.s_blocks_per_group);
+    fprintf(cmd_out(), "fragments per group: %u\n", sb.s_frags_per_group);
+    fprintf(cmd_out(), "inodes per group: %u\n", sb.s_inodes_per_group);
+    fprintf(cmd_out(), "mount time: %u\n", sb.s_mtime);
+    fprintf(cmd_out(), "write time: %u\n", sb.s_wtime);
+    fprintf(cmd_out(), "mount count: %u\n", sb.s_mnt_count);
+    fprintf(cmd_out(), "max mount count: %u\n", sb.s_max_mnt_count);
+    fprintf(cmd_out(), "magic signature: 0x%x\n", sb.s_magic);
+    fprintf(cmd_out(), "file system state: %u\n", sb.s_state);
+    fprintf(cmd_out(), "errors: %u\n", sb.s_errors);
+    fprintf(cmd_out(), "minor revision level: %u\n", sb.s_minor_rev_level);
 
     // last check: formatado em data
     time_t t = sb.s_lastcheck;
     struct tm *lt = localtime(&t);
-    printf("time of last check: %02d/%02d/%04d %02d:%02d\n",
+    fprintf(cmd_out(), "time of last check: %02d/%02d/%04d %02d:%02d\n",
            lt->tm_mday, lt->tm_mon + 1, lt->tm_year + 1900,
            lt->tm_hour, lt->tm_min);
 
-    printf("max check interval: %u\n", sb.s_checkinterval);
-    printf("creator OS: %u\n", sb.s_creator_os);
-    printf("revision level: %u\n", sb.s_rev_level);
-    printf("default uid reserved blocks: %u\n", sb.s_def_resuid);
-    printf("defautl gid reserved blocks: %u\n", sb.s_def_resgid);
-    printf("first non-reserved inode: %u\n", sb.s_first_ino);
-    printf("inode size: %u\n", sb.s_inode_size);
-    printf("block group number: %u\n", sb.s_block_group_nr);
-    printf("compatible feature set: %u\n", sb.s_feature_compat);
-    printf("incompatible feature set: %u\n", sb.s_feature_incompat);
-    printf("read only comp feature set: %u\n", sb.s_feature_ro_compat);
-
-    printf("volume UUID: ");
-    for (int i = 0; i < 16; i++) printf("%02x", sb.s_uuid[i]);
-    printf("\n");
-
-    printf("volume name: %.*s\n", 16, sb.s_volume_name);
-    printf("volume last mounted: %.*s\n", 64, sb.s_last_mounted);
-    printf("algorithm usage bitmap: %u\n", sb.s_algorithm_usage_bitmap);
-    printf("blocks to try to preallocate: %u\n", sb.s_prealloc_blocks);
-    printf("blocks preallocate dir: %u\n", sb.s_prealloc_dir_blocks);
-
-    printf("journal UUID: ");
-    //for (int i = 0; i < 16; i++) printf("%02x", sb.s_journal_uuid[i]);
-    printf("\n");
-
-    printf("journal INum: %u\n", sb.s_journal_inum);
-    printf("journal Dev: %u\n", sb.s_journal_dev);
-    printf("last orphan: %u\n", sb.s_last_orphan);
-
-    printf("hash seed: ");
-    for (int i = 0; i < 4; i++) printf("%08x", sb.s_hash_seed[i]);
-    printf("\n");
-
-    printf("default hash version: %u\n", sb.s_def_hash_version);
-    printf("default mount options: %u\n", sb.s_default_mount_opts);
-    printf("first meta: %u\n", sb.s_first_meta_bg);
+    fprintf(cmd_out(), "max check interval: %u\n", sb.s_checkinterval);
+    fprintf(cmd_out(), "creator OS: %u\n", sb.s_creator_os);
+    fprintf(cmd_out(), "revision level: %u\n", sb.s_rev_level);
+    fprintf(cmd_out(), "default uid reserved blocks: %u\n", sb.s_def_resuid);
+    fprintf(cmd_out(), "defautl gid reserved blocks: %u\n", sb.s_def_resgid);
+    fprintf(cmd_out(), "first non-reserved inode: %u\n", sb.s_first_ino);
+    fprintf(cmd_out(), "inode size: %u\n", sb.s_inode_size);
+    fprintf(cmd_out(), "block group number: %u\n", sb.s_block_group_nr);
+    fprintf(cmd_out(), "compatible feature set: %u\n", sb.s_feature_compat);
+    fprintf(cmd_out(), "incompatible feature set: %u\n", sb.s_feature_incompat);
+    fprintf(cmd_out(), "read only comp feature set: %u\n", sb.s_feature_ro_compat);
+
+    fprintf(cmd_out(), "volume UUID: ");
+    for (int i = 0; i < 16; i++) fprintf(cmd_out(), "%02x", sb.s_uuid[i]);
+    fprintf(cmd_out(), "\n");
+
+    fprintf(cmd_out(), "volume name: %.*s\n", 16, sb.s_volume_name);
+    fprintf(cmd_out(), "volume last mounted: %.*s\n", 64, sb.s_last_mounted);
+    fprintf(cmd_out(), "algorithm usage bitmap: %u\n", sb.s_algorithm_usage_bitmap);
+    fprintf(cmd_out(), "blocks to try to preallocate: %u\n", sb.s_prealloc_blocks);
+    fprintf(cmd_out(), "blocks preallocate dir: %u\n", sb.s_prealloc_dir_blocks);
+
+    fprintf(cmd_out(), "journal UUID: ");
+    //for (int i = 0; i < 16; i++) fprintf(cmd_out(), "%02x", sb.s_journal_uuid[i]);
+    fprintf(cmd_out(), "\n");
+
+    fprintf(cmd_out(), "journal INum: %u\n", sb.s_journal_inum);
+    fprintf(cmd_out(), "journal Dev: %u\n", sb.s_journal_dev);
+    fprintf(cmd_out(), "last orphan: %u\n", sb.s_last_orphan);
+
+    fprintf(cmd_out(), "hash seed: ");
+    for (int i = 0; i < 4; i++) fprintf(cmd_out(), "%08x", sb.s_hash_seed[i]);
+    fprintf(cmd_out(), "\n");
+
+    fprintf(cmd_out(), "default hash version: %u\n", sb.s_def_hash_version);
+    fprintf(cmd_out(), "default mount options: %u\n", sb.s_default_mount_opts);
+    fprintf(cmd_out(), "first meta: %u\n", sb.s_first_meta_bg);
 }
 
-void cmd_print_groups() {
-    ext2_super_block sb;
-    read_superblock(&sb);
-
-    //uint32_t block_size = 1024 << sb.s_log_block_size;
-    int group_count = sb.s_blocks_count / sb.s_blocks_per_group;
-
-    uint8_t buf[1024];
-    read_block(2, buf);  // Descritores começam no bloco 2 (geralmente)
-
-    for (int i = 0; i < group_count; i++) {
-        ext2_group_desc *gd = (ext2_group_desc *)(buf + i * sizeof(ext2_group_desc));
-        printf("Block Group Descriptor %d:\n", i);
-        printf("block bitmap: %u\n", gd->bg_block_bitmap);
-        printf("inode bitmap: %u\n", gd->bg_inode_bitmap);
-        printf("inode table: %u\n", gd->bg_inode_table);
-        printf("free blocks count: %u\n", gd->bg_free_blocks_count);
-        printf("free inodes count: %u\n", gd->bg_free_inodes_count);
-        printf("used dirs count: %u\n", gd->bg_used_dirs_count);
+void cmd_print_groups(ext2_fs *fs) {
+    unsigned int group_count = ext2_group_count(fs);
+
+    for (unsigned int i = 0; i < group_count; i++) {
+        ext2_group_desc desc;
+        if (read_group_desc(fs, i, &desc) != 0) break;
+        ext2_group_desc *gd = &desc;
+        fprintf(cmd_out(), "Block Group Descriptor %u:\n", i);
+        fprintf(cmd_out(), "block bitmap: %u\n", gd->bg_block_bitmap);
+        fprintf(cmd_out(), "inode bitmap: %u\n", gd->bg_inode_bitmap);
+        fprintf(cmd_out(), "inode table: %u\n", gd->bg_inode_table);
+        fprintf(cmd_out(), "free blocks count: %u\n", gd->bg_free_blocks_count);
+        fprintf(cmd_out(), "free inodes count: %u\n", gd->bg_free_inodes_count);
+        fprintf(cmd_out(), "used dirs count: %u\n", gd->bg_used_dirs_count);
     }
 }
 
-void cmd_print_inode(uint32_t inode_num) {
+void cmd_print_inode(ext2_fs *fs, uint32_t inode_num) {
     ext2_inode inode;
-    read_inode(inode_num, &inode);
-
-    printf("file format and access rights: 0x%x\n", inode.i_mode);
-    printf("user id: %u\n", inode.i_uid);
-    printf("lower 32-bit file size: %u\n", inode.i_size);
-    printf("access time: %u\n", inode.i_atime);
-    printf("creation time: %u\n", inode.i_ctime);
-    printf("modification time: %u\n", inode.i_mtime);
-    printf("deletion time: %u\n", inode.i_dtime);
-    printf("group id: %u\n", inode.i_gid);
-    printf("link count inode: %u\n", inode.i_links_count);
-    printf("512-bytes blocks: %u\n", inode.i_blocks);
-    printf("ext2 flags: %u\n", inode.i_flags);
-    printf("reserved (Linux): %u\n", inode.i_osd1);
+    read_inode(fs, inode_num, &inode);
+
+    fprintf(cmd_out(), "file format and access rights: 0x%x\n", inode.i_mode);
+    fprintf(cmd_out(), "user id: %u\n", inode.i_uid);
+    fprintf(cmd_out(), "lower 32-bit file size: %u\n", inode.i_size);
+    fprintf(cmd_out(), "access time: %u\n", inode.i_atime);
+    fprintf(cmd_out(), "creation time: %u\n", inode.i_ctime);
+    fprintf(cmd_out(), "modification time: %u\n", inode.i_mtime);
+    fprintf(cmd_out(), "deletion time: %u\n", inode.i_dtime);
+    fprintf(cmd_out(), "group id: %u\n", inode.i_gid);
+    fprintf(cmd_out(), "link count inode: %u\n", inode.i_links_count);
+    fprintf(cmd_out(), "512-bytes blocks: %u\n", inode.i_blocks);
+    fprintf(cmd_out(), "ext2 flags: %u\n", inode.i_flags);
+    fprintf(cmd_out(), "reserved (Linux): %u\n", inode.i_osd1);
 
     for (int i = 0; i < EXT2_N_BLOCKS; i++) {
-        printf("pointer[%d]: %u\n", i, inode.i_block[i]);
+        fprintf(cmd_out(), "pointer[%d]: %u\n", i, inode.i_block[i]);
     }
 
-    printf("file version (nfs): %u\n", inode.i_generation);
-    printf("block number extended attributes: %u\n", inode.i_file_acl);
-    printf("higher 32-bit file size: %u\n", inode.i_dir_acl);
-    printf("location file fragment: %u\n", inode.i_faddr);
+    fprintf(cmd_out(), "file version (nfs): %u\n", inode.i_generation);
+    fprintf(cmd_out(), "block number extended attributes: %u\n", inode.i_file_acl);
+    fprintf(cmd_out(), "higher 32-bit file size: %u\n", inode.i_dir_acl);
+    fprintf(cmd_out(), "location file fragment: %u\n", inode.i_faddr);
 }
@@ -7,22 +7,43 @@
 #include <time.h>
 #include "ext2_fs.h"
 #include "ext2_lib.h"
+#include "ext2_find.h"
+#include "ext2_verify.h"
 
-extern ext2_super_block sb;
-extern unsigned int block_size;
+/*
+function: Define para onde os comandos da thread atual escrevem.
+param:
+  - out: Saída normal (NULL = stdout).
+  - err: Mensagens de erro (NULL = stderr).
+observações:
+  - A configuração é por thread: no modo servidor cada worker escreve na
+    resposta do cliente que está atendendo.
+*/
+void commands_set_output(FILE *out, FILE *err);
 
-void do_info();
-void do_attr(unsigned int inode_num);
-void do_ls(unsigned int dir_inode_num);
-void do_cat(unsigned int file_inode_num);
-void do_touch(unsigned int parent_inode_num, const char* filename);
-void do_mkdir(unsigned int parent_inode_num, const char* dirname);
-void do_rm(unsigned int parent_inode_num, const char *filename);
-void do_rmdir(unsigned int parent_inode_num, const char *dirname);
-void do_rename(unsigned int parent_inode_num, const char* oldname, const char* newname);
-void do_cp(unsigned int current_dir_inode, const char* source_in_image, const char* dest_on_host);
-void cmd_print_superblock(void);
-void cmd_print_groups(void);
-void cmd_print_inode(uint32_t inode_num);
+void do_info(ext2_fs *fs);
+void do_attr(ext2_fs *fs, unsigned int inode_num);
+void do_ls(ext2_fs *fs, unsigned int dir_inode_num);
+void do_cat(ext2_fs *fs, unsigned int file_inode_num);
+void do_touch(ext2_fs *fs, unsigned int parent_inode_num, const char* filename);
+void do_mkdir(ext2_fs *fs, unsigned int parent_inode_num, const char* dirname);
+void do_rm(ext2_fs *fs, unsigned int parent_inode_num, const char *filename);
+void do_rm_recursive(ext2_fs *fs, unsigned int parent_inode_num, const char *name);
+void do_rmdir(ext2_fs *fs, unsigned int parent_inode_num, const char *dirname);
+void do_rename(ext2_fs *fs, unsigned int parent_inode_num, const char* oldname, const char* newname);
+void do_append(ext2_fs *fs, unsigned int parent_inode_num, const char *filename, const char *text);
+void do_truncate(ext2_fs *fs, unsigned int parent_inode_num, const char *filename, uint64_t new_size);
+void do_defrag(ext2_fs *fs, unsigned int inode_num, const char *path, int dry_run);
+void do_check(ext2_fs *fs, int repair, int threads);
+void do_du(ext2_fs *fs, unsigned int inode_num, const char *path, int threads);
+void do_freefrag(ext2_fs *fs, unsigned int alloc_blocks, int per_group);
+void do_find(ext2_fs *fs, unsigned int inode_num, const char *path, const struct ext2_find_query *q,
+             enum ext2_find_mode mode, int threads);
+void do_verify(ext2_fs *fs, enum ext2_verify_mode mode, int threads);
+void do_import(ext2_fs *fs, unsigned int dest_inode_num, const char *host_dir, const char *dest_path);
+void do_cp(ext2_fs *fs, unsigned int current_dir_inode, const char* source_in_image, const char* dest_on_host);
+void cmd_print_superblock(ext2_fs *fs);
+void cmd_print_groups(ext2_fs *fs);
+void cmd_print_inode(ext2_fs *fs, uint32_t inode_num);
 
 #endif
\ No newline at end of file
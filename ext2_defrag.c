@@ -0,0 +1,258 @@
+#include <unistd.h>
+#include "ext2_defrag.h"
+#include "ext2_internal.h"
+#include "ext2_journal.h"
+
+// Realocação de um arquivo. Os blocos antigos são listados em pré-ordem
+// (indireto antes dos filhos), a mesma ordem em que o trecho novo é ocupado:
+// o bloco old.blocks[i] vai para start + i.
+struct defrag_file {
+    ext2_fs *fs;
+    block_list old;
+    int invalid;              // Ponteiro fora da imagem no mapa
+    uint32_t start, pos;
+
+    // Cópias de dados pendentes (até EXT2_DEFRAG_CHUNK)
+    struct block_write *data;
+    uint32_t *data_old;
+    size_t ndata;
+    char *chunk;
+
+    // Indiretos novos, gravados depois dos dados
+    struct block_write *meta;
+    size_t nmeta, meta_cap;
+};
+
+struct defrag_stats {
+    unsigned int files, fragmented, moved, failed;
+    unsigned long long fragments, blocks;
+};
+
+static void collect(struct defrag_file *f, uint32_t blk, int level) {
+    ext2_fs *fs = f->fs;
+    if (blk == 0 || f->invalid) return;
+    if (blk < fs->sb.s_first_data_block || blk >= fs->sb.s_blocks_count) {
+        f->invalid = 1;
+        return;
+    }
+    block_list_add(&f->old, blk);
+    if (level == 0) return;
+
+    uint32_t ptrs[fs->block_size / 4];
+    if (read_block_as(fs, blk, ptrs, EXT2_IO_INDIRECT) != 0) {
+        f->invalid = 1;
+        return;
+    }
+    for (unsigned int i = 0; i < fs->block_size / 4; i++) collect(f, ptrs[i], level - 1);
+}
+
+// Lê os blocos antigos pendentes (trechos contíguos em um único pread) e grava
+// as cópias no trecho novo
+static int flush_data(struct defrag_file *f) {
+    ext2_fs *fs = f->fs;
+    for (size_t i = 0; i < f->ndata;) {
+        size_t j = i + 1;
+        while (j < f->ndata && f->data_old[j] == f->data_old[j - 1] + 1) j++;
+        size_t len = (j - i) * fs->block_size;
+        if (image_pread(fs, f->chunk + i * fs->block_size, len, (off_t)f->data_old[i] * fs->block_size) != 0) {
+            perror("defrag: pread");
+            return -1;
+        }
+        stats_blocks(fs, 0, f->data_old[i], j - i, EXT2_IO_DATA);
+        stats_calls(fs, 0, 1);
+        i = j;
+    }
+    write_data_blocks(fs, f->data, f->ndata);
+    f->ndata = 0;
+    return 0;
+}
+
+static uint32_t relocate(struct defrag_file *f, uint32_t old, int level) {
+    ext2_fs *fs = f->fs;
+    if (old == 0) return 0;
+    uint32_t new_blk = f->start + f->pos++;
+
+    if (level == 0) {
+        if (f->ndata == EXT2_DEFRAG_CHUNK) flush_data(f);
+        f->data[f->ndata] = (struct block_write){ new_blk, f->chunk + f->ndata * fs->block_size };
+        f->data_old[f->ndata++] = old;
+        return new_blk;
+    }
+
+    uint32_t *ptrs = malloc(fs->block_size);
+    read_block_as(fs, old, ptrs, EXT2_IO_INDIRECT);
+    for (unsigned int i = 0; i < fs->block_size / 4; i++) ptrs[i] = relocate(f, ptrs[i], level - 1);
+    if (f->nmeta == f->meta_cap) {
+        f->meta_cap = f->meta_cap ? f->meta_cap * 2 : 16;
+        f->meta = realloc(f->meta, f->meta_cap * sizeof(struct block_write));
+    }
+    f->meta[f->nmeta++] = (struct block_write){ new_blk, ptrs };
+    return new_blk;
+}
+
+// Copia o arquivo para [start, start + old.count) e troca o mapa do inode
+static void move_file(struct defrag_file *f, unsigned int inode_num, ext2_inode *inode) {
+    ext2_fs *fs = f->fs;
+    for (int b = 0; b < EXT2_NDIR_BLOCKS; b++) inode->i_block[b] = relocate(f, inode->i_block[b], 0);
+    for (int level = 1; level <= 3; level++) {
+        int idx = EXT2_IND_BLOCK + level - 1;
+        inode->i_block[idx] = relocate(f, inode->i_block[idx], level);
+    }
+    flush_data(f);
+
+    // Dados no lugar antes dos ponteiros que os usam; os blocos antigos só
+    // são liberados depois que o inode aponta para os novos
+    if (!fs->journal) write_barrier(fs);
+    write_metadata_blocks(fs, f->meta, f->nmeta);
+    inode->i_ctime = (uint32_t)time(NULL); // Mapa trocado (o verify acha os grupos alterados por essa data)
+    write_inode(fs, inode_num, inode);
+    free_block_list(fs, &f->old);
+}
+
+// Devolve um trecho alocado e não usado
+static void release_run(ext2_fs *fs, uint32_t start, unsigned int count) {
+    block_list run = {0};
+    for (unsigned int k = 0; k < count; k++) block_list_add(&run, start + k);
+    free_block_list(fs, &run);
+    block_list_destroy(&run);
+}
+
+static void defrag_file(ext2_fs *fs, unsigned int inode_num, const char *path, int dry_run,
+                        FILE *out, struct defrag_stats *stats) {
+    ext2_journal_begin(fs);
+    pthread_rwlock_wrlock(inode_lock(fs, inode_num));
+
+    ext2_inode inode;
+    struct defrag_file f = { .fs = fs };
+    get_inode(fs, inode_num, &inode);
+    for (int b = 0; b < EXT2_NDIR_BLOCKS; b++) collect(&f, inode.i_block[b], 0);
+    for (int level = 1; level <= 3; level++) collect(&f, inode.i_block[EXT2_IND_BLOCK + level - 1], level);
+
+    unsigned int fragments = f.old.count > 0;
+    for (size_t i = 1; i < f.old.count; i++) fragments += f.old.blocks[i] != f.old.blocks[i - 1] + 1;
+    stats->files++;
+
+    if (f.invalid) {
+        fprintf(out, "%s: mapa de blocos inválido (use check)\n", path);
+        stats->failed++;
+    } else if (fragments > 1) {
+        stats->fragmented++;
+        stats->fragments += fragments;
+        unsigned int got = 0;
+        unsigned int start = dry_run ? 0 : alloc_block_run(fs, f.old.blocks[0], f.old.count, &got);
+
+        if (dry_run) {
+            fprintf(out, "%s: %zu blocos em %u fragmentos\n", path, f.old.count, fragments);
+            stats->blocks += f.old.count;
+        } else if (got < f.old.count) {
+            if (start) release_run(fs, start, got);
+            fprintf(out, "%s: sem trecho livre de %zu blocos, mantido com %u fragmentos\n", path, f.old.count, fragments);
+            stats->failed++;
+        } else {
+            size_t chunk = f.old.count < EXT2_DEFRAG_CHUNK ? f.old.count : EXT2_DEFRAG_CHUNK;
+            f.start = start;
+            f.chunk = malloc(chunk * fs->block_size);
+            f.data = malloc(chunk * sizeof(struct block_write));
+            f.data_old = malloc(chunk * sizeof(uint32_t));
+            if (f.chunk && f.data && f.data_old) {
+                size_t count = f.old.count;
+                move_file(&f, inode_num, &inode);
+                fprintf(out, "%s: %u fragmentos -> 1 (%zu blocos)\n", path, fragments, count);
+                stats->moved++;
+                stats->blocks += count;
+            } else {
+                release_run(fs, start, got);
+                fprintf(out, "%s: memória insuficiente\n", path);
+                stats->failed++;
+            }
+        }
+    }
+
+    pthread_rwlock_unlock(inode_lock(fs, inode_num));
+    ext2_journal_end(fs);
+
+    for (size_t i = 0; i < f.nmeta; i++) free((void *)f.meta[i].data);
+    free(f.meta);
+    free(f.chunk);
+    free(f.data);
+    free(f.data_old);
+    block_list_destroy(&f.old);
+}
+
+// Entradas de um diretório (exceto "." e "..")
+struct dir_list {
+    uint32_t *inodes;
+    char **names;
+    size_t count, cap;
+};
+
+static int list_dir_block(ext2_fs *fs, uint32_t block_num, uint64_t lblk, void *ctx) {
+    (void)lblk;
+    struct dir_list *l = ctx;
+    if (block_num == 0) return 0;
+    char buf[fs->block_size];
+    if (read_block_as(fs, block_num, buf, EXT2_IO_DIR) != 0) return 0;
+
+    for (unsigned int off = 0; off < fs->block_size;) {
+        ext2_dir_entry_2 *de = (ext2_dir_entry_2 *)(buf + off);
+        if (de->rec_len < 8 || off + de->rec_len > fs->block_size) break;
+        off += de->rec_len;
+        if (de->inode == 0 || (de->name_len == 1 && de->name[0] == '.') ||
+            (de->name_len == 2 && memcmp(de->name, "..", 2) == 0)) continue;
+
+        if (l->count == l->cap) {
+            l->cap = l->cap ? l->cap * 2 : 32;
+            l->inodes = realloc(l->inodes, l->cap * sizeof(uint32_t));
+            l->names = realloc(l->names, l->cap * sizeof(char *));
+        }
+        l->inodes[l->count] = de->inode;
+        l->names[l->count++] = strndup(de->name, de->name_len);
+    }
+    return 0;
+}
+
+static void defrag_tree(ext2_fs *fs, unsigned int dir_inode, const char *path, int dry_run,
+                        FILE *out, struct defrag_stats *stats) {
+    ext2_inode dir;
+    struct dir_list l = {0};
+    pthread_rwlock_rdlock(inode_lock(fs, dir_inode));
+    get_inode(fs, dir_inode, &dir);
+    walk_file_blocks(fs, &dir, dir.i_size / fs->block_size, list_dir_block, &l);
+    pthread_rwlock_unlock(inode_lock(fs, dir_inode));
+
+    for (size_t i = 0; i < l.count; i++) {
+        size_t len = strlen(path) + strlen(l.names[i]) + 2;
+        char child_path[len];
+        snprintf(child_path, len, "%s%s%s", path, strcmp(path, "/") == 0 ? "" : "/", l.names[i]);
+
+        free(l.names[i]);
+
+        ext2_inode child;
+        if (get_inode(fs, l.inodes[i], &child) != 0) continue;
+        uint16_t type = child.i_mode & EXT2_S_IFMT;
+        if (type == EXT2_S_IFREG) defrag_file(fs, l.inodes[i], child_path, dry_run, out, stats);
+        else if (type == EXT2_S_IFDIR) defrag_tree(fs, l.inodes[i], child_path, dry_run, out, stats);
+    }
+    free(l.inodes);
+    free(l.names);
+}
+
+int ext2_defrag(ext2_fs *fs, unsigned int inode_num, const char *path, int dry_run, FILE *out) {
+    ext2_inode inode;
+    if (get_inode(fs, inode_num, &inode) != 0) return -1;
+
+    struct defrag_stats stats = {0};
+    uint16_t type = inode.i_mode & EXT2_S_IFMT;
+    if (type == EXT2_S_IFREG) defrag_file(fs, inode_num, path, dry_run, out, &stats);
+    else if (type == EXT2_S_IFDIR) defrag_tree(fs, inode_num, path, dry_run, out, &stats);
+    else return -1;
+
+    if (dry_run) {
+        fprintf(out, "%u arquivos, %u fragmentados (%llu fragmentos, %llu blocos a mover)\n",
+                stats.files, stats.fragmented, stats.fragments, stats.blocks);
+        return (int)stats.fragmented;
+    }
+    fprintf(out, "%u arquivos, %u fragmentados: %u desfragmentados (%llu blocos movidos), %u mantidos\n",
+            stats.files, stats.fragmented, stats.moved, stats.blocks, stats.failed);
+    return (int)stats.moved;
+}
@@ -0,0 +1,32 @@
+#ifndef _EXT2_DEFRAG_H_
+#define _EXT2_DEFRAG_H_
+
+#include <stdio.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Blocos de dados copiados por leitura/gravação durante a realocação
+#define EXT2_DEFRAG_CHUNK 1024
+
+/*
+function: Desfragmenta um arquivo ou todos os arquivos regulares de uma árvore.
+param:
+  - inode_num: Arquivo regular ou diretório (percorrido recursivamente).
+  - path: Caminho de inode_num, usado no relatório.
+  - dry_run: 1 para apenas relatar a fragmentação, sem mover nada.
+  - out: Onde o relatório é escrito.
+return:
+  - Quantidade de arquivos desfragmentados (ou que seriam, com dry_run), -1 em erro.
+observações:
+  - A fragmentação é medida pelo mapa de blocos na ordem em que ext2_file
+    grava um arquivo (cada indireto logo antes dos blocos que aponta):
+    fragmentos = trechos contíguos nessa sequência.
+  - Um arquivo fragmentado é copiado inteiro para um trecho livre contíguo
+    (alloc_block_run), com leituras e gravações de até EXT2_DEFRAG_CHUNK
+    blocos. Os indiretos são regravados com os novos ponteiros, depois o
+    inode, e só então os blocos antigos são liberados.
+  - Arquivos sem um trecho livre do tamanho necessário ficam como estão.
+*/
+int ext2_defrag(ext2_fs *fs, unsigned int inode_num, const char *path, int dry_run, FILE *out);
+
+#endif
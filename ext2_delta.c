@@ -0,0 +1,467 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include "ext2_internal.h"
+#include "ext2_journal.h"
+#include "ext2_verify.h"
+
+// Delta de blocos entre duas imagens da mesma geometria (backup incremental).
+// diff: confere superbloco e descritores de grupo, lê os bitmaps de blocos da
+// imagem nova e compara, em paralelo por grupo, só os blocos em uso nela;
+// os trechos diferentes vão para o arquivo de delta. apply: confere a base
+// contra os CRCs do delta e grava os trechos nela.
+
+#define DELTA_MAGIC "E2DELTA1"
+#define DELTA_VERSION 1
+
+// Blocos lidos por pread (comparação, cópia e conferência)
+#define DELTA_RUN_BLOCKS 256
+
+// Formato: o cabeçalho e, para cada trecho, o registro seguido dos blocos
+struct delta_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t blocks_count;
+    uint32_t blocks_per_group;
+    uint8_t uuid[16];           // s_uuid das duas imagens
+    uint64_t created;
+    uint64_t runs;
+    uint64_t blocks;            // Soma dos trechos
+    uint32_t reserved;
+    uint32_t header_crc;        // Cabeçalho com header_crc = 0
+};
+
+struct delta_run {
+    uint32_t start;
+    uint32_t count;
+    uint32_t base_crc;          // Conteúdo na base (conferido antes de gravar)
+    uint32_t data_crc;          // Conteúdo novo, que segue o registro
+};
+
+struct image {
+    const char *path;
+    int fd;
+    ext2_super_block sb;
+    ext2_group_desc *gd;
+    uint32_t block_size;
+    unsigned int group_count;
+};
+
+// Abre a imagem, reaplica o journal pendente (como ext2_init) e lê a geometria
+static int image_open(struct image *im, const char *path, int writable) {
+    memset(im, 0, sizeof(*im));
+    im->path = path;
+    size_t path_len = strlen(path) + sizeof(EXT2_JOURNAL_SUFFIX);
+    char journal_path[path_len];
+    snprintf(journal_path, path_len, "%s%s", path, EXT2_JOURNAL_SUFFIX);
+    int has_journal = access(journal_path, F_OK) == 0;
+
+    im->fd = open(path, writable || has_journal ? O_RDWR : O_RDONLY);
+    if (im->fd < 0) {
+        perror(path);
+        return -1;
+    }
+    int replayed = has_journal ? journal_replay(im->fd, journal_path) : 0;
+    if (replayed < 0) {
+        fprintf(stderr, "Falha ao reaplicar o journal %s\n", journal_path);
+        close(im->fd);
+        return -1;
+    }
+    if (replayed > 0) fprintf(stderr, "%s: %d transações do journal reaplicadas\n", path, replayed);
+
+    if (pread(im->fd, &im->sb, sizeof(im->sb), 1024) != sizeof(im->sb) || im->sb.s_magic != EXT2_SUPER_MAGIC) {
+        fprintf(stderr, "%s: não é um sistema de arquivos EXT2\n", path);
+        close(im->fd);
+        return -1;
+    }
+    im->block_size = 1024 << im->sb.s_log_block_size;
+    im->group_count = (im->sb.s_blocks_count - im->sb.s_first_data_block + im->sb.s_blocks_per_group - 1) /
+                      im->sb.s_blocks_per_group;
+    size_t len = im->group_count * sizeof(ext2_group_desc);
+    im->gd = malloc(len);
+    if (!im->gd || pread(im->fd, im->gd, len, (off_t)(im->sb.s_first_data_block + 1) * im->block_size) != (ssize_t)len) {
+        fprintf(stderr, "%s: falha ao ler os descritores de grupo\n", path);
+        free(im->gd);
+        close(im->fd);
+        return -1;
+    }
+    return 0;
+}
+
+static void image_close(struct image *im) {
+    free(im->gd);
+    close(im->fd);
+}
+
+static int read_run(int fd, uint32_t first, uint32_t count, uint32_t bs, char *buf) {
+    size_t len = (size_t)count * bs;
+    return pread(fd, buf, len, (off_t)first * bs) == (ssize_t)len ? 0 : -1;
+}
+
+static uint32_t header_crc(const struct delta_header *h) {
+    struct delta_header copy = *h;
+    copy.header_crc = 0;
+    return ext2_crc32c(0, &copy, sizeof(copy));
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// --- diff ---
+
+struct run_list {
+    struct delta_run *runs;
+    size_t count, cap;
+};
+
+struct diff_state {
+    struct image *base, *target;
+    struct run_list *groups;        // Trechos alterados de cada grupo, em ordem
+    uint8_t *failed;
+    unsigned int next;
+    uint64_t used;                  // Blocos em uso comparados (atômico)
+};
+
+static int run_add(struct run_list *l, uint32_t start) {
+    if (l->count == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 16;
+        struct delta_run *r = realloc(l->runs, cap * sizeof(*r));
+        if (!r) return -1;
+        l->runs = r;
+        l->cap = cap;
+    }
+    l->runs[l->count++] = (struct delta_run){ start, 0, 0, 0 };
+    return 0;
+}
+
+// Compara os blocos [first, first + n) das duas imagens e estende ou abre
+// trechos em `l`; `open` diz se o último trecho termina em first
+static int compare_blocks(struct diff_state *st, struct run_list *l, uint32_t first, uint32_t n, int *open,
+                          char *a, char *b) {
+    uint32_t bs = st->target->block_size;
+    if (read_run(st->base->fd, first, n, bs, a) != 0 || read_run(st->target->fd, first, n, bs, b) != 0) return -1;
+    for (uint32_t i = 0; i < n; i++) {
+        const char *old = a + (size_t)i * bs, *new = b + (size_t)i * bs;
+        if (memcmp(old, new, bs) == 0) {
+            *open = 0;
+            continue;
+        }
+        if (!*open && run_add(l, first + i) != 0) return -1;
+        struct delta_run *r = &l->runs[l->count - 1];
+        r->count++;
+        r->base_crc = ext2_crc32c(r->base_crc, old, bs);
+        r->data_crc = ext2_crc32c(r->data_crc, new, bs);
+        *open = 1;
+    }
+    return 0;
+}
+
+static void diff_group(struct diff_state *st, unsigned int group) {
+    struct image *t = st->target;
+    uint32_t bs = t->block_size;
+    uint8_t *bitmap = malloc(bs);
+    char *a = malloc((size_t)DELTA_RUN_BLOCKS * bs), *b = malloc((size_t)DELTA_RUN_BLOCKS * bs);
+    struct run_list *l = &st->groups[group];
+    if (!bitmap || !a || !b || read_run(t->fd, t->gd[group].bg_block_bitmap, 1, bs, (char *)bitmap) != 0) {
+        st->failed[group] = 1;
+        goto out;
+    }
+
+    // O bloco de boot das imagens de 1 KiB fica antes do grupo 0
+    int open = 0;
+    uint64_t used = 0;
+    if (group == 0 && t->sb.s_first_data_block > 0 &&
+        compare_blocks(st, l, 0, t->sb.s_first_data_block, &open, a, b) != 0) {
+        st->failed[group] = 1;
+        goto out;
+    }
+
+    // Blocos livres na imagem nova não interessam: nem são comparados
+    uint32_t first = t->sb.s_first_data_block + group * t->sb.s_blocks_per_group;
+    uint32_t nblocks = t->sb.s_blocks_count - first;
+    if (nblocks > t->sb.s_blocks_per_group) nblocks = t->sb.s_blocks_per_group;
+    for (uint32_t i = 0; i < nblocks;) {
+        if (!((bitmap[i / 8] >> (i % 8)) & 1)) {
+            open = 0;
+            i++;
+            continue;
+        }
+        uint32_t n = 1;
+        while (i + n < nblocks && n < DELTA_RUN_BLOCKS && ((bitmap[(i + n) / 8] >> ((i + n) % 8)) & 1)) n++;
+        if (compare_blocks(st, l, first + i, n, &open, a, b) != 0) {
+            st->failed[group] = 1;
+            break;
+        }
+        used += n;
+        i += n;
+    }
+    __atomic_add_fetch(&st->used, used, __ATOMIC_RELAXED);
+
+out:
+    free(bitmap);
+    free(a);
+    free(b);
+}
+
+static void *diff_worker(void *arg) {
+    struct diff_state *st = arg;
+    for (;;) {
+        unsigned int group = __atomic_fetch_add(&st->next, 1, __ATOMIC_RELAXED);
+        if (group >= st->target->group_count) break;
+        diff_group(st, group);
+    }
+    return NULL;
+}
+
+static void run_diff(struct diff_state *st, int threads) {
+    pthread_t tids[threads];
+    int started = 0;
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&tids[started], NULL, diff_worker, st) == 0) started++;
+    }
+    diff_worker(st); // A thread principal também compara
+    for (int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+}
+
+// Mesma geometria e mesmo volume: só assim os blocos se correspondem
+static int same_geometry(const struct image *a, const struct image *b) {
+    if (a->block_size != b->block_size || a->sb.s_blocks_count != b->sb.s_blocks_count ||
+        a->sb.s_blocks_per_group != b->sb.s_blocks_per_group || a->sb.s_first_data_block != b->sb.s_first_data_block ||
+        a->sb.s_inodes_per_group != b->sb.s_inodes_per_group || memcmp(a->sb.s_uuid, b->sb.s_uuid, 16) != 0) {
+        return 0;
+    }
+    for (unsigned int g = 0; g < a->group_count; g++) {
+        if (a->gd[g].bg_block_bitmap != b->gd[g].bg_block_bitmap || a->gd[g].bg_inode_bitmap != b->gd[g].bg_inode_bitmap ||
+            a->gd[g].bg_inode_table != b->gd[g].bg_inode_table) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Grava o delta em um temporário e renomeia; os blocos são lidos de novo da
+// imagem nova e conferidos contra os CRCs da comparação
+static int write_delta(struct diff_state *st, const char *path, uint64_t runs, uint64_t blocks) {
+    struct image *t = st->target;
+    uint32_t bs = t->block_size;
+    struct delta_header h = {0};
+    memcpy(h.magic, DELTA_MAGIC, 8);
+    h.version = DELTA_VERSION;
+    h.block_size = bs;
+    h.blocks_count = t->sb.s_blocks_count;
+    h.blocks_per_group = t->sb.s_blocks_per_group;
+    memcpy(h.uuid, t->sb.s_uuid, 16);
+    h.created = (uint64_t)time(NULL);
+    h.runs = runs;
+    h.blocks = blocks;
+    h.header_crc = header_crc(&h);
+
+    size_t tmp_len = strlen(path) + 5;
+    char tmp[tmp_len];
+    snprintf(tmp, tmp_len, "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    char *buf = malloc((size_t)DELTA_RUN_BLOCKS * bs);
+    int ok = f && buf && fwrite(&h, sizeof(h), 1, f) == 1;
+    for (unsigned int g = 0; ok && g < t->group_count; g++) {
+        for (size_t r = 0; ok && r < st->groups[g].count; r++) {
+            const struct delta_run *run = &st->groups[g].runs[r];
+            ok = fwrite(run, sizeof(*run), 1, f) == 1;
+            uint32_t crc = 0;
+            for (uint32_t done = 0; ok && done < run->count;) {
+                uint32_t n = run->count - done < DELTA_RUN_BLOCKS ? run->count - done : DELTA_RUN_BLOCKS;
+                ok = read_run(t->fd, run->start + done, n, bs, buf) == 0 && fwrite(buf, (size_t)n * bs, 1, f) == 1;
+                crc = ext2_crc32c(crc, buf, (size_t)n * bs);
+                done += n;
+            }
+            if (ok && crc != run->data_crc) {
+                fprintf(stderr, "diff: %s mudou durante a comparação\n", t->path);
+                ok = 0;
+            }
+        }
+    }
+    ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    if (f) ok = fclose(f) == 0 && ok;
+    free(buf);
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static int do_diff(const char *base_path, const char *target_path, const char *delta_path, int threads) {
+    double start = now_ms();
+    struct image base, target;
+    if (image_open(&base, base_path, 0) != 0) return 1;
+    if (image_open(&target, target_path, 0) != 0) {
+        image_close(&base);
+        return 1;
+    }
+    int ret = 1;
+    struct diff_state st = { &base, &target, NULL, NULL, 0, 0 };
+    if (!same_geometry(&base, &target)) {
+        fprintf(stderr, "diff: %s e %s não são o mesmo volume com a mesma geometria\n", base_path, target_path);
+        goto out;
+    }
+
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    if ((unsigned int)threads > target.group_count) threads = (int)target.group_count;
+    st.groups = calloc(target.group_count, sizeof(struct run_list));
+    st.failed = calloc(target.group_count, 1);
+    if (!st.groups || !st.failed) goto out;
+
+    run_diff(&st, threads);
+
+    uint64_t runs = 0, blocks = 0;
+    for (unsigned int g = 0; g < target.group_count; g++) {
+        if (st.failed[g]) {
+            fprintf(stderr, "diff: erro de leitura no grupo %u\n", g);
+            goto out;
+        }
+        runs += st.groups[g].count;
+        for (size_t r = 0; r < st.groups[g].count; r++) blocks += st.groups[g].runs[r].count;
+    }
+    if (write_delta(&st, delta_path, runs, blocks) != 0) {
+        fprintf(stderr, "diff: falha ao gravar %s\n", delta_path);
+        goto out;
+    }
+
+    double mib = 1024.0 * 1024.0;
+    double secs = (now_ms() - start) / 1000.0;
+    printf("%llu blocos alterados em %llu trechos (%.1f MiB de %.1f MiB em uso) -> %s\n",
+           (unsigned long long)blocks, (unsigned long long)runs, blocks * (double)target.block_size / mib,
+           st.used * (double)target.block_size / mib, delta_path);
+    printf("%.2f s, %d threads\n", secs, threads);
+    ret = 0;
+
+out:
+    for (unsigned int g = 0; st.groups && g < target.group_count; g++) free(st.groups[g].runs);
+    free(st.groups);
+    free(st.failed);
+    image_close(&base);
+    image_close(&target);
+    return ret;
+}
+
+// --- apply ---
+
+// Percorre os trechos do delta. Sem `patch`, confere cada um: a base tem de
+// estar como no diff ou já com o conteúdo novo (apply interrompido e
+// repetido). Com `patch`, grava os blocos na base.
+static int apply_pass(struct image *base, FILE *f, const struct delta_header *h, int patch, char *a, char *b) {
+    uint32_t bs = base->block_size;
+    if (fseeko(f, sizeof(*h), SEEK_SET) != 0) return -1;
+    for (uint64_t r = 0; r < h->runs; r++) {
+        struct delta_run run;
+        if (fread(&run, sizeof(run), 1, f) != 1 || run.count == 0 || run.start >= h->blocks_count ||
+            run.count > h->blocks_count - run.start) {
+            fprintf(stderr, "apply: delta truncado ou inválido (trecho %llu)\n", (unsigned long long)r);
+            return -1;
+        }
+        uint32_t base_crc = 0, data_crc = 0;
+        for (uint32_t done = 0; done < run.count;) {
+            uint32_t n = run.count - done < DELTA_RUN_BLOCKS ? run.count - done : DELTA_RUN_BLOCKS;
+            size_t len = (size_t)n * bs;
+            if (fread(b, len, 1, f) != 1) {
+                fprintf(stderr, "apply: delta truncado (trecho %llu)\n", (unsigned long long)r);
+                return -1;
+            }
+            if (patch) {
+                if (pwrite(base->fd, b, len, (off_t)(run.start + done) * bs) != (ssize_t)len) {
+                    perror("apply");
+                    return -1;
+                }
+            } else {
+                if (read_run(base->fd, run.start + done, n, bs, a) != 0) return -1;
+                base_crc = ext2_crc32c(base_crc, a, len);
+                data_crc = ext2_crc32c(data_crc, b, len);
+            }
+            done += n;
+        }
+        if (patch) continue;
+        if (data_crc != run.data_crc) {
+            fprintf(stderr, "apply: delta corrompido (trecho no bloco %u)\n", run.start);
+            return -1;
+        }
+        if (base_crc != run.base_crc && base_crc != run.data_crc) {
+            fprintf(stderr, "apply: %s não é a base do delta (bloco %u difere)\n", base->path, run.start);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int do_apply(const char *base_path, const char *delta_path) {
+    double start = now_ms();
+    FILE *f = fopen(delta_path, "rb");
+    if (!f) {
+        perror(delta_path);
+        return 1;
+    }
+    struct delta_header h;
+    if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, DELTA_MAGIC, 8) != 0 || h.version != DELTA_VERSION ||
+        h.header_crc != header_crc(&h)) {
+        fprintf(stderr, "apply: %s não é um delta válido\n", delta_path);
+        fclose(f);
+        return 1;
+    }
+    struct image base;
+    if (image_open(&base, base_path, 1) != 0) {
+        fclose(f);
+        return 1;
+    }
+
+    int ret = 1;
+    char *a = malloc((size_t)DELTA_RUN_BLOCKS * h.block_size), *b = malloc((size_t)DELTA_RUN_BLOCKS * h.block_size);
+    if (h.block_size != base.block_size || h.blocks_count != base.sb.s_blocks_count ||
+        h.blocks_per_group != base.sb.s_blocks_per_group || memcmp(h.uuid, base.sb.s_uuid, 16) != 0) {
+        fprintf(stderr, "apply: o delta é de outro volume ou de outra geometria\n");
+        goto out;
+    }
+    // Nada é gravado antes de o delta inteiro e a base serem conferidos
+    if (!a || !b || apply_pass(&base, f, &h, 0, a, b) != 0) goto out;
+    if (apply_pass(&base, f, &h, 1, a, b) != 0 || fdatasync(base.fd) != 0) {
+        fprintf(stderr, "apply: gravação interrompida; repita o apply com o mesmo delta\n");
+        goto out;
+    }
+    printf("%llu blocos em %llu trechos aplicados em %s (%.2f s)\n", (unsigned long long)h.blocks,
+           (unsigned long long)h.runs, base_path, (now_ms() - start) / 1000.0);
+    ret = 0;
+
+out:
+    free(a);
+    free(b);
+    fclose(f);
+    image_close(&base);
+    return ret;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s diff [-j <threads>] <base> <imagem_nova> <delta>\n"
+                    "       %s apply <base> <delta>\n", prog, prog);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "diff") == 0) {
+        const char *paths[3];
+        int npaths = 0, threads = 0;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+            else if (npaths < 3 && argv[i][0] != '-') paths[npaths++] = argv[i];
+            else npaths = 4;
+        }
+        if (npaths == 3) return do_diff(paths[0], paths[1], paths[2], threads);
+    }
+    else if (argc == 4 && strcmp(argv[1], "apply") == 0) {
+        return do_apply(argv[2], argv[3]);
+    }
+    usage(argv[0]);
+    return 1;
+}
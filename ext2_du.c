@@ -0,0 +1,148 @@
+#include <time.h>
+#include "ext2_du.h"
+#include "ext2_walk.h"
+#include "ext2_internal.h"
+
+// Totais de uma entrada do diretório inicial (somas atômicas)
+struct du_total {
+    char *name;
+    uint64_t files, dirs, bytes, alloc;
+};
+
+struct du_state {
+    ext2_fs *fs;
+    uint64_t *seen;             // Bitmap de inodes com mais de um link já contados
+    uint64_t hardlinks;         // Links extras ignorados
+    struct du_total *tops;
+    size_t ntops;
+    struct du_total root;       // O próprio inode inicial
+};
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Soma um inode aos totais; retorna 0 se for um link extra já contado
+static int account(struct du_state *st, uint32_t ino, const ext2_inode *inode, struct du_total *t) {
+    int is_dir = (inode->i_mode & EXT2_S_IFMT) == EXT2_S_IFDIR;
+    if (!is_dir && inode->i_links_count > 1) {
+        uint64_t bit = 1ull << ((ino - 1) % 64);
+        if (__atomic_fetch_or(&st->seen[(ino - 1) / 64], bit, __ATOMIC_RELAXED) & bit) {
+            __atomic_add_fetch(&st->hardlinks, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+    }
+    if (is_dir) t->dirs++;
+    else t->files++;
+    t->bytes += inode_file_size(st->fs, inode);
+    t->alloc += (uint64_t)inode->i_blocks * 512;
+    return 1;
+}
+
+static void add_total(struct du_total *to, const struct du_total *from) {
+    __atomic_add_fetch(&to->files, from->files, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&to->dirs, from->dirs, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&to->bytes, from->bytes, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&to->alloc, from->alloc, __ATOMIC_RELAXED);
+}
+
+// Um diretório: soma as entradas e empilha os subdiretórios
+static void du_dir(ext2_walk *w, int thread, const struct walk_task *task, struct walk_dir *d, void *arg) {
+    struct du_state *st = arg;
+    struct du_total sum = {0};
+    for (size_t i = 0; i < d->n; i++) {
+        struct walk_entry *e = &d->e[i];
+        if (account(st, e->ino, &e->inode, &sum) && walk_is_dir(e)) {
+            walk_push(w, thread, (struct walk_task){ e->ino, task->tag, NULL });
+        }
+    }
+    add_total(&st->tops[task->tag], &sum);
+}
+
+// --- Relatório ---
+
+static const char *human(uint64_t bytes, char *buf, size_t len) {
+    const char *units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+    double v = bytes;
+    int u = 0;
+    while (v >= 1024 && u < 4) {
+        v /= 1024;
+        u++;
+    }
+    if (u == 0) snprintf(buf, len, "%llu B", (unsigned long long)bytes);
+    else snprintf(buf, len, "%.1f %s", v, units[u]);
+    return buf;
+}
+
+static void print_line(FILE *out, const struct du_total *t, const char *name) {
+    char a[32], b[32];
+    fprintf(out, "%12s %12s %10llu %10llu  %s\n", human(t->bytes, a, sizeof(a)), human(t->alloc, b, sizeof(b)),
+            (unsigned long long)t->files, (unsigned long long)t->dirs, name);
+}
+
+static int cmp_top_alloc(const void *a, const void *b) {
+    uint64_t x = ((const struct du_total *)a)->alloc, y = ((const struct du_total *)b)->alloc;
+    return (x < y) - (x > y);
+}
+
+long long ext2_du(ext2_fs *fs, unsigned int inode_num, const char *path, int threads, FILE *out) {
+    double start = now_ms();
+    ext2_inode inode;
+    if (get_inode(fs, inode_num, &inode) != 0) return -1;
+
+    struct du_state st = { .fs = fs };
+    struct walk_dir d = {0};
+    ext2_walk *w = walk_create(fs, threads, du_dir, &st);
+    st.seen = calloc((fs->sb.s_inodes_count + 63) / 64, sizeof(uint64_t));
+    long long ret = -1;
+    if (!st.seen || !w) goto out;
+
+    account(&st, inode_num, &inode, &st.root);
+    if ((inode.i_mode & EXT2_S_IFMT) == EXT2_S_IFDIR) {
+        // O diretório inicial é lido aqui: cada entrada ganha o seu total e os
+        // subdiretórios são distribuídos entre as filas
+        if (walk_read_dir(fs, &inode, &d) != 0) goto out;
+        st.tops = calloc(d.n ? d.n : 1, sizeof(struct du_total));
+        if (!st.tops) goto out;
+        st.ntops = d.n;
+        for (size_t i = 0; i < d.n; i++) {
+            st.tops[i].name = strdup(walk_name(&d, i));
+            if (account(&st, d.e[i].ino, &d.e[i].inode, &st.tops[i]) && walk_is_dir(&d.e[i])) {
+                walk_push(w, (int)i, (struct walk_task){ d.e[i].ino, (uint32_t)i, NULL });
+            }
+        }
+        walk_run(w);
+    }
+
+    struct du_total total = st.root;
+    for (size_t i = 0; i < st.ntops; i++) {
+        total.files += st.tops[i].files;
+        total.dirs += st.tops[i].dirs;
+        total.bytes += st.tops[i].bytes;
+        total.alloc += st.tops[i].alloc;
+    }
+
+    fprintf(out, "%12s %12s %10s %10s  %s\n", "Aparente", "Alocado", "Arquivos", "Diretórios", "Nome");
+    qsort(st.tops, st.ntops, sizeof(struct du_total), cmp_top_alloc);
+    for (size_t i = 0; i < st.ntops; i++) {
+        if (st.tops[i].files + st.tops[i].dirs > 0) print_line(out, &st.tops[i], st.tops[i].name ? st.tops[i].name : "?");
+    }
+    print_line(out, &total, path);
+
+    ret = total.files + total.dirs;
+    double ms = now_ms() - start;
+    fprintf(out, "%lld inodes em %.1f ms (%.0f inodes/s), %d threads, %llu roubos de tarefa", ret, ms,
+            ms > 0 ? ret * 1000.0 / ms : 0.0, walk_threads(w), walk_steals(w));
+    if (st.hardlinks) fprintf(out, "; %llu links extras contados uma vez", (unsigned long long)st.hardlinks);
+    fprintf(out, "\n");
+
+out:
+    for (size_t i = 0; i < st.ntops; i++) free(st.tops[i].name);
+    free(st.tops);
+    free(st.seen);
+    walk_dir_free(&d);
+    walk_destroy(w);
+    return ret;
+}
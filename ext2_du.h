@@ -0,0 +1,30 @@
+#ifndef _EXT2_DU_H_
+#define _EXT2_DU_H_
+
+#include <stdio.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+/*
+function: Soma o espaço ocupado por um arquivo ou por uma árvore de diretórios.
+param:
+  - inode_num: Arquivo ou diretório inicial.
+  - path: Caminho de inode_num, usado no relatório.
+  - threads: Quantidade de threads (0 = uma por CPU).
+  - out: Onde o relatório é escrito.
+return:
+  - Quantidade de inodes contados ou -1 em erro.
+observações:
+  - Relata, para cada entrada do diretório inicial e no total, arquivos,
+    diretórios, tamanho aparente (soma dos tamanhos) e espaço alocado
+    (i_blocks, inclusive indiretos).
+  - A árvore é percorrida em paralelo por ext2_walk (filas por thread com
+    roubo de tarefas); os inodes das entradas de um diretório são buscados
+    em ordem de número, um bloco da tabela de inodes por vez.
+  - Inodes com mais de um link são contados uma única vez (bitmap atômico).
+  - Só leitura; sem locks de diretório, então uma árvore alterada durante a
+    contagem dá um resultado aproximado.
+*/
+long long ext2_du(ext2_fs *fs, unsigned int inode_num, const char *path, int threads, FILE *out);
+
+#endif
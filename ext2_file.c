@@ -0,0 +1,360 @@
+#include <time.h>
+#include "ext2_file.h"
+#include "ext2_internal.h"
+#include "ext2_journal.h"
+
+// Bloco lógico com dados sujos ainda sem bloco físico garantido
+struct dirty_page {
+    uint64_t lblk;
+    char *data;
+};
+
+struct ext2_file {
+    ext2_fs *fs;
+    unsigned int inode_num;
+    ext2_inode inode;
+    uint64_t size;          // Tamanho lógico (inclui dados ainda não gravados)
+    uint64_t disk_size;     // Tamanho já refletido no disco
+    struct dirty_page *pages; // Ordenado por lblk
+    size_t npages, cap;
+};
+
+// Bloco indireto em uso durante o flush (um por nível de profundidade)
+struct map_slot {
+    uint32_t blk;
+    uint32_t *buf;
+    int dirty;
+};
+
+// Estado de uma passada de flush. Com count_only, nada é gravado: a passada
+// apenas conta quantos blocos (dados + indiretos) precisam ser alocados.
+struct flush_state {
+    ext2_fs *fs;
+    ext2_inode inode;
+    int count_only;
+    unsigned int needed;
+    uint32_t fake_next;
+    uint32_t *pool;
+    unsigned int pool_len, pool_pos;
+    struct map_slot slots[3];
+
+    // Passada real: gravações acumuladas e feitas em trechos contíguos no fim,
+    // dados antes dos indiretos (cópias, pois os buffers dos slots são reusados)
+    struct block_write *data;
+    size_t ndata;
+    struct block_write *meta;
+    size_t nmeta, meta_cap;
+};
+
+ext2_file *ext2_file_open(ext2_fs *fs, unsigned int inode_num) {
+    ext2_file *f = calloc(1, sizeof(ext2_file));
+    if (!f) return NULL;
+
+    if (get_inode(fs, inode_num, &f->inode) != 0 || (f->inode.i_mode & EXT2_S_IFMT) != EXT2_S_IFREG) {
+        free(f);
+        return NULL;
+    }
+    f->fs = fs;
+    f->inode_num = inode_num;
+    f->size = f->disk_size = inode_file_size(fs, &f->inode);
+    return f;
+}
+
+// Busca binária pela página de `lblk`; retorna a posição de inserção se não existir
+static size_t find_page(const ext2_file *f, uint64_t lblk, int *found) {
+    size_t lo = 0, hi = f->npages;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (f->pages[mid].lblk < lblk) lo = mid + 1;
+        else hi = mid;
+    }
+    *found = (lo < f->npages && f->pages[lo].lblk == lblk);
+    return lo;
+}
+
+static char *get_page(ext2_file *f, uint64_t lblk) {
+    ext2_fs *fs = f->fs;
+    int found;
+    size_t pos = find_page(f, lblk, &found);
+    if (found) {
+        stats_op(fs, EXT2_OP_PAGE_HIT, 1);
+        return f->pages[pos].data;
+    }
+
+    if (f->npages == f->cap) {
+        size_t new_cap = f->cap ? f->cap * 2 : 64;
+        struct dirty_page *p = realloc(f->pages, new_cap * sizeof(struct dirty_page));
+        if (!p) return NULL;
+        f->pages = p;
+        f->cap = new_cap;
+    }
+
+    char *data = malloc(fs->block_size);
+    if (!data) return NULL;
+
+    // Escrita parcial sobre um bloco existente: parte do conteúdo atual
+    uint64_t disk_blocks = (f->disk_size + fs->block_size - 1) / fs->block_size;
+    uint32_t phys = (lblk < disk_blocks) ? inode_bmap(fs, &f->inode, lblk) : 0;
+    if (phys == 0 || read_block(fs, phys, data) != 0) {
+        memset(data, 0, fs->block_size);
+    }
+
+    memmove(&f->pages[pos + 1], &f->pages[pos], (f->npages - pos) * sizeof(struct dirty_page));
+    f->pages[pos].lblk = lblk;
+    f->pages[pos].data = data;
+    f->npages++;
+    return data;
+}
+
+ssize_t ext2_pwrite(ext2_file *f, const void *buf, size_t len, uint64_t offset) {
+    ext2_fs *fs = f->fs;
+    const char *src = buf;
+    size_t done = 0;
+
+    while (done < len) {
+        uint64_t lblk = offset / fs->block_size;
+        unsigned int in_block = offset % fs->block_size;
+        size_t n = fs->block_size - in_block;
+        if (n > len - done) n = len - done;
+
+        uint32_t idx[3];
+        if (inode_block_path(fs, lblk, idx) < 0) {
+            fprintf(stderr, "ext2_pwrite: offset além do limite do mapa de blocos\n");
+            break;
+        }
+
+        char *page = get_page(f, lblk);
+        if (!page) {
+            perror("ext2_pwrite");
+            break;
+        }
+        memcpy(page + in_block, src + done, n);
+
+        done += n;
+        offset += n;
+    }
+
+    if (offset > f->size) f->size = offset;
+
+    if ((uint64_t)f->npages * fs->block_size >= EXT2_FILE_MAX_DIRTY && ext2_file_flush(f) != 0) {
+        return -1;
+    }
+    return (done == 0 && len > 0) ? -1 : (ssize_t)done;
+}
+
+ssize_t ext2_append(ext2_file *f, const void *buf, size_t len) {
+    return ext2_pwrite(f, buf, len, f->size);
+}
+
+static uint32_t take_block(struct flush_state *st) {
+    ext2_fs *fs = st->fs;
+    st->inode.i_blocks += fs->block_size / 512;
+    if (st->count_only) {
+        st->needed++;
+        return st->fake_next--; // Número fictício, nunca lido do disco
+    }
+    if (st->pool_pos >= st->pool_len) return 0;
+    return st->pool[st->pool_pos++];
+}
+
+// Guarda uma cópia do indireto sujo para a gravação no fim; -1 sem memória
+static int slot_release(struct flush_state *st, int depth) {
+    ext2_fs *fs = st->fs;
+    struct map_slot *s = &st->slots[depth];
+    if (s->blk != 0 && s->dirty && !st->count_only) {
+        if (st->nmeta == st->meta_cap) {
+            size_t new_cap = st->meta_cap ? st->meta_cap * 2 : 16;
+            struct block_write *m = realloc(st->meta, new_cap * sizeof(struct block_write));
+            if (!m) return -1;
+            st->meta = m;
+            st->meta_cap = new_cap;
+        }
+        char *copy = malloc(fs->block_size);
+        if (!copy) return -1;
+        memcpy(copy, s->buf, fs->block_size);
+        st->meta[st->nmeta++] = (struct block_write){ s->blk, copy };
+    }
+    s->blk = 0;
+    s->dirty = 0;
+    return 0;
+}
+
+static uint32_t *slot_load(struct flush_state *st, int depth, uint32_t blk, int is_new) {
+    ext2_fs *fs = st->fs;
+    struct map_slot *s = &st->slots[depth];
+    if (s->blk == blk) {
+        stats_op(fs, EXT2_OP_MAP_HIT, 1);
+        return s->buf;
+    }
+
+    if (slot_release(st, depth) != 0) return NULL;
+    s->blk = blk;
+    if (is_new) {
+        memset(s->buf, 0, fs->block_size);
+        s->dirty = 1;
+    } else {
+        read_block_as(fs, blk, s->buf, EXT2_IO_INDIRECT);
+    }
+    return s->buf;
+}
+
+// Garante que o bloco lógico tenha bloco físico (criando indiretos se preciso)
+static uint32_t map_for_write(struct flush_state *st, uint64_t lblk) {
+    ext2_fs *fs = st->fs;
+    uint32_t idx[3];
+    int levels = inode_block_path(fs, lblk, idx);
+    if (levels < 0) return 0;
+
+    if (levels == 0) {
+        if (st->inode.i_block[idx[0]] == 0) st->inode.i_block[idx[0]] = take_block(st);
+        return st->inode.i_block[idx[0]];
+    }
+
+    int top = EXT2_IND_BLOCK + levels - 1;
+    int is_new = 0;
+    if (st->inode.i_block[top] == 0) {
+        st->inode.i_block[top] = take_block(st);
+        is_new = 1;
+        if (st->inode.i_block[top] == 0) return 0;
+    }
+
+    uint32_t blk = st->inode.i_block[top];
+    for (int d = 0; d < levels; d++) {
+        uint32_t *ptrs = slot_load(st, d, blk, is_new);
+        if (!ptrs) return 0;
+        is_new = 0;
+        if (ptrs[idx[d]] == 0) {
+            ptrs[idx[d]] = take_block(st);
+            st->slots[d].dirty = 1;
+            is_new = 1;
+            if (ptrs[idx[d]] == 0) return 0;
+        }
+        blk = ptrs[idx[d]];
+    }
+    return blk;
+}
+
+static int flush_pass(ext2_file *f, struct flush_state *st) {
+    ext2_fs *fs = f->fs;
+    int ret = 0;
+    st->inode = f->inode;
+    for (size_t i = 0; i < f->npages; i++) {
+        uint32_t phys = map_for_write(st, f->pages[i].lblk);
+        if (phys == 0) {
+            ret = -1;
+            break;
+        }
+        if (!st->count_only) st->data[st->ndata++] = (struct block_write){ phys, f->pages[i].data };
+    }
+    for (int d = 0; d < 3; d++) {
+        if (slot_release(st, d) != 0) ret = -1;
+    }
+    // Falha na passada real: nada foi gravado e o pool é devolvido pelo chamador
+    if (st->count_only || ret != 0) return ret;
+
+    write_data_blocks(fs, st->data, st->ndata);
+    // Com journal, o commit já leva os dados ao disco antes dos metadados
+    if (!fs->journal && st->nmeta > 0) write_barrier(fs);
+    write_metadata_blocks(fs, st->meta, st->nmeta);
+    return ret;
+}
+
+static int flush_pages(ext2_file *f) {
+    ext2_fs *fs = f->fs;
+
+    struct flush_state st = {0};
+    st.fs = fs;
+    for (int d = 0; d < 3; d++) {
+        st.slots[d].buf = malloc(fs->block_size);
+        if (!st.slots[d].buf) {
+            for (int k = 0; k < d; k++) free(st.slots[k].buf);
+            return -1;
+        }
+    }
+
+    // 1. Passada de contagem: quantos blocos de dados e indiretos faltam
+    st.count_only = 1;
+    st.fake_next = 0xFFFFFFFF;
+    int ret = flush_pass(f, &st);
+
+    // 2. Aloca tudo de uma vez, começando logo após o bloco anterior à primeira página
+    if (ret == 0 && st.needed > 0) {
+        st.pool = malloc(st.needed * sizeof(uint32_t));
+        uint32_t goal = 0;
+        if (f->npages > 0 && f->pages[0].lblk > 0) {
+            goal = inode_bmap(fs, &f->inode, f->pages[0].lblk - 1);
+            if (goal) goal++;
+        }
+
+        while (st.pool && st.pool_len < st.needed) {
+            unsigned int got;
+            unsigned int start = alloc_block_run(fs, goal, st.needed - st.pool_len, &got);
+            if (start == 0) break;
+            for (unsigned int k = 0; k < got; k++) st.pool[st.pool_len++] = start + k;
+            goal = start + got;
+        }
+
+        if (!st.pool || st.pool_len < st.needed) {
+            fprintf(stderr, "ext2_file_flush: sem espaço para %u blocos\n", st.needed);
+            if (st.pool) {
+                block_list partial = { st.pool, st.pool_len, st.needed };
+                free_block_list(fs, &partial);
+            }
+            ret = -1;
+        }
+    }
+
+    // 3. Passada real: distribui o trecho em ordem lógica e grava os dados
+    if (ret == 0) {
+        st.count_only = 0;
+        st.data = malloc(f->npages * sizeof(struct block_write));
+        ret = st.data ? flush_pass(f, &st) : -1;
+        if (ret != 0 && st.pool_len > 0) {
+            fprintf(stderr, "ext2_file_flush: sem memória para o mapa de blocos\n");
+            block_list pool = { st.pool, st.pool_len, st.needed };
+            free_block_list(fs, &pool);
+        }
+    }
+
+    if (ret == 0) {
+        time_t now = time(NULL);
+        f->inode = st.inode;
+        inode_set_file_size(fs, &f->inode, f->size);
+        f->inode.i_mtime = now;
+        f->inode.i_ctime = now;
+        write_inode(fs, f->inode_num, &f->inode);
+        f->disk_size = f->size;
+
+        for (size_t i = 0; i < f->npages; i++) free(f->pages[i].data);
+        f->npages = 0;
+    }
+
+    free(st.pool);
+    free(st.data);
+    for (size_t i = 0; i < st.nmeta; i++) free((void *)st.meta[i].data);
+    free(st.meta);
+    for (int d = 0; d < 3; d++) free(st.slots[d].buf);
+    return ret;
+}
+
+int ext2_file_flush(ext2_file *f) {
+    if (f->npages == 0 && f->size == f->disk_size) return 0;
+    // Alocação, indiretos e inode entram juntos em uma transação do journal.
+    // Como em ext2_truncate, o inode fica travado para escrita durante todo o
+    // flush: o mapa é relido aqui e regravado sem outra alteração no meio.
+    ext2_journal_begin(f->fs);
+    pthread_rwlock_wrlock(inode_lock(f->fs, f->inode_num));
+    int ret = get_inode(f->fs, f->inode_num, &f->inode) == 0 ? flush_pages(f) : -1;
+    pthread_rwlock_unlock(inode_lock(f->fs, f->inode_num));
+    ext2_journal_end(f->fs);
+    return ret;
+}
+
+int ext2_file_close(ext2_file *f) {
+    if (!f) return 0;
+    int ret = ext2_file_flush(f);
+    for (size_t i = 0; i < f->npages; i++) free(f->pages[i].data);
+    free(f->pages);
+    free(f);
+    return ret;
+}
@@ -0,0 +1,74 @@
+#ifndef _EXT2_FILE_H_
+#define _EXT2_FILE_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Limite de dados sujos em memória antes de um flush automático (bytes)
+#define EXT2_FILE_MAX_DIRTY (8 * 1024 * 1024)
+
+// Arquivo aberto para escrita (alocação de blocos adiada até o flush)
+typedef struct ext2_file ext2_file;
+
+/*
+função: Abre um arquivo regular da imagem para escrita.
+parâmetros:
+  - inode_num: Inode do arquivo.
+retorno:
+  - Handle do arquivo ou NULL em erro (inode inválido ou não regular).
+*/
+ext2_file *ext2_file_open(ext2_fs *fs, unsigned int inode_num);
+
+/*
+função: Escreve dados em um offset do arquivo.
+parâmetros:
+  - f: Handle do arquivo.
+  - buf: Dados a serem escritos.
+  - len: Quantidade de bytes.
+  - offset: Posição (em bytes) no arquivo.
+retorno:
+  - Bytes aceitos ou -1 em erro.
+observações:
+  - Os dados ficam em buffers na memória; nenhum bloco é alocado aqui.
+  - Ao passar de EXT2_FILE_MAX_DIRTY bytes sujos, faz flush automático.
+*/
+ssize_t ext2_pwrite(ext2_file *f, const void *buf, size_t len, uint64_t offset);
+
+/*
+função: Acrescenta dados ao final do arquivo.
+parâmetros:
+  - f: Handle do arquivo.
+  - buf: Dados a serem escritos.
+  - len: Quantidade de bytes.
+retorno:
+  - Bytes aceitos ou -1 em erro.
+*/
+ssize_t ext2_append(ext2_file *f, const void *buf, size_t len);
+
+/*
+função: Grava os dados pendentes, alocando os blocos físicos necessários.
+parâmetros:
+  - f: Handle do arquivo.
+retorno:
+  - 0 em sucesso, -1 em erro (ex: sem espaço).
+observações:
+  - Conta todos os blocos de dados e indiretos que faltam e os aloca de uma
+    vez com alloc_block_run(), começando após o último bloco do arquivo,
+    para que o trecho fique contíguo no disco.
+*/
+int ext2_file_flush(ext2_file *f);
+
+/*
+função: Faz flush e libera o handle.
+parâmetros:
+  - f: Handle do arquivo.
+retorno:
+  - 0 em sucesso, -1 se o flush falhou.
+*/
+int ext2_file_close(ext2_file *f);
+
+#endif
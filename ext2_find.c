@@ -0,0 +1,486 @@
+#include <fnmatch.h>
+#include "ext2_find.h"
+#include "ext2_walk.h"
+#include "ext2_internal.h"
+
+// Blocos de diretório lidos por pread na varredura
+#define FIND_RUN_BLOCKS 64
+
+// Profundidade máxima ao subir pela cadeia de pais (protege contra ciclos)
+#define FIND_MAX_DEPTH 4096
+
+int ext2_find_predicate(struct ext2_find_query *q, const char *opt, const char *value) {
+    if (!value || !*value) return -1;
+    if (strcmp(opt, "-name") == 0) {
+        q->name = value;
+        return 0;
+    }
+    if (strcmp(opt, "-type") == 0) {
+        if (strcmp(value, "f") != 0 && strcmp(value, "d") != 0 && strcmp(value, "l") != 0) return -1;
+        q->type = value[0];
+        return 0;
+    }
+
+    int cmp = 0;
+    if (*value == '+' || *value == '-') cmp = *value++ == '+' ? 1 : -1;
+    char *end;
+    unsigned long long n = strtoull(value, &end, 10);
+    if (end == value) return -1;
+
+    if (strcmp(opt, "-size") == 0) {
+        uint64_t unit = 1;
+        if (*end == 'k') unit = 1024;
+        else if (*end == 'M') unit = 1024 * 1024;
+        else if (*end == 'G') unit = 1024 * 1024 * 1024;
+        else if (*end == 'c') unit = 1;
+        else if (*end) return -1;
+        if (*end && end[1]) return -1;
+        q->has_size = 1;
+        q->size_cmp = cmp;
+        q->size = n;
+        q->size_unit = unit;
+        return 0;
+    }
+    if (strcmp(opt, "-mtime") == 0) {
+        if (*end) return -1;
+        q->has_mtime = 1;
+        q->mtime_cmp = cmp;
+        q->mtime_days = (long)n;
+        q->now = time(NULL);
+        return 0;
+    }
+    return -1;
+}
+
+static int compare(uint64_t value, int cmp, uint64_t ref) {
+    return cmp > 0 ? value > ref : cmp < 0 ? value < ref : value == ref;
+}
+
+// Predicados que só dependem do inode
+static int match_attrs(ext2_fs *fs, const struct ext2_find_query *q, const ext2_inode *inode) {
+    uint16_t type = inode->i_mode & EXT2_S_IFMT;
+    if (q->type == 'f' && type != EXT2_S_IFREG) return 0;
+    if (q->type == 'd' && type != EXT2_S_IFDIR) return 0;
+    if (q->type == 'l' && type != EXT2_S_IFLNK) return 0;
+    if (q->has_size) {
+        uint64_t size = inode_file_size(fs, inode);
+        uint64_t units = (size + q->size_unit - 1) / q->size_unit;
+        if (!compare(units, q->size_cmp, q->size)) return 0;
+    }
+    if (q->has_mtime) {
+        int64_t age = (int64_t)q->now - inode->i_mtime;
+        uint64_t days = age > 0 ? (uint64_t)age / 86400 : 0;
+        if (!compare(days, q->mtime_cmp, q->mtime_days)) return 0;
+    }
+    return 1;
+}
+
+static int match_name(const struct ext2_find_query *q, const char *name) {
+    return !q->name || fnmatch(q->name, name, 0) == 0;
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// --- Resultados ---
+
+struct path_list {
+    char **v;
+    size_t n, cap;
+};
+
+static int list_add(struct path_list *l, char *path) {
+    if (!path) return -1;
+    if (l->n == l->cap) {
+        size_t cap = l->cap ? l->cap * 2 : 256;
+        char **grown = realloc(l->v, cap * sizeof(char *));
+        if (!grown) {
+            free(path);
+            return -1;
+        }
+        l->v = grown;
+        l->cap = cap;
+    }
+    l->v[l->n++] = path;
+    return 0;
+}
+
+static void list_free(struct path_list *l) {
+    for (size_t i = 0; i < l->n; i++) free(l->v[i]);
+    free(l->v);
+}
+
+static char *join_path(const char *dir, const char *name) {
+    size_t dl = strlen(dir), nl = strlen(name);
+    int slash = dl > 0 && dir[dl - 1] != '/';
+    char *p = malloc(dl + slash + nl + 1);
+    if (!p) return NULL;
+    memcpy(p, dir, dl);
+    if (slash) p[dl] = '/';
+    memcpy(p + dl + slash, name, nl + 1);
+    return p;
+}
+
+static int cmp_path(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// --- Percurso ---
+
+struct find_walk {
+    ext2_fs *fs;
+    const struct ext2_find_query *q;
+    struct path_list *found;    // Um por thread
+};
+
+static void find_dir(ext2_walk *w, int thread, const struct walk_task *task, struct walk_dir *d, void *arg) {
+    struct find_walk *st = arg;
+    for (size_t i = 0; i < d->n; i++) {
+        struct walk_entry *e = &d->e[i];
+        const char *name = walk_name(d, i);
+        int hit = match_name(st->q, name) && match_attrs(st->fs, st->q, &e->inode);
+        if (!hit && !walk_is_dir(e)) continue;
+
+        char *child = join_path(task->path, name);
+        if (hit && child) list_add(&st->found[thread], strdup(child));
+        if (walk_is_dir(e)) walk_push(w, thread, (struct walk_task){ e->ino, 0, child });
+        else free(child);
+    }
+}
+
+static int find_walk(ext2_fs *fs, unsigned int inode_num, const char *path, const struct ext2_find_query *q,
+                     int threads, struct path_list *found, char *note, size_t note_len) {
+    struct find_walk st = { fs, q, NULL };
+    ext2_walk *w = walk_create(fs, threads, find_dir, &st);
+    char *root = strdup(path);
+    if (!w || !root || !(st.found = calloc(walk_threads(w), sizeof(struct path_list)))) {
+        free(root);
+        walk_destroy(w);
+        return -1;
+    }
+    walk_push(w, 0, (struct walk_task){ inode_num, 0, root });
+    walk_run(w);
+
+    int ret = 0;
+    for (int t = 0; t < walk_threads(w); t++) {
+        for (size_t i = 0; i < st.found[t].n; i++) {
+            if (list_add(found, st.found[t].v[i]) != 0) ret = -1;
+        }
+        free(st.found[t].v);
+    }
+    snprintf(note, note_len, "percurso paralelo: %d threads, %llu roubos de tarefa", walk_threads(w), walk_steals(w));
+    free(st.found);
+    walk_destroy(w);
+    return ret;
+}
+
+// --- Varredura ---
+
+struct scan_dir {
+    uint32_t ino;
+    ext2_inode inode;
+};
+
+struct scan_block {
+    uint32_t block;
+    uint32_t dir;
+};
+
+struct scan_hit {
+    uint32_t ino, parent, name_off;
+};
+
+struct find_scan {
+    ext2_fs *fs;
+    const struct ext2_find_query *q;
+    uint64_t *is_dir, *is_hit;  // Bitmaps por número de inode
+    struct scan_dir *dirs;
+    size_t ndirs, dirs_cap;
+    struct scan_block *blocks;  // Blocos de dados de todos os diretórios
+    size_t nblocks, blocks_cap;
+    uint32_t cur_dir;
+    uint32_t *parent, *name_off; // Pai e nome de cada diretório (0 = desconhecido)
+    char *strs;
+    size_t strs_len, strs_cap;
+    struct scan_hit *hits;
+    size_t nhits, hits_cap;
+    uint64_t inodes, table_blocks, reads;
+};
+
+static inline int test_bit(const uint64_t *bm, uint32_t ino) {
+    return (bm[(ino - 1) / 64] >> ((ino - 1) % 64)) & 1;
+}
+
+static inline void set_bit(uint64_t *bm, uint32_t ino) {
+    bm[(ino - 1) / 64] |= 1ull << ((ino - 1) % 64);
+}
+
+// Aumenta *v (de `size` bytes por item) para caber mais um
+static int grow(void **v, size_t n, size_t *cap, size_t size) {
+    if (n < *cap) return 0;
+    size_t c = *cap ? *cap * 2 : 256;
+    void *grown = realloc(*v, c * size);
+    if (!grown) return -1;
+    *v = grown;
+    *cap = c;
+    return 0;
+}
+
+// Guarda um nome de entrada; retorna o offset em strs ou UINT32_MAX sem memória
+static uint32_t store_name(struct find_scan *st, const char *name, unsigned int len) {
+    while (st->strs_len + len + 1 > st->strs_cap) {
+        size_t cap = st->strs_cap ? st->strs_cap * 2 : 65536;
+        char *grown = realloc(st->strs, cap);
+        if (!grown) return UINT32_MAX;
+        st->strs = grown;
+        st->strs_cap = cap;
+    }
+    uint32_t off = (uint32_t)st->strs_len;
+    memcpy(st->strs + off, name, len);
+    st->strs[off + len] = '\0';
+    st->strs_len += len + 1;
+    return off;
+}
+
+// Lê `count` blocos seguidos com um único pread (versões do journal têm prioridade)
+static int read_run(struct find_scan *st, uint32_t first, uint32_t count, char *buf, enum ext2_io_cat cat) {
+    ext2_fs *fs = st->fs;
+    size_t len = (size_t)count * fs->block_size;
+    stats_calls(fs, 0, 1);
+    st->reads++;
+    if (image_pread(fs, buf, len, (off_t)first * fs->block_size) != 0) return -1;
+    stats_blocks(fs, 0, first, count, cat);
+    if (fs->journal) {
+        for (uint32_t i = 0; i < count; i++) journal_read(fs, first + i, buf + (size_t)i * fs->block_size);
+    }
+    return 0;
+}
+
+// Passo 1: tabelas de inodes em ordem; só até o último inode em uso de cada grupo
+static int scan_tables(struct find_scan *st, unsigned int first_ino) {
+    ext2_fs *fs = st->fs;
+    uint32_t ipg = fs->sb.s_inodes_per_group;
+    uint32_t itb = (ipg + fs->inodes_per_block - 1) / fs->inodes_per_block;
+    char *table = malloc((size_t)itb * fs->block_size);
+    uint64_t *bitmap = malloc(fs->block_size);
+    int ret = table && bitmap ? 0 : -1;
+
+    for (unsigned int g = 0; ret == 0 && g < fs->group_count; g++) {
+        if (fs->gd[g].bg_free_inodes_count >= ipg) continue;
+        if (read_block_as(fs, fs->gd[g].bg_inode_bitmap, bitmap, EXT2_IO_BITMAP) != 0) {
+            ret = -1;
+            break;
+        }
+        uint32_t used_end = 0;
+        for (uint32_t w = (ipg + 63) / 64; w-- > 0;) {
+            uint64_t bits = bitmap[w];
+            if (w * 64 + 64 > ipg) bits &= (1ull << (ipg - w * 64)) - 1;
+            if (bits) {
+                used_end = w * 64 + 64 - __builtin_clzll(bits);
+                break;
+            }
+        }
+        if (used_end == 0) continue;
+
+        uint32_t nblocks = (used_end + fs->inodes_per_block - 1) / fs->inodes_per_block;
+        if (read_run(st, fs->gd[g].bg_inode_table, nblocks, table, EXT2_IO_INODE) != 0) {
+            ret = -1;
+            break;
+        }
+        st->table_blocks += nblocks;
+
+        for (uint32_t i = 0; i < used_end; i++) {
+            uint32_t ino = g * ipg + i + 1;
+            if (ino > fs->sb.s_inodes_count) break;
+            if (!((bitmap[i / 64] >> (i % 64)) & 1)) continue;
+            if (ino < first_ino && ino != EXT2_ROOT_INO) continue;
+            const ext2_inode *inode = (const ext2_inode *)(table + (size_t)i * sizeof(ext2_inode));
+            if (inode->i_links_count == 0) continue;
+            st->inodes++;
+
+            if ((inode->i_mode & EXT2_S_IFMT) == EXT2_S_IFDIR) {
+                if (grow((void **)&st->dirs, st->ndirs, &st->dirs_cap, sizeof(struct scan_dir)) != 0) {
+                    ret = -1;
+                    break;
+                }
+                st->dirs[st->ndirs++] = (struct scan_dir){ ino, *inode };
+                set_bit(st->is_dir, ino);
+            }
+            if (match_attrs(fs, st->q, inode)) set_bit(st->is_hit, ino);
+        }
+    }
+    stats_op(fs, EXT2_OP_GET_INODE, st->inodes);
+    free(table);
+    free(bitmap);
+    return ret;
+}
+
+static int collect_block(ext2_fs *fs, uint32_t block_num, uint64_t lblk, void *ctx) {
+    (void)lblk;
+    struct find_scan *st = ctx;
+    if (block_num == 0 || block_num >= fs->sb.s_blocks_count) return 0;
+    if (grow((void **)&st->blocks, st->nblocks, &st->blocks_cap, sizeof(struct scan_block)) != 0) return -1;
+    st->blocks[st->nblocks++] = (struct scan_block){ block_num, st->cur_dir };
+    return 0;
+}
+
+static int cmp_scan_block(const void *a, const void *b) {
+    uint32_t x = ((const struct scan_block *)a)->block, y = ((const struct scan_block *)b)->block;
+    return (x > y) - (x < y);
+}
+
+static int parse_dir_block(struct find_scan *st, const char *buf, uint32_t dir) {
+    ext2_fs *fs = st->fs;
+    for (unsigned int off = 0; off + 8 <= fs->block_size;) {
+        const ext2_dir_entry_2 *e = (const ext2_dir_entry_2 *)(buf + off);
+        if (e->rec_len < 8 || off + e->rec_len > fs->block_size) break;
+        off += e->rec_len;
+        uint32_t child = e->inode;
+        if (child == 0 || child > fs->sb.s_inodes_count) continue;
+        if (e->name_len == 1 && e->name[0] == '.') continue;
+        if (e->name_len == 2 && e->name[0] == '.' && e->name[1] == '.') continue;
+
+        int is_dir = test_bit(st->is_dir, child);
+        int is_hit = test_bit(st->is_hit, child);
+        if (!is_dir && !is_hit) continue;
+
+        char name[256];
+        memcpy(name, e->name, e->name_len);
+        name[e->name_len] = '\0';
+        uint32_t off_name = store_name(st, name, e->name_len);
+        if (off_name == UINT32_MAX) return -1;
+        if (is_dir) {
+            st->parent[child - 1] = dir;
+            st->name_off[child - 1] = off_name;
+        }
+        if (is_hit && match_name(st->q, name)) {
+            if (grow((void **)&st->hits, st->nhits, &st->hits_cap, sizeof(struct scan_hit)) != 0) return -1;
+            st->hits[st->nhits++] = (struct scan_hit){ child, dir, off_name };
+        }
+    }
+    return 0;
+}
+
+// Passo 2: blocos de todos os diretórios, em ordem de bloco e em trechos contíguos
+static int scan_dirs(struct find_scan *st) {
+    ext2_fs *fs = st->fs;
+    for (size_t i = 0; i < st->ndirs; i++) {
+        const ext2_inode *inode = &st->dirs[i].inode;
+        uint64_t nblocks = (inode_file_size(fs, inode) + fs->block_size - 1) / fs->block_size;
+        st->cur_dir = st->dirs[i].ino;
+        if (walk_file_blocks(fs, inode, nblocks, collect_block, st) < 0) return -1;
+    }
+    qsort(st->blocks, st->nblocks, sizeof(struct scan_block), cmp_scan_block);
+
+    char *buf = malloc((size_t)FIND_RUN_BLOCKS * fs->block_size);
+    if (!buf) return -1;
+    int ret = 0;
+    for (size_t i = 0; ret == 0 && i < st->nblocks;) {
+        size_t n = 1;
+        while (i + n < st->nblocks && n < FIND_RUN_BLOCKS && st->blocks[i + n].block == st->blocks[i].block + n) n++;
+        if (read_run(st, st->blocks[i].block, (uint32_t)n, buf, EXT2_IO_DIR) != 0) {
+            ret = -1;
+            break;
+        }
+        for (size_t k = 0; k < n && ret == 0; k++) {
+            ret = parse_dir_block(st, buf + k * fs->block_size, st->blocks[i + k].dir);
+        }
+        i += n;
+    }
+    free(buf);
+    return ret;
+}
+
+// Passo 3: caminho de um encontrado, subindo pelos pais até o inicial
+static char *hit_path(struct find_scan *st, const struct scan_hit *h, uint32_t root, const char *path) {
+    const char *parts[FIND_MAX_DEPTH];
+    int depth = 0;
+    parts[depth++] = st->strs + h->name_off;
+    for (uint32_t dir = h->parent; dir != root; dir = st->parent[dir - 1]) {
+        if (dir == EXT2_ROOT_INO || st->parent[dir - 1] == 0 || depth == FIND_MAX_DEPTH) return NULL; // Fora da subárvore
+        parts[depth++] = st->strs + st->name_off[dir - 1];
+    }
+
+    size_t len = strlen(path) + 1;
+    for (int i = 0; i < depth; i++) len += strlen(parts[i]) + 1;
+    char *p = malloc(len);
+    if (!p) return NULL;
+    size_t pos = strlen(path);
+    memcpy(p, path, pos);
+    for (int i = depth - 1; i >= 0; i--) {
+        if (pos == 0 || p[pos - 1] != '/') p[pos++] = '/';
+        size_t l = strlen(parts[i]);
+        memcpy(p + pos, parts[i], l);
+        pos += l;
+    }
+    p[pos] = '\0';
+    return p;
+}
+
+static int find_scan(ext2_fs *fs, unsigned int inode_num, const char *path, const struct ext2_find_query *q,
+                     struct path_list *found, char *note, size_t note_len) {
+    struct find_scan st = { .fs = fs, .q = q };
+    size_t words = (fs->sb.s_inodes_count + 63) / 64;
+    unsigned int first_ino = fs->sb.s_rev_level >= 1 ? fs->sb.s_first_ino : 11;
+    st.is_dir = calloc(words, sizeof(uint64_t));
+    st.is_hit = calloc(words, sizeof(uint64_t));
+    st.parent = calloc(fs->sb.s_inodes_count, sizeof(uint32_t));
+    st.name_off = calloc(fs->sb.s_inodes_count, sizeof(uint32_t));
+
+    int ret = -1;
+    if (st.is_dir && st.is_hit && st.parent && st.name_off && scan_tables(&st, first_ino) == 0 && scan_dirs(&st) == 0) {
+        ret = 0;
+        for (size_t i = 0; i < st.nhits; i++) {
+            char *p = hit_path(&st, &st.hits[i], inode_num, path);
+            if (p && list_add(found, p) != 0) ret = -1;
+        }
+        snprintf(note, note_len, "varredura: %llu inodes em %llu blocos da tabela, %zu diretórios em %zu blocos, %llu leituras",
+                (unsigned long long)st.inodes, (unsigned long long)st.table_blocks, st.ndirs, st.nblocks,
+                (unsigned long long)st.reads);
+    }
+    free(st.is_dir);
+    free(st.is_hit);
+    free(st.parent);
+    free(st.name_off);
+    free(st.dirs);
+    free(st.blocks);
+    free(st.strs);
+    free(st.hits);
+    return ret;
+}
+
+long long ext2_find(ext2_fs *fs, unsigned int inode_num, const char *path, const struct ext2_find_query *q,
+                    enum ext2_find_mode mode, int threads, FILE *out) {
+    double start = now_ms();
+    ext2_inode inode;
+    if (get_inode(fs, inode_num, &inode) != 0) return -1;
+
+    // O próprio inicial, testado pelo último componente do caminho
+    struct path_list found = {0};
+    const char *base = strrchr(path, '/');
+    base = base && base[1] ? base + 1 : path;
+    if (match_name(q, base) && match_attrs(fs, q, &inode)) list_add(&found, strdup(path));
+
+    // Sem diretório, não há o que percorrer
+    char summary[256] = "";
+    int ret = 0;
+    if ((inode.i_mode & EXT2_S_IFMT) == EXT2_S_IFDIR) {
+        if (mode == EXT2_FIND_AUTO) mode = q->name ? EXT2_FIND_WALK : EXT2_FIND_SCAN;
+        if (mode == EXT2_FIND_WALK) ret = find_walk(fs, inode_num, path, q, threads, &found, summary, sizeof(summary));
+        else ret = find_scan(fs, inode_num, path, q, &found, summary, sizeof(summary));
+    }
+    if (ret != 0) {
+        list_free(&found);
+        return -1;
+    }
+
+    qsort(found.v, found.n, sizeof(char *), cmp_path);
+    for (size_t i = 0; i < found.n; i++) fprintf(out, "%s\n", found.v[i]);
+    fprintf(out, "%zu encontrados em %.1f ms%s%s\n", found.n, now_ms() - start, *summary ? "; " : "", summary);
+    long long n = (long long)found.n;
+    list_free(&found);
+    return n;
+}
@@ -0,0 +1,73 @@
+#ifndef _EXT2_FIND_H_
+#define _EXT2_FIND_H_
+
+#include <stdio.h>
+#include <time.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Predicados de uma busca; os ausentes são ignorados
+struct ext2_find_query {
+    const char *name;       // Padrão do nome (fnmatch: *, ?, [...]) ou NULL
+    char type;              // 'f', 'd', 'l' ou 0
+    int has_size;
+    int size_cmp;           // -1 menor, 0 igual, 1 maior
+    uint64_t size;          // Em unidades de size_unit
+    uint64_t size_unit;     // 1, 1024, 1024^2 ou 1024^3 bytes
+    int has_mtime;
+    int mtime_cmp;
+    long mtime_days;        // Dias completos desde a última modificação
+    time_t now;             // Referência de -mtime (preenchida por ext2_find_predicate)
+};
+
+enum ext2_find_mode {
+    EXT2_FIND_AUTO,         // Percurso com -name, varredura sem
+    EXT2_FIND_WALK,
+    EXT2_FIND_SCAN,
+};
+
+/*
+function: Interpreta um predicado da linha de comando.
+param:
+  - q: Busca a completar (zerada antes do primeiro predicado).
+  - opt: "-name", "-type", "-size" ou "-mtime".
+  - value: Argumento do predicado ("*.c", "f", "+10k", "-7", ...).
+return:
+  - 0 em sucesso, -1 se o predicado ou o valor forem inválidos.
+observações:
+  - -size aceita [+-]N com sufixo k, M ou G (sem sufixo: bytes); como no
+    find(1), o tamanho é arredondado para cima na unidade antes de comparar.
+  - -mtime [+-]N compara os dias completos desde a modificação.
+  - q->name aponta para `value`, que deve viver até o fim da busca.
+*/
+int ext2_find_predicate(struct ext2_find_query *q, const char *opt, const char *value);
+
+/*
+function: Lista os arquivos de uma árvore que satisfazem todos os predicados.
+param:
+  - inode_num: Diretório (ou arquivo) inicial.
+  - path: Caminho de inode_num, prefixo dos caminhos listados.
+  - q: Predicados.
+  - mode: Estratégia (EXT2_FIND_AUTO escolhe pelo predicado de nome).
+  - threads: Threads do percurso (0 = uma por CPU).
+  - out: Onde os caminhos e o resumo são escritos.
+return:
+  - Quantidade de caminhos listados ou -1 em erro.
+observações:
+  - Percurso: a árvore é percorrida em paralelo por ext2_walk e o nome de
+    cada entrada é testado antes de qualquer outro predicado. Bom quando o
+    nome descarta quase tudo ou a subárvore é pequena.
+  - Varredura: as tabelas de inodes são lidas em ordem, em grandes leituras
+    sequenciais, e os predicados de atributo são testados em cada inode em
+    uso. Em seguida, os blocos de todos os diretórios são lidos uma vez, em
+    ordem de bloco, para montar o mapa inode -> (pai, nome) que dá os
+    caminhos dos inodes encontrados. O custo não depende da quantidade de
+    arquivos encontrados: nada de uma leitura aleatória por arquivo.
+  - Os caminhos saem ordenados; um arquivo com vários hard links aparece uma
+    vez por nome. O próprio inicial é listado se satisfizer os predicados.
+  - Só leitura; sem locks de diretório, como o du.
+*/
+long long ext2_find(ext2_fs *fs, unsigned int inode_num, const char *path, const struct ext2_find_query *q,
+                    enum ext2_find_mode mode, int threads, FILE *out);
+
+#endif
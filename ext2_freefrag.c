@@ -0,0 +1,166 @@
+#include "ext2_freefrag.h"
+#include "ext2_internal.h"
+
+// Tamanhos de alocação relatados: potências de 2 até 2^(FREEFRAG_SIZES - 1)
+// blocos, mais o pedido pelo usuário (último lugar)
+#define FREEFRAG_SIZES 16
+
+struct frag_hist {
+    uint64_t free, extents, largest;
+    uint64_t count[EXT2_FREEFRAG_BUCKETS];     // Trechos por faixa
+    uint64_t blocks[EXT2_FREEFRAG_BUCKETS];    // Blocos livres por faixa
+    uint64_t usable[FREEFRAG_SIZES + 1];       // Blocos aproveitáveis por tamanho de alocação
+};
+
+static void end_run(struct frag_hist *h, uint64_t len, unsigned int alloc_blocks) {
+    if (len == 0) return;
+    unsigned int b = 63 - __builtin_clzll(len);
+    if (b >= EXT2_FREEFRAG_BUCKETS) b = EXT2_FREEFRAG_BUCKETS - 1;
+    h->count[b]++;
+    h->blocks[b] += len;
+    h->extents++;
+    if (len > h->largest) h->largest = len;
+    for (unsigned int k = 0; k < FREEFRAG_SIZES; k++) h->usable[k] += len - (len & ((1ull << k) - 1));
+    if (alloc_blocks) h->usable[FREEFRAG_SIZES] += len - len % alloc_blocks;
+}
+
+// Percorre `nbits` bits do bitmap (1 = ocupado) 64 por vez. Em x86-64 o GCC
+// gera uma versão com a instrução popcnt, escolhida na carga do programa.
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+__attribute__((target_clones("popcnt", "default")))
+#endif
+static void scan_bitmap(const uint64_t *words, unsigned int nbits, struct frag_hist *h, unsigned int alloc_blocks) {
+    uint64_t run = 0;
+    for (unsigned int w = 0; w * 64 < nbits; w++) {
+        uint64_t free_bits = ~words[w];
+        unsigned int valid = nbits - w * 64 < 64 ? nbits - w * 64 : 64;
+        if (valid < 64) free_bits &= (1ull << valid) - 1; // Bits além do grupo contam como ocupados
+        h->free += __builtin_popcountll(free_bits);
+
+        if (free_bits == ~0ull) {
+            run += 64;
+            continue;
+        }
+        if (free_bits == 0) {
+            end_run(h, run, alloc_blocks);
+            run = 0;
+            continue;
+        }
+
+        // Alternância de trechos livres (1) e ocupados (0) dentro da palavra
+        unsigned int left = 64;
+        uint64_t x = free_bits;
+        while (left > 0) {
+            unsigned int n;
+            if (x & 1) {
+                n = __builtin_ctzll(~x);
+                if (n > left) n = left;
+                run += n;
+            } else {
+                n = x == 0 ? left : (unsigned int)__builtin_ctzll(x);
+                if (n > left) n = left;
+                end_run(h, run, alloc_blocks);
+                run = 0;
+            }
+            left -= n;
+            x = n < 64 ? x >> n : 0;
+        }
+    }
+    end_run(h, run, alloc_blocks);
+}
+
+static void merge(struct frag_hist *total, const struct frag_hist *g) {
+    total->free += g->free;
+    total->extents += g->extents;
+    if (g->largest > total->largest) total->largest = g->largest;
+    for (int b = 0; b < EXT2_FREEFRAG_BUCKETS; b++) {
+        total->count[b] += g->count[b];
+        total->blocks[b] += g->blocks[b];
+    }
+    for (int k = 0; k <= FREEFRAG_SIZES; k++) total->usable[k] += g->usable[k];
+}
+
+// Faixas não vazias em uma linha: "1:3 2-3:5 ..."
+static void print_compact(const struct frag_hist *h, FILE *out) {
+    for (int b = 0; b < EXT2_FREEFRAG_BUCKETS; b++) {
+        if (!h->count[b]) continue;
+        if (b == 0) fprintf(out, " 1:%llu", (unsigned long long)h->count[b]);
+        else fprintf(out, " %llu-%llu:%llu", 1ull << b, (2ull << b) - 1, (unsigned long long)h->count[b]);
+    }
+    fprintf(out, "\n");
+}
+
+static double pct(uint64_t part, uint64_t total) {
+    return total ? 100.0 * part / total : 0.0;
+}
+
+long long ext2_freefrag(ext2_fs *fs, unsigned int alloc_blocks, int per_group, FILE *out) {
+    uint64_t *words = malloc(fs->block_size);
+    if (!words) return -1;
+    struct frag_hist total = {0};
+    uint64_t counted_free = 0;
+
+    if (per_group) {
+        fprintf(out, "%6s %10s %9s %9s %9s  %s\n", "Grupo", "Livres", "Trechos", "Maior", "Média", "Trechos por tamanho");
+    }
+    for (unsigned int g = 0; g < fs->group_count; g++) {
+        struct frag_hist h = {0};
+        unsigned int first = g * fs->sb.s_blocks_per_group + fs->sb.s_first_data_block;
+        unsigned int nbits = fs->sb.s_blocks_per_group;
+        if (first + nbits > fs->sb.s_blocks_count) nbits = fs->sb.s_blocks_count - first;
+
+        // O lock garante um bitmap coerente com o contador do descritor
+        pthread_mutex_lock(&fs->group_locks[g]);
+        int ok = read_block_as(fs, fs->gd[g].bg_block_bitmap, words, EXT2_IO_BITMAP) == 0;
+        counted_free += fs->gd[g].bg_free_blocks_count;
+        pthread_mutex_unlock(&fs->group_locks[g]);
+        if (!ok) {
+            fprintf(out, "freefrag: erro ao ler o bitmap do grupo %u\n", g);
+            free(words);
+            return -1;
+        }
+
+        scan_bitmap(words, nbits, &h, alloc_blocks);
+        merge(&total, &h);
+        if (per_group) {
+            fprintf(out, "%6u %10llu %9llu %9llu %9.1f ", g, (unsigned long long)h.free,
+                    (unsigned long long)h.extents, (unsigned long long)h.largest,
+                    h.extents ? (double)h.free / h.extents : 0.0);
+            print_compact(&h, out);
+        }
+    }
+    free(words);
+
+    unsigned int bs = fs->block_size;
+    if (per_group) fprintf(out, "\n");
+    fprintf(out, "Blocos livres: %llu de %u (%.1f%%) em %llu trechos\n", (unsigned long long)total.free,
+            fs->sb.s_blocks_count, pct(total.free, fs->sb.s_blocks_count), (unsigned long long)total.extents);
+    fprintf(out, "Maior trecho livre: %llu blocos (%llu KiB); tamanho médio: %.1f blocos\n",
+            (unsigned long long)total.largest, (unsigned long long)total.largest * bs / 1024,
+            total.extents ? (double)total.free / total.extents : 0.0);
+    if (counted_free != total.free) {
+        fprintf(out, "Aviso: os descritores de grupo contam %llu blocos livres (use check)\n",
+                (unsigned long long)counted_free);
+    }
+    if (total.extents == 0) return total.free;
+
+    fprintf(out, "\n%-20s %10s %12s %9s\n", "Trecho (blocos)", "Trechos", "Blocos", "% livre");
+    for (int b = 0; b < EXT2_FREEFRAG_BUCKETS; b++) {
+        if (!total.count[b]) continue;
+        char range[32];
+        snprintf(range, sizeof(range), "%llu-%llu", 1ull << b, (2ull << b) - 1);
+        fprintf(out, "%-20s %10llu %12llu %8.2f%%\n", range, (unsigned long long)total.count[b],
+                (unsigned long long)total.blocks[b], pct(total.blocks[b], total.free));
+    }
+
+    fprintf(out, "\n%-20s %12s %9s\n", "Alocação (blocos)", "Utilizável", "% livre");
+    for (unsigned int k = 0; k < FREEFRAG_SIZES && (1ull << k) <= total.largest; k++) {
+        fprintf(out, "%-20llu %12llu %8.1f%%\n", 1ull << k, (unsigned long long)total.usable[k],
+                pct(total.usable[k], total.free));
+    }
+    if (alloc_blocks) {
+        fprintf(out, "%-20u %12llu %8.1f%%\n", alloc_blocks, (unsigned long long)total.usable[FREEFRAG_SIZES],
+                pct(total.usable[FREEFRAG_SIZES], total.free));
+    }
+    return total.free;
+}
@@ -0,0 +1,33 @@
+#ifndef _EXT2_FREEFRAG_H_
+#define _EXT2_FREEFRAG_H_
+
+#include <stdio.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Faixas do histograma de trechos livres: a faixa i conta trechos com
+// tamanho em [2^i, 2^(i+1)) blocos
+#define EXT2_FREEFRAG_BUCKETS 32
+
+/*
+function: Relata a fragmentação do espaço livre a partir dos bitmaps de blocos.
+param:
+  - alloc_blocks: Tamanho de alocação (em blocos) incluído no relatório de
+    espaço utilizável, além das potências de 2; 0 para nenhum.
+  - per_group: 1 para incluir uma linha por grupo.
+  - out: Onde o relatório é escrito.
+return:
+  - Quantidade de blocos livres encontrados nos bitmaps ou -1 em erro.
+observações:
+  - Cada bitmap é lido sob o lock do grupo e percorrido 64 bits por vez:
+    palavras inteiramente livres ou ocupadas custam uma comparação, a
+    contagem usa popcount e os limites dos trechos, ctz.
+  - Relata total livre, quantidade de trechos, maior trecho, histograma de
+    tamanhos (global e, com per_group, por grupo) e a fração do espaço livre
+    aproveitável por alocações de N blocos seguidos (soma de
+    floor(trecho / N) * N), que cai antes de a vazão de gravação cair.
+  - Trechos não atravessam grupos (cada grupo começa com os seus bitmaps).
+*/
+long long ext2_freefrag(ext2_fs *fs, unsigned int alloc_blocks, int per_group, FILE *out);
+
+#endif
@@ -6,9 +6,28 @@
 // --- Constantes ---
 #define EXT2_SUPER_MAGIC 0xEF53
 #define EXT2_ROOT_INO    2
+#define EXT2_RESIZE_INO  7           // Inode que reserva os blocos de crescimento da GDT
 #define EXT2_N_BLOCKS    15
 
+// --- Índices em i_block ---
+#define EXT2_NDIR_BLOCKS 12          // Blocos diretos (0-11)
+#define EXT2_IND_BLOCK   12          // Indireto simples
+#define EXT2_DIND_BLOCK  13          // Indireto duplo
+#define EXT2_TIND_BLOCK  14          // Indireto triplo
+
+// --- Features (s_feature_compat) ---
+#define EXT2_FEATURE_COMPAT_RESIZE_INODE  0x0010  // Blocos de GDT reservados (inode 7)
+
+// --- Features (s_feature_incompat) ---
+#define EXT2_FEATURE_INCOMPAT_FILETYPE    0x0002  // Tipo do arquivo nas entradas de diretório
+
+// --- Features (s_feature_ro_compat) ---
+#define EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER 0x0001 // Cópias do superbloco só nos grupos 0, 1 e potências de 3, 5 e 7
+#define EXT2_FEATURE_RO_COMPAT_LARGE_FILE 0x0002  // Arquivos > 2 GiB (i_dir_acl = tamanho alto)
+
 // --- Tipos de arquivo (modo do inode) ---
+#define EXT2_S_IFMT  0xF000  // Máscara do tipo de arquivo
+#define EXT2_S_IFLNK 0xA000  // Link simbólico
 #define EXT2_S_IFREG 0x8000  // Arquivo regular
 #define EXT2_S_IFDIR 0x4000  // Diretório
 
@@ -16,6 +35,7 @@
 #define EXT2_FT_UNKNOWN   0
 #define EXT2_FT_REG_FILE  1
 #define EXT2_FT_DIR       2
+#define EXT2_FT_SYMLINK   7
 
 // --- Estrutura do Superbloco ---
 typedef struct {
@@ -60,7 +80,7 @@ typedef struct {
     // Performance Hints
     uint8_t  s_prealloc_blocks;     // Número de blocos para pré-alocação
     uint8_t  s_prealloc_dir_blocks; // Número de blocos para pré-alocação em diretórios
-    uint16_t s_padding;             // Alinhamento/padding
+    uint16_t s_reserved_gdt_blocks; // Blocos reservados após a GDT para crescimento (resize_inode)
 
     // Journaling Support
     uint8_t  s_journal_uuid[16];    // UUID do journal
@@ -0,0 +1,281 @@
+#ifndef _EXT2_INTERNAL_H_
+#define _EXT2_INTERNAL_H_
+
+#include <pthread.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+#include "ext2_stats.h"
+#include "ext2_trace.h"
+
+// Quantidade de rwlocks de inode (distribuídos por número de inode)
+#define EXT2_INODE_LOCK_STRIPES 64
+
+// Contadores de E/S e de operações (ext2_stats.c). Os contadores são
+// atualizados com somas atômicas relaxadas, sem lock; só a tabela de comandos
+// usa o mutex.
+struct ext2_stats {
+    uint64_t reads[EXT2_IO_NCATS];     // Blocos lidos por categoria
+    uint64_t writes[EXT2_IO_NCATS];    // Blocos gravados por categoria
+    uint64_t read_calls, write_calls;  // Chamadas de sistema (pread/pwrite/pwritev)
+    uint64_t bytes_read, bytes_written;
+    uint64_t ops[EXT2_OP_COUNT];
+    uint64_t start_ns;                 // Início da contagem (ext2_init ou reset)
+    uint32_t itable_blocks;            // Blocos da tabela de inodes de um grupo
+    uint32_t super_area;               // Superbloco + GDT + GDT reservada (grupos com cópia)
+    char *exit_path;                   // JSON gravado em ext2_exit (NULL = nenhum)
+
+    pthread_mutex_t lock;
+    struct ext2_cmd_stats cmds[EXT2_STATS_MAX_COMMANDS];
+    unsigned int ncmds;
+};
+
+// Trace de acessos a blocos (ext2_trace.c). `active` é lido sem lock a cada
+// acesso; o resto só com o mutex.
+struct ext2_trace {
+    int active;                        // Atômico: trace aberto
+    int fd;
+    uint64_t start_ns;
+    uint64_t records;                  // Registros já gravados no arquivo
+    struct ext2_trace_record *buf;     // Registros pendentes
+    unsigned int nbuf;
+    char (*names)[EXT2_TRACE_NAME_LEN];
+    unsigned int ncmds;
+    pthread_mutex_t lock;
+};
+
+// Nome procurado em blocos de diretório, preparado uma vez por busca
+struct dir_key {
+    unsigned int len;
+    uint64_t sig, sig_mask;         // Primeiros 8 bytes do nome e máscara dos válidos
+    char bytes[256 + 32] __attribute__((aligned(32))); // Nome completado com zeros
+};
+
+// Prepara a chave de `name` (len <= 255)
+void dir_key_init(struct dir_key *k, const char *name, unsigned int len);
+
+// Núcleos dos caminhos quentes para um tamanho de bloco (ext2_kernels.c).
+// `bs` é o tamanho do bloco do handle; as instâncias de 1, 2 e 4 KiB o ignoram.
+struct ext2_kernels {
+    const char *name;
+    // Primeiro bit livre do bitmap (marcado ao retornar) ou -1
+    int (*claim_first_free)(uint8_t *bitmap, unsigned int nbits, unsigned int bs);
+    // Maior trecho livre a partir de `from`, parando ao atingir `count`
+    unsigned int (*free_run)(const uint8_t *bitmap, unsigned int from, unsigned int nbits, unsigned int count,
+                             unsigned int *start, unsigned int bs);
+    // Offset da entrada com o nome da chave em um bloco de diretório ou -1;
+    // em *prev (se não NULL), o offset da entrada anterior ou -1
+    int (*dir_block_find)(const char *block, const struct dir_key *k, int *prev, unsigned int bs);
+    // Copia para `out` os ponteiros >= min_block de um bloco indireto; retorna quantos
+    unsigned int (*gather_ptrs)(const uint32_t *ptrs, uint32_t min_block, uint32_t *out, unsigned int bs);
+};
+
+// Instância para o tamanho de bloco (a genérica para tamanhos sem instância)
+const struct ext2_kernels *kernels_select(unsigned int block_size);
+
+// Definição do handle opaco. Uso exclusivo dos módulos da biblioteca
+// (ext2_lib.c, ext2_file.c); os comandos usam apenas a API pública.
+//
+// Ordem de aquisição dos locks (nunca inverter, nunca segurar dois grupos):
+//   inode_locks -> group_locks[g] -> sb_lock
+struct ext2_fs {
+    int fd;                         // Imagem aberta (acesso via image_pread/image_pwrite)
+    ext2_super_block sb;            // Superbloco em memória
+    ext2_group_desc *gd;            // Tabela de descritores de grupo em memória
+    unsigned int block_size;
+    unsigned int inodes_per_block;
+    unsigned int group_count;
+    // Geometria em potências de 2 (calculada em ext2_init) e núcleos escolhidos
+    // para o tamanho do bloco
+    unsigned int block_shift;       // log2(block_size)
+    unsigned int ipb_shift;         // log2(inodes_per_block)
+    unsigned int ptrs_shift;        // log2(ponteiros por bloco indireto)
+    unsigned int ipg_shift;         // log2(s_inodes_per_group) ou 0 se não for potência de 2
+    const struct ext2_kernels *kern;
+
+    // Contadores globais de livres, atualizados com operações atômicas.
+    // sb é packed, então os valores vivem aqui e são copiados para sb ao gravar.
+    uint32_t free_blocks;
+    uint32_t free_inodes;
+
+    pthread_mutex_t *group_locks;   // Um por grupo: bitmaps, contadores do gd e tabela de inodes
+    pthread_mutex_t sb_lock;        // Gravação do superbloco/GDT e flags de features
+    int defer_metadata;             // Superbloco/GDT só são gravados em ext2_flush_metadata()
+    int sb_dirty, gd_dirty;         // Gravações pendentes (atômicos)
+    uint8_t *gdt_dirty;             // Um por bloco da GDT: descritor alterado e não gravado (atômico)
+    unsigned int gdt_blocks;
+    int write_barriers;             // fdatasync entre dados, metadados e superbloco (atômico)
+    pthread_rwlock_t inode_locks[EXT2_INODE_LOCK_STRIPES]; // Leitura x alteração de diretórios, truncate
+
+    char *image_path;
+    struct ext2_journal *journal;   // NULL = metadados gravados no lugar
+    struct ext2_overlay *overlay;   // NULL = gravações na própria imagem
+    struct ext2_stats stats;
+    struct ext2_trace trace;
+};
+
+// Grupo, bloco da tabela de inodes e offset no bloco de um inode (1..N)
+static inline void inode_location(ext2_fs *fs, unsigned int inode_num, unsigned int *group, uint32_t *block,
+                                  unsigned int *offset) {
+    unsigned int index = inode_num - 1, in_group;
+    if (fs->ipg_shift) {
+        *group = index >> fs->ipg_shift;
+        in_group = index & ((1u << fs->ipg_shift) - 1);
+    } else {
+        *group = index / fs->sb.s_inodes_per_group;
+        in_group = index % fs->sb.s_inodes_per_group;
+    }
+    *block = fs->gd[*group].bg_inode_table + (in_group >> fs->ipb_shift);
+    *offset = (in_group & (fs->inodes_per_block - 1)) * sizeof(ext2_inode);
+}
+
+static inline pthread_rwlock_t *inode_lock(ext2_fs *fs, unsigned int inode_num) {
+    return &fs->inode_locks[inode_num % EXT2_INODE_LOCK_STRIPES];
+}
+
+// Descritor do grupo alterado: marca só o bloco da GDT que o contém e o
+// superbloco (contadores globais, copiados dos atômicos na gravação). Ambos
+// vão ao disco em ext2_flush_metadata() ou no commit do journal.
+static inline void mark_group_dirty(ext2_fs *fs, unsigned int group) {
+    __atomic_store_n(&fs->gdt_dirty[group * sizeof(ext2_group_desc) / fs->block_size], 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&fs->gd_dirty, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&fs->sb_dirty, 1, __ATOMIC_RELEASE);
+}
+
+// Indica se o grupo guarda uma cópia do superbloco e da GDT (sparse_super:
+// grupos 0, 1 e potências de 3, 5 e 7)
+int group_has_super(ext2_fs *fs, unsigned int group);
+
+// --- Estatísticas (ext2_stats.c) ---
+
+static inline void stats_add(uint64_t *counter, uint64_t n) {
+    __atomic_add_fetch(counter, n, __ATOMIC_RELAXED);
+}
+
+static inline void stats_op(ext2_fs *fs, enum ext2_op op, uint64_t n) {
+    stats_add(&fs->stats.ops[op], n);
+}
+
+// Categoria de um bloco: as áreas fixas de cada grupo são reconhecidas pelo
+// número; nos demais blocos vale `fallback`
+enum ext2_io_cat stats_block_cat(ext2_fs *fs, uint32_t block, enum ext2_io_cat fallback);
+
+// --- Trace (ext2_trace.c) ---
+
+// Registra `count` blocos consecutivos a partir de `block` (flags EXT2_TRACE_*)
+void trace_record(ext2_fs *fs, unsigned int flags, uint32_t block, unsigned int count, enum ext2_io_cat cat);
+
+static inline void trace_blocks(ext2_fs *fs, unsigned int flags, uint32_t block, unsigned int count,
+                                enum ext2_io_cat cat) {
+    if (__atomic_load_n(&fs->trace.active, __ATOMIC_RELAXED)) trace_record(fs, flags, block, count, cat);
+}
+
+void trace_init(ext2_fs *fs);
+
+// Fecha o trace, se aberto, e libera o estado
+void trace_destroy(ext2_fs *fs);
+
+// Conta `count` blocos consecutivos lidos ou gravados a partir de `block`
+// (categoria do primeiro) e os passa ao trace
+static inline void stats_blocks(ext2_fs *fs, int write, uint32_t block, unsigned int count,
+                                enum ext2_io_cat fallback) {
+    enum ext2_io_cat cat = stats_block_cat(fs, block, fallback);
+    stats_add(write ? &fs->stats.writes[cat] : &fs->stats.reads[cat], count);
+    stats_add(write ? &fs->stats.bytes_written : &fs->stats.bytes_read, (uint64_t)count * fs->block_size);
+    trace_blocks(fs, write ? EXT2_TRACE_WRITE : 0, block, count, cat);
+}
+
+// Conta chamadas de sistema de leitura ou gravação
+static inline void stats_calls(ext2_fs *fs, int write, uint64_t n) {
+    stats_add(write ? &fs->stats.write_calls : &fs->stats.read_calls, n);
+}
+
+void stats_init(ext2_fs *fs);
+
+// Grava o JSON pedido em ext2_stats_dump_on_exit() e libera o estado
+void stats_destroy(ext2_fs *fs);
+
+// --- Gravação agrupada (ext2_lib.c) ---
+
+// Bloco a ser gravado por uma das funções abaixo. A lista não pode repetir blocos.
+struct block_write {
+    uint32_t block;
+    const void *data;
+};
+
+// Ordena a lista por número de bloco e grava cada trecho contíguo com um único
+// pwritev (até IOV_MAX blocos por chamada). Retorna a quantidade de chamadas
+// ou -1 se alguma gravação falhou.
+int pwrite_block_runs(int fd, unsigned int block_size, struct block_write *w, size_t n);
+
+// Versões agrupadas de write_data_block() e write_block(). Reordenam a lista.
+void write_data_blocks(ext2_fs *fs, struct block_write *w, size_t n);
+void write_metadata_blocks(ext2_fs *fs, struct block_write *w, size_t n);
+
+// fdatasync da imagem se as barreiras de ordem estiverem ligadas
+void write_barrier(ext2_fs *fs);
+
+// --- Journal (ext2_journal.c) ---
+// O lock do journal é o último da ordem: pode ser pego com qualquer outro.
+
+// Reaplica as transações confirmadas do journal na imagem e esvazia o journal.
+// Retorna a quantidade de transações reaplicadas ou -1 em erro.
+int journal_replay(int image_fd, const char *journal_path);
+
+// Abre o journal e liga o registro de metadados no handle
+int journal_open(ext2_fs *fs, const char *journal_path);
+
+// Confirma o pendente, faz o checkpoint e desliga o journal
+void journal_close(ext2_fs *fs);
+
+// Versão mais recente do bloco se ele estiver no journal (retorna 1), senão 0
+int journal_read(ext2_fs *fs, uint32_t block_num, void *buffer);
+
+// Registra a nova versão de um bloco de metadados na transação em andamento
+// (cat: categoria do bloco nas estatísticas do checkpoint)
+void journal_write(ext2_fs *fs, uint32_t block_num, const void *buffer, enum ext2_io_cat cat);
+
+// O bloco passou a guardar dados de arquivo: descarta versões de metadados
+void journal_revoke(ext2_fs *fs, uint32_t block_num);
+
+// Bloco `index` do grupo liberado na transação em andamento: fica retido
+// (fora do alocador) até ela ser confirmada
+void journal_hold(ext2_fs *fs, unsigned int group, unsigned int index);
+
+// Com blocos retidos no grupo, copia o bitmap para `view` com eles marcados
+// e retorna 1; senão retorna 0 (lock do grupo já adquirido)
+int journal_mask_held(ext2_fs *fs, unsigned int group, const char *bitmap, char *view);
+
+// 1 se o journal tem transações ainda não reaplicadas, 0 se vazio ou ausente
+int journal_pending(const char *journal_path);
+
+// --- Overlay (ext2_overlay.c) ---
+// Com overlay, fs->fd é a imagem base aberta só para leitura e toda gravação
+// vai para o arquivo de delta. O lock do overlay é o último da ordem.
+
+// Abre (ou cria) o delta da base descrita por `sb`; NULL em erro
+struct ext2_overlay *overlay_open(int base_fd, const char *path, const ext2_super_block *sb);
+void overlay_close(struct ext2_overlay *ov);
+
+// pread/pwrite de `len` bytes no offset da imagem, bloco a bloco pelo delta
+// ou pela base. Retornam 0 ou -1.
+int overlay_pread(struct ext2_overlay *ov, void *buf, size_t len, off_t offset);
+int overlay_pwrite(struct ext2_overlay *ov, const void *buf, size_t len, off_t offset);
+
+// pwrite_block_runs() no delta
+int overlay_write_runs(struct ext2_overlay *ov, struct block_write *w, size_t n);
+
+// fdatasync do delta
+int overlay_sync(struct ext2_overlay *ov);
+
+// Acesso à imagem de todos os módulos: com overlay, pelo delta
+static inline int image_pread(ext2_fs *fs, void *buf, size_t len, off_t offset) {
+    if (fs->overlay) return overlay_pread(fs->overlay, buf, len, offset);
+    return pread(fs->fd, buf, len, offset) == (ssize_t)len ? 0 : -1;
+}
+
+static inline int image_pwrite(ext2_fs *fs, const void *buf, size_t len, off_t offset) {
+    if (fs->overlay) return overlay_pwrite(fs->overlay, buf, len, offset);
+    return pwrite(fs->fd, buf, len, offset) == (ssize_t)len ? 0 : -1;
+}
+
+#endif
@@ -0,0 +1,647 @@
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "ext2_journal.h"
+#include "ext2_internal.h"
+
+// Formato do arquivo: cabeçalho seguido de transações. Cada transação é um
+// descritor, a lista de blocos, a lista de blocos revogados, o conteúdo dos
+// blocos e um registro de commit com CRC32 de tudo que veio antes. Uma
+// transação sem commit válido (queda no meio da gravação) é ignorada.
+#define JOURNAL_MAGIC_HEADER 0x4A324558 // "XE2J"
+#define JOURNAL_MAGIC_DESC   0x44324558 // "XE2D"
+#define JOURNAL_MAGIC_COMMIT 0x43324558 // "XE2C"
+
+#define JOURNAL_BUCKETS 16384
+
+struct journal_header {
+    uint32_t magic;
+    uint32_t block_size;
+    uint64_t first_seq;   // Sequência esperada da primeira transação do arquivo
+};
+
+struct journal_desc {
+    uint32_t magic;
+    uint32_t nblocks;
+    uint32_t nrevoke;
+    uint32_t reserved;
+    uint64_t seq;
+};
+
+struct journal_commit {
+    uint32_t magic;
+    uint32_t crc;
+    uint64_t seq;
+};
+
+// Bloco de metadados mantido em memória enquanto não chega à imagem
+struct jentry {
+    uint32_t blk;
+    enum ext2_io_cat cat; // Categoria nas estatísticas do checkpoint
+    char *running;     // Versão da transação em andamento
+    char *committed;   // Versão já no journal, ainda não copiada para a imagem
+    struct jentry *next;
+};
+
+struct ext2_journal {
+    ext2_fs *fs;
+    int fd;
+    int image_fd;
+    unsigned int block_size;
+    uint32_t super_first, super_last; // Blocos do superbloco e da GDT (últimos no checkpoint)
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;       // Handles fechados, fim de commit, pedidos à thread de commit
+    int handles;               // Handles abertos na transação em andamento
+    int committing;            // Commit em curso: novos handles esperam
+
+    struct jentry *buckets[JOURNAL_BUCKETS];
+    block_list dirty;          // Blocos alterados na transação em andamento
+    block_list revoked;        // Blocos revogados na transação em andamento
+    char **held;               // Por grupo: bitmap dos blocos liberados na transação em andamento
+    block_list held_groups;    // Grupos com bitmap em held
+    uint64_t seq;              // Sequência da transação em andamento
+    off_t size;                // Tamanho atual do arquivo de journal
+    double last_commit;
+
+    pthread_t thread;
+    int stop;
+};
+
+// Profundidade de handles da thread atual (handles aninhados não esperam commit)
+static __thread int handle_depth;
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t crc32_buf(const void *data, size_t len) {
+    pthread_once(&crc_once, crc_init);
+    const unsigned char *p = data;
+    uint32_t c = 0xFFFFFFFF;
+    while (len--) c = crc_table[(c ^ *p++) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFF;
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int write_header(int fd, unsigned int block_size, uint64_t first_seq) {
+    struct journal_header h = { JOURNAL_MAGIC_HEADER, block_size, first_seq };
+    if (pwrite(fd, &h, sizeof(h), 0) != sizeof(h) || ftruncate(fd, sizeof(h)) != 0) return -1;
+    return fdatasync(fd);
+}
+
+// --- Tabela de blocos em memória (com o lock do journal) ---
+
+static struct jentry **entry_slot(struct ext2_journal *j, uint32_t blk) {
+    struct jentry **p = &j->buckets[(blk * 2654435761u) % JOURNAL_BUCKETS];
+    while (*p && (*p)->blk != blk) p = &(*p)->next;
+    return p;
+}
+
+static void entry_remove(struct jentry **slot) {
+    struct jentry *e = *slot;
+    *slot = e->next;
+    free(e->running);
+    free(e->committed);
+    free(e);
+}
+
+// Versão do bloco na transação em andamento; -1 sem memória
+static int write_locked(struct ext2_journal *j, uint32_t block_num, const void *buffer, enum ext2_io_cat cat) {
+    struct jentry **slot = entry_slot(j, block_num);
+    if (!*slot) *slot = calloc(1, sizeof(struct jentry));
+    struct jentry *e = *slot;
+    if (e && !e->running) e->running = malloc(j->block_size);
+    if (!e || !e->running) return -1;
+    e->blk = block_num;
+    e->cat = cat;
+    memcpy(e->running, buffer, j->block_size);
+    block_list_add(&j->dirty, block_num);
+
+    // Volta a ser metadado na mesma transação: a revogação perde o efeito
+    for (size_t i = 0; i < j->revoked.count; i++) {
+        if (j->revoked.blocks[i] == block_num) j->revoked.blocks[i--] = j->revoked.blocks[--j->revoked.count];
+    }
+    return 0;
+}
+
+// A transação que liberou os blocos retidos chegou ao journal: voltam ao alocador
+static void release_held_locked(struct ext2_journal *j) {
+    for (size_t i = 0; i < j->held_groups.count; i++) {
+        free(j->held[j->held_groups.blocks[i]]);
+        j->held[j->held_groups.blocks[i]] = NULL;
+    }
+    j->held_groups.count = 0;
+}
+
+// Conteúdo atual de um bloco: versão do journal ou a da imagem
+static void current_locked(struct ext2_journal *j, uint32_t block_num, char *buf) {
+    struct jentry *e = *entry_slot(j, block_num);
+    if (e) memcpy(buf, e->running ? e->running : e->committed, j->block_size);
+    else if (pread(j->image_fd, buf, j->block_size, (off_t)block_num * j->block_size) != (ssize_t)j->block_size) {
+        memset(buf, 0, j->block_size);
+    }
+}
+
+// Blocos marcados da GDT e o superbloco (contadores copiados dos atômicos)
+// entram na transação que fecha. Sem handles abertos, nenhum contador está
+// sendo alterado: a transação leva bitmaps e contadores coerentes entre si.
+static void stage_super_locked(struct ext2_journal *j) {
+    ext2_fs *fs = j->fs;
+    char buf[j->block_size];
+    if (__atomic_exchange_n(&fs->gd_dirty, 0, __ATOMIC_ACQ_REL)) {
+        uint32_t gd_block = fs->sb.s_first_data_block + 1;
+        size_t len = sizeof(ext2_group_desc) * fs->group_count;
+        for (unsigned int b = 0; b < fs->gdt_blocks; b++) {
+            if (!__atomic_exchange_n(&fs->gdt_dirty[b], 0, __ATOMIC_ACQ_REL)) continue;
+            size_t off = (size_t)b * j->block_size;
+            size_t n = len - off < j->block_size ? len - off : j->block_size;
+            if (n < j->block_size) current_locked(j, gd_block + b, buf); // Fim da tabela
+            memcpy(buf, (const char *)fs->gd + off, n);
+            if (write_locked(j, gd_block + b, buf, EXT2_IO_GDT) != 0) {
+                __atomic_store_n(&fs->gdt_dirty[b], 1, __ATOMIC_RELAXED);
+                __atomic_store_n(&fs->gd_dirty, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+    if (__atomic_exchange_n(&fs->sb_dirty, 0, __ATOMIC_ACQ_REL)) {
+        ext2_super_block sb = fs->sb;
+        sb.s_free_blocks_count = __atomic_load_n(&fs->free_blocks, __ATOMIC_RELAXED);
+        sb.s_free_inodes_count = __atomic_load_n(&fs->free_inodes, __ATOMIC_RELAXED);
+        uint32_t blk = 1024 / j->block_size;
+        size_t in = 1024 % j->block_size;
+        if (sizeof(sb) < j->block_size) current_locked(j, blk, buf);
+        memcpy(buf + in, &sb, sizeof(sb));
+        if (write_locked(j, blk, buf, EXT2_IO_SUPER) != 0) __atomic_store_n(&fs->sb_dirty, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// --- Reaplicação ---
+
+// Descritor e blocos de uma transação lida do arquivo
+struct replay_tx {
+    off_t offset;
+    uint64_t seq;
+    uint32_t nblocks, nrevoke;
+};
+
+int journal_replay(int image_fd, const char *journal_path) {
+    int fd = open(journal_path, O_RDWR);
+    if (fd < 0) return (errno == ENOENT) ? 0 : -1;
+
+    struct journal_header h;
+    if (pread(fd, &h, sizeof(h), 0) != sizeof(h) || h.magic != JOURNAL_MAGIC_HEADER || h.block_size == 0) {
+        close(fd); // Journal vazio ou recém-criado
+        return 0;
+    }
+
+    // 1ª passada: valida as transações e guarda as revogações (bloco, sequência)
+    struct replay_tx *txs = NULL;
+    size_t ntx = 0, cap = 0;
+    block_list revoke_blk = {0};
+    uint64_t *revoke_seq = NULL;
+    size_t revoke_cap = 0;
+    uint64_t expect = h.first_seq;
+    off_t off = sizeof(h);
+
+    for (;;) {
+        struct journal_desc d;
+        if (pread(fd, &d, sizeof(d), off) != sizeof(d) || d.magic != JOURNAL_MAGIC_DESC || d.seq != expect) break;
+
+        size_t body = sizeof(d) + (size_t)(d.nblocks + d.nrevoke) * 4 + (size_t)d.nblocks * h.block_size;
+        char *buf = malloc(body);
+        struct journal_commit c;
+        int ok = buf && pread(fd, buf, body, off) == (ssize_t)body &&
+                 pread(fd, &c, sizeof(c), off + body) == sizeof(c) &&
+                 c.magic == JOURNAL_MAGIC_COMMIT && c.seq == d.seq && c.crc == crc32_buf(buf, body);
+        if (ok) {
+            const uint32_t *revoked = (const uint32_t *)(buf + sizeof(d)) + d.nblocks;
+            for (uint32_t i = 0; i < d.nrevoke; i++) {
+                if (revoke_blk.count == revoke_cap) {
+                    revoke_cap = revoke_cap ? revoke_cap * 2 : 64;
+                    revoke_seq = realloc(revoke_seq, revoke_cap * sizeof(uint64_t));
+                }
+                revoke_seq[revoke_blk.count] = d.seq;
+                block_list_add(&revoke_blk, revoked[i]);
+            }
+            if (ntx == cap) {
+                cap = cap ? cap * 2 : 16;
+                txs = realloc(txs, cap * sizeof(struct replay_tx));
+            }
+            txs[ntx++] = (struct replay_tx){ off, d.seq, d.nblocks, d.nrevoke };
+        }
+        free(buf);
+        if (!ok) break;
+        off += body + sizeof(c);
+        expect++;
+    }
+
+    // 2ª passada: grava as transações em ordem, cada uma em trechos contíguos;
+    // uma revogação posterior à transação indica que o bloco virou dado de
+    // arquivo e não deve ser sobrescrito
+    int ret = (int)ntx;
+    for (size_t t = 0; t < ntx; t++) {
+        size_t tags_len = (size_t)txs[t].nblocks * 4;
+        size_t data_len = (size_t)txs[t].nblocks * h.block_size;
+        off_t tag_off = txs[t].offset + sizeof(struct journal_desc);
+        off_t data_off = tag_off + (off_t)(txs[t].nblocks + txs[t].nrevoke) * 4;
+        uint32_t *tags = malloc(tags_len + 4);
+        char *data = malloc(data_len + 1);
+        struct block_write *w = malloc((txs[t].nblocks + 1) * sizeof(struct block_write));
+        size_t n = 0;
+        int ok = tags && data && w && pread(fd, tags, tags_len, tag_off) == (ssize_t)tags_len &&
+                 pread(fd, data, data_len, data_off) == (ssize_t)data_len;
+
+        for (uint32_t i = 0; ok && i < txs[t].nblocks; i++) {
+            int skip = 0;
+            for (size_t r = 0; r < revoke_blk.count && !skip; r++) {
+                skip = (revoke_blk.blocks[r] == tags[i] && revoke_seq[r] > txs[t].seq);
+            }
+            if (!skip) w[n++] = (struct block_write){ tags[i], data + (size_t)i * h.block_size };
+        }
+        if (!ok || pwrite_block_runs(image_fd, h.block_size, w, n) < 0) {
+            perror("journal: reaplicação");
+            ret = -1;
+        }
+        free(w);
+        free(data);
+        free(tags);
+        if (ret < 0) break;
+    }
+
+    // Falha na reaplicação: o journal é mantido para a próxima abertura
+    if (ret >= 0 && (fdatasync(image_fd) != 0 || write_header(fd, h.block_size, expect) != 0)) ret = -1;
+
+    free(txs);
+    free(revoke_seq);
+    block_list_destroy(&revoke_blk);
+    close(fd);
+    return ret;
+}
+
+int journal_pending(const char *journal_path) {
+    struct stat st;
+    return stat(journal_path, &st) == 0 && st.st_size > (off_t)sizeof(struct journal_header);
+}
+
+// --- Commit e checkpoint (com o lock do journal) ---
+
+// Copia as versões confirmadas para a imagem e esvazia o arquivo de journal.
+// Os blocos vão em ordem crescente e em trechos contíguos (pwritev), em duas
+// etapas: metadados em geral e, por último, superbloco e GDT.
+static int checkpoint_locked(struct ext2_journal *j) {
+    size_t total = 0;
+    for (size_t b = 0; b < JOURNAL_BUCKETS; b++) {
+        for (struct jentry *e = j->buckets[b]; e; e = e->next) total += (e->committed != NULL);
+    }
+
+    struct block_write *w = malloc((total + 1) * sizeof(struct block_write));
+    if (!w) return -1;
+    size_t nmeta = 0, nsuper = 0;
+    for (size_t b = 0; b < JOURNAL_BUCKETS; b++) {
+        for (struct jentry *e = j->buckets[b]; e; e = e->next) {
+            if (!e->committed) continue;
+            stats_blocks(j->fs, 1, e->blk, 1, e->cat);
+            struct block_write bw = { e->blk, e->committed };
+            // Superbloco e GDT ficam no fim da lista
+            if (e->blk >= j->super_first && e->blk <= j->super_last) w[total - ++nsuper] = bw;
+            else w[nmeta++] = bw;
+        }
+    }
+
+    int calls = pwrite_block_runs(j->image_fd, j->block_size, w, nmeta);
+    if (calls >= 0 && nsuper > 0) {
+        write_barrier(j->fs);
+        int more = pwrite_block_runs(j->image_fd, j->block_size, w + nmeta, nsuper);
+        calls = more < 0 ? more : calls + more;
+    }
+    free(w);
+    if (calls < 0) {
+        perror("journal: checkpoint");
+        return -1; // O journal continua válido: nada é perdido
+    }
+    stats_calls(j->fs, 1, calls);
+    stats_op(j->fs, EXT2_OP_CHECKPOINT, 1);
+    stats_op(j->fs, EXT2_OP_SYNC, 1);
+
+    for (size_t b = 0; b < JOURNAL_BUCKETS; b++) {
+        struct jentry **p = &j->buckets[b];
+        while (*p) {
+            struct jentry *e = *p;
+            free(e->committed);
+            e->committed = NULL;
+            if (!e->running) entry_remove(p);
+            else p = &e->next;
+        }
+    }
+    if (fdatasync(j->image_fd) != 0 || write_header(j->fd, j->block_size, j->seq) != 0) return -1;
+    j->size = sizeof(struct journal_header);
+    return 0;
+}
+
+static int commit_locked(struct ext2_journal *j) {
+    while (j->committing) pthread_cond_wait(&j->cond, &j->lock);
+    int marked = __atomic_load_n(&j->fs->gd_dirty, __ATOMIC_ACQUIRE) || __atomic_load_n(&j->fs->sb_dirty, __ATOMIC_ACQUIRE);
+    if (j->dirty.count == 0 && j->revoked.count == 0 && !marked) return 0;
+
+    // Fecha a transação: novos handles esperam e os abertos terminam
+    j->committing = 1;
+    while (j->handles > 0) pthread_cond_wait(&j->cond, &j->lock);
+    stage_super_locked(j);
+
+    qsort(j->dirty.blocks, j->dirty.count, sizeof(uint32_t), cmp_u32);
+    size_t n = 0;
+    for (size_t i = 0; i < j->dirty.count; i++) {
+        uint32_t blk = j->dirty.blocks[i];
+        struct jentry *e = *entry_slot(j, blk);
+        if (e && e->running && (n == 0 || j->dirty.blocks[n - 1] != blk)) j->dirty.blocks[n++] = blk;
+    }
+
+    struct journal_desc d = { JOURNAL_MAGIC_DESC, (uint32_t)n, (uint32_t)j->revoked.count, 0, j->seq };
+    size_t body = sizeof(d) + (n + j->revoked.count) * 4 + n * j->block_size;
+    char *buf = malloc(body + sizeof(struct journal_commit));
+    int ret = -1;
+
+    // Modo ordenado: os dados de arquivo chegam ao disco antes dos metadados que os apontam
+    if (buf && fdatasync(j->image_fd) == 0) {
+        char *p = buf;
+        memcpy(p, &d, sizeof(d));
+        p += sizeof(d);
+        memcpy(p, j->dirty.blocks, n * 4);
+        p += n * 4;
+        memcpy(p, j->revoked.blocks, j->revoked.count * 4);
+        p += j->revoked.count * 4;
+        for (size_t i = 0; i < n; i++, p += j->block_size) {
+            memcpy(p, (*entry_slot(j, j->dirty.blocks[i]))->running, j->block_size);
+        }
+        struct journal_commit c = { JOURNAL_MAGIC_COMMIT, crc32_buf(buf, body), j->seq };
+        memcpy(p, &c, sizeof(c));
+
+        size_t total = body + sizeof(c);
+        if (pwrite(j->fd, buf, total, j->size) == (ssize_t)total && fdatasync(j->fd) == 0) {
+            j->size += total;
+            ret = 0;
+        }
+        stats_add(&j->fs->stats.writes[EXT2_IO_JOURNAL], (total + j->block_size - 1) / j->block_size);
+        stats_add(&j->fs->stats.bytes_written, total);
+        stats_calls(j->fs, 1, 1);
+        stats_op(j->fs, EXT2_OP_JOURNAL_COMMIT, 1);
+        stats_op(j->fs, EXT2_OP_SYNC, 2);
+    }
+    free(buf);
+
+    if (ret == 0) {
+        for (size_t i = 0; i < n; i++) {
+            struct jentry *e = *entry_slot(j, j->dirty.blocks[i]);
+            free(e->committed);
+            e->committed = e->running;
+            e->running = NULL;
+        }
+        j->dirty.count = 0;
+        j->revoked.count = 0;
+        release_held_locked(j);
+        j->seq++;
+        if (j->size >= EXT2_JOURNAL_MAX_BYTES) checkpoint_locked(j);
+    } else {
+        perror("journal: commit");
+    }
+
+    j->last_commit = now_ms();
+    j->committing = 0;
+    pthread_cond_broadcast(&j->cond);
+    return ret;
+}
+
+// Commit periódico: agrupa as operações de todas as threads em uma transação
+static void *commit_thread(void *arg) {
+    struct ext2_journal *j = arg;
+    pthread_mutex_lock(&j->lock);
+    while (!j->stop) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        ts.tv_sec += EXT2_JOURNAL_COMMIT_MS / 1000;
+        ts.tv_nsec += (EXT2_JOURNAL_COMMIT_MS % 1000) * 1000000L;
+        if (ts.tv_nsec >= 1000000000L) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&j->cond, &j->lock, &ts);
+        if (j->stop) break;
+
+        int big = (uint64_t)j->dirty.count * j->block_size >= EXT2_JOURNAL_COMMIT_BYTES;
+        int old = now_ms() - j->last_commit >= EXT2_JOURNAL_COMMIT_MS;
+        if ((big || old) && (j->dirty.count > 0 || j->revoked.count > 0)) commit_locked(j);
+    }
+    pthread_mutex_unlock(&j->lock);
+    return NULL;
+}
+
+// --- Interface interna ---
+
+int journal_open(ext2_fs *fs, const char *journal_path) {
+    // O checkpoint grava direto na imagem: com overlay, a base ficaria alterada
+    if (fs->overlay) {
+        fprintf(stderr, "journal: indisponível com overlay (o delta já isola as gravações)\n");
+        return -1;
+    }
+    struct ext2_journal *j = calloc(1, sizeof(struct ext2_journal));
+    if (!j) return -1;
+
+    j->held = calloc(fs->group_count, sizeof(char *));
+    j->fd = j->held ? open(journal_path, O_RDWR | O_CREAT, 0644) : -1;
+    if (j->fd < 0) {
+        perror(journal_path);
+        free(j->held);
+        free(j);
+        return -1;
+    }
+
+    // ext2_init() já reaplicou o conteúdo anterior: começa com o arquivo vazio
+    struct journal_header h;
+    j->seq = 1;
+    if (pread(j->fd, &h, sizeof(h), 0) == sizeof(h) && h.magic == JOURNAL_MAGIC_HEADER) j->seq = h.first_seq;
+    if (write_header(j->fd, fs->block_size, j->seq) != 0) {
+        perror("journal: cabeçalho");
+        close(j->fd);
+        free(j->held);
+        free(j);
+        return -1;
+    }
+
+    size_t gd_len = sizeof(ext2_group_desc) * fs->group_count;
+    j->fs = fs;
+    j->image_fd = fs->fd;
+    j->block_size = fs->block_size;
+    j->super_first = 1024 / fs->block_size;
+    j->super_last = fs->sb.s_first_data_block + (gd_len + fs->block_size - 1) / fs->block_size;
+    j->size = sizeof(struct journal_header);
+    j->last_commit = now_ms();
+    pthread_mutex_init(&j->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&j->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&j->thread, NULL, commit_thread, j) != 0) {
+        pthread_cond_destroy(&j->cond);
+        pthread_mutex_destroy(&j->lock);
+        close(j->fd);
+        free(j->held);
+        free(j);
+        return -1;
+    }
+    fs->journal = j;
+    return 0;
+}
+
+void journal_close(ext2_fs *fs) {
+    struct ext2_journal *j = fs->journal;
+    if (!j) return;
+
+    pthread_mutex_lock(&j->lock);
+    j->stop = 1;
+    pthread_cond_broadcast(&j->cond);
+    pthread_mutex_unlock(&j->lock);
+    pthread_join(j->thread, NULL);
+
+    pthread_mutex_lock(&j->lock);
+    if (commit_locked(j) == 0) checkpoint_locked(j);
+    pthread_mutex_unlock(&j->lock);
+
+    fs->journal = NULL;
+    for (size_t b = 0; b < JOURNAL_BUCKETS; b++) {
+        while (j->buckets[b]) entry_remove(&j->buckets[b]);
+    }
+    release_held_locked(j);
+    free(j->held);
+    block_list_destroy(&j->held_groups);
+    block_list_destroy(&j->dirty);
+    block_list_destroy(&j->revoked);
+    pthread_cond_destroy(&j->cond);
+    pthread_mutex_destroy(&j->lock);
+    close(j->fd);
+    free(j);
+}
+
+int journal_read(ext2_fs *fs, uint32_t block_num, void *buffer) {
+    struct ext2_journal *j = fs->journal;
+    int found = 0;
+    pthread_mutex_lock(&j->lock);
+    struct jentry *e = *entry_slot(j, block_num);
+    if (e) {
+        memcpy(buffer, e->running ? e->running : e->committed, j->block_size);
+        found = 1;
+    }
+    pthread_mutex_unlock(&j->lock);
+    return found;
+}
+
+void journal_write(ext2_fs *fs, uint32_t block_num, const void *buffer, enum ext2_io_cat cat) {
+    struct ext2_journal *j = fs->journal;
+    pthread_mutex_lock(&j->lock);
+    int ret = write_locked(j, block_num, buffer, cat);
+    if (ret == 0 && (uint64_t)j->dirty.count * j->block_size >= EXT2_JOURNAL_COMMIT_BYTES) {
+        pthread_cond_broadcast(&j->cond);
+    }
+    pthread_mutex_unlock(&j->lock);
+    if (ret != 0) {
+        // Sem memória: grava no lugar (perde a atomicidade, mas não o dado)
+        perror("journal");
+        pwrite(j->image_fd, buffer, j->block_size, (off_t)block_num * j->block_size);
+    }
+}
+
+void journal_revoke(ext2_fs *fs, uint32_t block_num) {
+    struct ext2_journal *j = fs->journal;
+    pthread_mutex_lock(&j->lock);
+    struct jentry **slot = entry_slot(j, block_num);
+    if (*slot) {
+        // Só precisa constar no journal se já houver uma versão confirmada
+        if ((*slot)->committed) block_list_add(&j->revoked, block_num);
+        entry_remove(slot);
+    }
+    pthread_mutex_unlock(&j->lock);
+}
+
+void journal_hold(ext2_fs *fs, unsigned int group, unsigned int index) {
+    struct ext2_journal *j = fs->journal;
+    pthread_mutex_lock(&j->lock);
+    if (!j->held[group]) {
+        j->held[group] = calloc(1, j->block_size);
+        if (j->held[group] && block_list_add(&j->held_groups, group) != 0) {
+            free(j->held[group]);
+            j->held[group] = NULL;
+        }
+    }
+    if (j->held[group]) j->held[group][index / 8] |= 1 << (index % 8);
+    else perror("journal: bloco liberado sem retenção");
+    pthread_mutex_unlock(&j->lock);
+}
+
+int journal_mask_held(ext2_fs *fs, unsigned int group, const char *bitmap, char *view) {
+    struct ext2_journal *j = fs->journal;
+    pthread_mutex_lock(&j->lock);
+    const char *held = j->held[group];
+    if (held) {
+        for (unsigned int i = 0; i < j->block_size; i++) view[i] = bitmap[i] | held[i];
+    }
+    pthread_mutex_unlock(&j->lock);
+    return held != NULL;
+}
+
+// --- API pública ---
+
+int ext2_journal_enable(ext2_fs *fs) {
+    if (fs->journal) return 0;
+    size_t len = strlen(fs->image_path) + sizeof(EXT2_JOURNAL_SUFFIX);
+    char path[len];
+    snprintf(path, len, "%s%s", fs->image_path, EXT2_JOURNAL_SUFFIX);
+    return journal_open(fs, path);
+}
+
+void ext2_journal_begin(ext2_fs *fs) {
+    struct ext2_journal *j = fs->journal;
+    if (!j || handle_depth++ > 0) return;
+    pthread_mutex_lock(&j->lock);
+    while (j->committing) pthread_cond_wait(&j->cond, &j->lock);
+    j->handles++;
+    pthread_mutex_unlock(&j->lock);
+}
+
+void ext2_journal_end(ext2_fs *fs) {
+    struct ext2_journal *j = fs->journal;
+    if (!j || --handle_depth > 0) return;
+    pthread_mutex_lock(&j->lock);
+    if (--j->handles == 0) pthread_cond_broadcast(&j->cond);
+    pthread_mutex_unlock(&j->lock);
+}
+
+int ext2_journal_commit(ext2_fs *fs) {
+    struct ext2_journal *j = fs->journal;
+    if (!j) return 0;
+    if (handle_depth > 0) return -1; // O commit esperaria o próprio handle
+    pthread_mutex_lock(&j->lock);
+    int ret = commit_locked(j);
+    pthread_mutex_unlock(&j->lock);
+    return ret;
+}
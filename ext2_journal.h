@@ -0,0 +1,58 @@
+#ifndef _EXT2_JOURNAL_H_
+#define _EXT2_JOURNAL_H_
+
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Sufixo do arquivo de journal externo: "<imagem>.journal"
+#define EXT2_JOURNAL_SUFFIX ".journal"
+
+// Intervalo do commit em segundo plano (ms)
+#define EXT2_JOURNAL_COMMIT_MS 1000
+
+// Tamanho da transação em andamento que força um commit imediato (bytes)
+#define EXT2_JOURNAL_COMMIT_BYTES (4 * 1024 * 1024)
+
+// Tamanho do arquivo de journal que dispara o checkpoint (bytes)
+#define EXT2_JOURNAL_MAX_BYTES (32 * 1024 * 1024)
+
+/*
+function: Cria o journal externo da imagem (se não existir) e passa a usá-lo.
+return:
+  - 0 em sucesso, -1 em erro.
+observações:
+  - O journal é o arquivo "<imagem>.journal". Se ele existir, ext2_init()
+    reaplica as transações confirmadas e liga o journal automaticamente.
+  - Com o journal ligado, os blocos de metadados (bitmaps, tabela de inodes,
+    diretórios, indiretos, superbloco e descritores) não são gravados no
+    lugar: ficam em memória, vão para o journal no commit e só são copiados
+    para a imagem no checkpoint. Blocos de dados de arquivos continuam sendo
+    gravados direto na imagem (antes do commit dos metadados que os usam).
+*/
+int ext2_journal_enable(ext2_fs *fs);
+
+/*
+function: Abre uma operação atômica (handle) no journal.
+return: void.
+observações:
+  - Todas as alterações de metadados feitas até ext2_journal_end() entram na
+    mesma transação. Várias operações, de várias threads, são confirmadas
+    juntas (group commit): o commit espera todos os handles abertos fecharem.
+  - Pode ser aninhado na mesma thread. Sem journal, não faz nada.
+*/
+void ext2_journal_begin(ext2_fs *fs);
+
+/*
+function: Fecha o handle aberto por ext2_journal_begin().
+return: void.
+*/
+void ext2_journal_end(ext2_fs *fs);
+
+/*
+function: Confirma no journal a transação em andamento e espera a gravação.
+return:
+  - 0 em sucesso, -1 em erro ou se chamada com um handle aberto na thread.
+*/
+int ext2_journal_commit(ext2_fs *fs);
+
+#endif
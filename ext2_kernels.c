@@ -0,0 +1,232 @@
+#include "ext2_internal.h"
+
+// Núcleos dos caminhos quentes escritos uma vez, com o tamanho do bloco como
+// parâmetro, e instanciados para 1, 2 e 4 KiB: com `bs` constante o compilador
+// troca divisões por deslocamentos, desenrola os laços de tamanho fixo e
+// vetoriza a busca por palavras do bitmap. Outros tamanhos usam a instância
+// genérica, com `bs` lido em tempo de execução.
+//
+// Os bitmaps são lidos 64 bits por vez: o bit i fica no byte i/8, bit i%8,
+// que é o bit i da palavra em máquinas little-endian (como o resto da
+// biblioteca, que lê as estruturas do disco diretamente).
+
+#define KERNEL static inline __attribute__((always_inline))
+
+static inline uint64_t load_word(const uint8_t *bitmap, unsigned int w) {
+    uint64_t x;
+    memcpy(&x, bitmap + (size_t)w * 8, sizeof(x));
+    return x;
+}
+
+KERNEL int claim_first_free_t(uint8_t *bitmap, unsigned int nbits, unsigned int bs) {
+    // nbits nunca passa de 8 * bs (um bloco de bitmap por grupo)
+    unsigned int words = bs / 8;
+    if (nbits < words * 64) words = (nbits + 63) / 64;
+    for (unsigned int w = 0; w < words; w++) {
+        uint64_t free_bits = ~load_word(bitmap, w);
+        if (free_bits == 0) continue;
+        unsigned int i = w * 64 + __builtin_ctzll(free_bits);
+        if (i >= nbits) return -1;
+        bitmap[i / 8] |= 1 << (i % 8);
+        return (int)i;
+    }
+    return -1;
+}
+
+KERNEL unsigned int free_run_t(const uint8_t *bitmap, unsigned int from, unsigned int nbits, unsigned int count,
+                               unsigned int *start, unsigned int bs) {
+    if (nbits > bs * 8) nbits = bs * 8;
+    unsigned int best_len = 0, run_start = 0, run_len = 0;
+    for (unsigned int i = from; i < nbits;) {
+        // Palavras inteiras (todas ocupadas ou todas livres) de uma vez
+        if (i % 64 == 0 && i + 64 <= nbits) {
+            uint64_t used = load_word(bitmap, i / 64);
+            if (used == ~0ull) {
+                run_len = 0;
+                i += 64;
+                continue;
+            }
+            if (used == 0) {
+                if (run_len == 0) run_start = i;
+                run_len += 64;
+                i += 64;
+                if (run_len > best_len) {
+                    *start = run_start;
+                    best_len = run_len < count ? run_len : count;
+                    if (best_len == count) break;
+                }
+                continue;
+            }
+        }
+        if ((bitmap[i / 8] >> (i % 8)) & 1) {
+            run_len = 0;
+        } else {
+            if (run_len == 0) run_start = i;
+            run_len++;
+            if (run_len > best_len) {
+                *start = run_start;
+                best_len = run_len;
+                if (best_len == count) break;
+            }
+        }
+        i++;
+    }
+    return best_len;
+}
+
+// --- Busca de nomes em blocos de diretório ---
+//
+// A chave é preparada uma vez por busca: tamanho, os 8 primeiros bytes como
+// assinatura e o nome completado com zeros para as comparações vetoriais.
+// Cada registro é descartado pelo name_len e pela assinatura (uma leitura de
+// 8 bytes); só os candidatos são comparados por inteiro, 16 (SSE2) ou 32
+// (AVX2) bytes por instrução.
+
+void dir_key_init(struct dir_key *k, const char *name, unsigned int len) {
+    memset(k, 0, sizeof(*k));
+    k->len = len;
+    memcpy(k->bytes, name, len);
+    memcpy(&k->sig, k->bytes, sizeof(k->sig));
+    k->sig_mask = len >= 8 ? ~0ull : (1ull << (len * 8)) - 1;
+}
+
+// Compara os `len` bytes do nome; `room` é quanto do bloco há a partir de p
+static inline int name_equal_scalar(const char *p, const struct dir_key *k, unsigned int room) {
+    (void)room;
+    return memcmp(p, k->bytes, k->len) == 0;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+
+static inline int name_equal_sse2(const char *p, const struct dir_key *k, unsigned int room) {
+    unsigned int done = 0;
+    // Blocos de 16 bytes enquanto couberem no bloco de diretório
+    while (done < k->len && done + 16 <= room) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(p + done));
+        __m128i b = _mm_load_si128((const __m128i *)(k->bytes + done));
+        unsigned int eq = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+        unsigned int n = k->len - done < 16 ? k->len - done : 16;
+        unsigned int mask = n == 16 ? 0xFFFFu : (1u << n) - 1;
+        if ((eq & mask) != mask) return 0;
+        done += 16;
+    }
+    return done >= k->len || memcmp(p + done, k->bytes + done, k->len - done) == 0;
+}
+
+__attribute__((target("avx2")))
+static inline int name_equal_avx2(const char *p, const struct dir_key *k, unsigned int room) {
+    unsigned int done = 0;
+    while (done < k->len && done + 32 <= room) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(p + done));
+        __m256i b = _mm256_load_si256((const __m256i *)(k->bytes + done));
+        uint32_t eq = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+        unsigned int n = k->len - done < 32 ? k->len - done : 32;
+        uint32_t mask = n == 32 ? 0xFFFFFFFFu : (1u << n) - 1;
+        if ((eq & mask) != mask) return 0;
+        done += 32;
+    }
+    return done >= k->len || memcmp(p + done, k->bytes + done, k->len - done) == 0;
+}
+#endif
+
+typedef int (*name_equal_fn)(const char *p, const struct dir_key *k, unsigned int room);
+
+KERNEL int dir_block_find_t(const char *block, const struct dir_key *k, int *prev, unsigned int bs,
+                            name_equal_fn equal) {
+    int last = -1;
+    for (unsigned int off = 0; off + 8 <= bs;) {
+        const ext2_dir_entry_2 *e = (const ext2_dir_entry_2 *)(block + off);
+        if (e->rec_len < 8 || off + e->rec_len > bs) break;
+        if (e->name_len == k->len && e->inode != 0) {
+            uint64_t sig;
+            int cand = 1;
+            if (off + 16 <= bs) {
+                memcpy(&sig, e->name, sizeof(sig));
+                cand = (sig & k->sig_mask) == k->sig;
+            }
+            if (cand && equal(e->name, k, bs - off - 8)) {
+                if (prev) *prev = last;
+                return (int)off;
+            }
+        }
+        last = (int)off;
+        off += e->rec_len;
+    }
+    return -1;
+}
+
+KERNEL unsigned int gather_ptrs_t(const uint32_t *ptrs, uint32_t min_block, uint32_t *out, unsigned int bs) {
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < bs / sizeof(uint32_t); i++) {
+        out[n] = ptrs[i];
+        n += ptrs[i] >= min_block;
+    }
+    return n;
+}
+
+// Uma instância por tamanho de bloco; o último argumento (bs da chamada) só é
+// usado pela genérica
+#define EXT2_KERNELS(NAME, BS)                                                                          \
+    static int claim_first_free_##NAME(uint8_t *bitmap, unsigned int nbits, unsigned int bs) {         \
+        return claim_first_free_t(bitmap, nbits, BS);                                                  \
+    }                                                                                                   \
+    static unsigned int free_run_##NAME(const uint8_t *bitmap, unsigned int from, unsigned int nbits,  \
+                                        unsigned int count, unsigned int *start, unsigned int bs) {    \
+        return free_run_t(bitmap, from, nbits, count, start, BS);                                      \
+    }                                                                                                   \
+    static int dir_block_find_##NAME(const char *block, const struct dir_key *k, int *prev,            \
+                                     unsigned int bs) {                                                 \
+        return dir_block_find_t(block, k, prev, BS, NAME_EQUAL);                                       \
+    }                                                                                                   \
+    static unsigned int gather_ptrs_##NAME(const uint32_t *ptrs, uint32_t min_block, uint32_t *out,    \
+                                           unsigned int bs) {                                           \
+        return gather_ptrs_t(ptrs, min_block, out, BS);                                                \
+    }                                                                                                   \
+    static const struct ext2_kernels kernels_##NAME = {                                                 \
+        #NAME, claim_first_free_##NAME, free_run_##NAME, dir_block_find_##NAME, gather_ptrs_##NAME,     \
+    };
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define NAME_EQUAL name_equal_sse2 // SSE2 faz parte de todo x86-64
+#else
+#define NAME_EQUAL name_equal_scalar
+#endif
+EXT2_KERNELS(1k, 1024)
+EXT2_KERNELS(2k, 2048)
+EXT2_KERNELS(4k, 4096)
+EXT2_KERNELS(generic, bs)
+#undef NAME_EQUAL
+
+#if defined(__x86_64__) && defined(__GNUC__)
+// Mesmos núcleos compilados para AVX2 (escolhidos se a CPU tiver)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define NAME_EQUAL name_equal_avx2
+EXT2_KERNELS(1k_avx2, 1024)
+EXT2_KERNELS(2k_avx2, 2048)
+EXT2_KERNELS(4k_avx2, 4096)
+EXT2_KERNELS(generic_avx2, bs)
+#undef NAME_EQUAL
+#pragma GCC pop_options
+#endif
+
+const struct ext2_kernels *kernels_select(unsigned int block_size) {
+#if defined(__x86_64__) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        switch (block_size) {
+        case 1024: return &kernels_1k_avx2;
+        case 2048: return &kernels_2k_avx2;
+        case 4096: return &kernels_4k_avx2;
+        default: return &kernels_generic_avx2;
+        }
+    }
+#endif
+    switch (block_size) {
+    case 1024: return &kernels_1k;
+    case 2048: return &kernels_2k;
+    case 4096: return &kernels_4k;
+    default: return &kernels_generic;
+    }
+}
@@ -1,211 +1,759 @@
-#include "ext2_lib.h"
-
-// Variáveis globais
-FILE *disk_image = NULL;
-ext2_super_block sb;
-ext2_group_desc *gd = NULL;
-unsigned int block_size = 0;
-unsigned int inodes_per_block = 0;
-unsigned int group_count = 0;
+#include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024 // Valor do Linux; limits.h só o define com _XOPEN_SOURCE
+#endif
+#include "ext2_internal.h"
+#include "ext2_journal.h"
+#include "ext2_overlay.h"
 
 // === Funções de Leitura/Escrita de Baixo Nível ===
 
-void write_block(unsigned int block_num, const void *buffer) {
-    if (fseek(disk_image, block_num * block_size, SEEK_SET) != 0) {
-        perror("fseek write");
+void write_block(ext2_fs *fs, unsigned int block_num, const void *buffer) {
+    write_block_as(fs, block_num, buffer, EXT2_IO_DIR);
+}
+
+void write_block_as(ext2_fs *fs, unsigned int block_num, const void *buffer, enum ext2_io_cat cat) {
+    // Com journal, metadados vão para a transação em andamento
+    if (fs->journal) {
+        journal_write(fs, block_num, buffer, cat);
         return;
     }
-    if (fwrite(buffer, block_size, 1, disk_image) != 1) {
-        perror("fwrite block");
+    // pwrite não usa posição compartilhada: seguro com várias threads no mesmo handle
+    if (image_pwrite(fs, buffer, fs->block_size, (off_t)block_num * fs->block_size) != 0) {
+        perror("pwrite block");
     }
+    stats_blocks(fs, 1, block_num, 1, cat);
+    stats_calls(fs, 1, 1);
 }
 
-int read_block(unsigned int block_num, void *buffer) {
-    if (fseek(disk_image, block_num * block_size, SEEK_SET) != 0) {
-        perror("fseek read");
-        return -1;
+void write_data_block(ext2_fs *fs, unsigned int block_num, const void *buffer) {
+    if (fs->journal) journal_revoke(fs, block_num);
+    if (image_pwrite(fs, buffer, fs->block_size, (off_t)block_num * fs->block_size) != 0) {
+        perror("pwrite block");
+    }
+    stats_blocks(fs, 1, block_num, 1, EXT2_IO_DATA);
+    stats_calls(fs, 1, 1);
+}
+
+static int cmp_block_write(const void *a, const void *b) {
+    uint32_t x = ((const struct block_write *)a)->block, y = ((const struct block_write *)b)->block;
+    return (x > y) - (x < y);
+}
+
+int pwrite_block_runs(int fd, unsigned int block_size, struct block_write *w, size_t n) {
+    struct iovec iov[IOV_MAX];
+    int ret = 0, calls = 0;
+    qsort(w, n, sizeof(struct block_write), cmp_block_write);
+    for (size_t i = 0; i < n;) {
+        uint32_t first = w[i].block;
+        int k = 0;
+        while (i < n && k < IOV_MAX && w[i].block == first + (uint32_t)k) {
+            iov[k].iov_base = (void *)w[i].data;
+            iov[k].iov_len = block_size;
+            k++;
+            i++;
+        }
+        if (pwritev(fd, iov, k, (off_t)first * block_size) != (ssize_t)k * block_size) {
+            perror("pwritev");
+            ret = -1;
+        }
+        calls++;
+    }
+    return ret < 0 ? ret : calls;
+}
+
+void write_data_blocks(ext2_fs *fs, struct block_write *w, size_t n) {
+    if (n == 0) return;
+    if (fs->journal) {
+        for (size_t i = 0; i < n; i++) journal_revoke(fs, w[i].block);
     }
-    if (fread(buffer, block_size, 1, disk_image) != 1) {
+    int calls = fs->overlay ? overlay_write_runs(fs->overlay, w, n) : pwrite_block_runs(fs->fd, fs->block_size, w, n);
+    // w já está em ordem crescente: conta por trecho contíguo
+    for (size_t i = 0, j; i < n; i = j) {
+        for (j = i + 1; j < n && w[j].block == w[j - 1].block + 1; j++);
+        stats_blocks(fs, 1, w[i].block, j - i, EXT2_IO_DATA);
+    }
+    if (calls > 0) stats_calls(fs, 1, calls);
+}
+
+void write_metadata_blocks(ext2_fs *fs, struct block_write *w, size_t n) {
+    // Fora das áreas fixas, os metadados gravados em lote são indiretos
+    if (fs->journal) {
+        for (size_t i = 0; i < n; i++) journal_write(fs, w[i].block, w[i].data, EXT2_IO_INDIRECT);
+        return;
+    }
+    int calls = fs->overlay ? overlay_write_runs(fs->overlay, w, n) : pwrite_block_runs(fs->fd, fs->block_size, w, n);
+    for (size_t i = 0; i < n; i++) stats_blocks(fs, 1, w[i].block, 1, EXT2_IO_INDIRECT);
+    if (calls > 0) stats_calls(fs, 1, calls);
+}
+
+void write_barrier(ext2_fs *fs) {
+    if (!__atomic_load_n(&fs->write_barriers, __ATOMIC_RELAXED)) return;
+    if ((fs->overlay ? overlay_sync(fs->overlay) : fdatasync(fs->fd)) != 0) perror("fdatasync");
+    stats_op(fs, EXT2_OP_SYNC, 1);
+}
+
+void ext2_set_write_barriers(ext2_fs *fs, int enabled) {
+    __atomic_store_n(&fs->write_barriers, enabled, __ATOMIC_RELAXED);
+}
+
+int read_block(ext2_fs *fs, unsigned int block_num, void *buffer) {
+    return read_block_as(fs, block_num, buffer, EXT2_IO_DATA);
+}
+
+int read_block_as(ext2_fs *fs, unsigned int block_num, void *buffer, enum ext2_io_cat cat) {
+    if (fs->journal && journal_read(fs, block_num, buffer)) {
+        stats_op(fs, EXT2_OP_JOURNAL_HIT, 1);
+        trace_blocks(fs, EXT2_TRACE_MEMORY, block_num, 1, stats_block_cat(fs, block_num, cat));
+        return 0;
+    }
+    stats_calls(fs, 0, 1);
+    if (image_pread(fs, buffer, fs->block_size, (off_t)block_num * fs->block_size) != 0) {
         // EOF pode ser normal
         return -1;
     }
+    stats_blocks(fs, 0, block_num, 1, cat);
     return 0;
 }
 
-void write_superblock() {
-    fseek(disk_image, 1024, SEEK_SET);
-    fwrite(&sb, sizeof(  ext2_super_block), 1, disk_image);
+// Copia os contadores atômicos para o superbloco em memória (com sb_lock)
+static void sync_free_counters(ext2_fs *fs) {
+    fs->sb.s_free_blocks_count = __atomic_load_n(&fs->free_blocks, __ATOMIC_RELAXED);
+    fs->sb.s_free_inodes_count = __atomic_load_n(&fs->free_inodes, __ATOMIC_RELAXED);
+}
+
+// Gravações de fato, sem journal (com sb_lock). Com o journal, o superbloco e
+// os blocos sujos da GDT entram na transação no commit (journal_stage_super).
+// A marca é limpa antes da cópia: uma alteração concorrente volta a marcar.
+static void pwrite_superblock(ext2_fs *fs) {
+    __atomic_store_n(&fs->sb_dirty, 0, __ATOMIC_RELAXED);
+    sync_free_counters(fs);
+    if (image_pwrite(fs, &fs->sb, sizeof(ext2_super_block), 1024) != 0) {
+        perror("pwrite superblock");
+    }
+    stats_add(&fs->stats.writes[EXT2_IO_SUPER], 1);
+    stats_add(&fs->stats.bytes_written, sizeof(ext2_super_block));
+    stats_calls(fs, 1, 1);
+    trace_blocks(fs, EXT2_TRACE_WRITE, 1024 / fs->block_size, 1, EXT2_IO_SUPER);
 }
 
-void write_group_descriptors() {
-    unsigned int gd_block = (sb.s_first_data_block == 0) ? 2 : sb.s_first_data_block + 1;
-    fseek(disk_image, gd_block * block_size, SEEK_SET);
-    fwrite(gd, sizeof(  ext2_group_desc) * group_count, 1, disk_image);
+// Grava só os blocos marcados da GDT, um pwrite por trecho contíguo
+static void pwrite_group_descriptors(ext2_fs *fs) {
+    unsigned int gd_block = fs->sb.s_first_data_block + 1; // GDT logo após o superbloco
+    size_t len = sizeof(ext2_group_desc) * fs->group_count;
+    __atomic_store_n(&fs->gd_dirty, 0, __ATOMIC_RELAXED);
+    for (unsigned int b = 0; b < fs->gdt_blocks;) {
+        if (!__atomic_exchange_n(&fs->gdt_dirty[b], 0, __ATOMIC_ACQ_REL)) {
+            b++;
+            continue;
+        }
+        unsigned int n = 1;
+        while (b + n < fs->gdt_blocks && __atomic_exchange_n(&fs->gdt_dirty[b + n], 0, __ATOMIC_ACQ_REL)) n++;
+        size_t off = (size_t)b * fs->block_size;
+        size_t run = (size_t)n * fs->block_size;
+        if (off + run > len) run = len - off;
+        if (image_pwrite(fs, (const char *)fs->gd + off, run, (off_t)gd_block * fs->block_size + off) != 0) {
+            perror("pwrite group descriptors");
+        }
+        stats_add(&fs->stats.writes[EXT2_IO_GDT], n);
+        stats_add(&fs->stats.bytes_written, run);
+        stats_calls(fs, 1, 1);
+        trace_blocks(fs, EXT2_TRACE_WRITE, gd_block + b, n, EXT2_IO_GDT);
+        b += n;
+    }
 }
 
-int ext2_init(const char *image_path) {
-    disk_image = fopen(image_path, "r+b");
-    if (!disk_image) {
+void write_superblock(ext2_fs *fs) {
+    __atomic_store_n(&fs->sb_dirty, 1, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&fs->sb_lock);
+    if (!fs->defer_metadata && !fs->journal) pwrite_superblock(fs);
+    pthread_mutex_unlock(&fs->sb_lock);
+}
+
+void write_group_descriptors(ext2_fs *fs) {
+    // Pedido explícito: a tabela inteira. Alocações e liberações marcam só o
+    // bloco do grupo alterado (mark_group_dirty) e não gravam na hora.
+    for (unsigned int b = 0; b < fs->gdt_blocks; b++) __atomic_store_n(&fs->gdt_dirty[b], 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&fs->gd_dirty, 1, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&fs->sb_lock);
+    if (!fs->defer_metadata && !fs->journal) pwrite_group_descriptors(fs);
+    pthread_mutex_unlock(&fs->sb_lock);
+}
+
+void ext2_flush_metadata(ext2_fs *fs) {
+    pthread_mutex_lock(&fs->sb_lock);
+    int gd_dirty = __atomic_load_n(&fs->gd_dirty, __ATOMIC_ACQUIRE);
+    int sb_dirty = __atomic_load_n(&fs->sb_dirty, __ATOMIC_ACQUIRE);
+    // Com o journal, os pendentes entram na transação fechada pelo commit abaixo.
+    // Sem ele, bitmaps e inodes já foram gravados no lugar: a barreira os leva
+    // ao disco antes dos contadores do superbloco/GDT
+    if (!fs->journal) {
+        if (gd_dirty || sb_dirty) write_barrier(fs);
+        if (gd_dirty) pwrite_group_descriptors(fs);
+        if (sb_dirty) pwrite_superblock(fs);
+    }
+    pthread_mutex_unlock(&fs->sb_lock);
+    ext2_journal_commit(fs);
+}
+
+void ext2_set_deferred_flush(ext2_fs *fs, int enabled) {
+    pthread_mutex_lock(&fs->sb_lock);
+    fs->defer_metadata = enabled;
+    pthread_mutex_unlock(&fs->sb_lock);
+    if (!enabled) ext2_flush_metadata(fs);
+}
+
+// Abre a imagem; com overlay_path, a base só para leitura e o delta nele
+static ext2_fs *open_image(const char *image_path, const char *overlay_path) {
+    ext2_fs *fs = calloc(1, sizeof(ext2_fs));
+    if (!fs) return NULL;
+
+    fs->fd = open(image_path, overlay_path ? O_RDONLY : O_RDWR);
+    if (fs->fd < 0) {
         perror("Falha ao abrir a imagem do disco");
-        return -1;
+        free(fs);
+        return NULL;
     }
-    fseek(disk_image, 1024, SEEK_SET);
-    fread(&sb, sizeof(  ext2_super_block), 1, disk_image);
 
-    if (sb.s_magic != EXT2_SUPER_MAGIC) {
-        fprintf(stderr, "Não é um sistema de arquivos EXT2 (magic: 0x%x)\n", sb.s_magic);
-        fclose(disk_image);
-        return -1;
+    // Journal externo de uma sessão anterior: reaplica antes de ler qualquer
+    // metadado. A base de um overlay não é alterada: o journal precisa estar vazio.
+    size_t path_len = strlen(image_path) + sizeof(EXT2_JOURNAL_SUFFIX);
+    char journal_path[path_len];
+    snprintf(journal_path, path_len, "%s%s", image_path, EXT2_JOURNAL_SUFFIX);
+    int replayed = 0;
+    if (overlay_path && journal_pending(journal_path)) {
+        fprintf(stderr, "O journal %s tem transações pendentes: abra a imagem sem overlay uma vez\n", journal_path);
+        replayed = -1;
+    } else if (!overlay_path) {
+        replayed = journal_replay(fs->fd, journal_path);
+        if (replayed < 0) fprintf(stderr, "Falha ao reaplicar o journal %s\n", journal_path);
+    }
+    if (replayed < 0) {
+        close(fs->fd);
+        free(fs);
+        return NULL;
+    }
+    if (replayed > 0) fprintf(stderr, "Journal: %d transações reaplicadas\n", replayed);
+
+    if (pread(fs->fd, &fs->sb, sizeof(ext2_super_block), 1024) != sizeof(ext2_super_block) ||
+        fs->sb.s_magic != EXT2_SUPER_MAGIC) {
+        fprintf(stderr, "Não é um sistema de arquivos EXT2 (magic: 0x%x)\n", fs->sb.s_magic);
+        close(fs->fd);
+        free(fs);
+        return NULL;
+    }
+    if (overlay_path) {
+        // O superbloco em vigor pode estar no delta de uma sessão anterior
+        fs->overlay = overlay_open(fs->fd, overlay_path, &fs->sb);
+        if (!fs->overlay || image_pread(fs, &fs->sb, sizeof(ext2_super_block), 1024) != 0) {
+            overlay_close(fs->overlay);
+            close(fs->fd);
+            free(fs);
+            return NULL;
+        }
+    }
+
+    fs->block_size = 1024 << fs->sb.s_log_block_size;
+    fs->inodes_per_block = fs->block_size / sizeof(ext2_inode);
+    fs->block_shift = __builtin_ctz(fs->block_size);
+    fs->ipb_shift = __builtin_ctz(fs->inodes_per_block);
+    fs->ptrs_shift = fs->block_shift - 2;
+    unsigned int ipg = fs->sb.s_inodes_per_group;
+    fs->ipg_shift = ipg > 1 && (ipg & (ipg - 1)) == 0 ? __builtin_ctz(ipg) : 0;
+    fs->kern = kernels_select(fs->block_size);
+    fs->group_count = (fs->sb.s_blocks_count - fs->sb.s_first_data_block + fs->sb.s_blocks_per_group - 1) / fs->sb.s_blocks_per_group;
+    fs->free_blocks = fs->sb.s_free_blocks_count;
+    fs->free_inodes = fs->sb.s_free_inodes_count;
+
+    fs->gd = malloc(fs->group_count * sizeof(ext2_group_desc));
+    fs->group_locks = malloc(fs->group_count * sizeof(pthread_mutex_t));
+    unsigned int gd_block = fs->sb.s_first_data_block + 1; // GDT logo após o superbloco
+    size_t len = fs->group_count * sizeof(ext2_group_desc);
+    fs->gdt_blocks = (len + fs->block_size - 1) / fs->block_size;
+    fs->gdt_dirty = calloc(fs->gdt_blocks, 1);
+    if (!fs->gd || !fs->group_locks || !fs->gdt_dirty ||
+        image_pread(fs, fs->gd, len, (off_t)gd_block * fs->block_size) != 0) {
+        fprintf(stderr, "Falha ao ler os descritores de grupo\n");
+        free(fs->gd);
+        free(fs->gdt_dirty);
+        free(fs->group_locks);
+        overlay_close(fs->overlay);
+        close(fs->fd);
+        free(fs);
+        return NULL;
     }
 
-    block_size = 1024 << sb.s_log_block_size;
-    inodes_per_block = block_size / sizeof(  ext2_inode);
-    group_count = (sb.s_blocks_count + sb.s_blocks_per_group - 1) / sb.s_blocks_per_group;
+    for (unsigned int g = 0; g < fs->group_count; g++) {
+        pthread_mutex_init(&fs->group_locks[g], NULL);
+    }
+    for (int i = 0; i < EXT2_INODE_LOCK_STRIPES; i++) {
+        pthread_rwlock_init(&fs->inode_locks[i], NULL);
+    }
+    pthread_mutex_init(&fs->sb_lock, NULL);
+    stats_init(fs);
+    trace_init(fs);
 
-    gd = malloc(group_count * sizeof(  ext2_group_desc));
-    unsigned int gd_block = (sb.s_first_data_block == 0) ? 2 : sb.s_first_data_block + 1;
-    fseek(disk_image, gd_block * block_size, SEEK_SET);
-    fread(gd, sizeof(  ext2_group_desc), group_count, disk_image);
+    fs->image_path = strdup(image_path);
+    if (!overlay_path && access(journal_path, F_OK) == 0 && journal_open(fs, journal_path) != 0) {
+        fprintf(stderr, "Aviso: journal %s não pôde ser aberto; gravando sem journal\n", journal_path);
+    }
 
-    return 0;
+    return fs;
 }
 
-void ext2_exit() {
-    if (gd) free(gd);
-    if (disk_image) {
-        fflush(disk_image);
-        fclose(disk_image);
+ext2_fs *ext2_init(const char *image_path) {
+    return open_image(image_path, NULL);
+}
+
+ext2_fs *ext2_init_overlay(const char *image_path, const char *delta_path) {
+    size_t len = strlen(image_path) + sizeof(EXT2_OVERLAY_SUFFIX);
+    char default_path[len];
+    snprintf(default_path, len, "%s%s", image_path, EXT2_OVERLAY_SUFFIX);
+    return open_image(image_path, delta_path ? delta_path : default_path);
+}
+
+void ext2_exit(ext2_fs *fs) {
+    if (!fs) return;
+    ext2_flush_metadata(fs);
+    journal_close(fs);
+    free(fs->gd);
+    free(fs->gdt_dirty);
+    free(fs->image_path);
+    if (fs->overlay) overlay_sync(fs->overlay);
+    else fsync(fs->fd);
+    stats_op(fs, EXT2_OP_SYNC, 1);
+    overlay_close(fs->overlay);
+    close(fs->fd);
+    for (unsigned int g = 0; g < fs->group_count; g++) {
+        pthread_mutex_destroy(&fs->group_locks[g]);
+    }
+    for (int i = 0; i < EXT2_INODE_LOCK_STRIPES; i++) {
+        pthread_rwlock_destroy(&fs->inode_locks[i]);
     }
+    pthread_mutex_destroy(&fs->sb_lock);
+    trace_destroy(fs);
+    stats_destroy(fs);
+    free(fs->group_locks);
+    free(fs);
+}
+
+const ext2_super_block *ext2_superblock(ext2_fs *fs) {
+    pthread_mutex_lock(&fs->sb_lock);
+    sync_free_counters(fs);
+    pthread_mutex_unlock(&fs->sb_lock);
+    return &fs->sb;
+}
+
+unsigned int ext2_block_size(ext2_fs *fs) {
+    return fs->block_size;
+}
+
+unsigned int ext2_group_count(ext2_fs *fs) {
+    return fs->group_count;
+}
+
+static int is_power_of(unsigned int n, unsigned int base) {
+    while (n > 1 && n % base == 0) n /= base;
+    return n == 1;
+}
+
+int group_has_super(ext2_fs *fs, unsigned int group) {
+    if (group <= 1 || !(fs->sb.s_feature_ro_compat & EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER)) return 1;
+    return is_power_of(group, 3) || is_power_of(group, 5) || is_power_of(group, 7);
+}
+
+void adjust_used_dirs(ext2_fs *fs, unsigned int inode_num, int delta) {
+    unsigned int group = (inode_num - 1) / fs->sb.s_inodes_per_group;
+    pthread_mutex_lock(&fs->group_locks[group]);
+    if (delta > 0 || fs->gd[group].bg_used_dirs_count > 0) {
+        fs->gd[group].bg_used_dirs_count += delta;
+    }
+    pthread_mutex_unlock(&fs->group_locks[group]);
+    mark_group_dirty(fs, group);
 }
 
 
 // === Funções de Inode ===
 
-int get_inode(unsigned int inode_num,   ext2_inode *inode_buf) {
-    if (inode_num == 0 || inode_num > sb.s_inodes_count) return -1;
-    
-    inode_num--;
-    unsigned int group = inode_num / sb.s_inodes_per_group;
-    unsigned int index = inode_num % sb.s_inodes_per_group;
-    unsigned int block = gd[group].bg_inode_table + (index / inodes_per_block);
-    unsigned int offset = (index % inodes_per_block) * sizeof(ext2_inode);
-    
-    char buffer[block_size];
-    read_block(block, buffer);
+int get_inode(ext2_fs *fs, unsigned int inode_num,   ext2_inode *inode_buf) {
+    if (inode_num == 0 || inode_num > fs->sb.s_inodes_count) return -1;
+
+    unsigned int group, offset;
+    uint32_t block;
+    inode_location(fs, inode_num, &group, &block, &offset);
+
+    char buffer[fs->block_size];
+    read_block(fs, block, buffer);
     memcpy(inode_buf, buffer + offset, sizeof(ext2_inode));
+    stats_op(fs, EXT2_OP_GET_INODE, 1);
     return 0;
 }
 
-void write_inode(unsigned int inode_num, const   ext2_inode *inode_buf) {
-    inode_num--;
-    unsigned int group = inode_num / sb.s_inodes_per_group;
-    unsigned int index = inode_num % sb.s_inodes_per_group;
-    unsigned int block = gd[group].bg_inode_table + (index / inodes_per_block);
-    unsigned int offset = (index % inodes_per_block) * sizeof(  ext2_inode);
+void write_inode(ext2_fs *fs, unsigned int inode_num, const   ext2_inode *inode_buf) {
+    unsigned int group, offset;
+    uint32_t block;
+    inode_location(fs, inode_num, &group, &block, &offset);
+    // Vários inodes dividem o bloco: o read-modify-write é feito sob o lock do grupo
+    pthread_mutex_lock(&fs->group_locks[group]);
     
-    char buffer[block_size];
-    read_block(block, buffer);
+    char buffer[fs->block_size];
+    read_block(fs, block, buffer);
     memcpy(buffer + offset, inode_buf, sizeof(  ext2_inode));
-    write_block(block, buffer);
+    write_block(fs, block, buffer);
+    pthread_mutex_unlock(&fs->group_locks[group]);
+    stats_op(fs, EXT2_OP_WRITE_INODE, 1);
+}
+
+// Atualiza só i_mtime e i_ctime, no bloco da tabela e sob o lock do grupo:
+// não sobrescreve campos que outra thread esteja alterando no mesmo inode
+static void touch_inode_times(ext2_fs *fs, unsigned int inode_num) {
+    unsigned int group, offset;
+    uint32_t block;
+    inode_location(fs, inode_num, &group, &block, &offset);
+    uint32_t now = (uint32_t)time(NULL);
+
+    pthread_mutex_lock(&fs->group_locks[group]);
+    char buffer[fs->block_size];
+    read_block(fs, block, buffer);
+    ext2_inode *inode = (ext2_inode *)(buffer + offset);
+    inode->i_mtime = now;
+    inode->i_ctime = now;
+    write_block(fs, block, buffer);
+    pthread_mutex_unlock(&fs->group_locks[group]);
+    stats_op(fs, EXT2_OP_WRITE_INODE, 1);
+}
+
+uint64_t inode_file_size(ext2_fs *fs, const ext2_inode *inode) {
+    uint64_t size = inode->i_size;
+    // Em arquivos regulares, i_dir_acl guarda os 32 bits altos do tamanho
+    if ((inode->i_mode & EXT2_S_IFMT) == EXT2_S_IFREG &&
+        (fs->sb.s_feature_ro_compat & EXT2_FEATURE_RO_COMPAT_LARGE_FILE)) {
+        size |= (uint64_t)inode->i_dir_acl << 32;
+    }
+    return size;
+}
+
+void inode_set_file_size(ext2_fs *fs, ext2_inode *inode, uint64_t size) {
+    inode->i_size = (uint32_t)size;
+    if ((inode->i_mode & EXT2_S_IFMT) != EXT2_S_IFREG) return;
+
+    inode->i_dir_acl = (uint32_t)(size >> 32);
+    // Arquivos acima de 2 GiB exigem a feature large_file no superbloco
+    int changed = 0;
+    pthread_mutex_lock(&fs->sb_lock);
+    if (size > 0x7FFFFFFFULL && !(fs->sb.s_feature_ro_compat & EXT2_FEATURE_RO_COMPAT_LARGE_FILE)) {
+        fs->sb.s_feature_ro_compat |= EXT2_FEATURE_RO_COMPAT_LARGE_FILE;
+        changed = 1;
+    }
+    pthread_mutex_unlock(&fs->sb_lock);
+    if (changed) write_superblock(fs);
+}
+
+int inode_block_path(ext2_fs *fs, uint64_t logical_block, uint32_t idx[3]) {
+    unsigned int shift = fs->ptrs_shift;
+    if (logical_block < EXT2_NDIR_BLOCKS) {
+        idx[0] = (uint32_t)logical_block;
+        return 0;
+    }
+
+    // Descobre o nível de indireção (1 = simples, 2 = duplo, 3 = triplo)
+    logical_block -= EXT2_NDIR_BLOCKS;
+    int levels = 1;
+    while (logical_block >= 1ull << (shift * levels)) {
+        logical_block -= 1ull << (shift * levels);
+        if (++levels > 3) return -1;
+    }
+
+    for (int d = levels - 1; d >= 0; d--) {
+        idx[d] = logical_block & ((1u << shift) - 1);
+        logical_block >>= shift;
+    }
+    return levels;
+}
+
+uint32_t inode_bmap(ext2_fs *fs, const ext2_inode *inode, uint64_t logical_block) {
+    uint32_t idx[3];
+    int levels = inode_block_path(fs, logical_block, idx);
+    if (levels < 0) return 0;
+    if (levels == 0) return inode->i_block[idx[0]];
+
+    uint32_t blk = inode->i_block[EXT2_IND_BLOCK + levels - 1];
+    uint32_t ptrs[fs->block_size / sizeof(uint32_t)];
+    for (int d = 0; d < levels && blk != 0; d++) {
+        if (read_block_as(fs, blk, ptrs, EXT2_IO_INDIRECT) != 0) return 0;
+        blk = ptrs[idx[d]];
+    }
+    return blk;
 }
 
 // === Funções de Alocação e Liberação ===
 
-unsigned int alloc_inode() {
-    char bitmap[block_size];
-    for (unsigned int group = 0; group < group_count; group++) {
-        if (gd[group].bg_free_inodes_count > 0) {
-            read_block(gd[group].bg_inode_bitmap, bitmap);
-            for (unsigned int i = 0; i < sb.s_inodes_per_group; i++) {
-                if (!((bitmap[i / 8] >> (i % 8)) & 1)) {
-                    bitmap[i / 8] |= (1 << (i % 8));
-                    write_block(gd[group].bg_inode_bitmap, bitmap);
-                    gd[group].bg_free_inodes_count--;
-                    sb.s_free_inodes_count--;
-                    write_group_descriptors();
-                    write_superblock();
-                    return (group * sb.s_inodes_per_group) + i + 1;
-                }
+// Bitmap de blocos visto pelo alocador (lock do grupo já adquirido). Com o
+// journal, blocos liberados na transação em andamento contam como ocupados
+// até o commit: numa queda antes dele, a liberação se perde e o bloco volta
+// ao dono antigo, e os dados gravados no lugar o teriam sobrescrito.
+static char *alloc_view(ext2_fs *fs, unsigned int group, char *bitmap, char *held) {
+    if (fs->journal && journal_mask_held(fs, group, bitmap, held)) return held;
+    return bitmap;
+}
+
+// Procura o primeiro bit livre do grupo e o marca (lock do grupo já adquirido).
+// Em bitmaps de blocos, `held_group` é o grupo (alloc_view); em bitmaps de inodes, -1.
+static int claim_first_free(ext2_fs *fs, unsigned int bitmap_block, unsigned int nbits, char *bitmap, int held_group) {
+    char held[fs->block_size];
+    read_block(fs, bitmap_block, bitmap);
+    char *view = held_group >= 0 ? alloc_view(fs, held_group, bitmap, held) : bitmap;
+    int i = fs->kern->claim_first_free((uint8_t *)view, nbits, fs->block_size);
+    if (i < 0) return i;
+    bitmap[i / 8] |= 1 << (i % 8); // Já marcado quando view == bitmap
+    write_block(fs, bitmap_block, bitmap);
+    return i;
+}
+
+unsigned int alloc_inode(ext2_fs *fs) {
+    char bitmap[fs->block_size];
+    // 1ª passada: pula grupos ocupados por outra thread; 2ª passada: espera
+    for (int pass = 0; pass < 2; pass++) {
+        for (unsigned int group = 0; group < fs->group_count; group++) {
+            if (fs->gd[group].bg_free_inodes_count == 0) continue;
+            if (pass == 0) {
+                if (pthread_mutex_trylock(&fs->group_locks[group]) != 0) continue;
+            } else {
+                pthread_mutex_lock(&fs->group_locks[group]);
+            }
+
+            int i = -1;
+            if (fs->gd[group].bg_free_inodes_count > 0) {
+                i = claim_first_free(fs, fs->gd[group].bg_inode_bitmap, fs->sb.s_inodes_per_group, bitmap, -1);
+                if (i >= 0) fs->gd[group].bg_free_inodes_count--;
+            }
+            pthread_mutex_unlock(&fs->group_locks[group]);
+
+            if (i >= 0) {
+                __atomic_sub_fetch(&fs->free_inodes, 1, __ATOMIC_RELAXED);
+                stats_op(fs, EXT2_OP_ALLOC_INODE, 1);
+                mark_group_dirty(fs, group);
+                return (group * fs->sb.s_inodes_per_group) + i + 1;
             }
         }
     }
     return 0;
 }
 
-void free_inode_resource(unsigned int inode_num) {
+unsigned int alloc_inode_list(ext2_fs *fs, unsigned int count, unsigned int goal_group, block_list *list) {
+    char bitmap[fs->block_size];
+    unsigned int ipg = fs->sb.s_inodes_per_group;
+    unsigned int got = 0;
+
+    for (unsigned int n = 0; n < fs->group_count && got < count; n++) {
+        unsigned int group = (goal_group + n) % fs->group_count;
+        if (fs->gd[group].bg_free_inodes_count == 0) continue;
+
+        pthread_mutex_lock(&fs->group_locks[group]);
+        unsigned int avail = fs->gd[group].bg_free_inodes_count, taken = 0;
+        read_block(fs, fs->gd[group].bg_inode_bitmap, bitmap);
+        for (unsigned int i = 0; i < ipg && taken < avail && got < count; i++) {
+            if ((bitmap[i / 8] >> (i % 8)) & 1) continue;
+            bitmap[i / 8] |= 1 << (i % 8);
+            block_list_add(list, group * ipg + i + 1);
+            taken++;
+            got++;
+        }
+        if (taken > 0) {
+            write_block(fs, fs->gd[group].bg_inode_bitmap, bitmap);
+            fs->gd[group].bg_free_inodes_count -= taken;
+            mark_group_dirty(fs, group);
+        }
+        pthread_mutex_unlock(&fs->group_locks[group]);
+        __atomic_sub_fetch(&fs->free_inodes, taken, __ATOMIC_RELAXED);
+    }
+
+    if (got > 0) stats_op(fs, EXT2_OP_ALLOC_INODE, got);
+    return got;
+}
+
+void free_inode_resource(ext2_fs *fs, unsigned int inode_num) {
     inode_num--;
-    unsigned int group = inode_num / sb.s_inodes_per_group;
-    unsigned int index = inode_num % sb.s_inodes_per_group;
-    char bitmap[block_size];
-    read_block(gd[group].bg_inode_bitmap, bitmap);
+    unsigned int group = inode_num / fs->sb.s_inodes_per_group;
+    unsigned int index = inode_num % fs->sb.s_inodes_per_group;
+    pthread_mutex_lock(&fs->group_locks[group]);
+    char bitmap[fs->block_size];
+    read_block(fs, fs->gd[group].bg_inode_bitmap, bitmap);
     bitmap[index / 8] &= ~(1 << (index % 8)); // Limpa o bit
-    write_block(gd[group].bg_inode_bitmap, bitmap);
-    gd[group].bg_free_inodes_count++;
-    sb.s_free_inodes_count++;
-    write_group_descriptors();
-    write_superblock();
-}
-
-
-unsigned int alloc_block() {
-    char bitmap[block_size];
-    for (unsigned int group = 0; group < group_count; group++) {
-        if (gd[group].bg_free_blocks_count > 0) {
-            read_block(gd[group].bg_block_bitmap, bitmap);
-            for (unsigned int i = 0; i < sb.s_blocks_per_group; i++) {
-                if (!((bitmap[i / 8] >> (i % 8)) & 1)) {
-                    bitmap[i / 8] |= (1 << (i % 8));
-                    write_block(gd[group].bg_block_bitmap, bitmap);
-                    gd[group].bg_free_blocks_count--;
-                    sb.s_free_blocks_count--;
-                    write_group_descriptors();
-                    write_superblock();
-                    return (group * sb.s_blocks_per_group) + i + sb.s_first_data_block;
-                }
+    write_block(fs, fs->gd[group].bg_inode_bitmap, bitmap);
+    fs->gd[group].bg_free_inodes_count++;
+    pthread_mutex_unlock(&fs->group_locks[group]);
+    __atomic_add_fetch(&fs->free_inodes, 1, __ATOMIC_RELAXED);
+    stats_op(fs, EXT2_OP_FREE_INODE, 1);
+    mark_group_dirty(fs, group);
+}
+
+// Quantidade de blocos do grupo (o último grupo pode ser menor)
+static unsigned int group_block_count(ext2_fs *fs, unsigned int group) {
+    unsigned int group_first = group * fs->sb.s_blocks_per_group + fs->sb.s_first_data_block;
+    if (group_first + fs->sb.s_blocks_per_group > fs->sb.s_blocks_count) {
+        return fs->sb.s_blocks_count - group_first;
+    }
+    return fs->sb.s_blocks_per_group;
+}
+
+unsigned int alloc_block(ext2_fs *fs) {
+    char bitmap[fs->block_size];
+    for (int pass = 0; pass < 2; pass++) {
+        for (unsigned int group = 0; group < fs->group_count; group++) {
+            if (fs->gd[group].bg_free_blocks_count == 0) continue;
+            if (pass == 0) {
+                if (pthread_mutex_trylock(&fs->group_locks[group]) != 0) continue;
+            } else {
+                pthread_mutex_lock(&fs->group_locks[group]);
+            }
+
+            int i = -1;
+            if (fs->gd[group].bg_free_blocks_count > 0) {
+                i = claim_first_free(fs, fs->gd[group].bg_block_bitmap, group_block_count(fs, group), bitmap, group);
+                if (i >= 0) fs->gd[group].bg_free_blocks_count--;
+            }
+            pthread_mutex_unlock(&fs->group_locks[group]);
+
+            if (i >= 0) {
+                __atomic_sub_fetch(&fs->free_blocks, 1, __ATOMIC_RELAXED);
+                stats_op(fs, EXT2_OP_ALLOC_BLOCK, 1);
+                mark_group_dirty(fs, group);
+                return (group * fs->sb.s_blocks_per_group) + i + fs->sb.s_first_data_block;
             }
         }
     }
     return 0;
 }
 
-void free_block_resource(unsigned int block_num) {
+void free_block_resource(ext2_fs *fs, unsigned int block_num) {
     if (block_num == 0) return;
-    block_num -= sb.s_first_data_block;
-    unsigned int group = block_num / sb.s_blocks_per_group;
-    unsigned int index = block_num % sb.s_blocks_per_group;
-    char bitmap[block_size];
-    read_block(gd[group].bg_block_bitmap, bitmap);
+    block_num -= fs->sb.s_first_data_block;
+    unsigned int group = block_num / fs->sb.s_blocks_per_group;
+    unsigned int index = block_num % fs->sb.s_blocks_per_group;
+    pthread_mutex_lock(&fs->group_locks[group]);
+    char bitmap[fs->block_size];
+    read_block(fs, fs->gd[group].bg_block_bitmap, bitmap);
     bitmap[index / 8] &= ~(1 << (index % 8));
-    write_block(gd[group].bg_block_bitmap, bitmap);
-    gd[group].bg_free_blocks_count++;
-    sb.s_free_blocks_count++;
-    write_group_descriptors();
-    write_superblock();
+    write_block(fs, fs->gd[group].bg_block_bitmap, bitmap);
+    if (fs->journal) journal_hold(fs, group, index);
+    fs->gd[group].bg_free_blocks_count++;
+    pthread_mutex_unlock(&fs->group_locks[group]);
+    __atomic_add_fetch(&fs->free_blocks, 1, __ATOMIC_RELAXED);
+    stats_op(fs, EXT2_OP_FREE_BLOCK, 1);
+    mark_group_dirty(fs, group);
+}
+
+// Marca o trecho no bitmap do grupo e atualiza o contador do grupo
+// (lock do grupo já adquirido; bitmap já lido)
+static void claim_run(ext2_fs *fs, unsigned int group, char *bitmap, unsigned int start, unsigned int len) {
+    for (unsigned int i = start; i < start + len; i++) {
+        bitmap[i / 8] |= (1 << (i % 8));
+    }
+    write_block(fs, fs->gd[group].bg_block_bitmap, bitmap);
+    fs->gd[group].bg_free_blocks_count -= len;
+}
+
+unsigned int alloc_block_run(ext2_fs *fs, unsigned int goal, unsigned int count, unsigned int *got) {
+    *got = 0;
+    if (count == 0) return 0;
+
+    unsigned int goal_group = 0;
+    if (goal >= fs->sb.s_first_data_block && goal < fs->sb.s_blocks_count) {
+        goal_group = (goal - fs->sb.s_first_data_block) / fs->sb.s_blocks_per_group;
+    }
+
+    char bitmap[fs->block_size], held[fs->block_size];
+    unsigned int best_group = 0, best_len = 0, found_group = 0, found_start = 0, found_len = 0;
+
+    // Procura o primeiro trecho livre com `count` blocos a partir do grupo do goal,
+    // um grupo por vez sob o seu lock. Um trecho completo é reservado na hora.
+    // (o grupo do goal é visitado de novo no fim para cobrir os blocos anteriores ao goal)
+    for (unsigned int n = 0; n <= fs->group_count; n++) {
+        unsigned int group = (goal_group + n) % fs->group_count;
+        if (fs->gd[group].bg_free_blocks_count == 0 || fs->gd[group].bg_free_blocks_count <= best_len) continue;
+
+        unsigned int group_first = group * fs->sb.s_blocks_per_group + fs->sb.s_first_data_block;
+        unsigned int from = (n == 0 && goal > group_first) ? goal - group_first : 0;
+        unsigned int start = 0;
+
+        pthread_mutex_lock(&fs->group_locks[group]);
+        read_block(fs, fs->gd[group].bg_block_bitmap, bitmap);
+        const char *view = alloc_view(fs, group, bitmap, held);
+        unsigned int len = fs->kern->free_run((const uint8_t *)view, from, group_block_count(fs, group), count, &start,
+                                              fs->block_size);
+        if (len == count) {
+            claim_run(fs, group, bitmap, start, len);
+            found_group = group;
+            found_start = start;
+            found_len = len;
+        }
+        pthread_mutex_unlock(&fs->group_locks[group]);
+
+        if (found_len > 0) break;
+        if (len > best_len) {
+            best_group = group;
+            best_len = len;
+        }
+    }
+
+    // Nenhum grupo tem `count` blocos seguidos: usa o maior trecho do melhor grupo,
+    // procurado de novo sob o lock (outra thread pode ter alocado nesse meio tempo)
+    if (found_len == 0 && best_len > 0) {
+        pthread_mutex_lock(&fs->group_locks[best_group]);
+        read_block(fs, fs->gd[best_group].bg_block_bitmap, bitmap);
+        const char *view = alloc_view(fs, best_group, bitmap, held);
+        found_len = fs->kern->free_run((const uint8_t *)view, 0, group_block_count(fs, best_group), count, &found_start,
+                                       fs->block_size);
+        if (found_len > 0) claim_run(fs, best_group, bitmap, found_start, found_len);
+        pthread_mutex_unlock(&fs->group_locks[best_group]);
+        found_group = best_group;
+    }
+
+    if (found_len == 0) return 0;
+
+    // Descritor e superbloco marcados uma única vez para o trecho inteiro
+    __atomic_sub_fetch(&fs->free_blocks, found_len, __ATOMIC_RELAXED);
+    stats_op(fs, EXT2_OP_ALLOC_BLOCK, found_len);
+    mark_group_dirty(fs, found_group);
+
+    *got = found_len;
+    return (found_group * fs->sb.s_blocks_per_group) + found_start + fs->sb.s_first_data_block;
 }
 
 // === Funções de Diretório ===
 
-unsigned int search_directory(unsigned int dir_inode_num, const char *name) {
+static unsigned int search_directory_locked(ext2_fs *fs, unsigned int dir_inode_num, const char *name) {
       ext2_inode dir_inode;
-    if (get_inode(dir_inode_num, &dir_inode) != 0 || !(dir_inode.i_mode & EXT2_S_IFDIR)) return 0;
+    if (get_inode(fs, dir_inode_num, &dir_inode) != 0 || !(dir_inode.i_mode & EXT2_S_IFDIR)) return 0;
     
-    char block_buf[block_size];
+    size_t len = strlen(name);
+    if (len == 0 || len > 255) return 0;
+    struct dir_key key;
+    dir_key_init(&key, name, (unsigned int)len);
+    char block_buf[fs->block_size];
     for (int i = 0; i < 12 && dir_inode.i_block[i] != 0; ++i) {
-        read_block(dir_inode.i_block[i], block_buf);
-          ext2_dir_entry_2 *entry = (  ext2_dir_entry_2 *)block_buf;
-        unsigned int offset = 0;
-        while (offset < block_size && entry->rec_len > 0) {
-            if (entry->inode != 0 && strncmp(name, entry->name, entry->name_len) == 0 && strlen(name) == entry->name_len) {
-                return entry->inode;
-            }
-            offset += entry->rec_len;
-            entry = (  ext2_dir_entry_2 *)((char *)block_buf + offset);
-        }
+        if (read_block_as(fs, dir_inode.i_block[i], block_buf, EXT2_IO_DIR) != 0) continue;
+        int off = fs->kern->dir_block_find(block_buf, &key, NULL, fs->block_size);
+        if (off >= 0) return ((ext2_dir_entry_2 *)(block_buf + off))->inode;
     }
     return 0;
 }
 
-unsigned int find_inode_by_path(const char *path, unsigned int start_inode_num) {
+unsigned int search_directory(ext2_fs *fs, unsigned int dir_inode_num, const char *name) {
+    // Leitores do mesmo diretório rodam em paralelo; add/remove de entrada esperam
+    stats_op(fs, EXT2_OP_SEARCH_DIR, 1);
+    pthread_rwlock_rdlock(inode_lock(fs, dir_inode_num));
+    unsigned int ret = search_directory_locked(fs, dir_inode_num, name);
+    pthread_rwlock_unlock(inode_lock(fs, dir_inode_num));
+    return ret;
+}
+
+unsigned int find_inode_by_path(ext2_fs *fs, const char *path, unsigned int start_inode_num) {
     if (path == NULL || strlen(path) == 0) return 0;
     char path_copy[1024];
     strcpy(path_copy, path);
@@ -217,7 +765,7 @@ unsigned int find_inode_by_path(const char *path, unsigned int start_inode_num)
 
     char *token = strtok(path_copy, "/");
     while (token != NULL) {
-        current_inode_num = search_directory(current_inode_num, token);
+        current_inode_num = search_directory(fs, current_inode_num, token);
         if (current_inode_num == 0) return 0;
         token = strtok(NULL, "/");
     }
@@ -225,44 +773,46 @@ unsigned int find_inode_by_path(const char *path, unsigned int start_inode_num)
 }
 
 
-int read_superblock(ext2_super_block *sb) {
-    uint8_t buf[1024];
-
-    // O superbloco sempre está no offset 1024 (ou bloco 1 se block_size == 1024)
-    if (read_block(1, buf) != 0) {
+int read_superblock(ext2_fs *fs, ext2_super_block *sb) {
+    // O superbloco sempre está no offset 1024, qualquer que seja o tamanho do bloco
+    // (lido pelo bloco que o contém: a versão mais nova pode estar no journal)
+    char block[fs->block_size];
+    if (read_block(fs, 1024 / fs->block_size, block) != 0) {
         fprintf(stderr, "Erro ao ler o bloco do superbloco.\n");
         return -1;
     }
-
-    memcpy(sb, buf, sizeof(ext2_super_block));
+    memcpy(sb, block + 1024 % fs->block_size, sizeof(ext2_super_block));
 
     if (sb->s_magic != EXT2_SUPER_MAGIC) {
         fprintf(stderr, "Sistema de arquivos inválido. Magic: 0x%x\n", sb->s_magic);
         return -1;
     }
+    // Os contadores no disco podem estar atrasados (gravados no flush ou no commit)
+    sb->s_free_blocks_count = __atomic_load_n(&fs->free_blocks, __ATOMIC_RELAXED);
+    sb->s_free_inodes_count = __atomic_load_n(&fs->free_inodes, __ATOMIC_RELAXED);
 
     return 0;
 }
 
-int add_dir_entry(unsigned int parent_inode_num, unsigned int new_inode_num, const char *name, uint8_t file_type) {
+static int add_dir_entry_locked(ext2_fs *fs, unsigned int parent_inode_num, unsigned int new_inode_num, const char *name, uint8_t file_type) {
       ext2_inode parent_inode;
-    get_inode(parent_inode_num, &parent_inode);
-    char block_buf[block_size];
+    get_inode(fs, parent_inode_num, &parent_inode);
+    char block_buf[fs->block_size];
 
     unsigned char name_len = strlen(name);
     unsigned short needed_len = 8 + name_len;
     if (needed_len % 4 != 0) needed_len = (needed_len / 4 + 1) * 4;
 
     for (int i = 0; i < 12 && parent_inode.i_block[i] != 0; i++) {
-        read_block(parent_inode.i_block[i], block_buf);
+        read_block_as(fs, parent_inode.i_block[i], block_buf, EXT2_IO_DIR);
           ext2_dir_entry_2 *entry = (  ext2_dir_entry_2 *)block_buf;
         unsigned int offset = 0;
         
-        while (offset < block_size && entry->rec_len > 0) {
+        while (offset < fs->block_size && entry->rec_len > 0) {
             unsigned short ideal_len = 8 + entry->name_len;
             if (ideal_len % 4 != 0) ideal_len = (ideal_len / 4 + 1) * 4;
 
-            if (offset + entry->rec_len >= block_size && entry->rec_len >= ideal_len + needed_len) {
+            if (offset + entry->rec_len >= fs->block_size && entry->rec_len >= ideal_len + needed_len) {
                 unsigned short old_rec_len = entry->rec_len;
                 entry->rec_len = ideal_len;
                 
@@ -274,7 +824,8 @@ int add_dir_entry(unsigned int parent_inode_num, unsigned int new_inode_num, con
                 new_entry->file_type = file_type;
                 memcpy(new_entry->name, name, name_len);
 
-                write_block(parent_inode.i_block[i], block_buf);
+                write_block(fs, parent_inode.i_block[i], block_buf);
+                touch_inode_times(fs, parent_inode_num);
                 return 0;
             }
             offset += entry->rec_len;
@@ -285,29 +836,32 @@ int add_dir_entry(unsigned int parent_inode_num, unsigned int new_inode_num, con
     return -1;
 }
 
-int read_group_desc(uint32_t group_num, ext2_group_desc *desc) {
-    if (desc == NULL) return -1;
-
-    uint32_t group_desc_table_block = (block_size == 1024) ? 2 : 1;
-    uint32_t offset = group_num * sizeof(ext2_group_desc);
-    uint32_t block_offset = offset / block_size;
-    uint32_t offset_in_block = offset % block_size;
+int add_dir_entry(ext2_fs *fs, unsigned int parent_inode_num, unsigned int new_inode_num, const char *name, uint8_t file_type) {
+    pthread_rwlock_wrlock(inode_lock(fs, parent_inode_num));
+    int ret = add_dir_entry_locked(fs, parent_inode_num, new_inode_num, name, file_type);
+    pthread_rwlock_unlock(inode_lock(fs, parent_inode_num));
+    return ret;
+}
 
-    uint8_t buf[1024];
-    if (read_block(group_desc_table_block + block_offset, buf) != 0) {
+int read_group_desc(ext2_fs *fs, uint32_t group_num, ext2_group_desc *desc) {
+    if (desc == NULL) return -1;
+    if (group_num >= fs->group_count) {
         fprintf(stderr, "Erro ao ler descritor do grupo %u\n", group_num);
         return -1;
     }
 
-    memcpy(desc, buf + offset_in_block, sizeof(ext2_group_desc));
+    // A cópia em memória é a atual: o bloco da GDT só é gravado no flush ou no commit
+    pthread_mutex_lock(&fs->group_locks[group_num]);
+    *desc = fs->gd[group_num];
+    pthread_mutex_unlock(&fs->group_locks[group_num]);
     return 0;
 }
 
-int read_inode(uint32_t inode_num, ext2_inode *inode_out) {
+int read_inode(ext2_fs *fs, uint32_t inode_num, ext2_inode *inode_out) {
     if (inode_num == 0) return -1;
 
     ext2_super_block sb;
-    if (read_superblock(&sb) != 0) return -1;
+    if (read_superblock(fs, &sb) != 0) return -1;
 
     // Quantos inodes por grupo existem
     uint32_t inodes_per_group = sb.s_inodes_per_group;
@@ -319,7 +873,7 @@ int read_inode(uint32_t inode_num, ext2_inode *inode_out) {
 
     // Ler o descritor do grupo
     ext2_group_desc gd;
-    if (read_group_desc(group, &gd) != 0) return -1;
+    if (read_group_desc(fs, group, &gd) != 0) return -1;
 
     // Bloco onde está a tabela de inodes
     uint32_t inode_table_block = gd.bg_inode_table;
@@ -331,15 +885,15 @@ int read_inode(uint32_t inode_num, ext2_inode *inode_out) {
     //uint32_t inodes_per_block = block_size / inode_size;
 
     // Qual bloco dentro da tabela de inodes contém o inode?
-    uint32_t block_offset = offset_bytes / block_size;
+    uint32_t block_offset = offset_bytes / fs->block_size;
     uint32_t block_number = inode_table_block + block_offset;
 
     // Offset dentro do bloco
-    uint32_t offset_in_block = offset_bytes % block_size;
+    uint32_t offset_in_block = offset_bytes % fs->block_size;
 
     // Ler o bloco onde está o inode
-    uint8_t buf[1024];
-    if (read_block(block_number, buf) != 0) {
+    uint8_t buf[fs->block_size];
+    if (read_block(fs, block_number, buf) != 0) {
         fprintf(stderr, "Erro ao ler bloco do inode\n");
         return -1;
     }
@@ -350,103 +904,586 @@ int read_inode(uint32_t inode_num, ext2_inode *inode_out) {
     return 0;
 }
 
-int remove_dir_entry(unsigned int parent_inode_num, const char *name_to_remove) {
+static int remove_dir_entry_locked(ext2_fs *fs, unsigned int parent_inode_num, const char *name_to_remove) {
       ext2_inode parent_inode;
-    get_inode(parent_inode_num, &parent_inode);
-    char block_buf[block_size];
+    get_inode(fs, parent_inode_num, &parent_inode);
+    size_t len = strlen(name_to_remove);
+    if (len == 0 || len > 255) return -1;
+    struct dir_key key;
+    dir_key_init(&key, name_to_remove, (unsigned int)len);
+    char block_buf[fs->block_size];
     
     for (int i = 0; i < 12 && parent_inode.i_block[i] != 0; i++) {
-        read_block(parent_inode.i_block[i], block_buf);
-          ext2_dir_entry_2 *entry = (  ext2_dir_entry_2 *)block_buf;
-          ext2_dir_entry_2 *prev_entry = NULL;
-        unsigned int offset = 0;
-        
-        while (offset < block_size && entry->rec_len > 0) {
-            if (entry->inode != 0 && strncmp(name_to_remove, entry->name, entry->name_len) == 0 && strlen(name_to_remove) == entry->name_len) {
-                if (prev_entry) {
-                    prev_entry->rec_len += entry->rec_len;
-                } else {
-                    entry->inode = 0; // Invalida a entrada se for a primeira
-                }
-                write_block(parent_inode.i_block[i], block_buf);
-                return 0; // Sucesso
-            }
-            prev_entry = entry;
-            offset += entry->rec_len;
-            entry = (  ext2_dir_entry_2 *)((char *)block_buf + offset);
+        if (read_block_as(fs, parent_inode.i_block[i], block_buf, EXT2_IO_DIR) != 0) continue;
+        int prev;
+        int off = fs->kern->dir_block_find(block_buf, &key, &prev, fs->block_size);
+        if (off < 0) continue;
+
+        ext2_dir_entry_2 *entry = (ext2_dir_entry_2 *)(block_buf + off);
+        if (prev >= 0) {
+            ((ext2_dir_entry_2 *)(block_buf + prev))->rec_len += entry->rec_len;
+        } else {
+            entry->inode = 0; // Invalida a entrada se for a primeira
         }
+        write_block(fs, parent_inode.i_block[i], block_buf);
+        touch_inode_times(fs, parent_inode_num);
+        return 0; // Sucesso
     }
     return -1; // Não encontrado
 }
 
-void copy_block_to_file(uint32_t block_num, FILE *dest_file, unsigned int *bytes_remaining, char *block_buf) {
+int remove_dir_entry(ext2_fs *fs, unsigned int parent_inode_num, const char *name_to_remove) {
+    pthread_rwlock_wrlock(inode_lock(fs, parent_inode_num));
+    int ret = remove_dir_entry_locked(fs, parent_inode_num, name_to_remove);
+    pthread_rwlock_unlock(inode_lock(fs, parent_inode_num));
+    return ret;
+}
+
+void copy_block_to_file(ext2_fs *fs, uint32_t block_num, FILE *dest_file, uint64_t *bytes_remaining, char *block_buf) {
     if (*bytes_remaining == 0) return;
-    read_block(block_num, block_buf);
-    unsigned int bytes_to_write = (*bytes_remaining < block_size) ? *bytes_remaining : block_size;
+    if (block_num == 0) {
+        memset(block_buf, 0, fs->block_size); // Buraco no arquivo: lê como zeros
+    } else {
+        read_block(fs, block_num, block_buf);
+    }
+    unsigned int bytes_to_write = (*bytes_remaining < fs->block_size) ? (unsigned int)*bytes_remaining : fs->block_size;
     fwrite(block_buf, 1, bytes_to_write, dest_file);
     *bytes_remaining -= bytes_to_write;
 }
 
-void free_indirect_blocks(uint32_t block_ptr, int level) {
-    if (block_ptr == 0 || block_ptr < sb.s_first_data_block) {
-        return;  // Bloco inválido
+// Percorre recursivamente um bloco indireto de nível `level` (1, 2 ou 3).
+// Ponteiros nulos são buracos e cobrem `span` blocos lógicos cada.
+static int walk_indirect(ext2_fs *fs, uint32_t block_ptr, int level, uint64_t *lblk, uint64_t max_blocks,
+                         block_walk_fn fn, void *ctx) {
+    unsigned int ptrs = 1u << fs->ptrs_shift;
+    uint64_t span = 1ull << (fs->ptrs_shift * (level - 1));
+
+    if (block_ptr == 0) {
+        // Subárvore inteira ausente: reporta cada bloco lógico como buraco
+        uint64_t end = *lblk + span * ptrs;
+        if (end > max_blocks) end = max_blocks;
+        for (; *lblk < end; (*lblk)++) {
+            if (fn(fs, 0, *lblk, ctx) != 0) return 1;
+        }
+        return 0;
     }
 
-    uint32_t *blocks = malloc(block_size);
-    if (read_block(block_ptr, blocks) != 0) {
+    uint32_t *blocks = malloc(fs->block_size);
+    if (!blocks) return -1;
+    if (read_block_as(fs, block_ptr, blocks, EXT2_IO_INDIRECT) != 0) {
         free(blocks);
-        return;  // Falha na leitura
+        return -1;
+    }
+
+    int ret = 0;
+    for (unsigned int i = 0; i < ptrs && *lblk < max_blocks && ret == 0; i++) {
+        if (level == 1) {
+            ret = fn(fs, blocks[i], *lblk, ctx);
+            (*lblk)++;
+        } else {
+            ret = walk_indirect(fs, blocks[i], level - 1, lblk, max_blocks, fn, ctx);
+        }
+    }
+    free(blocks);
+    return ret;
+}
+
+int walk_file_blocks(ext2_fs *fs, const ext2_inode *inode, uint64_t max_blocks, block_walk_fn fn, void *ctx) {
+    uint64_t lblk = 0;
+
+    // 1. Blocos diretos (0-11)
+    for (int i = 0; i < EXT2_NDIR_BLOCKS && lblk < max_blocks; i++, lblk++) {
+        if (fn(fs, inode->i_block[i], lblk, ctx) != 0) return 1;
     }
 
-    if (level == 1) {
-        // Nível de dados
-        for (int i = 0; i < block_size/sizeof(uint32_t); i++) {
-            if (blocks[i] != 0 && blocks[i] >= sb.s_first_data_block) {
-                free_block_resource(blocks[i]);
+    // 2. Indireto simples, duplo e triplo (12, 13 e 14)
+    for (int level = 1; level <= 3 && lblk < max_blocks; level++) {
+        int ret = walk_indirect(fs, inode->i_block[EXT2_IND_BLOCK + level - 1], level,
+                                &lblk, max_blocks, fn, ctx);
+        if (ret != 0) return ret;
+    }
+    return 0;
+}
+
+struct copy_ctx {
+    FILE *dest;
+    uint64_t bytes_remaining;
+    char *block_buf;
+};
+
+static int copy_walk_cb(ext2_fs *fs, uint32_t block_num, uint64_t lblk, void *ctx) {
+    (void)lblk;
+    struct copy_ctx *c = ctx;
+    copy_block_to_file(fs, block_num, c->dest, &c->bytes_remaining, c->block_buf);
+    return c->bytes_remaining == 0;
+}
+
+int copy_inode_to_file(ext2_fs *fs, const ext2_inode *inode, FILE *dest_file) {
+    struct copy_ctx c = { dest_file, inode_file_size(fs, inode), malloc(fs->block_size) };
+    if (!c.block_buf) return -1;
+
+    uint64_t nblocks = (c.bytes_remaining + fs->block_size - 1) / fs->block_size;
+    int ret = walk_file_blocks(fs, inode, nblocks, copy_walk_cb, &c);
+    free(c.block_buf);
+    return ret < 0 ? -1 : 0;
+}
+
+int block_list_add(block_list *list, uint32_t block_num) {
+    if (list->count == list->cap) {
+        size_t new_cap = list->cap ? list->cap * 2 : 256;
+        uint32_t *p = realloc(list->blocks, new_cap * sizeof(uint32_t));
+        if (!p) return -1;
+        list->blocks = p;
+        list->cap = new_cap;
+    }
+    list->blocks[list->count++] = block_num;
+    return 0;
+}
+
+void block_list_destroy(block_list *list) {
+    free(list->blocks);
+    list->blocks = NULL;
+    list->count = list->cap = 0;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Limpa os bits da lista no bitmap de blocos (descritores só marcados).
+// Cada grupo é tratado sob o seu lock, um de cada vez.
+static unsigned int clear_block_bits(ext2_fs *fs, block_list *list) {
+    if (list->count == 0) return 0;
+    qsort(list->blocks, list->count, sizeof(uint32_t), cmp_u32);
+
+    char bitmap[fs->block_size];
+    unsigned int total = 0;
+    size_t i = 0;
+
+    // Blocos ordenados ficam agrupados por grupo: cada bitmap é lido e gravado uma vez
+    while (i < list->count) {
+        uint32_t blk = list->blocks[i];
+        if (blk < fs->sb.s_first_data_block || blk >= fs->sb.s_blocks_count) {
+            i++;
+            continue;
+        }
+        unsigned int group = (blk - fs->sb.s_first_data_block) / fs->sb.s_blocks_per_group;
+        uint32_t group_first = group * fs->sb.s_blocks_per_group + fs->sb.s_first_data_block;
+        uint32_t group_end = group_first + fs->sb.s_blocks_per_group;
+
+        pthread_mutex_lock(&fs->group_locks[group]);
+        read_block(fs, fs->gd[group].bg_block_bitmap, bitmap);
+        unsigned int freed = 0;
+        for (; i < list->count && list->blocks[i] < group_end; i++) {
+            unsigned int index = list->blocks[i] - group_first;
+            // Só conta bits realmente ocupados (protege contadores de blocos repetidos)
+            if ((bitmap[index / 8] >> (index % 8)) & 1) {
+                bitmap[index / 8] &= ~(1 << (index % 8));
+                if (fs->journal) journal_hold(fs, group, index);
+                freed++;
             }
         }
-    } else {
-        // Níveis de ponteiros
-        for (int i = 0; i < block_size/sizeof(uint32_t); i++) {
-            if (blocks[i] != 0 && blocks[i] >= sb.s_first_data_block) {
-                free_indirect_blocks(blocks[i], level - 1);
+        if (freed > 0) {
+            write_block(fs, fs->gd[group].bg_block_bitmap, bitmap);
+            fs->gd[group].bg_free_blocks_count += freed;
+            total += freed;
+            mark_group_dirty(fs, group);
+        }
+        pthread_mutex_unlock(&fs->group_locks[group]);
+    }
+
+    __atomic_add_fetch(&fs->free_blocks, total, __ATOMIC_RELAXED);
+    stats_op(fs, EXT2_OP_FREE_BLOCK, total);
+    return total;
+}
+
+// Limpa os bits da lista no bitmap de inodes (descritores só marcados)
+static unsigned int clear_inode_bits(ext2_fs *fs, block_list *list, const unsigned int *dirs_per_group) {
+    if (list->count == 0) return 0;
+    qsort(list->blocks, list->count, sizeof(uint32_t), cmp_u32);
+
+    char bitmap[fs->block_size];
+    unsigned int total = 0;
+    size_t i = 0;
+
+    while (i < list->count) {
+        uint32_t ino = list->blocks[i];
+        if (ino == 0 || ino > fs->sb.s_inodes_count) {
+            i++;
+            continue;
+        }
+        unsigned int group = (ino - 1) / fs->sb.s_inodes_per_group;
+        uint32_t group_first = group * fs->sb.s_inodes_per_group + 1;
+        uint32_t group_end = group_first + fs->sb.s_inodes_per_group;
+
+        pthread_mutex_lock(&fs->group_locks[group]);
+        read_block(fs, fs->gd[group].bg_inode_bitmap, bitmap);
+        unsigned int freed = 0;
+        for (; i < list->count && list->blocks[i] < group_end; i++) {
+            unsigned int index = list->blocks[i] - group_first;
+            if ((bitmap[index / 8] >> (index % 8)) & 1) {
+                bitmap[index / 8] &= ~(1 << (index % 8));
+                freed++;
             }
         }
+        if (freed > 0) {
+            write_block(fs, fs->gd[group].bg_inode_bitmap, bitmap);
+            fs->gd[group].bg_free_inodes_count += freed;
+            total += freed;
+        }
+        if (dirs_per_group && dirs_per_group[group] > 0) {
+            unsigned int dirs = dirs_per_group[group];
+            fs->gd[group].bg_used_dirs_count -= (dirs < fs->gd[group].bg_used_dirs_count) ? dirs : fs->gd[group].bg_used_dirs_count;
+        }
+        if (freed > 0 || (dirs_per_group && dirs_per_group[group] > 0)) mark_group_dirty(fs, group);
+        pthread_mutex_unlock(&fs->group_locks[group]);
     }
 
-    free_block_resource(block_ptr);  // Libera o bloco atual
-    free(blocks);
+    __atomic_add_fetch(&fs->free_inodes, total, __ATOMIC_RELAXED);
+    stats_op(fs, EXT2_OP_FREE_INODE, total);
+    return total;
+}
+
+// Zera links e grava i_dtime dos inodes (lista ordenada), uma escrita por
+// bloco da tabela de inodes
+static void mark_inodes_deleted(ext2_fs *fs, const block_list *list) {
+    char table[fs->block_size];
+    uint32_t now = (uint32_t)time(NULL);
+    size_t i = 0;
+
+    while (i < list->count) {
+        uint32_t ino = list->blocks[i];
+        if (ino == 0 || ino > fs->sb.s_inodes_count) {
+            i++;
+            continue;
+        }
+        unsigned int group = (ino - 1) / fs->sb.s_inodes_per_group;
+        unsigned int index = (ino - 1) % fs->sb.s_inodes_per_group;
+        unsigned int block = fs->gd[group].bg_inode_table + index / fs->inodes_per_block;
+        uint32_t first_in_block = ino - index % fs->inodes_per_block;
+
+        pthread_mutex_lock(&fs->group_locks[group]);
+        read_block(fs, block, table);
+        for (; i < list->count && list->blocks[i] < first_in_block + fs->inodes_per_block; i++) {
+            ext2_inode *inode = (ext2_inode *)(table + (list->blocks[i] - first_in_block) * sizeof(ext2_inode));
+            inode->i_links_count = 0;
+            inode->i_dtime = now;
+        }
+        write_block(fs, block, table);
+        pthread_mutex_unlock(&fs->group_locks[group]);
+    }
+}
+
+unsigned int free_block_list(ext2_fs *fs, block_list *list) {
+    return clear_block_bits(fs, list);
+}
+
+unsigned int free_inode_list(ext2_fs *fs, block_list *list, const unsigned int *dirs_per_group) {
+    unsigned int total = clear_inode_bits(fs, list, dirs_per_group);
+    mark_inodes_deleted(fs, list);
+    return total;
+}
+
+// Coleta um bloco indireto de nível `level` e tudo que ele referencia
+static void collect_indirect_blocks(ext2_fs *fs, uint32_t block_ptr, int level, block_list *list) {
+    if (block_ptr == 0 || block_ptr < fs->sb.s_first_data_block) {
+        return;  // Bloco inválido
+    }
+
+    uint32_t blocks[fs->block_size / sizeof(uint32_t)];
+    if (read_block_as(fs, block_ptr, blocks, EXT2_IO_INDIRECT) == 0) {
+        // Ponteiros válidos compactados no próprio buffer (0 < first_data_block)
+        uint32_t min = fs->sb.s_first_data_block ? fs->sb.s_first_data_block : 1;
+        unsigned int n = fs->kern->gather_ptrs(blocks, min, blocks, fs->block_size);
+        for (unsigned int i = 0; i < n; i++) {
+            if (level == 1) block_list_add(list, blocks[i]);  // Nível de dados
+            else collect_indirect_blocks(fs, blocks[i], level - 1, list);
+        }
+    }
+    block_list_add(list, block_ptr);
+}
+
+// Remove da subárvore os blocos lógicos >= keep. Retorna 1 se o próprio bloco
+// indireto ficou vazio (foi coletado e o ponteiro do pai deve ser zerado).
+static int truncate_indirect(ext2_fs *fs, uint32_t block_ptr, int level, uint64_t base, uint64_t keep,
+                             block_list *list) {
+    if (base >= keep) {
+        collect_indirect_blocks(fs, block_ptr, level, list);
+        return 1;
+    }
+
+    unsigned int ptrs = fs->block_size / sizeof(uint32_t);
+    uint64_t span = 1;
+    for (int l = 1; l < level; l++) span *= ptrs;
+
+    uint32_t blocks[ptrs];
+    if (read_block_as(fs, block_ptr, blocks, EXT2_IO_INDIRECT) != 0) return 0;
+
+    int modified = 0;
+    for (unsigned int i = 0; i < ptrs; i++) {
+        uint64_t child_base = base + i * span;
+        if (blocks[i] == 0 || child_base + span <= keep) continue;
+        if (level == 1) {
+            block_list_add(list, blocks[i]);
+            blocks[i] = 0;
+            modified = 1;
+        } else if (truncate_indirect(fs, blocks[i], level - 1, child_base, keep, list)) {
+            blocks[i] = 0;
+            modified = 1;
+        }
+    }
+    if (modified) write_block_as(fs, block_ptr, blocks, EXT2_IO_INDIRECT);
+    return 0;
+}
+
+unsigned int truncate_inode_blocks(ext2_fs *fs, ext2_inode *inode, uint64_t keep_blocks, block_list *list) {
+    size_t before = list->count;
+    unsigned int ptrs = fs->block_size / sizeof(uint32_t);
+
+    // 1. Blocos diretos (0-11)
+    for (uint64_t i = keep_blocks; i < EXT2_NDIR_BLOCKS; i++) {
+        if (inode->i_block[i] != 0) {
+            block_list_add(list, inode->i_block[i]);
+            inode->i_block[i] = 0;
+        }
+    }
+
+    // 2. Indireto simples, duplo e triplo (12, 13 e 14)
+    uint64_t base = EXT2_NDIR_BLOCKS, span = ptrs;
+    for (int level = 1; level <= 3; level++) {
+        int slot = EXT2_IND_BLOCK + level - 1;
+        if (inode->i_block[slot] != 0 &&
+            truncate_indirect(fs, inode->i_block[slot], level, base, keep_blocks, list)) {
+            inode->i_block[slot] = 0;
+        }
+        base += span;
+        span *= ptrs;
+    }
+
+    unsigned int collected = list->count - before;
+    uint32_t sectors = collected * (fs->block_size / 512);
+    inode->i_blocks = (inode->i_blocks > sectors) ? inode->i_blocks - sectors : 0;
+    return collected;
+}
+
+void free_indirect_blocks(ext2_fs *fs, uint32_t block_ptr, int level) {
+    block_list list = {0};
+    collect_indirect_blocks(fs, block_ptr, level, &list);
+    free_block_list(fs, &list);
+    block_list_destroy(&list);
+}
+
+void free_all_blocks(ext2_fs *fs, ext2_inode *inode) {
+    block_list list = {0};
+    truncate_inode_blocks(fs, inode, 0, &list);
+    free_block_list(fs, &list);
+    block_list_destroy(&list);
+}
+
+static int ext2_truncate_locked(ext2_fs *fs, unsigned int inode_num, uint64_t new_size) {
+    ext2_inode inode;
+    if (get_inode(fs, inode_num, &inode) != 0 || (inode.i_mode & EXT2_S_IFMT) != EXT2_S_IFREG) return -1;
+
+    uint64_t old_size = inode_file_size(fs, &inode);
+    uint64_t keep_blocks = (new_size + fs->block_size - 1) / fs->block_size;
+
+    if (new_size < old_size) {
+        // Zera o final do último bloco mantido para que uma extensão futura leia zeros
+        if (new_size % fs->block_size != 0) {
+            uint32_t last = inode_bmap(fs, &inode, new_size / fs->block_size);
+            char buf[fs->block_size];
+            if (last != 0 && read_block(fs, last, buf) == 0) {
+                memset(buf + new_size % fs->block_size, 0, fs->block_size - new_size % fs->block_size);
+                write_data_block(fs, last, buf);
+            }
+        }
+
+        block_list list = {0};
+        truncate_inode_blocks(fs, &inode, keep_blocks, &list);
+        free_block_list(fs, &list);
+        block_list_destroy(&list);
+    }
+
+    time_t now = time(NULL);
+    inode_set_file_size(fs, &inode, new_size);
+    inode.i_mtime = now;
+    inode.i_ctime = now;
+    write_inode(fs, inode_num, &inode);
+    return 0;
+}
+
+int ext2_truncate(ext2_fs *fs, unsigned int inode_num, uint64_t new_size) {
+    ext2_journal_begin(fs);
+    pthread_rwlock_wrlock(inode_lock(fs, inode_num));
+    int ret = ext2_truncate_locked(fs, inode_num, new_size);
+    pthread_rwlock_unlock(inode_lock(fs, inode_num));
+    ext2_journal_end(fs);
+    return ret;
+}
+
+// Estado da remoção recursiva: tudo que será liberado é acumulado aqui
+struct remove_ctx {
+    block_list blocks;
+    block_list inodes;
+    unsigned int *dirs_per_group;
+    unsigned int files;
+    unsigned int dirs;
+};
+
+// Diretório em remoção: o inode e o próximo bloco lógico a ler
+struct remove_frame {
+    unsigned int ino;
+    ext2_inode inode;
+    uint64_t next_block;
+};
+
+// Pilha explícita (no heap): a profundidade da árvore não usa a pilha da thread
+struct remove_stack {
+    struct remove_frame *items;
+    size_t len, cap;
+};
+
+static int remove_push(struct remove_stack *st, unsigned int ino, const ext2_inode *inode) {
+    if (st->len == st->cap) {
+        size_t cap = st->cap ? st->cap * 2 : 16;
+        struct remove_frame *items = realloc(st->items, cap * sizeof(struct remove_frame));
+        if (!items) return -1;
+        st->items = items;
+        st->cap = cap;
+    }
+    st->items[st->len++] = (struct remove_frame){ ino, *inode, 0 };
+    return 0;
+}
+
+// Inode que não é diretório: coletado na hora
+static void remove_collect_file(ext2_fs *fs, unsigned int ino, ext2_inode *inode, struct remove_ctx *c) {
+    // Hard link ainda referenciado fora da subárvore: só decrementa
+    if (inode->i_links_count > 1) {
+        inode->i_links_count--;
+        write_inode(fs, ino, inode);
+        return;
+    }
+
+    // Symlink rápido guarda o destino em i_block, não ponteiros de blocos
+    uint16_t type = inode->i_mode & EXT2_S_IFMT;
+    if (!(type == EXT2_S_IFLNK && inode->i_blocks == 0)) {
+        truncate_inode_blocks(fs, inode, 0, &c->blocks);
+    }
+    block_list_add(&c->inodes, ino);
+    c->files++;
 }
 
-void free_all_blocks(ext2_inode *inode) {
-    // 1. Libera blocos diretos (0-11)
-    for (int i = 0; i < 12 && inode->i_block[i] != 0; i++) {
-        free_block_resource(inode->i_block[i]);
+// Pós-ordem: um diretório só é coletado depois de todos os filhos
+static int remove_collect(ext2_fs *fs, unsigned int ino, struct remove_ctx *c) {
+    ext2_inode inode;
+    if (get_inode(fs, ino, &inode) != 0) return 0;
+    if ((inode.i_mode & EXT2_S_IFMT) != EXT2_S_IFDIR) {
+        remove_collect_file(fs, ino, &inode, c);
+        return 0;
     }
 
-    // 2. Libera indireto simples (bloco 12) - nível 1
-    if (inode->i_block[12] != 0) {
-        free_indirect_blocks(inode->i_block[12], 1);
+    struct remove_stack st = {0};
+    char *block_buf = malloc(fs->block_size);
+    int ret = block_buf && remove_push(&st, ino, &inode) == 0 ? 0 : -1;
+    while (ret == 0 && st.len > 0) {
+        struct remove_frame *top = &st.items[st.len - 1];
+        if (top->next_block >= top->inode.i_size / fs->block_size) {
+            truncate_inode_blocks(fs, &top->inode, 0, &c->blocks);
+            block_list_add(&c->inodes, top->ino);
+            c->dirs_per_group[(top->ino - 1) / fs->sb.s_inodes_per_group]++;
+            c->dirs++;
+            st.len--;
+            continue;
+        }
+
+        uint32_t block_num = inode_bmap(fs, &top->inode, top->next_block++);
+        if (block_num == 0 || read_block_as(fs, block_num, block_buf, EXT2_IO_DIR) != 0) continue;
+
+        // Os subdiretórios do bloco vão para a pilha; o bloco já está lido
+        for (unsigned int offset = 0; offset < fs->block_size;) {
+            ext2_dir_entry_2 *entry = (ext2_dir_entry_2 *)(block_buf + offset);
+            if (entry->rec_len == 0) break;
+            offset += entry->rec_len;
+            int is_dot = (entry->name_len == 1 && entry->name[0] == '.') ||
+                         (entry->name_len == 2 && entry->name[0] == '.' && entry->name[1] == '.');
+            if (entry->inode == 0 || is_dot || get_inode(fs, entry->inode, &inode) != 0) continue;
+            if ((inode.i_mode & EXT2_S_IFMT) != EXT2_S_IFDIR) remove_collect_file(fs, entry->inode, &inode, c);
+            else if (remove_push(&st, entry->inode, &inode) != 0) {
+                ret = -1;
+                break;
+            }
+        }
     }
+    free(st.items);
+    free(block_buf);
+    return ret;
+}
+
+int remove_tree(ext2_fs *fs, unsigned int parent_inode_num, const char *name, unsigned int *files, unsigned int *dirs) {
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) return -1;
 
-    // 3. Libera indireto duplo (bloco 13) - nível 2
-    if (inode->i_block[13] != 0) {
-        free_indirect_blocks(inode->i_block[13], 2);
+    unsigned int target = search_directory(fs, parent_inode_num, name);
+    if (target == 0 || target == EXT2_ROOT_INO) return -1;
+
+    ext2_inode target_inode;
+    get_inode(fs, target, &target_inode);
+    int is_dir = ((target_inode.i_mode & EXT2_S_IFMT) == EXT2_S_IFDIR);
+
+    struct remove_ctx c = {0};
+    c.dirs_per_group = calloc(fs->group_count, sizeof(unsigned int));
+    if (!c.dirs_per_group) return -1;
+
+    // Só a entrada do topo é removida: os diretórios internos somem inteiros.
+    // Depois disso a subárvore fica inalcançável e pode ser coletada sem locks
+    // de diretório (se outra thread removeu a entrada antes, falha aqui).
+    ext2_journal_begin(fs);
+    if (remove_dir_entry(fs, parent_inode_num, name) != 0) {
+        ext2_journal_end(fs);
+        free(c.dirs_per_group);
+        return -1;
     }
 
+    // Sem memória, o que foi coletado ainda é liberado; o resto da subárvore
+    // fica sem entrada (órfão para o check)
+    int ret = remove_collect(fs, target, &c);
+
+    // Bitmaps de blocos e inodes uma vez por grupo; descritores só marcados
+    clear_block_bits(fs, &c.blocks);
+    clear_inode_bits(fs, &c.inodes, c.dirs_per_group);
+    mark_inodes_deleted(fs, &c.inodes);
+
+    if (is_dir) {
+        ext2_inode parent_inode;
+        pthread_rwlock_wrlock(inode_lock(fs, parent_inode_num));
+        get_inode(fs, parent_inode_num, &parent_inode);
+        parent_inode.i_links_count--;
+        write_inode(fs, parent_inode_num, &parent_inode);
+        pthread_rwlock_unlock(inode_lock(fs, parent_inode_num));
+    }
+    ext2_journal_end(fs);
+
+    if (files) *files = c.files;
+    if (dirs) *dirs = c.dirs;
+
+    block_list_destroy(&c.blocks);
+    block_list_destroy(&c.inodes);
+    free(c.dirs_per_group);
+    return ret;
 }
 
-bool is_directory_empty(unsigned int dir_inode_num) {
+
+bool is_directory_empty(ext2_fs *fs, unsigned int dir_inode_num) {
     ext2_inode dir_inode;
-    get_inode(dir_inode_num, &dir_inode);
+    get_inode(fs, dir_inode_num, &dir_inode);
 
-    char block[block_size];
-    read_block(dir_inode.i_block[0], block);
+    char block[fs->block_size];
+    read_block_as(fs, dir_inode.i_block[0], block, EXT2_IO_DIR);
 
     int entry_count = 0;
     unsigned int offset = 0;
 
-    while (offset < block_size) {
+    while (offset < fs->block_size) {
         ext2_dir_entry_2 *entry = (ext2_dir_entry_2 *)(block + offset);
         
         // Fim das entradas válidas
@@ -10,22 +10,37 @@
 #include <stdbool.h>
 
 
-// Variáveis globais
-extern FILE *disk_image;
-extern ext2_super_block sb;
-extern ext2_group_desc *gd;
-extern unsigned int block_size;
-extern unsigned int inodes_per_block;
-extern unsigned int group_count;
+// Handle de um sistema de arquivos aberto (estrutura opaca).
+// Cada handle tem seu próprio descritor de arquivo e sua própria cópia do
+// superbloco e dos descritores de grupo; todas as funções da biblioteca
+// recebem o handle como primeiro parâmetro, de modo que um processo pode
+// abrir várias imagens e várias threads podem compartilhar um mesmo handle.
+// Os locks são por grupo de blocos (bitmaps e contadores) e por diretório
+// (leitura compartilhada em search_directory, exclusiva ao alterar entradas),
+// então threads que alocam em grupos ou diretórios diferentes não se bloqueiam.
+typedef struct ext2_fs ext2_fs;
 
 /*
-function: Escreve um bloco de dados no disco.
+function: Escreve um bloco de metadados no disco.
 param:
   - block_num: Número do bloco a ser escrito.
   - buffer: Ponteiro para os dados a serem escritos.
 return: void (erros são tratados via perror).
+observações:
+  - Com o journal ligado, o bloco entra na transação em andamento.
+*/
+void write_block(ext2_fs *fs, unsigned int block_num, const void *buffer);
+
+/*
+function: Escreve um bloco de conteúdo de arquivo direto na imagem.
+param:
+  - block_num: Número do bloco a ser escrito.
+  - buffer: Ponteiro para os dados a serem escritos.
+return: void (erros são tratados via perror).
+observações:
+  - Não passa pelo journal; versões antigas do bloco como metadado são revogadas.
 */
-void write_block(unsigned int block_num, const void *buffer);
+void write_data_block(ext2_fs *fs, unsigned int block_num, const void *buffer);
 
 /*
 function: Lê um bloco de dados do disco.
@@ -35,39 +50,132 @@ param:
 return: 
   - 0 em caso de sucesso, -1 em caso de erro.
 */
-int read_block(unsigned int block_num, void *buffer);
+int read_block(ext2_fs *fs, unsigned int block_num, void *buffer);
+
+// Categorias de bloco das estatísticas de E/S (ext2_stats.h)
+enum ext2_io_cat {
+    EXT2_IO_SUPER,      // Superbloco (e cópias)
+    EXT2_IO_GDT,        // Descritores de grupo (e cópias, reservados)
+    EXT2_IO_BITMAP,     // Bitmaps de blocos e de inodes
+    EXT2_IO_INODE,      // Tabelas de inodes
+    EXT2_IO_DIR,        // Blocos de diretório
+    EXT2_IO_DATA,       // Conteúdo de arquivos
+    EXT2_IO_INDIRECT,   // Blocos indiretos
+    EXT2_IO_JOURNAL,    // Arquivo de journal
+    EXT2_IO_NCATS
+};
+
+/*
+function: Versões de read_block() e write_block() que informam o conteúdo do bloco.
+param:
+  - cat: EXT2_IO_DIR, EXT2_IO_DATA ou EXT2_IO_INDIRECT.
+return:
+  - Como read_block() e write_block().
+observações:
+  - Só muda a contabilidade: superbloco, descritores, bitmaps e tabelas de
+    inodes são reconhecidos pelo número do bloco. Sem categoria, read_block()
+    conta o bloco como dados e write_block() como diretório.
+*/
+int read_block_as(ext2_fs *fs, unsigned int block_num, void *buffer, enum ext2_io_cat cat);
+void write_block_as(ext2_fs *fs, unsigned int block_num, const void *buffer, enum ext2_io_cat cat);
 
 /*
 function: Escreve o superbloco EXT2 no disco (offset fixo de 1024 bytes).
-param: void (usa a variável global `sb`).
+param: void (usa o superbloco em memória do handle).
 return: void.
+observações:
+  - Com o journal (ou com o adiamento), só marca o superbloco: ele entra na
+    próxima transação (ou em ext2_flush_metadata()).
 */
-void write_superblock();
+void write_superblock(ext2_fs *fs);
 
+/*
+function: Escreve a tabela de descritores de grupo no disco.
+param: void (usa os descritores em memória do handle).
+return: void.
+observações:
+  - Marca a tabela inteira; a gravação segue a regra de write_superblock().
+  - Alocações e liberações não a chamam: marcam só o bloco da GDT do grupo
+    alterado e o superbloco, cujos contadores globais vêm dos atômicos do
+    handle. Esses blocos vão ao disco em ext2_flush_metadata() (sem journal)
+    ou no commit da transação (com journal).
+*/
+void write_group_descriptors(ext2_fs *fs);
 
 /*
-function: Escreve o superbloco EXT2 no disco (offset fixo de 1024 bytes).
-param: void (usa a variável global `sb`).
+function: Liga ou desliga o adiamento da gravação de superbloco e descritores.
+param:
+  - enabled: 1 para adiar, 0 para voltar a gravar imediatamente.
+return: void.
+observações:
+  - Com o adiamento ligado, write_superblock() e write_group_descriptors()
+    apenas marcam os metadados como sujos; a gravação acontece em
+    ext2_flush_metadata(), ao desligar o adiamento ou em ext2_exit().
+  - Bitmaps, inodes e dados continuam sendo gravados na hora.
+*/
+void ext2_set_deferred_flush(ext2_fs *fs, int enabled);
+
+/*
+function: Liga ou desliga as barreiras de ordem de gravação.
+param:
+  - enabled: 1 para forçar a ordem dados -> metadados -> superbloco/GDT.
 return: void.
+observações:
+  - Desligadas por padrão. Ligadas, cada etapa termina com um fdatasync da
+    imagem antes da seguinte: no flush de arquivos (dados antes dos indiretos
+    e do inode), no checkpoint do journal e em ext2_flush_metadata().
+  - Com o journal, a ordem dados -> commit já é garantida pelo modo ordenado;
+    a barreira só afeta a cópia dos metadados para a imagem no checkpoint.
 */
-void write_superblock(); 
+void ext2_set_write_barriers(ext2_fs *fs, int enabled);
 
+/*
+function: Grava o superbloco e os descritores de grupo pendentes, se houver.
+return: void.
+*/
+void ext2_flush_metadata(ext2_fs *fs);
 
 /*
-function: Inicializa o acesso ao sistema de arquivos EXT2.
+function: Abre uma imagem EXT2 e cria o handle do sistema de arquivos.
 param:
   - image_path: Caminho para a imagem do disco.
 return: 
-  - 0 em sucesso, -1 em erro (ex: magic number inválido).
+  - Handle aberto ou NULL em erro (ex: magic number inválido).
 */
-int ext2_init(const char *image_path);
+ext2_fs *ext2_init(const char *image_path);
 
 /*
-function: Libera recursos e fecha a imagem do disco.
-param: void.
+function: Libera recursos do handle e fecha a imagem do disco.
+param:
+  - fs: Handle retornado por ext2_init().
 return: void.
 */
-void ext2_exit();
+void ext2_exit(ext2_fs *fs);
+
+/*
+function: Acesso somente leitura ao superbloco em memória.
+return: Ponteiro válido enquanto o handle estiver aberto.
+*/
+const ext2_super_block *ext2_superblock(ext2_fs *fs);
+
+/*
+function: Tamanho do bloco do sistema de arquivos, em bytes.
+*/
+unsigned int ext2_block_size(ext2_fs *fs);
+
+/*
+function: Quantidade de grupos de blocos.
+*/
+unsigned int ext2_group_count(ext2_fs *fs);
+
+/*
+function: Ajusta o contador de diretórios (bg_used_dirs_count) do grupo de um inode.
+param:
+  - inode_num: Inode do diretório criado ou removido.
+  - delta: +1 ao criar, -1 ao remover.
+return: void (marca o descritor do grupo).
+*/
+void adjust_used_dirs(ext2_fs *fs, unsigned int inode_num, int delta);
 
 /*
 function: Lê um inode do disco.
@@ -77,7 +185,7 @@ param:
 return: 
   - 0 em sucesso, -1 se o inode for inválido.
 */
-int get_inode(unsigned int inode_num, ext2_inode *inode_buf);
+int get_inode(ext2_fs *fs, unsigned int inode_num, ext2_inode *inode_buf);
 
 /*
 function: Escreve um inode no disco.
@@ -86,7 +194,28 @@ param:
   - inode_buf: Ponteiro para os dados do inode.
 return: void.
 */
-void write_inode(unsigned int inode_num, const ext2_inode *inode_buf);
+void write_inode(ext2_fs *fs, unsigned int inode_num, const ext2_inode *inode_buf);
+
+/*
+function: Calcula o caminho de um bloco lógico no mapa de blocos do inode.
+param:
+  - logical_block: Índice lógico do bloco no arquivo.
+  - idx: Saída com o índice em cada nível de indireção (do mais externo ao mais interno).
+return: 
+  - 0 para bloco direto (idx[0] = posição em i_block), 1/2/3 para indireto
+    simples/duplo/triplo, ou -1 se o bloco estiver além do triplo indireto.
+*/
+int inode_block_path(ext2_fs *fs, uint64_t logical_block, uint32_t idx[3]);
+
+/*
+function: Traduz um bloco lógico do arquivo para o bloco físico.
+param:
+  - inode: Inode do arquivo.
+  - logical_block: Índice lógico do bloco.
+return: 
+  - Número do bloco físico ou 0 se for um buraco / fora do mapa.
+*/
+uint32_t inode_bmap(ext2_fs *fs, const ext2_inode *inode, uint64_t logical_block);
 
 /*
 function: Aloca um inode livre.
@@ -94,7 +223,7 @@ param: void.
 return: 
   - Número do inode alocado (1-based) ou 0 se não houver espaço.
 */
-unsigned int alloc_inode();
+unsigned int alloc_inode(ext2_fs *fs);
 
 /*
 function: Libera um inode (marca como livre no bitmap).
@@ -102,7 +231,7 @@ param:
   - inode_num: Número do inode (1-based).
 return: void.
 */
-void free_inode_resource(unsigned int inode_num);
+void free_inode_resource(ext2_fs *fs, unsigned int inode_num);
 
 
 /*
@@ -111,7 +240,21 @@ param: void.
 return: 
   - Número do bloco alocado ou 0 se não houver espaço.
 */
-unsigned int alloc_block();
+unsigned int alloc_block(ext2_fs *fs);
+
+/*
+function: Aloca um trecho de blocos contíguos.
+param:
+  - goal: Bloco preferido para o início do trecho (ex: após o último bloco do arquivo).
+  - count: Quantidade de blocos desejada.
+  - got: Saída com a quantidade de blocos efetivamente alocada (pode ser < count).
+return: 
+  - Primeiro bloco do trecho alocado ou 0 se não houver espaço.
+observações:
+  - Se não existir trecho livre com `count` blocos, aloca o maior trecho encontrado.
+  - O bitmap é gravado uma única vez; descritor e superbloco são marcados.
+*/
+unsigned int alloc_block_run(ext2_fs *fs, unsigned int goal, unsigned int count, unsigned int *got);
 
 /*
 function: Libera um bloco (marca como livre no bitmap).
@@ -119,7 +262,7 @@ param:
   - block_num: Número do bloco.
 return: void.
 */
-void free_block_resource(unsigned int block_num);
+void free_block_resource(ext2_fs *fs, unsigned int block_num);
 
 /*
 function: Busca um arquivo/diretório em um diretório.
@@ -129,7 +272,7 @@ param:
 return: 
   - Número do inode do arquivo/diretório encontrado ou 0 se não existir.
 */
-unsigned int search_directory(unsigned int dir_inode_num, const char *name);
+unsigned int search_directory(ext2_fs *fs, unsigned int dir_inode_num, const char *name);
 
 
 /*
@@ -140,7 +283,7 @@ param:
 return: 
   - Número do inode correspondente ou 0 se não encontrado.
 */
-unsigned int find_inode_by_path(const char *path, unsigned int start_inode_num);
+unsigned int find_inode_by_path(ext2_fs *fs, const char *path, unsigned int start_inode_num);
 
 /*
 function: Lê o superbloco EXT2 do disco.
@@ -148,18 +291,21 @@ param:
   - sb: Ponteiro para armazenar o superbloco lido.
 return: 
   - 0 em sucesso, -1 em erro (ex: magic inválido).
+observações:
+  - Os contadores de livres vêm do handle: no disco, eles só são atualizados
+    no flush ou no commit do journal.
 */
-int read_superblock(ext2_super_block *sb);
+int read_superblock(ext2_fs *fs, ext2_super_block *sb);
 
 /*
-function: Lê um descritor de grupo do disco.
+function: Lê um descritor de grupo (cópia em memória do handle, a mais atual).
 param:
   - group_num: Número do grupo.
   - desc: Ponteiro para armazenar o descritor lido.
 return: 
   - 0 em sucesso, -1 em erro.
 */
-int read_group_desc(uint32_t group_num, ext2_group_desc *desc);
+int read_group_desc(ext2_fs *fs, uint32_t group_num, ext2_group_desc *desc);
 
 /*
 function: Adiciona uma entrada a um diretório.
@@ -170,8 +316,11 @@ param:
   - file_type: Tipo (arquivo, diretório, etc.).
 return: 
   - 0 em sucesso, -1 em erro (ex: sem espaço).
+observações:
+  - Atualiza i_mtime e i_ctime do diretório pai (o verify usa essas datas
+    para achar os grupos alterados).
 */
-int add_dir_entry(unsigned int parent_inode_num, unsigned int new_inode_num, const char *name, uint8_t file_type);
+int add_dir_entry(ext2_fs *fs, unsigned int parent_inode_num, unsigned int new_inode_num, const char *name, uint8_t file_type);
 
 
 /*
@@ -183,7 +332,7 @@ return:
   - 0 em caso de sucesso.
   - -1 em caso de erro (inode inválido, falha de leitura, etc.).
 */
-int read_inode(uint32_t inode_num, ext2_inode *inode_out);
+int read_inode(ext2_fs *fs, uint32_t inode_num, ext2_inode *inode_out);
 
 /*
 function: Remove uma entrada de um diretório.
@@ -192,8 +341,10 @@ param:
   - name_to_remove: Nome da entrada a ser removida.
 return: 
   - 0 em sucesso, -1 se a entrada não for encontrada.
+observações:
+  - Atualiza i_mtime e i_ctime do diretório pai, como add_dir_entry.
 */
-int remove_dir_entry(unsigned int parent_inode_num, const char *name_to_remove);
+int remove_dir_entry(ext2_fs *fs, unsigned int parent_inode_num, const char *name_to_remove);
 
 /*
 função: Copia dados de um bloco do sistema de arquivos para um arquivo externo.
@@ -208,41 +359,192 @@ observações:
   - Lida automaticamente com gravações parciais de blocos.
   - Atualiza bytes_remaining durante a cópia.
 */
-void copy_block_to_file(uint32_t block_num, FILE *dest_file,
-                      unsigned int *bytes_remaining, char *block_buf);
+void copy_block_to_file(ext2_fs *fs, uint32_t block_num, FILE *dest_file,
+                      uint64_t *bytes_remaining, char *block_buf);
+
+/*
+função: Callback chamado para cada bloco de dados durante walk_file_blocks().
+parâmetros:
+  - block_num: Bloco físico (0 indica um buraco no arquivo).
+  - logical_block: Índice lógico do bloco dentro do arquivo.
+  - ctx: Contexto do chamador.
+retorno: 0 para continuar, diferente de 0 para interromper o percurso.
+*/
+typedef int (*block_walk_fn)(ext2_fs *fs, uint32_t block_num, uint64_t logical_block, void *ctx);
+
+/*
+função: Percorre em ordem lógica os blocos de dados de um inode.
+parâmetros:
+  - inode: Inode cujo mapa de blocos será percorrido.
+  - max_blocks: Quantidade de blocos lógicos a visitar (ex: tamanho / block_size).
+  - fn: Callback chamado para cada bloco.
+  - ctx: Contexto repassado ao callback.
+retorno: 0 ao final, 1 se o callback interrompeu, -1 em erro de leitura.
+observações:
+  - Segue blocos diretos, indireto simples, duplo e triplo.
+*/
+int walk_file_blocks(ext2_fs *fs, const ext2_inode *inode, uint64_t max_blocks, block_walk_fn fn, void *ctx);
+
+/*
+função: Copia todo o conteúdo de um inode para um arquivo/stream do host.
+parâmetros:
+  - inode: Inode do arquivo de origem.
+  - dest_file: Stream de destino (ex: stdout ou arquivo aberto).
+retorno: 0 em sucesso, -1 em erro.
+*/
+int copy_inode_to_file(ext2_fs *fs, const ext2_inode *inode, FILE *dest_file);
+
+/*
+função: Retorna o tamanho completo (64 bits) de um inode.
+parâmetros:
+  - inode: Inode a ser consultado.
+retorno: i_size combinado com i_dir_acl (bits altos) para arquivos regulares
+         quando a feature large_file está ativa.
+*/
+uint64_t inode_file_size(ext2_fs *fs, const ext2_inode *inode);
+
+/*
+função: Define o tamanho completo (64 bits) de um inode.
+parâmetros:
+  - inode: Inode a ser atualizado.
+  - size: Novo tamanho em bytes.
+retorno: void
+observações:
+  - Ativa a feature large_file no superbloco se o tamanho passar de 2 GiB.
+*/
+void inode_set_file_size(ext2_fs *fs, ext2_inode *inode, uint64_t size);
+
+// Lista dinâmica de blocos físicos (usada para liberar blocos em lote)
+typedef struct {
+    uint32_t *blocks;
+    size_t count;
+    size_t cap;
+} block_list;
+
+/*
+função: Acrescenta um bloco à lista.
+parâmetros:
+  - list: Lista de blocos (inicializar com {0}).
+  - block_num: Bloco físico.
+retorno: 0 em sucesso, -1 se faltar memória.
+*/
+int block_list_add(block_list *list, uint32_t block_num);
+
+/*
+função: Libera a memória da lista (não altera os bitmaps).
+parâmetros:
+  - list: Lista de blocos.
+retorno: void
+*/
+void block_list_destroy(block_list *list);
+
+/*
+função: Libera no bitmap todos os blocos da lista, em lote.
+parâmetros:
+  - list: Lista de blocos (é ordenada no lugar).
+retorno: Quantidade de blocos efetivamente liberados.
+observações:
+  - Ordena os blocos e agrupa por grupo de blocos: cada bitmap é lido e gravado
+    uma única vez; os descritores dos grupos tocados são marcados.
+  - Blocos já livres não alteram os contadores.
+*/
+unsigned int free_block_list(ext2_fs *fs, block_list *list);
+
+/*
+function: Aloca vários inodes de uma vez.
+param:
+  - count: Quantidade desejada.
+  - goal_group: Grupo preferido; os seguintes são usados quando ele enche.
+  - list: Lista onde os números dos inodes alocados são acrescentados.
+return:
+  - Quantidade de inodes alocados (< count se faltar espaço).
+observações:
+  - Cada bitmap é lido e gravado uma vez; os descritores tocados são marcados.
+*/
+unsigned int alloc_inode_list(ext2_fs *fs, unsigned int count, unsigned int goal_group, block_list *list);
+
+/*
+função: Libera no bitmap de inodes todos os inodes da lista, em lote.
+parâmetros:
+  - list: Lista de números de inode (é ordenada no lugar).
+  - dirs_per_group: Quantidade de diretórios removidos por grupo (ajusta
+    bg_used_dirs_count) ou NULL.
+retorno: Quantidade de inodes efetivamente liberados.
+observações:
+  - Cada bitmap é lido e gravado uma vez; os descritores tocados são marcados.
+  - Os inodes recebem i_links_count = 0 e i_dtime, com uma escrita por bloco da tabela.
+*/
+unsigned int free_inode_list(ext2_fs *fs, block_list *list, const unsigned int *dirs_per_group);
+
+/*
+função: Remove do mapa de blocos do inode todos os blocos lógicos >= keep_blocks.
+parâmetros:
+  - inode: Inode a ser truncado (i_block e i_blocks são atualizados).
+  - keep_blocks: Quantidade de blocos lógicos mantidos.
+  - list: Lista onde os blocos físicos removidos (dados e indiretos) são coletados.
+retorno: Quantidade de blocos coletados.
+observações:
+  - Percorre todos os níveis de indireção, inclusive o triplo.
+  - Blocos indiretos parcialmente mantidos são regravados; os que ficam vazios são coletados.
+  - Não altera bitmaps: use free_block_list() em seguida.
+*/
+unsigned int truncate_inode_blocks(ext2_fs *fs, ext2_inode *inode, uint64_t keep_blocks, block_list *list);
 
 /*
 função: Libera recursivamente blocos indiretos e seus blocos referenciados.
 parâmetros:
   - block_ptr: Bloco inicial a ser liberado.
-  - level: Nível de indireção (1=simples, 2=duplo, etc.).
+  - level: Nível de indireção (1=simples, 2=duplo, 3=triplo).
 retorno: void
-comportamento:
-  - Nível 1: Libera blocos de dados diretamente.
-  - Nível >1: Processa blocos de ponteiros recursivamente.
-  - Sempre libera o block_ptr após processamento.
 observações:
+  - Coleta todos os blocos e os libera em lote com free_block_list().
   - Ignora blocos inválidos (< s_first_data_block).
-  - Aloca buffer temporário para leitura de blocos.
 */
-void free_indirect_blocks(uint32_t block_ptr, int level);
+void free_indirect_blocks(ext2_fs *fs, uint32_t block_ptr, int level);
 
 /*
 função: Libera todos os blocos associados a um inode.
 parâmetros:
   - inode: Ponteiro para a estrutura inode contendo blocos.
 retorno: void
-etapas:
-  1. Libera 12 blocos diretos (i_block[0-11])
-  2. Processa bloco indireto simples (i_block[12])
-  3. Processa bloco indireto duplo (i_block[13])
-  4. (Opcional) Suporte para bloco indireto triplo (i_block[14])
 observações:
-  - Usa free_indirect_blocks() para blocos indiretos.
-  - Ignora ponteiros de bloco nulos com segurança.
+  - Equivale a truncate_inode_blocks(inode, 0) + free_block_list().
+  - Cada bitmap tocado é gravado uma vez; os descritores tocados são marcados.
+*/
+void free_all_blocks(ext2_fs *fs, ext2_inode *inode);
+
+/*
+função: Altera o tamanho de um arquivo regular.
+parâmetros:
+  - inode_num: Inode do arquivo.
+  - new_size: Novo tamanho em bytes.
+retorno: 0 em sucesso, -1 se o inode for inválido ou não for arquivo regular.
+observações:
+  - Ao reduzir, libera em lote os blocos além do novo tamanho.
+  - Ao aumentar, apenas ajusta o tamanho (a região nova é um buraco).
+*/
+int ext2_truncate(ext2_fs *fs, unsigned int inode_num, uint64_t new_size);
+
+/*
+função: Remove recursivamente uma entrada (arquivo ou árvore de diretórios).
+parâmetros:
+  - parent_inode_num: Inode do diretório pai.
+  - name: Nome da entrada no diretório pai.
+  - files: Saída com o número de arquivos removidos (pode ser NULL).
+  - dirs: Saída com o número de diretórios removidos (pode ser NULL).
+retorno: 0 em sucesso, -1 se a entrada não existir ou for ".", ".." ou a raiz.
+  -1 também se faltar memória no percurso: a entrada já foi removida e só a
+  parte coletada é liberada.
+observações:
+  - Percorre a árvore em pós-ordem acumulando inodes e blocos liberados. A
+    pilha de diretórios fica no heap: a profundidade da árvore não é limitada
+    pela pilha da thread.
+  - Apenas a entrada do topo é removida do pai; as entradas internas somem
+    junto com os blocos dos diretórios, sem regravação por filho.
+  - Bitmaps são atualizados uma vez por grupo; os descritores tocados são marcados.
 */
-void free_all_blocks(ext2_inode *inode);
+int remove_tree(ext2_fs *fs, unsigned int parent_inode_num, const char *name, unsigned int *files, unsigned int *dirs);
 
-bool is_directory_empty(unsigned int dir_inode_num);
+bool is_directory_empty(ext2_fs *fs, unsigned int dir_inode_num);
 
 #endif
\ No newline at end of file
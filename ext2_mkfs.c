@@ -0,0 +1,337 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "ext2_fs.h"
+
+// Cria uma imagem EXT2 vazia (raiz e lost+found), no formato aceito pelo
+// e2fsck. Só os blocos com conteúdo são gravados: em arquivo regular a imagem
+// é esparsa e as tabelas de inodes são buracos (lidos como zero), então o
+// tempo não depende do tamanho da imagem.
+
+#define MKFS_INODE_SIZE   128
+#define MKFS_FIRST_INO    11
+#define MKFS_LPF_INO      11
+#define MKFS_ZERO_CHUNK   (4 * 1024 * 1024)
+
+struct mkfs_geometry {
+    uint32_t block_size;
+    uint32_t blocks_count;
+    uint32_t first_data_block;
+    uint32_t blocks_per_group;
+    uint32_t group_count;
+    uint32_t inodes_per_group;
+    uint32_t inode_table_blocks;
+    uint32_t gdt_blocks;
+    uint32_t lpf_blocks;
+};
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [-b <bloco>] [-i <bytes_por_inode>] [-L <rótulo>] [-P] <imagem> <tamanho[K|M|G|T]>\n", prog);
+    fprintf(stderr, "  -b  Tamanho do bloco: 1024, 2048 ou 4096 (padrão: 4096 a partir de 512M)\n");
+    fprintf(stderr, "  -i  Bytes de dados por inode (padrão: 16384)\n");
+    fprintf(stderr, "  -P  Reserva o espaço da imagem no host com fallocate (sem buracos)\n");
+}
+
+static uint64_t parse_size(const char *s) {
+    char *end;
+    uint64_t v = strtoull(s, &end, 10);
+    switch (*end) {
+        case 'T': case 't': v <<= 10; // fallthrough
+        case 'G': case 'g': v <<= 10; // fallthrough
+        case 'M': case 'm': v <<= 10; // fallthrough
+        case 'K': case 'k': v <<= 10; end++; break;
+        case '\0': break;
+        default: return 0;
+    }
+    return *end == '\0' ? v : 0;
+}
+
+static int group_has_super(uint32_t group) {
+    if (group <= 1) return 1;
+    for (uint32_t base = 3; base <= 7; base += 2) {
+        uint32_t n = group;
+        while (n % base == 0) n /= base;
+        if (n == 1) return 1;
+    }
+    return 0;
+}
+
+static uint32_t group_first(const struct mkfs_geometry *g, uint32_t group) {
+    return g->first_data_block + group * g->blocks_per_group;
+}
+
+// Blocos de metadados no início do grupo (cópia do superbloco/GDT, bitmaps e tabela)
+static uint32_t group_overhead(const struct mkfs_geometry *g, uint32_t group) {
+    return (group_has_super(group) ? 1 + g->gdt_blocks : 0) + 2 + g->inode_table_blocks;
+}
+
+static int compute_geometry(struct mkfs_geometry *g, uint64_t size, uint32_t inode_ratio) {
+    uint32_t bs = g->block_size;
+    uint64_t blocks = size / bs;
+    if (blocks > UINT32_MAX) {
+        fprintf(stderr, "mkfs: imagem grande demais para blocos de %u bytes\n", bs);
+        return -1;
+    }
+    g->blocks_count = (uint32_t)blocks;
+    g->first_data_block = bs == 1024 ? 1 : 0;
+    g->blocks_per_group = bs * 8;
+    g->lpf_blocks = 16384 / bs < EXT2_NDIR_BLOCKS ? 16384 / bs : EXT2_NDIR_BLOCKS;
+
+    for (;;) {
+        g->group_count = (g->blocks_count - g->first_data_block + g->blocks_per_group - 1) / g->blocks_per_group;
+        if (g->group_count == 0) break;
+        g->gdt_blocks = (g->group_count * sizeof(ext2_group_desc) + bs - 1) / bs;
+
+        uint32_t per_block = bs / MKFS_INODE_SIZE;
+        uint64_t inodes = (uint64_t)g->blocks_count * bs / inode_ratio;
+        uint64_t ipg = (inodes + g->group_count - 1) / g->group_count;
+        if (ipg < 16) ipg = 16;
+        ipg = (ipg + per_block - 1) / per_block * per_block; // Tabela ocupa blocos inteiros
+        if (ipg > bs * 8) ipg = bs * 8;                      // Um bloco de bitmap por grupo
+        g->inodes_per_group = (uint32_t)ipg;
+        g->inode_table_blocks = g->inodes_per_group / per_block;
+
+        // Último grupo pequeno demais para os próprios metadados: fica de fora
+        uint32_t last = g->group_count - 1;
+        uint32_t last_blocks = g->blocks_count - group_first(g, last);
+        if (g->group_count > 1 && last_blocks < group_overhead(g, last) + 50) {
+            g->blocks_count = group_first(g, last);
+            continue;
+        }
+        break;
+    }
+
+    uint32_t root_needs = group_overhead(g, 0) + 1 + g->lpf_blocks;
+    if (g->group_count == 0 || g->blocks_count - g->first_data_block < root_needs + 16) {
+        fprintf(stderr, "mkfs: imagem pequena demais\n");
+        return -1;
+    }
+    return 0;
+}
+
+static void set_bit(uint8_t *map, uint32_t bit) {
+    map[bit >> 3] |= 1 << (bit & 7);
+}
+
+static void fill_inode_dir(ext2_inode *inode, uint16_t mode, uint16_t links, uint32_t bs,
+                           uint32_t first_block, uint32_t nblocks, uint32_t now) {
+    memset(inode, 0, sizeof(*inode));
+    inode->i_mode = EXT2_S_IFDIR | mode;
+    inode->i_links_count = links;
+    inode->i_size = nblocks * bs;
+    inode->i_blocks = nblocks * (bs / 512);
+    inode->i_atime = inode->i_ctime = inode->i_mtime = now;
+    for (uint32_t i = 0; i < nblocks; i++) inode->i_block[i] = first_block + i;
+}
+
+// Acrescenta uma entrada em `buf`; a última ocupa o restante do bloco
+static uint32_t put_entry(char *buf, uint32_t off, uint32_t inode, const char *name, uint32_t rec_len) {
+    ext2_dir_entry_2 *de = (ext2_dir_entry_2 *)(buf + off);
+    de->inode = inode;
+    de->rec_len = rec_len;
+    de->name_len = strlen(name);
+    de->file_type = EXT2_FT_DIR;
+    memcpy(de->name, name, de->name_len);
+    return off + rec_len;
+}
+
+static int write_all(int fd, const void *buf, size_t len, off_t offset) {
+    if (pwrite(fd, buf, len, offset) != (ssize_t)len) {
+        perror("mkfs: pwrite");
+        return -1;
+    }
+    return 0;
+}
+
+// Zera um intervalo com gravações grandes (dispositivos, onde não há buracos)
+static int zero_range(int fd, off_t offset, off_t len) {
+    static char zeros[MKFS_ZERO_CHUNK];
+    while (len > 0) {
+        size_t n = len < MKFS_ZERO_CHUNK ? (size_t)len : MKFS_ZERO_CHUNK;
+        if (write_all(fd, zeros, n, offset) != 0) return -1;
+        offset += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static void random_uuid(uint8_t uuid[16]) {
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0 || read(fd, uuid, 16) != 16) {
+        srand(time(NULL) ^ getpid());
+        for (int i = 0; i < 16; i++) uuid[i] = rand();
+    }
+    if (fd >= 0) close(fd);
+    uuid[6] = (uuid[6] & 0x0F) | 0x40; // Versão 4
+    uuid[8] = (uuid[8] & 0x3F) | 0x80;
+}
+
+int main(int argc, char *argv[]) {
+    const char *image = NULL, *size_arg = NULL, *label = "";
+    uint32_t block_size = 0, inode_ratio = 16384;
+    int prealloc = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) block_size = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) inode_ratio = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-L") == 0 && i + 1 < argc) label = argv[++i];
+        else if (strcmp(argv[i], "-P") == 0) prealloc = 1;
+        else if (!image && argv[i][0] != '-') image = argv[i];
+        else if (!size_arg && argv[i][0] != '-') size_arg = argv[i];
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    uint64_t size = size_arg ? parse_size(size_arg) : 0;
+    if (!image || size == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (block_size == 0) block_size = size >= 512ULL * 1024 * 1024 ? 4096 : 1024;
+    if ((block_size != 1024 && block_size != 2048 && block_size != 4096) || inode_ratio < block_size) {
+        fprintf(stderr, "mkfs: bloco deve ser 1024, 2048 ou 4096 e bytes_por_inode >= bloco\n");
+        return 1;
+    }
+
+    struct mkfs_geometry g = { .block_size = block_size };
+    if (compute_geometry(&g, size, inode_ratio) != 0) return 1;
+    uint32_t bs = g.block_size;
+    uint32_t now = (uint32_t)time(NULL);
+
+    int fd = open(image, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(image);
+        return 1;
+    }
+
+    // Arquivo regular: recriado vazio, tudo o que não for gravado é buraco (zero)
+    int sparse = S_ISREG(st.st_mode);
+    off_t image_len = (off_t)g.blocks_count * bs;
+    if (sparse) {
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, image_len) != 0) {
+            perror("mkfs: ftruncate");
+            return 1;
+        }
+        if (prealloc && fallocate(fd, 0, 0, image_len) != 0) perror("mkfs: fallocate (imagem continua esparsa)");
+    }
+
+    // Descritores e contadores
+    ext2_group_desc *gd = calloc(g.gdt_blocks, bs);
+    uint32_t free_blocks = 0, free_inodes = 0;
+    uint32_t root_block = group_first(&g, 0) + group_overhead(&g, 0);
+    for (uint32_t grp = 0; grp < g.group_count; grp++) {
+        uint32_t first = group_first(&g, grp);
+        uint32_t meta = first + (group_has_super(grp) ? 1 + g.gdt_blocks : 0);
+        uint32_t nblocks = g.blocks_count - first < g.blocks_per_group ? g.blocks_count - first : g.blocks_per_group;
+        uint32_t used = group_overhead(&g, grp) + (grp == 0 ? 1 + g.lpf_blocks : 0);
+
+        gd[grp].bg_block_bitmap = meta;
+        gd[grp].bg_inode_bitmap = meta + 1;
+        gd[grp].bg_inode_table = meta + 2;
+        gd[grp].bg_free_blocks_count = nblocks - used;
+        gd[grp].bg_free_inodes_count = g.inodes_per_group - (grp == 0 ? MKFS_FIRST_INO : 0);
+        gd[grp].bg_used_dirs_count = grp == 0 ? 2 : 0;
+        free_blocks += gd[grp].bg_free_blocks_count;
+        free_inodes += gd[grp].bg_free_inodes_count;
+    }
+
+    // Superbloco
+    ext2_super_block sb = {0};
+    sb.s_inodes_count = g.inodes_per_group * g.group_count;
+    sb.s_blocks_count = g.blocks_count;
+    sb.s_r_blocks_count = g.blocks_count / 20;
+    sb.s_free_blocks_count = free_blocks;
+    sb.s_free_inodes_count = free_inodes;
+    sb.s_first_data_block = g.first_data_block;
+    sb.s_log_block_size = bs == 1024 ? 0 : bs == 2048 ? 1 : 2;
+    sb.s_log_frag_size = sb.s_log_block_size;
+    sb.s_blocks_per_group = g.blocks_per_group;
+    sb.s_frags_per_group = g.blocks_per_group;
+    sb.s_inodes_per_group = g.inodes_per_group;
+    sb.s_wtime = now;
+    sb.s_max_mnt_count = 0xFFFF;
+    sb.s_magic = EXT2_SUPER_MAGIC;
+    sb.s_state = 1;
+    sb.s_errors = 1;
+    sb.s_lastcheck = now;
+    sb.s_rev_level = 1;
+    sb.s_first_ino = MKFS_FIRST_INO;
+    sb.s_inode_size = MKFS_INODE_SIZE;
+    sb.s_feature_incompat = EXT2_FEATURE_INCOMPAT_FILETYPE;
+    sb.s_feature_ro_compat = EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER | EXT2_FEATURE_RO_COMPAT_LARGE_FILE;
+    random_uuid(sb.s_uuid);
+    strncpy(sb.s_volume_name, label, sizeof(sb.s_volume_name));
+
+    // Início de cada grupo em uma única gravação: [superbloco + GDT] + bitmaps
+    size_t head_cap = (size_t)(1 + g.gdt_blocks + 2) * bs;
+    char *head = malloc(head_cap);
+    for (uint32_t grp = 0; grp < g.group_count; grp++) {
+        uint32_t first = group_first(&g, grp);
+        uint32_t nblocks = g.blocks_count - first < g.blocks_per_group ? g.blocks_count - first : g.blocks_per_group;
+        uint32_t used = group_overhead(&g, grp) + (grp == 0 ? 1 + g.lpf_blocks : 0);
+        uint32_t start = group_has_super(grp) ? first : gd[grp].bg_block_bitmap;
+        size_t len = (size_t)(gd[grp].bg_inode_bitmap + 1 - start) * bs;
+        memset(head, 0, len);
+
+        if (group_has_super(grp)) {
+            sb.s_block_group_nr = grp;
+            size_t sb_off = (grp == 0 && bs > 1024) ? 1024 : 0; // Superbloco sempre no byte 1024 da imagem
+            memcpy(head + sb_off, &sb, sizeof(sb));
+            memcpy(head + bs, gd, (size_t)g.group_count * sizeof(ext2_group_desc));
+        }
+
+        // Bitmaps: bits além do fim do grupo ficam marcados
+        uint8_t *bbitmap = (uint8_t *)head + (size_t)(gd[grp].bg_block_bitmap - start) * bs;
+        uint8_t *ibitmap = bbitmap + bs;
+        for (uint32_t b = 0; b < used; b++) set_bit(bbitmap, b);
+        for (uint32_t b = nblocks; b < bs * 8; b++) set_bit(bbitmap, b);
+        if (grp == 0) {
+            for (uint32_t i = 0; i < MKFS_FIRST_INO; i++) set_bit(ibitmap, i);
+        }
+        for (uint32_t i = g.inodes_per_group; i < bs * 8; i++) set_bit(ibitmap, i);
+
+        if (write_all(fd, head, len, (off_t)start * bs) != 0) return 1;
+        if (!sparse && zero_range(fd, (off_t)gd[grp].bg_inode_table * bs, (off_t)g.inode_table_blocks * bs) != 0) return 1;
+    }
+
+    // Inodes reservados, raiz e lost+found (primeiros blocos da tabela do grupo 0)
+    uint32_t per_block = bs / MKFS_INODE_SIZE;
+    uint32_t table_blocks = (MKFS_LPF_INO + per_block - 1) / per_block;
+    char *table = calloc(table_blocks, bs);
+    ext2_inode *inodes = (ext2_inode *)table;
+    fill_inode_dir(&inodes[EXT2_ROOT_INO - 1], 0755, 3, bs, root_block, 1, now);
+    fill_inode_dir(&inodes[MKFS_LPF_INO - 1], 0700, 2, bs, root_block + 1, g.lpf_blocks, now);
+    if (write_all(fd, table, (size_t)table_blocks * bs, (off_t)gd[0].bg_inode_table * bs) != 0) return 1;
+
+    // Blocos dos diretórios, em sequência: raiz e lost+found
+    char *dirs = calloc(1 + g.lpf_blocks, bs);
+    uint32_t off = put_entry(dirs, 0, EXT2_ROOT_INO, ".", 12);
+    off = put_entry(dirs, off, EXT2_ROOT_INO, "..", 12);
+    put_entry(dirs, off, MKFS_LPF_INO, "lost+found", bs - off);
+    char *lpf = dirs + bs;
+    off = put_entry(lpf, 0, MKFS_LPF_INO, ".", 12);
+    put_entry(lpf, off, EXT2_ROOT_INO, "..", bs - off);
+    for (uint32_t i = 1; i < g.lpf_blocks; i++) {
+        ext2_dir_entry_2 *empty = (ext2_dir_entry_2 *)(lpf + (size_t)i * bs);
+        empty->rec_len = bs;
+    }
+    if (write_all(fd, dirs, (size_t)(1 + g.lpf_blocks) * bs, (off_t)root_block * bs) != 0) return 1;
+
+    if (fsync(fd) != 0) perror("mkfs: fsync");
+    close(fd);
+    printf("%s: %u blocos de %u bytes, %u inodes, %u grupos (%u blocos livres)\n",
+           image, g.blocks_count, bs, sb.s_inodes_count, g.group_count, free_blocks);
+
+    free(dirs);
+    free(table);
+    free(head);
+    free(gd);
+    return 0;
+}
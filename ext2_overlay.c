@@ -0,0 +1,281 @@
+#include <fcntl.h>
+#include <sys/file.h>
+#include "ext2_overlay.h"
+#include "ext2_internal.h"
+
+// Delta de um overlay. Os blocos ficam no mesmo offset que teriam na imagem
+// (arquivo esparso); depois da área dos blocos vêm o cabeçalho, com um bloco,
+// e o mapa de blocos presentes (um bit por bloco). Um bloco é gravado no
+// delta antes de o seu bit ser ligado: quem vê o bit encontra o conteúdo.
+
+#define OVERLAY_MAGIC "E2COW001"
+#define OVERLAY_VERSION 1
+
+// Blocos copiados por pread/pwrite no commit
+#define OVERLAY_RUN_BLOCKS 256
+
+struct overlay_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t blocks_count;
+    uint8_t uuid[16];               // s_uuid da base
+};
+
+struct ext2_overlay {
+    int base_fd;                    // Base, só leitura (o fd do handle)
+    int fd;                         // Delta
+    char *path;
+    uint32_t block_size;
+    uint32_t blocks_count;
+    off_t header_offset;            // Fim da área dos blocos
+    off_t map_offset;
+    size_t map_len;
+    uint8_t *map;                   // Bits lidos sem lock, ligados com o lock
+    uint64_t blocks;                // Blocos no delta (com o lock)
+    pthread_mutex_t lock;           // Mapa e gravações parciais de bloco
+};
+
+static inline int in_delta(struct ext2_overlay *ov, uint32_t block) {
+    if (block >= ov->blocks_count) return 0;
+    return (__atomic_load_n(&ov->map[block / 8], __ATOMIC_ACQUIRE) >> (block % 8)) & 1;
+}
+
+// Liga o bit do bloco (já gravado no delta) e grava o byte do mapa (com o lock)
+static int mark_locked(struct ext2_overlay *ov, uint32_t block) {
+    if (in_delta(ov, block)) return 0;
+    uint8_t byte = __atomic_or_fetch(&ov->map[block / 8], 1 << (block % 8), __ATOMIC_RELEASE);
+    ov->blocks++;
+    return pwrite(ov->fd, &byte, 1, ov->map_offset + block / 8) == 1 ? 0 : -1;
+}
+
+static int mark(struct ext2_overlay *ov, uint32_t block) {
+    if (in_delta(ov, block)) return 0;
+    pthread_mutex_lock(&ov->lock);
+    int ret = mark_locked(ov, block);
+    pthread_mutex_unlock(&ov->lock);
+    return ret;
+}
+
+// Deixa o delta vazio: só o cabeçalho e o mapa zerado, sem blocos alocados
+static int reset_file(struct ext2_overlay *ov, const ext2_super_block *sb) {
+    struct overlay_header h = {0};
+    memcpy(h.magic, OVERLAY_MAGIC, 8);
+    h.version = OVERLAY_VERSION;
+    h.block_size = ov->block_size;
+    h.blocks_count = ov->blocks_count;
+    memcpy(h.uuid, sb->s_uuid, 16);
+    if (ftruncate(ov->fd, 0) != 0 || ftruncate(ov->fd, ov->map_offset + ov->map_len) != 0 ||
+        pwrite(ov->fd, &h, sizeof(h), ov->header_offset) != sizeof(h)) {
+        return -1;
+    }
+    memset(ov->map, 0, ov->map_len);
+    ov->blocks = 0;
+    return fdatasync(ov->fd);
+}
+
+struct ext2_overlay *overlay_open(int base_fd, const char *path, const ext2_super_block *sb) {
+    struct ext2_overlay *ov = calloc(1, sizeof(*ov));
+    if (!ov) return NULL;
+    ov->base_fd = base_fd;
+    ov->block_size = 1024 << sb->s_log_block_size;
+    ov->blocks_count = sb->s_blocks_count;
+    ov->header_offset = (off_t)ov->blocks_count * ov->block_size;
+    ov->map_offset = ov->header_offset + ov->block_size;
+    ov->map_len = (ov->blocks_count + 7) / 8;
+    ov->map = malloc(ov->map_len);
+    ov->path = strdup(path);
+    ov->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (!ov->map || !ov->path || ov->fd < 0) {
+        if (ov->fd < 0) perror(path);
+        goto fail;
+    }
+    // Um delta por processo: duas sessões no mesmo delta se sobrescreveriam
+    if (flock(ov->fd, LOCK_EX | LOCK_NB) != 0) {
+        fprintf(stderr, "overlay: %s está em uso por outro processo\n", path);
+        goto fail;
+    }
+    pthread_mutex_init(&ov->lock, NULL);
+
+    struct overlay_header h;
+    ssize_t got = pread(ov->fd, &h, sizeof(h), ov->header_offset);
+    if (got == 0) {
+        if (reset_file(ov, sb) != 0) {
+            perror(path);
+            goto fail;
+        }
+        return ov;
+    }
+    if (got != sizeof(h) || memcmp(h.magic, OVERLAY_MAGIC, 8) != 0 || h.version != OVERLAY_VERSION ||
+        h.block_size != ov->block_size || h.blocks_count != ov->blocks_count || memcmp(h.uuid, sb->s_uuid, 16) != 0) {
+        fprintf(stderr, "overlay: %s não é um delta desta imagem\n", path);
+        goto fail;
+    }
+    if (pread(ov->fd, ov->map, ov->map_len, ov->map_offset) != (ssize_t)ov->map_len) {
+        fprintf(stderr, "overlay: mapa de %s truncado\n", path);
+        goto fail;
+    }
+    for (size_t i = 0; i < ov->map_len; i++) ov->blocks += __builtin_popcount(ov->map[i]);
+    return ov;
+
+fail:
+    if (ov->fd >= 0) close(ov->fd);
+    free(ov->map);
+    free(ov->path);
+    free(ov);
+    return NULL;
+}
+
+void overlay_close(struct ext2_overlay *ov) {
+    if (!ov) return;
+    close(ov->fd);
+    pthread_mutex_destroy(&ov->lock);
+    free(ov->map);
+    free(ov->path);
+    free(ov);
+}
+
+int overlay_pread(struct ext2_overlay *ov, void *buf, size_t len, off_t offset) {
+    char *dst = buf;
+    uint32_t bs = ov->block_size;
+    while (len > 0) {
+        // Trecho de blocos seguidos com a mesma origem em um só pread
+        uint32_t block = offset / bs;
+        int delta = in_delta(ov, block);
+        size_t n = bs - offset % bs;
+        for (uint32_t next = block + 1; n < len && in_delta(ov, next) == delta; next++) n += bs;
+        if (n > len) n = len;
+        if (pread(delta ? ov->fd : ov->base_fd, dst, n, offset) != (ssize_t)n) return -1;
+        dst += n;
+        offset += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int overlay_pwrite(struct ext2_overlay *ov, const void *buf, size_t len, off_t offset) {
+    const char *src = buf;
+    uint32_t bs = ov->block_size;
+    while (len > 0) {
+        uint32_t block = offset / bs;
+        size_t in = offset % bs;
+        if (in == 0 && len >= bs) {
+            // Blocos inteiros: direto no delta
+            size_t n = len - len % bs;
+            if (pwrite(ov->fd, src, n, offset) != (ssize_t)n) return -1;
+            for (size_t i = 0; i < n / bs; i++) {
+                if (mark(ov, block + i) != 0) return -1;
+            }
+            src += n;
+            offset += n;
+            len -= n;
+            continue;
+        }
+        // Parte de um bloco (superbloco em blocos de 2 e 4 KiB, fim da GDT):
+        // um bloco ainda só na base é copiado antes
+        size_t n = bs - in < len ? bs - in : len;
+        pthread_mutex_lock(&ov->lock);
+        int ok;
+        if (in_delta(ov, block)) {
+            ok = pwrite(ov->fd, src, n, offset) == (ssize_t)n;
+        } else {
+            char tmp[bs];
+            ok = pread(ov->base_fd, tmp, bs, (off_t)block * bs) == (ssize_t)bs;
+            memcpy(tmp + in, src, n);
+            ok = ok && pwrite(ov->fd, tmp, bs, (off_t)block * bs) == (ssize_t)bs && mark_locked(ov, block) == 0;
+        }
+        pthread_mutex_unlock(&ov->lock);
+        if (!ok) return -1;
+        src += n;
+        offset += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int overlay_write_runs(struct ext2_overlay *ov, struct block_write *w, size_t n) {
+    int calls = pwrite_block_runs(ov->fd, ov->block_size, w, n);
+    if (calls < 0) return calls;
+    for (size_t i = 0; i < n; i++) {
+        if (mark(ov, w[i].block) != 0) return -1;
+    }
+    return calls;
+}
+
+int overlay_sync(struct ext2_overlay *ov) {
+    return fdatasync(ov->fd);
+}
+
+// --- API pública ---
+
+long long ext2_overlay_commit(ext2_fs *fs) {
+    struct ext2_overlay *ov = fs->overlay;
+    if (!ov) return -1;
+    ext2_flush_metadata(fs);
+
+    int fd = open(fs->image_path, O_RDWR);
+    if (fd < 0) {
+        perror(fs->image_path);
+        return -1;
+    }
+    uint32_t bs = ov->block_size;
+    char *buf = malloc((size_t)OVERLAY_RUN_BLOCKS * bs);
+    int ok = buf != NULL;
+    long long copied = 0;
+    pthread_mutex_lock(&ov->lock);
+    for (uint32_t b = 0; ok && b < ov->blocks_count;) {
+        if (!in_delta(ov, b)) {
+            b++;
+            continue;
+        }
+        uint32_t n = 1;
+        while (b + n < ov->blocks_count && n < OVERLAY_RUN_BLOCKS && in_delta(ov, b + n)) n++;
+        size_t len = (size_t)n * bs;
+        ok = pread(ov->fd, buf, len, (off_t)b * bs) == (ssize_t)len && pwrite(fd, buf, len, (off_t)b * bs) == (ssize_t)len;
+        copied += n;
+        b += n;
+    }
+    // O delta só é esvaziado com a base já no disco
+    ok = ok && fdatasync(fd) == 0 && reset_file(ov, &fs->sb) == 0;
+    pthread_mutex_unlock(&ov->lock);
+    if (!ok) perror("overlay: commit");
+    close(fd);
+    free(buf);
+    stats_op(fs, EXT2_OP_SYNC, 1);
+    return ok ? copied : -1;
+}
+
+long long ext2_overlay_discard(ext2_fs *fs) {
+    struct ext2_overlay *ov = fs->overlay;
+    if (!ov) return -1;
+    pthread_mutex_lock(&fs->sb_lock);
+    pthread_mutex_lock(&ov->lock);
+    long long dropped = (long long)ov->blocks;
+    int ok = reset_file(ov, &fs->sb) == 0;
+    pthread_mutex_unlock(&ov->lock);
+
+    // Com o delta vazio, superbloco e GDT vêm da base
+    unsigned int gd_block = fs->sb.s_first_data_block + 1;
+    ok = ok && image_pread(fs, &fs->sb, sizeof(ext2_super_block), 1024) == 0 &&
+         image_pread(fs, fs->gd, fs->group_count * sizeof(ext2_group_desc), (off_t)gd_block * fs->block_size) == 0;
+    __atomic_store_n(&fs->free_blocks, fs->sb.s_free_blocks_count, __ATOMIC_RELAXED);
+    __atomic_store_n(&fs->free_inodes, fs->sb.s_free_inodes_count, __ATOMIC_RELAXED);
+    fs->sb_dirty = fs->gd_dirty = 0;
+    memset(fs->gdt_dirty, 0, fs->gdt_blocks);
+    pthread_mutex_unlock(&fs->sb_lock);
+    if (!ok) perror("overlay: discard");
+    return ok ? dropped : -1;
+}
+
+void ext2_overlay_print(ext2_fs *fs, FILE *out) {
+    struct ext2_overlay *ov = fs->overlay;
+    if (!ov) {
+        fprintf(out, "Sem overlay: gravações vão para %s\n", fs->image_path);
+        return;
+    }
+    pthread_mutex_lock(&ov->lock);
+    uint64_t blocks = ov->blocks;
+    pthread_mutex_unlock(&ov->lock);
+    fprintf(out, "Base: %s (só leitura)\nDelta: %s\n%llu blocos alterados (%.1f MiB)\n", fs->image_path, ov->path,
+            (unsigned long long)blocks, blocks * (double)ov->block_size / (1024.0 * 1024.0));
+}
@@ -0,0 +1,63 @@
+#ifndef _EXT2_OVERLAY_H_
+#define _EXT2_OVERLAY_H_
+
+#include <stdio.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Delta padrão ao lado da imagem base: "<imagem>.cow"
+#define EXT2_OVERLAY_SUFFIX ".cow"
+
+/*
+function: Abre a imagem em modo overlay (copy-on-write).
+param:
+  - image_path: Imagem base, aberta só para leitura.
+  - delta_path: Arquivo de delta (NULL = <imagem>.cow), criado se não existir.
+return:
+  - Handle como o de ext2_init() ou NULL em erro.
+observações:
+  - Toda gravação vai para o delta: um arquivo esparso do tamanho da imagem
+    (cada bloco no próprio offset) seguido de um cabeçalho e do mapa de
+    blocos presentes, mantido também em memória. Leituras vêm do delta para
+    os blocos do mapa e da base para os demais.
+  - A base nunca é alterada (até ext2_overlay_commit()) e pode ser aberta
+    por muitos processos ao mesmo tempo, cada um com o seu delta: todos
+    compartilham as páginas da base no page cache.
+  - Um delta existente continua a sessão anterior; ele é recusado se for de
+    outra imagem (UUID ou geometria) ou estiver aberto por outro processo.
+  - Sem journal: o journal grava na imagem no checkpoint. A base precisa
+    estar com o journal vazio.
+*/
+ext2_fs *ext2_init_overlay(const char *image_path, const char *delta_path);
+
+/*
+function: Copia os blocos do delta para a imagem base e esvazia o delta.
+return:
+  - Quantidade de blocos copiados ou -1 em erro (ou se o handle não é overlay).
+observações:
+  - A base é reaberta para gravação só durante o commit. Os outros processos
+    que usam a mesma base devem estar fechados.
+  - O delta só é esvaziado depois que a base foi sincronizada: um commit
+    interrompido pode ser repetido.
+  - Não deve rodar junto com outras operações no handle.
+*/
+long long ext2_overlay_commit(ext2_fs *fs);
+
+/*
+function: Descarta as alterações do delta; a sessão volta a ver a base.
+return:
+  - Quantidade de blocos descartados ou -1 em erro.
+observações:
+  - Superbloco e descritores de grupo são relidos da base. Caminhos e inodes
+    guardados pelo chamador podem não existir mais.
+  - Não deve rodar junto com outras operações no handle.
+*/
+long long ext2_overlay_discard(ext2_fs *fs);
+
+/*
+function: Escreve a base, o delta e a quantidade de blocos no delta.
+return: void.
+*/
+void ext2_overlay_print(ext2_fs *fs, FILE *out);
+
+#endif
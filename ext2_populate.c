@@ -0,0 +1,623 @@
+#include <time.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "ext2_populate.h"
+#include "ext2_internal.h"
+
+// Entrada da árvore do host, lida antes de qualquer alocação
+struct pop_node {
+    char *name;
+    char *host_path;
+    struct stat st;
+    uint64_t blocks;          // Blocos de dados (conteúdo do arquivo ou do diretório)
+    uint32_t ino;
+    struct pop_node **children;
+    size_t nchildren, cap;
+    unsigned int subdirs;
+    int appended;             // Entrada do destino que vai para um bloco novo
+};
+
+// Trecho de blocos alocado e ainda não distribuído
+struct pop_run {
+    uint32_t start, len;
+};
+
+// Inode a ser gravado no final
+struct pop_inode {
+    uint32_t ino;
+    ext2_inode inode;
+};
+
+struct populate {
+    ext2_fs *fs;
+    FILE *out;
+    unsigned int per_block;   // Ponteiros por bloco indireto
+
+    // Blocos alocados para o diretório em andamento
+    struct pop_run *runs;
+    size_t nruns, runs_cap, run_pos;
+    uint32_t run_off;
+
+    // Conteúdo em cópia: arquivo do host (fd) ou buffer do diretório (mem)
+    int fd;
+    const char *mem;
+    struct block_write *chunk;
+    char *chunk_buf;
+    size_t nchunk;
+
+    // Gravados no final
+    struct block_write *meta;
+    size_t nmeta, meta_cap;
+    struct pop_inode *inodes;
+    size_t ninodes, inodes_cap;
+    unsigned int *dirs_per_group;
+
+    // Blocos acrescentados ao diretório de destino, a partir de i_block[dest_first]
+    unsigned int dest_first, dest_new;
+    uint32_t dest_blocks[EXT2_NDIR_BLOCKS];
+
+    unsigned int files, dirs, links, skipped;
+    uint64_t bytes;
+    int error;
+};
+
+// --- Leitura da árvore do host ---
+
+static int cmp_node(const void *a, const void *b) {
+    return strcmp((*(struct pop_node *const *)a)->name, (*(struct pop_node *const *)b)->name);
+}
+
+static void free_tree(struct pop_node *n) {
+    for (size_t i = 0; i < n->nchildren; i++) free_tree(n->children[i]);
+    free(n->children);
+    free(n->name);
+    free(n->host_path);
+    free(n);
+}
+
+// Blocos ocupados pelas entradas de um diretório (incluindo "." e "..")
+static uint64_t dir_blocks(const struct pop_node *n, unsigned int bs) {
+    uint64_t blocks = 1;
+    unsigned int used = 12 + 12; // "." e ".."
+    for (size_t i = 0; i < n->nchildren; i++) {
+        unsigned int len = (8 + strlen(n->children[i]->name) + 3) & ~3u;
+        if (used + len > bs) {
+            blocks++;
+            used = 0;
+        }
+        used += len;
+    }
+    return blocks;
+}
+
+// Blocos indiretos necessários para mapear `n` blocos de dados
+static uint64_t map_overhead(uint64_t n, uint64_t p) {
+    if (n <= EXT2_NDIR_BLOCKS) return 0;
+    n -= EXT2_NDIR_BLOCKS;
+    if (n <= p) return 1;
+    n -= p;
+    uint64_t m = n < p * p ? n : p * p;
+    uint64_t ind = 1 + 1 + (m + p - 1) / p;
+    if (n <= p * p) return ind;
+    n -= p * p;
+    return ind + 1 + (n + p * p - 1) / (p * p) + (n + p - 1) / p;
+}
+
+static struct pop_node *scan(struct populate *p, const char *path, const char *name,
+                             uint64_t *inodes, uint64_t *blocks) {
+    ext2_fs *fs = p->fs;
+    struct pop_node *n = calloc(1, sizeof(struct pop_node));
+    if (!n || lstat(path, &n->st) != 0) {
+        fprintf(p->out, "import: %s: não foi possível ler\n", path);
+        free(n);
+        return NULL;
+    }
+    n->name = strdup(name);
+    n->host_path = strdup(path);
+    uint64_t max_blocks = EXT2_NDIR_BLOCKS + (uint64_t)p->per_block * (1 + p->per_block + (uint64_t)p->per_block * p->per_block);
+
+    if (S_ISREG(n->st.st_mode)) {
+        n->blocks = ((uint64_t)n->st.st_size + fs->block_size - 1) / fs->block_size;
+        if (n->blocks > max_blocks) {
+            fprintf(p->out, "import: %s: grande demais para blocos de %u bytes, ignorado\n", path, fs->block_size);
+            free_tree(n);
+            return NULL;
+        }
+    } else if (S_ISLNK(n->st.st_mode)) {
+        if (n->st.st_size >= (off_t)fs->block_size) {
+            fprintf(p->out, "import: %s: destino do link grande demais para blocos de %u bytes, ignorado\n", path, fs->block_size);
+            p->skipped++;
+            free_tree(n);
+            return NULL;
+        }
+        n->blocks = n->st.st_size >= (off_t)sizeof(((ext2_inode *)0)->i_block) ? 1 : 0; // Curto: guardado em i_block
+    } else if (S_ISDIR(n->st.st_mode)) {
+        DIR *d = opendir(path);
+        struct dirent *e;
+        while (d && (e = readdir(d))) {
+            if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+            if (strlen(e->d_name) > 255) continue;
+            size_t len = strlen(path) + strlen(e->d_name) + 2;
+            char child_path[len];
+            snprintf(child_path, len, "%s/%s", path, e->d_name);
+            struct pop_node *c = scan(p, child_path, e->d_name, inodes, blocks);
+            if (!c) continue;
+            if (n->nchildren == n->cap) {
+                n->cap = n->cap ? n->cap * 2 : 16;
+                n->children = realloc(n->children, n->cap * sizeof(struct pop_node *));
+            }
+            n->children[n->nchildren++] = c;
+            n->subdirs += S_ISDIR(c->st.st_mode);
+        }
+        if (d) closedir(d);
+        qsort(n->children, n->nchildren, sizeof(struct pop_node *), cmp_node);
+        n->blocks = dir_blocks(n, fs->block_size);
+    } else {
+        fprintf(p->out, "import: %s: tipo não suportado, ignorado\n", path);
+        p->skipped++;
+        free_tree(n);
+        return NULL;
+    }
+
+    *inodes += 1;
+    *blocks += n->blocks + map_overhead(n->blocks, p->per_block);
+    return n;
+}
+
+// --- Distribuição dos blocos ---
+
+static int reserve_blocks(struct populate *p, uint64_t count, uint32_t goal) {
+    p->nruns = p->run_pos = 0;
+    p->run_off = 0;
+    while (count > 0) {
+        unsigned int got;
+        unsigned int want = count > UINT32_MAX ? UINT32_MAX : (unsigned int)count;
+        unsigned int start = alloc_block_run(p->fs, goal, want, &got);
+        if (start == 0) return -1;
+        if (p->nruns == p->runs_cap) {
+            p->runs_cap = p->runs_cap ? p->runs_cap * 2 : 16;
+            p->runs = realloc(p->runs, p->runs_cap * sizeof(struct pop_run));
+        }
+        p->runs[p->nruns++] = (struct pop_run){ start, got };
+        count -= got;
+        goal = start + got;
+    }
+    return 0;
+}
+
+static uint32_t take_block(struct populate *p) {
+    while (p->run_pos < p->nruns && p->run_off == p->runs[p->run_pos].len) {
+        p->run_pos++;
+        p->run_off = 0;
+    }
+    if (p->run_pos == p->nruns) return 0;
+    return p->runs[p->run_pos].start + p->run_off++;
+}
+
+// Lê o trecho pendente da origem e grava nos blocos já distribuídos
+static void flush_chunk(struct populate *p) {
+    ext2_fs *fs = p->fs;
+    size_t len = p->nchunk * fs->block_size;
+    if (p->mem) {
+        memcpy(p->chunk_buf, p->mem, len);
+        p->mem += len;
+    } else {
+        size_t done = 0;
+        while (done < len) {
+            ssize_t r = read(p->fd, p->chunk_buf + done, len - done);
+            if (r <= 0) break;
+            done += r;
+        }
+        memset(p->chunk_buf + done, 0, len - done); // Fim do arquivo (ou arquivo encolheu)
+    }
+    write_data_blocks(fs, p->chunk, p->nchunk);
+    p->nchunk = 0;
+}
+
+static void queue_meta(struct populate *p, uint32_t block, void *data) {
+    if (p->nmeta == p->meta_cap) {
+        p->meta_cap = p->meta_cap ? p->meta_cap * 2 : 64;
+        p->meta = realloc(p->meta, p->meta_cap * sizeof(struct block_write));
+    }
+    p->meta[p->nmeta++] = (struct block_write){ block, data };
+}
+
+// Distribui blocos em pré-ordem (cada indireto antes dos blocos que aponta,
+// como ext2_file) e copia os dados à medida que os blocos são definidos
+static uint32_t layout(struct populate *p, int level, uint64_t *remaining) {
+    uint32_t blk = take_block(p);
+    if (blk == 0) {
+        p->error = 1;
+        return 0;
+    }
+    if (level == 0) {
+        p->chunk[p->nchunk] = (struct block_write){ blk, p->chunk_buf + p->nchunk * p->fs->block_size };
+        if (++p->nchunk == EXT2_POPULATE_CHUNK) flush_chunk(p);
+        (*remaining)--;
+        return blk;
+    }
+    uint32_t *ptrs = calloc(1, p->fs->block_size);
+    for (unsigned int i = 0; i < p->per_block && *remaining > 0 && !p->error; i++) {
+        ptrs[i] = layout(p, level - 1, remaining);
+    }
+    queue_meta(p, blk, ptrs);
+    return blk;
+}
+
+static void layout_inode(struct populate *p, ext2_inode *inode, uint64_t nblocks) {
+    uint64_t remaining = nblocks;
+    for (int i = 0; i < EXT2_NDIR_BLOCKS && remaining > 0; i++) inode->i_block[i] = layout(p, 0, &remaining);
+    for (int level = 1; level <= 3 && remaining > 0; level++) {
+        inode->i_block[EXT2_IND_BLOCK + level - 1] = layout(p, level, &remaining);
+    }
+    if (p->nchunk > 0) flush_chunk(p);
+    inode->i_blocks = (nblocks + map_overhead(nblocks, p->per_block)) * (p->fs->block_size / 512);
+}
+
+// --- Inodes e diretórios ---
+
+static void base_inode(const struct pop_node *n, ext2_inode *inode) {
+    memset(inode, 0, sizeof(*inode));
+    inode->i_mode = (n->st.st_mode & 07777) |
+                    (S_ISDIR(n->st.st_mode) ? EXT2_S_IFDIR : S_ISLNK(n->st.st_mode) ? EXT2_S_IFLNK : EXT2_S_IFREG);
+    inode->i_uid = n->st.st_uid;
+    inode->i_gid = n->st.st_gid;
+    inode->i_atime = n->st.st_atime;
+    inode->i_mtime = n->st.st_mtime;
+    inode->i_ctime = time(NULL);
+    inode->i_links_count = 1;
+}
+
+static void queue_inode(struct populate *p, uint32_t ino, const ext2_inode *inode) {
+    if (p->ninodes == p->inodes_cap) {
+        p->inodes_cap = p->inodes_cap ? p->inodes_cap * 2 : 256;
+        p->inodes = realloc(p->inodes, p->inodes_cap * sizeof(struct pop_inode));
+    }
+    p->inodes[p->ninodes].ino = ino;
+    p->inodes[p->ninodes++].inode = *inode;
+}
+
+static uint8_t file_type(const struct pop_node *n) {
+    if (S_ISDIR(n->st.st_mode)) return EXT2_FT_DIR;
+    if (S_ISLNK(n->st.st_mode)) return EXT2_FT_SYMLINK;
+    return EXT2_FT_REG_FILE;
+}
+
+// Blocos de diretório em montagem; a última entrada de cada bloco vai até o fim
+struct dir_fill {
+    char *buf;
+    unsigned int bs, off;
+    size_t block;
+    ext2_dir_entry_2 *last;
+};
+
+static void put_entry(struct dir_fill *f, uint32_t ino, const char *name, uint8_t type) {
+    unsigned int len = (8 + strlen(name) + 3) & ~3u;
+    if (f->last && f->off + len > f->bs) {
+        f->last->rec_len += f->bs - f->off;
+        f->block++;
+        f->off = 0;
+    }
+    f->last = (ext2_dir_entry_2 *)(f->buf + f->block * f->bs + f->off);
+    f->last->inode = ino;
+    f->last->rec_len = len;
+    f->last->name_len = strlen(name);
+    f->last->file_type = type;
+    memcpy(f->last->name, name, f->last->name_len);
+    f->off += len;
+}
+
+static char *finish_entries(struct dir_fill *f) {
+    if (f->last) f->last->rec_len += f->bs - f->off;
+    return f->buf;
+}
+
+// Monta as entradas do diretório em blocos
+static char *build_dir(const struct pop_node *n, uint32_t self, uint32_t parent, unsigned int bs) {
+    struct dir_fill f = { calloc(n->blocks, bs), bs, 0, 0, NULL };
+    if (!f.buf) return NULL;
+    put_entry(&f, self, ".", EXT2_FT_DIR);
+    put_entry(&f, parent, "..", EXT2_FT_DIR);
+    for (size_t i = 0; i < n->nchildren; i++) put_entry(&f, n->children[i]->ino, n->children[i]->name, file_type(n->children[i]));
+    return finish_entries(&f);
+}
+
+// Monta os blocos novos do destino com as entradas que não cabem nos existentes
+static char *build_appended(const struct pop_node *root, unsigned int nblocks, unsigned int bs) {
+    struct dir_fill f = { calloc(nblocks, bs), bs, 0, 0, NULL };
+    if (!f.buf) return NULL;
+    for (size_t i = 0; i < root->nchildren; i++) {
+        const struct pop_node *c = root->children[i];
+        if (c->appended) put_entry(&f, c->ino, c->name, file_type(c));
+    }
+    return finish_entries(&f);
+}
+
+static void copy_file(struct populate *p, struct pop_node *n, ext2_inode *inode) {
+    p->fd = open(n->host_path, O_RDONLY);
+    if (p->fd < 0) fprintf(p->out, "import: %s: não foi possível abrir, copiado vazio\n", n->host_path);
+    p->mem = NULL;
+    inode_set_file_size(p->fs, inode, n->st.st_size);
+    layout_inode(p, inode, n->blocks);
+    if (p->fd >= 0) close(p->fd);
+    p->files++;
+    p->bytes += n->st.st_size;
+}
+
+static void copy_symlink(struct populate *p, struct pop_node *n, ext2_inode *inode) {
+    char target[PATH_MAX];
+    ssize_t len = readlink(n->host_path, target, sizeof(target) - 1);
+    if (len < 0) len = 0;
+    // O link pode ter mudado depois do scan: não passa do espaço reservado
+    ssize_t room = n->blocks ? (ssize_t)p->fs->block_size - 1 : (ssize_t)sizeof(inode->i_block) - 1;
+    if (len > room) len = room;
+    inode->i_size = len;
+    if (n->blocks == 0) {
+        memcpy(inode->i_block, target, len);
+    } else {
+        char *block = calloc(1, p->fs->block_size);
+        memcpy(block, target, len);
+        p->mem = block;
+        layout_inode(p, inode, 1);
+        free(block);
+    }
+    p->links++;
+}
+
+// Cria os filhos de `n`. Com build_self, também monta o próprio diretório
+// (self, com ".." = parent); senão, os filhos entram no diretório já existente.
+static int populate_dir(struct populate *p, struct pop_node *n, uint32_t self, uint32_t parent, int build_self) {
+    ext2_fs *fs = p->fs;
+    unsigned int ipg = fs->sb.s_inodes_per_group;
+
+    // Inodes dos filhos, juntos e no grupo do diretório
+    block_list inos = {0};
+    if (alloc_inode_list(fs, n->nchildren, (self - 1) / ipg, &inos) < n->nchildren) {
+        fprintf(p->out, "import: sem inodes livres\n");
+        block_list_destroy(&inos);
+        return -1;
+    }
+    for (size_t i = 0; i < n->nchildren; i++) n->children[i]->ino = inos.blocks[i];
+    block_list_destroy(&inos);
+
+    // Blocos do diretório e dos arquivos, em trechos contíguos perto dos inodes
+    uint64_t need = build_self ? n->blocks + map_overhead(n->blocks, p->per_block) : p->dest_new;
+    for (size_t i = 0; i < n->nchildren; i++) {
+        struct pop_node *c = n->children[i];
+        if (!S_ISDIR(c->st.st_mode)) need += c->blocks + map_overhead(c->blocks, p->per_block);
+    }
+    uint32_t group = n->nchildren ? (n->children[0]->ino - 1) / ipg : (self - 1) / ipg;
+    if (need > 0 && reserve_blocks(p, need, fs->sb.s_first_data_block + group * fs->sb.s_blocks_per_group) != 0) {
+        fprintf(p->out, "import: sem blocos livres\n");
+        return -1;
+    }
+
+    if (build_self) {
+        ext2_inode inode;
+        base_inode(n, &inode);
+        inode.i_links_count = 2 + n->subdirs;
+        inode.i_size = n->blocks * fs->block_size;
+        char *content = build_dir(n, self, parent, fs->block_size);
+        if (!content) return -1;
+        p->mem = content;
+        layout_inode(p, &inode, n->blocks);
+        free(content);
+        queue_inode(p, self, &inode);
+        p->dirs_per_group[(self - 1) / ipg]++;
+        p->dirs++;
+    } else if (p->dest_new > 0) {
+        // Blocos novos do destino: só diretos, ligados ao inode no final
+        char *content = build_appended(n, p->dest_new, fs->block_size);
+        if (!content) return -1;
+        p->mem = content;
+        uint64_t remaining = p->dest_new;
+        for (unsigned int i = 0; i < p->dest_new; i++) p->dest_blocks[i] = layout(p, 0, &remaining);
+        if (p->nchunk > 0) flush_chunk(p);
+        free(content);
+    }
+
+    for (size_t i = 0; i < n->nchildren && !p->error; i++) {
+        struct pop_node *c = n->children[i];
+        if (S_ISDIR(c->st.st_mode)) continue;
+        ext2_inode inode;
+        base_inode(c, &inode);
+        if (S_ISREG(c->st.st_mode)) copy_file(p, c, &inode);
+        else copy_symlink(p, c, &inode);
+        queue_inode(p, c->ino, &inode);
+    }
+    if (p->error) {
+        fprintf(p->out, "import: blocos reservados insuficientes\n");
+        return -1;
+    }
+
+    for (size_t i = 0; i < n->nchildren; i++) {
+        struct pop_node *c = n->children[i];
+        if (S_ISDIR(c->st.st_mode) && populate_dir(p, c, c->ino, self, 1) != 0) return -1;
+    }
+    return 0;
+}
+
+static int cmp_pop_inode(const void *a, const void *b) {
+    uint32_t x = ((const struct pop_inode *)a)->ino, y = ((const struct pop_inode *)b)->ino;
+    return (x > y) - (x < y);
+}
+
+// Grava os inodes: cada bloco da tabela é lido e gravado uma vez
+static void write_inodes(struct populate *p) {
+    ext2_fs *fs = p->fs;
+    unsigned int ipg = fs->sb.s_inodes_per_group;
+    qsort(p->inodes, p->ninodes, sizeof(struct pop_inode), cmp_pop_inode);
+
+    struct block_write *w = malloc((p->ninodes + 1) * sizeof(struct block_write));
+    size_t nw = 0;
+    for (size_t i = 0; i < p->ninodes;) {
+        uint32_t index = p->inodes[i].ino - 1;
+        uint32_t group = index / ipg;
+        uint32_t block = fs->gd[group].bg_inode_table + (index % ipg) / fs->inodes_per_block;
+        char *buf = malloc(fs->block_size);
+        read_block(fs, block, buf);
+        for (; i < p->ninodes; i++) {
+            uint32_t idx = p->inodes[i].ino - 1;
+            if (idx / ipg != group || fs->gd[group].bg_inode_table + (idx % ipg) / fs->inodes_per_block != block) break;
+            memcpy(buf + (idx % fs->inodes_per_block) * sizeof(ext2_inode), &p->inodes[i].inode, sizeof(ext2_inode));
+        }
+        w[nw++] = (struct block_write){ block, buf };
+    }
+    write_metadata_blocks(fs, w, nw);
+    for (size_t i = 0; i < nw; i++) free((void *)w[i].data);
+    free(w);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Distribui as entradas de `root` no destino. add_dir_entry só usa a folga
+// da última entrada de cada bloco já existente, na ordem dos blocos; a
+// simulação segue a mesma regra. As que não cabem são marcadas `appended` e
+// vão para blocos novos, acrescentados aos blocos diretos do destino.
+static int plan_dest(struct populate *p, unsigned int dest_inode, struct pop_node *root) {
+    ext2_fs *fs = p->fs;
+    ext2_inode dest;
+    get_inode(fs, dest_inode, &dest);
+    unsigned int room[EXT2_NDIR_BLOCKS] = {0};
+    char buf[fs->block_size];
+    unsigned int nexist = 0;
+    while (nexist < EXT2_NDIR_BLOCKS && dest.i_block[nexist] != 0) nexist++;
+    for (unsigned int b = 0; b < nexist; b++) {
+        if (read_block_as(fs, dest.i_block[b], buf, EXT2_IO_DIR) != 0) continue;
+        unsigned int off = 0;
+        while (off < fs->block_size) {
+            ext2_dir_entry_2 *e = (ext2_dir_entry_2 *)(buf + off);
+            if (e->rec_len == 0) break;
+            unsigned int ideal = (8 + e->name_len + 3) & ~3u;
+            if (off + e->rec_len >= fs->block_size && e->rec_len >= ideal) room[b] = e->rec_len - ideal;
+            off += e->rec_len;
+        }
+    }
+    unsigned int nnew = 0, used = fs->block_size;
+    for (size_t i = 0; i < root->nchildren; i++) {
+        struct pop_node *c = root->children[i];
+        unsigned int len = (8 + strlen(c->name) + 3) & ~3u;
+        unsigned int b = 0;
+        while (b < nexist && room[b] < len) b++;
+        c->appended = b == nexist;
+        if (!c->appended) {
+            room[b] -= len;
+            continue;
+        }
+        // Mesma regra de build_appended
+        if (used + len > fs->block_size) {
+            nnew++;
+            used = 0;
+        }
+        used += len;
+    }
+    if (nexist + nnew > EXT2_NDIR_BLOCKS) return -1; // Diretórios só usam os blocos diretos
+    p->dest_first = nexist;
+    p->dest_new = nnew;
+    return 0;
+}
+
+int ext2_populate(ext2_fs *fs, const char *host_dir, unsigned int dest_inode, FILE *out) {
+    double start = now_ms();
+    struct populate p = { .fs = fs, .out = out, .fd = -1, .per_block = fs->block_size / 4 };
+
+    // 1. Árvore do host e necessidades totais
+    uint64_t need_inodes = 0, need_blocks = 0;
+    struct pop_node *root = scan(&p, host_dir, "", &need_inodes, &need_blocks);
+    if (!root) return -1;
+    if (!S_ISDIR(root->st.st_mode)) {
+        fprintf(out, "import: '%s' não é um diretório\n", host_dir);
+        free_tree(root);
+        return -1;
+    }
+    need_inodes--; // O próprio host_dir vira dest_inode
+    need_blocks -= root->blocks + map_overhead(root->blocks, p.per_block);
+    if (plan_dest(&p, dest_inode, root) != 0) {
+        fprintf(out, "import: as %zu entradas de '%s' não cabem nos %d blocos diretos do diretório de destino\n",
+                root->nchildren, host_dir, EXT2_NDIR_BLOCKS);
+        free_tree(root);
+        return -1;
+    }
+    need_blocks += p.dest_new;
+
+    uint32_t free_inodes = __atomic_load_n(&fs->free_inodes, __ATOMIC_RELAXED);
+    uint32_t free_blocks = __atomic_load_n(&fs->free_blocks, __ATOMIC_RELAXED);
+    if (need_inodes > free_inodes || need_blocks > free_blocks) {
+        fprintf(out, "import: são necessários %llu inodes e %llu blocos; livres: %u e %u\n",
+                (unsigned long long)need_inodes, (unsigned long long)need_blocks, free_inodes, free_blocks);
+        free_tree(root);
+        return -1;
+    }
+    for (size_t i = 0; i < root->nchildren; i++) {
+        if (search_directory(fs, dest_inode, root->children[i]->name)) {
+            fprintf(out, "import: '%s' já existe no destino\n", root->children[i]->name);
+            free_tree(root);
+            return -1;
+        }
+    }
+
+    // 2. Alocação e cópia dos dados; metadados acumulados em memória
+    int deferred = fs->defer_metadata;
+    ext2_set_deferred_flush(fs, 1);
+    p.chunk = malloc(EXT2_POPULATE_CHUNK * sizeof(struct block_write));
+    p.chunk_buf = malloc((size_t)EXT2_POPULATE_CHUNK * fs->block_size);
+    p.dirs_per_group = calloc(fs->group_count, sizeof(unsigned int));
+    int ret = (p.chunk && p.chunk_buf && p.dirs_per_group) ? populate_dir(&p, root, dest_inode, 0, 0) : -1;
+
+    // 3. Metadados, depois dos dados: indiretos, inodes, blocos e entradas no destino
+    if (ret == 0) {
+        if (!fs->journal) write_barrier(fs);
+        write_metadata_blocks(fs, p.meta, p.nmeta);
+        write_inodes(&p);
+        for (unsigned int g = 0; g < fs->group_count; g++) {
+            if (p.dirs_per_group[g] == 0) continue;
+            pthread_mutex_lock(&fs->group_locks[g]);
+            fs->gd[g].bg_used_dirs_count += p.dirs_per_group[g];
+            pthread_mutex_unlock(&fs->group_locks[g]);
+            mark_group_dirty(fs, g);
+        }
+
+        if (root->subdirs > 0 || p.dest_new > 0) {
+            ext2_inode dest;
+            get_inode(fs, dest_inode, &dest);
+            dest.i_links_count += root->subdirs;
+            for (unsigned int i = 0; i < p.dest_new; i++) dest.i_block[p.dest_first + i] = p.dest_blocks[i];
+            dest.i_size += p.dest_new * fs->block_size;
+            dest.i_blocks += p.dest_new * (fs->block_size / 512);
+            if (p.dest_new > 0) dest.i_mtime = dest.i_ctime = time(NULL);
+            write_inode(fs, dest_inode, &dest);
+        }
+        for (size_t i = 0; i < root->nchildren; i++) {
+            struct pop_node *c = root->children[i];
+            if (c->appended) continue;
+            if (add_dir_entry(fs, dest_inode, c->ino, c->name, file_type(c)) != 0) {
+                fprintf(out, "import: sem espaço no diretório de destino para '%s'\n", c->name);
+                ret = -1;
+            }
+        }
+    }
+    ext2_set_deferred_flush(fs, deferred); // Grava superbloco e descritores uma vez
+
+    double secs = (now_ms() - start) / 1000.0;
+    double mib = p.bytes / (1024.0 * 1024.0);
+    fprintf(out, "%u arquivos, %u diretórios, %u links simbólicos (%.1f MiB) em %.2f s (%.1f MiB/s)\n",
+            p.files, p.dirs, p.links, mib, secs, secs > 0 ? mib / secs : 0.0);
+    if (p.skipped) fprintf(out, "%u entradas ignoradas\n", p.skipped);
+
+    for (size_t i = 0; i < p.nmeta; i++) free((void *)p.meta[i].data);
+    free(p.meta);
+    free(p.inodes);
+    free(p.runs);
+    free(p.chunk);
+    free(p.chunk_buf);
+    free(p.dirs_per_group);
+    free_tree(root);
+    return ret == 0 ? (int)(p.files + p.dirs + p.links) : -1;
+}
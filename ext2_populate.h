@@ -0,0 +1,39 @@
+#ifndef _EXT2_POPULATE_H_
+#define _EXT2_POPULATE_H_
+
+#include <stdio.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Blocos de dados lidos do host e gravados na imagem por vez
+#define EXT2_POPULATE_CHUNK 1024
+
+/*
+function: Copia uma árvore de diretórios do host para dentro da imagem.
+param:
+  - host_dir: Diretório do host; o seu conteúdo é copiado.
+  - dest_inode: Diretório da imagem que recebe o conteúdo.
+  - out: Onde o progresso e o resumo são escritos.
+return:
+  - Quantidade de inodes criados ou -1 em erro.
+observações:
+  - A árvore do host é lida inteira antes (lstat), para conferir se os
+    inodes e blocos livres bastam e para calcular cada diretório e mapa.
+  - Cada diretório é processado de uma vez: os inodes dos filhos são
+    alocados juntos, no grupo do diretório (alloc_inode_list), e os blocos
+    do diretório e dos seus arquivos em trechos contíguos (alloc_block_run),
+    na ordem em que são gravados.
+  - O conteúdo dos arquivos é copiado em trechos de EXT2_POPULATE_CHUNK
+    blocos. Indiretos, inodes, bitmaps, descritores e superbloco são gravados
+    uma vez, no final, depois dos dados; por último as entradas em dest_inode.
+  - Entradas que não cabem na folga dos blocos de dest_inode vão para blocos
+    novos, alocados e gravados com os demais e ligados ao inode no final
+    (até os 12 blocos diretos).
+  - Arquivos regulares, diretórios e links simbólicos são copiados; hard
+    links viram arquivos independentes e os demais tipos são ignorados.
+  - Deve rodar com exclusividade (no servidor e no lote, o comando import é
+    executado sozinho).
+*/
+int ext2_populate(ext2_fs *fs, const char *host_dir, unsigned int dest_inode, FILE *out);
+
+#endif
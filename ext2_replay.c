@@ -0,0 +1,464 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+#include "ext2_stats.h"
+#include "ext2_trace.h"
+
+// Reprodução de um trace gravado com ext2shell -T (ou o comando trace).
+// Sem imagem, simula caches de blocos (LRU, FIFO e CLOCK) de vários tamanhos
+// de uma vez, com leitura antecipada opcional, e compara as taxas de acerto.
+// Com -i, as faltas da primeira configuração são lidas de verdade da imagem
+// por read_block_as(), e o relatório inclui o tempo e as estatísticas de E/S.
+
+enum policy { POLICY_LRU, POLICY_FIFO, POLICY_CLOCK, POLICY_COUNT };
+
+static const char *policy_names[POLICY_COUNT] = { "lru", "fifo", "clock" };
+
+static const char *cat_names[EXT2_IO_NCATS] = {
+    "superblock", "gdt", "bitmap", "inode_table", "directory", "data", "indirect", "journal"
+};
+
+// Cache de `cap` blocos: tabela hash encadeada pelos índices dos lugares e
+// lista duplamente ligada (mais recente na cabeça) para LRU e FIFO
+struct cache {
+    enum policy policy;
+    unsigned int cap, used;
+    uint32_t *block;
+    int32_t *prev, *next, *hnext;
+    uint8_t *ref;                 // CLOCK: bit de referência
+    uint8_t *prefetched;          // Trazido pela leitura antecipada e ainda não usado
+    int32_t *buckets;
+    uint32_t mask;
+    int32_t head, tail;
+    unsigned int hand;
+
+    // Resultados (leituras; gravações só ocupam lugar no cache)
+    uint64_t hits, misses;
+    uint64_t cat_hits[EXT2_IO_NCATS], cat_reads[EXT2_IO_NCATS];
+    uint64_t prefetch, prefetch_used;
+};
+
+static int cache_init(struct cache *c, enum policy policy, unsigned int cap) {
+    memset(c, 0, sizeof(*c));
+    c->policy = policy;
+    c->cap = cap;
+    uint32_t nb = 1;
+    while (nb < 2 * cap) nb <<= 1;
+    c->mask = nb - 1;
+    c->block = malloc(cap * sizeof(uint32_t));
+    c->prev = malloc(cap * sizeof(int32_t));
+    c->next = malloc(cap * sizeof(int32_t));
+    c->hnext = malloc(cap * sizeof(int32_t));
+    c->ref = calloc(cap, 1);
+    c->prefetched = calloc(cap, 1);
+    c->buckets = malloc(nb * sizeof(int32_t));
+    if (!c->block || !c->prev || !c->next || !c->hnext || !c->ref || !c->prefetched || !c->buckets) return -1;
+    for (uint32_t i = 0; i < nb; i++) c->buckets[i] = -1;
+    c->head = c->tail = -1;
+    return 0;
+}
+
+static void cache_free(struct cache *c) {
+    free(c->block);
+    free(c->prev);
+    free(c->next);
+    free(c->hnext);
+    free(c->ref);
+    free(c->prefetched);
+    free(c->buckets);
+}
+
+static uint32_t hash(const struct cache *c, uint32_t block) {
+    return (block * 2654435761u) & c->mask;
+}
+
+static int32_t cache_find(const struct cache *c, uint32_t block) {
+    int32_t s = c->buckets[hash(c, block)];
+    while (s >= 0 && c->block[s] != block) s = c->hnext[s];
+    return s;
+}
+
+static void list_unlink(struct cache *c, int32_t s) {
+    if (c->prev[s] >= 0) c->next[c->prev[s]] = c->next[s];
+    else c->head = c->next[s];
+    if (c->next[s] >= 0) c->prev[c->next[s]] = c->prev[s];
+    else c->tail = c->prev[s];
+}
+
+static void list_push_head(struct cache *c, int32_t s) {
+    c->prev[s] = -1;
+    c->next[s] = c->head;
+    if (c->head >= 0) c->prev[c->head] = s;
+    c->head = s;
+    if (c->tail < 0) c->tail = s;
+}
+
+static void hash_remove(struct cache *c, int32_t s) {
+    int32_t *p = &c->buckets[hash(c, c->block[s])];
+    while (*p != s) p = &c->hnext[*p];
+    *p = c->hnext[s];
+}
+
+// Acesso a um bloco presente no cache
+static void cache_touch(struct cache *c, int32_t s) {
+    if (c->policy == POLICY_LRU && c->head != s) {
+        list_unlink(c, s);
+        list_push_head(c, s);
+    }
+    c->ref[s] = 1;
+}
+
+// Coloca `block` no cache, descartando a vítima da política se estiver cheio
+static int32_t cache_insert(struct cache *c, uint32_t block, int prefetched) {
+    int32_t s;
+    if (c->used < c->cap) {
+        s = c->used++;
+    } else if (c->policy == POLICY_CLOCK) {
+        while (c->ref[c->hand]) {
+            c->ref[c->hand] = 0;
+            c->hand = (c->hand + 1) % c->cap;
+        }
+        s = c->hand;
+        c->hand = (c->hand + 1) % c->cap;
+        hash_remove(c, s);
+    } else {
+        s = c->tail;
+        list_unlink(c, s);
+        hash_remove(c, s);
+    }
+    c->block[s] = block;
+    c->ref[s] = !prefetched;
+    c->prefetched[s] = prefetched;
+    uint32_t h = hash(c, block);
+    c->hnext[s] = c->buckets[h];
+    c->buckets[h] = s;
+    if (c->policy != POLICY_CLOCK) list_push_head(c, s);
+    return s;
+}
+
+// Aplica um registro; retorna quantos blocos uma falta traz para o cache (o
+// pedido e os da leitura antecipada, guardados em `fetched` se não for NULL)
+static unsigned int cache_access(struct cache *c, const struct ext2_trace_record *r, unsigned int readahead,
+                                 uint32_t blocks_count, uint32_t *fetched) {
+    int32_t s = cache_find(c, r->block);
+    if (r->flags & EXT2_TRACE_WRITE) {
+        if (s >= 0) cache_touch(c, s);
+        else cache_insert(c, r->block, 0);
+        return 0;
+    }
+
+    unsigned int cat = r->cat < EXT2_IO_NCATS ? r->cat : EXT2_IO_DATA;
+    c->cat_reads[cat]++;
+    if (s >= 0) {
+        c->hits++;
+        c->cat_hits[cat]++;
+        if (c->prefetched[s]) {
+            c->prefetched[s] = 0;
+            c->prefetch_used++;
+        }
+        cache_touch(c, s);
+        return 0;
+    }
+    c->misses++;
+    cache_insert(c, r->block, 0);
+    unsigned int n = 1;
+    if (fetched) fetched[0] = r->block;
+    for (unsigned int i = 1; i <= readahead && r->block + i < blocks_count; i++) {
+        if (cache_find(c, r->block + i) >= 0) continue;
+        cache_insert(c, r->block + i, 1);
+        c->prefetch++;
+        if (fetched) fetched[n] = r->block + i;
+        n++;
+    }
+    return n;
+}
+
+// --- Leitura do trace ---
+
+struct trace {
+    struct ext2_trace_header h;
+    struct ext2_trace_record *rec;
+    size_t n;
+    char (*names)[EXT2_TRACE_NAME_LEN];
+};
+
+static int load_trace(const char *path, struct trace *t) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    memset(t, 0, sizeof(*t));
+    if (fread(&t->h, sizeof(t->h), 1, f) != 1 || memcmp(t->h.magic, EXT2_TRACE_MAGIC, sizeof(t->h.magic)) != 0) {
+        fprintf(stderr, "%s: não é um trace do ext2shell\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    // Trace não fechado (processo interrompido): registros até o fim do arquivo
+    size_t n = t->h.records;
+    if (t->h.records == 0) {
+        fseeko(f, 0, SEEK_END);
+        n = (ftello(f) - sizeof(t->h)) / sizeof(struct ext2_trace_record);
+        fseeko(f, sizeof(t->h), SEEK_SET);
+        fprintf(stderr, "%s: trace não foi fechado; usando %zu registros, sem nomes de comandos\n", path, n);
+    }
+    t->rec = malloc((n ? n : 1) * sizeof(struct ext2_trace_record));
+    t->names = calloc(t->h.ncmds ? t->h.ncmds : 1, EXT2_TRACE_NAME_LEN);
+    if (!t->rec || !t->names || fread(t->rec, sizeof(struct ext2_trace_record), n, f) != n) {
+        fprintf(stderr, "%s: trace truncado\n", path);
+        fclose(f);
+        return -1;
+    }
+    t->n = n;
+    if (t->h.ncmds) {
+        fseeko(f, t->h.names_offset, SEEK_SET);
+        if (fread(t->names, EXT2_TRACE_NAME_LEN, t->h.ncmds, f) != t->h.ncmds) t->h.ncmds = 0;
+    }
+    fclose(f);
+    return 0;
+}
+
+static const char *cmd_name(const struct trace *t, uint16_t cmd) {
+    return cmd < t->h.ncmds ? t->names[cmd] : "?";
+}
+
+static void dump(const struct trace *t) {
+    for (size_t i = 0; i < t->n; i++) {
+        const struct ext2_trace_record *r = &t->rec[i];
+        printf("%14.3f %c%c %10u %-12s %s\n", r->ns / 1e3, r->flags & EXT2_TRACE_WRITE ? 'W' : 'R',
+               r->flags & EXT2_TRACE_MEMORY ? 'm' : ' ', r->block,
+               r->cat < EXT2_IO_NCATS ? cat_names[r->cat] : "?", cmd_name(t, r->cmd));
+    }
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Totais do trace: acessos por tipo, categoria e comando e blocos distintos
+static void summary(const struct trace *t, int json) {
+    uint64_t reads = 0, writes = 0, memory = 0, cat_count[EXT2_IO_NCATS] = {0};
+    uint64_t *cmd_count = calloc(t->h.ncmds ? t->h.ncmds : 1, sizeof(uint64_t));
+    uint32_t *blocks = malloc((t->n ? t->n : 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < t->n; i++) {
+        const struct ext2_trace_record *r = &t->rec[i];
+        if (r->flags & EXT2_TRACE_WRITE) writes++;
+        else reads++;
+        if (r->flags & EXT2_TRACE_MEMORY) memory++;
+        if (r->cat < EXT2_IO_NCATS) cat_count[r->cat]++;
+        if (cmd_count && r->cmd < t->h.ncmds) cmd_count[r->cmd]++;
+        if (blocks) blocks[i] = r->block;
+    }
+    size_t distinct = 0;
+    if (blocks) {
+        qsort(blocks, t->n, sizeof(uint32_t), cmp_u32);
+        for (size_t i = 0; i < t->n; i++) distinct += i == 0 || blocks[i] != blocks[i - 1];
+    }
+    double seconds = t->n ? t->rec[t->n - 1].ns / 1e9 : 0;
+
+    if (json) {
+        printf("{\"records\":%zu,\"reads\":%llu,\"writes\":%llu,\"memory\":%llu,\"distinct_blocks\":%zu,"
+               "\"block_size\":%u,\"seconds\":%.6f,\"categories\":{",
+               t->n, (unsigned long long)reads, (unsigned long long)writes, (unsigned long long)memory, distinct,
+               t->h.block_size, seconds);
+        for (int c = 0; c < EXT2_IO_NCATS; c++) {
+            printf("%s\"%s\":%llu", c ? "," : "", cat_names[c], (unsigned long long)cat_count[c]);
+        }
+        printf("}}\n");
+    } else {
+        printf("Trace: %zu acessos em %.3f s (%llu leituras, %llu gravações, %llu no journal em memória)\n",
+               t->n, seconds, (unsigned long long)reads, (unsigned long long)writes, (unsigned long long)memory);
+        printf("Blocos distintos: %zu (%.1f KiB com blocos de %u bytes)\n",
+               distinct, distinct * (double)t->h.block_size / 1024, t->h.block_size);
+        printf("Por categoria:");
+        for (int c = 0; c < EXT2_IO_NCATS; c++) {
+            if (cat_count[c]) printf("  %s=%llu", cat_names[c], (unsigned long long)cat_count[c]);
+        }
+        printf("\nPor comando:");
+        for (unsigned int i = 0; cmd_count && i < t->h.ncmds; i++) {
+            if (cmd_count[i]) printf("  %s=%llu", t->names[i], (unsigned long long)cmd_count[i]);
+        }
+        printf("\n\n");
+    }
+    free(cmd_count);
+    free(blocks);
+}
+
+static void report(const struct cache *c, unsigned int block_size, unsigned int readahead, int json) {
+    uint64_t reads = c->hits + c->misses;
+    uint64_t meta_hits = 0, meta_reads = 0;
+    for (int k = 0; k < EXT2_IO_NCATS; k++) {
+        if (k == EXT2_IO_DATA) continue;
+        meta_hits += c->cat_hits[k];
+        meta_reads += c->cat_reads[k];
+    }
+    double ratio = reads ? 100.0 * c->hits / reads : 0;
+    double meta = meta_reads ? 100.0 * meta_hits / meta_reads : 0;
+    double data = c->cat_reads[EXT2_IO_DATA] ? 100.0 * c->cat_hits[EXT2_IO_DATA] / c->cat_reads[EXT2_IO_DATA] : 0;
+    if (json) {
+        printf("{\"policy\":\"%s\",\"blocks\":%u,\"kib\":%llu,\"readahead\":%u,\"reads\":%llu,\"hits\":%llu,"
+               "\"misses\":%llu,\"hit_pct\":%.2f,\"metadata_hit_pct\":%.2f,\"data_hit_pct\":%.2f,"
+               "\"prefetched\":%llu,\"prefetch_used\":%llu}\n",
+               policy_names[c->policy], c->cap, (unsigned long long)c->cap * block_size / 1024, readahead,
+               (unsigned long long)reads, (unsigned long long)c->hits, (unsigned long long)c->misses,
+               ratio, meta, data, (unsigned long long)c->prefetch, (unsigned long long)c->prefetch_used);
+    } else {
+        printf("%-6s %9u %10llu %10llu %10llu %7.2f%% %7.2f%% %7.2f%% %10llu %10llu\n",
+               policy_names[c->policy], c->cap, (unsigned long long)c->cap * block_size / 1024,
+               (unsigned long long)c->hits, (unsigned long long)c->misses, ratio, meta, data,
+               (unsigned long long)c->prefetch, (unsigned long long)c->prefetch_used);
+    }
+}
+
+// Reproduz o trace contra a imagem: as faltas do cache `c` (e a leitura
+// antecipada) viram leituras de verdade; com `writes`, as gravações regravam
+// o conteúdo atual do bloco
+static int replay_image(const struct trace *t, struct cache *c, unsigned int readahead, const char *image,
+                        int writes, int json) {
+    ext2_fs *fs = ext2_init(image);
+    if (!fs) return -1;
+    if (ext2_block_size(fs) != t->h.block_size) {
+        fprintf(stderr, "replay: a imagem tem blocos de %u bytes e o trace, de %u\n",
+                ext2_block_size(fs), t->h.block_size);
+        ext2_exit(fs);
+        return -1;
+    }
+    char *buf = malloc(t->h.block_size);
+    uint32_t *fetched = malloc((readahead + 1) * sizeof(uint32_t));
+    if (!buf || !fetched) {
+        free(buf);
+        free(fetched);
+        ext2_exit(fs);
+        return -1;
+    }
+
+    struct timespec a, b;
+    ext2_stats_reset(fs);
+    clock_gettime(CLOCK_MONOTONIC, &a);
+    for (size_t i = 0; i < t->n; i++) {
+        const struct ext2_trace_record *r = &t->rec[i];
+        enum ext2_io_cat cat = r->cat < EXT2_IO_NCATS ? r->cat : EXT2_IO_DATA;
+        unsigned int n = cache_access(c, r, readahead, t->h.blocks_count, fetched);
+        for (unsigned int k = 0; k < n; k++) read_block_as(fs, fetched[k], buf, k ? EXT2_IO_DATA : cat);
+        if (writes && (r->flags & EXT2_TRACE_WRITE) && read_block_as(fs, r->block, buf, cat) == 0) {
+            write_block_as(fs, r->block, buf, cat);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &b);
+    double seconds = (b.tv_sec - a.tv_sec) + (b.tv_nsec - a.tv_nsec) / 1e9;
+
+    if (json) {
+        // Duas linhas: o tempo e, em seguida, o JSON do comando stats
+        printf("{\"replay_seconds\":%.6f,\"policy\":\"%s\",\"blocks\":%u}\n",
+               seconds, policy_names[c->policy], c->cap);
+        ext2_stats_json(fs, stdout);
+    } else {
+        printf("\nReprodução na imagem (%s, %u blocos): %.3f s\n", policy_names[c->policy], c->cap, seconds);
+        ext2_stats_print(fs, stdout);
+    }
+    free(buf);
+    free(fetched);
+    ext2_exit(fs);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [-p lru|fifo|clock|all] [-c <blocos>[,<blocos>...]] [-r <leitura_antecipada>]\n"
+                    "       [-i <imagem> [-w]] [-j] <trace>\n"
+                    "     %s -d <trace>                                   (lista os acessos)\n", prog, prog);
+}
+
+int main(int argc, char *argv[]) {
+    const char *trace_path = NULL, *image = NULL, *sizes_arg = "64,256,1024,4096,16384";
+    int policy = -1, readahead = 0, writes = 0, json = 0, list = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            policy = -2;
+            for (int p = 0; p < POLICY_COUNT; p++) {
+                if (strcmp(name, policy_names[p]) == 0) policy = p;
+            }
+            if (strcmp(name, "all") == 0) policy = -1;
+            if (policy == -2) {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) sizes_arg = argv[++i];
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) readahead = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) image = argv[++i];
+        else if (strcmp(argv[i], "-w") == 0) writes = 1;
+        else if (strcmp(argv[i], "-j") == 0) json = 1;
+        else if (strcmp(argv[i], "-d") == 0) list = 1;
+        else if (!trace_path && argv[i][0] != '-') trace_path = argv[i];
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (!trace_path || readahead < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct trace t;
+    if (load_trace(trace_path, &t) != 0) return 1;
+    if (list) {
+        dump(&t);
+        return 0;
+    }
+
+    // Uma configuração por política x tamanho, todas simuladas na mesma passada
+    unsigned int sizes[32], nsizes = 0;
+    for (const char *p = sizes_arg; *p && nsizes < 32;) {
+        long v = strtol(p, (char **)&p, 10);
+        if (v > 0) sizes[nsizes++] = v;
+        if (*p) p++;
+    }
+    if (nsizes == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    unsigned int ncaches = 0;
+    struct cache *caches = malloc(POLICY_COUNT * nsizes * sizeof(struct cache));
+    for (int p = 0; caches && p < POLICY_COUNT; p++) {
+        if (policy >= 0 && p != policy) continue;
+        for (unsigned int k = 0; k < nsizes; k++) {
+            if (cache_init(&caches[ncaches++], p, sizes[k]) != 0) {
+                fprintf(stderr, "replay: memória insuficiente para %u blocos\n", sizes[k]);
+                return 1;
+            }
+        }
+    }
+    if (!caches) return 1;
+
+    summary(&t, json);
+    // Com -i, a primeira configuração é reproduzida na imagem; as demais, só simuladas
+    for (unsigned int k = image ? 1 : 0; k < ncaches; k++) {
+        for (size_t i = 0; i < t.n; i++) cache_access(&caches[k], &t.rec[i], readahead, t.h.blocks_count, NULL);
+    }
+    int ret = 0;
+    if (image) {
+        if (replay_image(&t, &caches[0], readahead, image, writes, json) != 0) ret = 1;
+        if (!json) printf("\n");
+    }
+
+    if (!json) {
+        printf("%-6s %9s %10s %10s %10s %8s %8s %8s %10s %10s\n", "Cache", "Blocos", "KiB", "Acertos", "Faltas",
+               "Taxa", "Meta", "Dados", "Antecip.", "Usadas");
+    }
+    for (unsigned int k = 0; k < ncaches; k++) {
+        if (!image || k > 0 || ret == 0) report(&caches[k], t.h.block_size, readahead, json);
+        cache_free(&caches[k]);
+    }
+    free(caches);
+    free(t.rec);
+    free(t.names);
+    return ret;
+}
@@ -0,0 +1,417 @@
+#define _GNU_SOURCE // accept4
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <arpa/inet.h>
+#include "ext2_server.h"
+#include "ext2_session.h"
+#include "ext2_commands.h"
+
+// Tempo máximo (ms) esperando um cliente lento aceitar a resposta
+#define SEND_TIMEOUT_MS 30000
+
+struct client {
+    int fd;
+    ext2_session session;
+    char inbuf[EXT2_SERVER_MAX_LINE];
+    size_t inlen;
+    char line[EXT2_SERVER_MAX_LINE + 1]; // Comando entregue à worker
+    int busy;       // Há um comando desta conexão em execução (só a worker mexe no cliente)
+    int watched;    // Registrado no epoll
+    int eof;        // O cliente fechou o lado de escrita
+    int quit;       // Pediu exit ou o envio da resposta falhou
+    struct client *next;                 // Fila de trabalho ou de concluídos
+    struct client *all_prev, *all_next;  // Todas as conexões abertas
+};
+
+struct server {
+    ext2_fs *fs;
+    int epfd;
+    int wakefd;                   // eventfd: workers avisam o laço de eventos
+    pthread_rwlock_t image_lock;  // Leitura: consultas; escrita: comandos que alteram a imagem
+    pthread_mutex_t mutex;        // Protege as filas abaixo
+    pthread_cond_t cond;
+    struct client *jobs_head, *jobs_tail;
+    struct client *done;
+    struct client *all;
+    int stopping;
+};
+
+// Marcadores de epoll para os descritores que não são clientes
+static int listen_tag, wake_tag;
+
+static volatile sig_atomic_t stop_requested;
+
+static void on_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static int send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n > 0) {
+            buf += n;
+            len -= n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            struct pollfd p = { fd, POLLOUT, 0 };
+            if (poll(&p, 1, SEND_TIMEOUT_MS) > 0) continue;
+        }
+        return -1;
+    }
+    return 0;
+}
+
+// Envia uma resposta: tamanho e conteúdo
+static int send_reply(int fd, const char *buf, size_t len) {
+    uint32_t header = htonl((uint32_t)len);
+    if (send_all(fd, (const char *)&header, EXT2_SERVER_HEADER) != 0) return -1;
+    return send_all(fd, buf, len);
+}
+
+// --- Workers ---
+
+static void *worker_main(void *arg) {
+    struct server *srv = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&srv->mutex);
+        while (!srv->jobs_head && !srv->stopping) pthread_cond_wait(&srv->cond, &srv->mutex);
+        struct client *c = srv->jobs_head;
+        if (!c) {
+            pthread_mutex_unlock(&srv->mutex);
+            break;
+        }
+        srv->jobs_head = c->next;
+        if (!srv->jobs_head) srv->jobs_tail = NULL;
+        pthread_mutex_unlock(&srv->mutex);
+
+        char *resp = NULL;
+        size_t resp_len = 0;
+        FILE *out = open_memstream(&resp, &resp_len);
+        int quit = 1;
+        if (out) {
+            int modifies = session_command_modifies(c->line);
+            if (modifies) pthread_rwlock_wrlock(&srv->image_lock);
+            else pthread_rwlock_rdlock(&srv->image_lock);
+            quit = session_execute(srv->fs, &c->session, c->line, out, out);
+            pthread_rwlock_unlock(&srv->image_lock);
+            commands_set_output(NULL, NULL);
+
+            fclose(out);
+            if (send_reply(c->fd, resp, resp_len) != 0) quit = 1;
+        }
+        free(resp);
+        c->quit |= quit;
+
+        // Devolve o cliente ao laço de eventos
+        pthread_mutex_lock(&srv->mutex);
+        c->next = srv->done;
+        srv->done = c;
+        pthread_mutex_unlock(&srv->mutex);
+        uint64_t one = 1;
+        if (write(srv->wakefd, &one, sizeof(one)) < 0) perror("eventfd");
+    }
+    return NULL;
+}
+
+// --- Laço de eventos ---
+
+static void client_watch(struct server *srv, struct client *c, int on) {
+    if (c->watched == on) return;
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = c };
+    epoll_ctl(srv->epfd, on ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, c->fd, &ev);
+    c->watched = on;
+}
+
+static void client_close(struct server *srv, struct client *c) {
+    client_watch(srv, c, 0);
+    close(c->fd);
+    if (c->all_prev) c->all_prev->all_next = c->all_next;
+    else srv->all = c->all_next;
+    if (c->all_next) c->all_next->all_prev = c->all_prev;
+    free(c);
+}
+
+// Entrega a próxima linha completa do buffer a uma worker
+static int client_dispatch(struct server *srv, struct client *c) {
+    // Última linha sem '\n' antes do fim da conexão também é um comando
+    if (c->eof && c->inlen > 0 && c->inlen < sizeof(c->inbuf) && !memchr(c->inbuf, '\n', c->inlen)) {
+        c->inbuf[c->inlen++] = '\n';
+    }
+
+    char *nl = memchr(c->inbuf, '\n', c->inlen);
+    if (!nl) return 0;
+    size_t n = nl - c->inbuf + 1;
+    memcpy(c->line, c->inbuf, n);
+    c->line[n] = '\0';
+    memmove(c->inbuf, nl + 1, c->inlen - n);
+    c->inlen -= n;
+
+    // Nada é lido desta conexão até a resposta sair: mantém a ordem dos comandos
+    client_watch(srv, c, 0);
+    c->busy = 1;
+    c->next = NULL;
+
+    pthread_mutex_lock(&srv->mutex);
+    if (srv->jobs_tail) srv->jobs_tail->next = c;
+    else srv->jobs_head = c;
+    srv->jobs_tail = c;
+    pthread_cond_signal(&srv->cond);
+    pthread_mutex_unlock(&srv->mutex);
+    return 1;
+}
+
+// Decide o próximo passo de um cliente ocioso
+static void client_advance(struct server *srv, struct client *c) {
+    if (c->quit) {
+        client_close(srv, c);
+        return;
+    }
+    if (client_dispatch(srv, c)) return;
+    if (c->eof) {
+        client_close(srv, c);
+        return;
+    }
+    if (c->inlen == sizeof(c->inbuf)) {
+        static const char msg[] = "Erro: linha de comando muito longa\n";
+        send_reply(c->fd, msg, sizeof(msg) - 1);
+        client_close(srv, c);
+        return;
+    }
+    client_watch(srv, c, 1);
+}
+
+static void client_read(struct server *srv, struct client *c) {
+    ssize_t n = read(c->fd, c->inbuf + c->inlen, sizeof(c->inbuf) - c->inlen);
+    if (n > 0) c->inlen += n;
+    else if (n == 0 || (errno != EAGAIN && errno != EINTR)) c->eof = 1;
+    client_advance(srv, c);
+}
+
+static void accept_clients(struct server *srv, int listen_fd) {
+    for (;;) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) perror("accept");
+            return;
+        }
+        struct client *c = calloc(1, sizeof(struct client));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        session_init(&c->session);
+        c->all_next = srv->all;
+        if (srv->all) srv->all->all_prev = c;
+        srv->all = c;
+        client_watch(srv, c, 1);
+    }
+}
+
+static void collect_done(struct server *srv) {
+    uint64_t count;
+    if (read(srv->wakefd, &count, sizeof(count)) < 0 && errno != EAGAIN) perror("eventfd");
+
+    pthread_mutex_lock(&srv->mutex);
+    struct client *c = srv->done;
+    srv->done = NULL;
+    pthread_mutex_unlock(&srv->mutex);
+
+    while (c) {
+        struct client *next = c->next;
+        c->busy = 0;
+        client_advance(srv, c);
+        c = next;
+    }
+}
+
+static int open_listen_socket(const char *socket_path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Caminho do socket muito longo: %s\n", socket_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    // Socket antigo: só remove se não houver um servidor respondendo nele
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        fprintf(stderr, "Já existe um servidor em %s\n", socket_path);
+        close(probe);
+        close(fd);
+        return -1;
+    }
+    if (probe >= 0) close(probe);
+    unlink(socket_path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        perror("bind/listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int server_run(ext2_fs *fs, const char *socket_path, int workers) {
+    if (workers <= 0) workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers <= 0) workers = 1;
+
+    int listen_fd = open_listen_socket(socket_path);
+    if (listen_fd < 0) return -1;
+
+    struct server srv = {0};
+    srv.fs = fs;
+    srv.epfd = epoll_create1(EPOLL_CLOEXEC);
+    srv.wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    pthread_rwlock_init(&srv.image_lock, NULL);
+    pthread_mutex_init(&srv.mutex, NULL);
+    pthread_cond_init(&srv.cond, NULL);
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &listen_tag };
+    epoll_ctl(srv.epfd, EPOLL_CTL_ADD, listen_fd, &ev);
+    ev.data.ptr = &wake_tag;
+    epoll_ctl(srv.epfd, EPOLL_CTL_ADD, srv.wakefd, &ev);
+
+    // Sinais de parada só devem interromper o laço de eventos, não as workers
+    struct sigaction sa = {0};
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    sigset_t stop_set, old_set;
+    sigemptyset(&stop_set);
+    sigaddset(&stop_set, SIGINT);
+    sigaddset(&stop_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop_set, &old_set);
+
+    pthread_t *threads = calloc(workers, sizeof(pthread_t));
+    int started = 0;
+    while (threads && started < workers && pthread_create(&threads[started], NULL, worker_main, &srv) == 0) {
+        started++;
+    }
+    pthread_sigmask(SIG_SETMASK, &old_set, NULL);
+
+    int ret = 0;
+    if (started == 0) {
+        fprintf(stderr, "Falha ao criar as threads de trabalho\n");
+        ret = -1;
+    } else {
+        printf("Servindo em %s com %d workers (Ctrl+C para encerrar)\n", socket_path, started);
+        fflush(stdout);
+    }
+
+    struct epoll_event events[64];
+    while (ret == 0 && !stop_requested) {
+        int n = epoll_wait(srv.epfd, events, 64, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            ret = -1;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == &listen_tag) accept_clients(&srv, listen_fd);
+            else if (events[i].data.ptr == &wake_tag) collect_done(&srv);
+            else client_read(&srv, events[i].data.ptr);
+        }
+    }
+
+    // Encerramento: as workers terminam a fila antes de sair
+    pthread_mutex_lock(&srv.mutex);
+    srv.stopping = 1;
+    pthread_cond_broadcast(&srv.cond);
+    pthread_mutex_unlock(&srv.mutex);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    free(threads);
+
+    while (srv.all) client_close(&srv, srv.all);
+    close(listen_fd);
+    unlink(socket_path);
+    close(srv.wakefd);
+    close(srv.epfd);
+    pthread_cond_destroy(&srv.cond);
+    pthread_mutex_destroy(&srv.mutex);
+    pthread_rwlock_destroy(&srv.image_lock);
+    return ret;
+}
+
+// --- Cliente ---
+
+static int recv_all(int fd, void *buf, size_t len) {
+    char *dst = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, dst, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        dst += n;
+        len -= n;
+    }
+    return 0;
+}
+
+int server_client(const char *socket_path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("Falha ao conectar ao servidor");
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    int interactive = isatty(STDIN_FILENO);
+    char line[EXT2_SERVER_MAX_LINE];
+    char buf[4096];
+    int connected = 1;
+
+    while (connected) {
+        if (interactive) {
+            printf("ext2shell> ");
+            fflush(stdout);
+        }
+        if (fgets(line, sizeof(line) - 1, stdin) == NULL) break;
+        size_t len = strlen(line);
+        if (line[len - 1] != '\n') line[len++] = '\n'; // Última linha sem '\n'
+        if (send_all(fd, line, len) != 0) break;
+
+        // Copia exatamente o conteúdo anunciado no cabeçalho
+        uint32_t header;
+        if (recv_all(fd, &header, EXT2_SERVER_HEADER) != 0) break;
+        for (size_t left = ntohl(header); left > 0;) {
+            size_t n = left < sizeof(buf) ? left : sizeof(buf);
+            if (recv_all(fd, buf, n) != 0) {
+                connected = 0;
+                break;
+            }
+            fwrite(buf, 1, n, stdout);
+            left -= n;
+        }
+        fflush(stdout);
+    }
+
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef _EXT2_SERVER_H_
+#define _EXT2_SERVER_H_
+
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Cabeçalho de cada resposta: tamanho do conteúdo (uint32, ordem de rede)
+#define EXT2_SERVER_HEADER 4
+
+// Tamanho máximo de uma linha de comando recebida
+#define EXT2_SERVER_MAX_LINE 1024
+
+/*
+função: Serve a imagem aberta para vários clientes em um socket Unix.
+parâmetros:
+  - socket_path: Caminho do socket a ser criado.
+  - workers: Quantidade de threads que executam comandos (0 = nº de CPUs).
+retorno:
+  - 0 ao encerrar normalmente (SIGINT/SIGTERM), -1 em erro.
+observações:
+  - Protocolo em texto: o cliente envia comandos do shell, um por linha; cada
+    resposta é um quadro com EXT2_SERVER_HEADER bytes de tamanho seguidos da
+    saída do comando, que pode conter qualquer byte (inclusive '\0').
+  - Um laço de eventos (epoll) aceita conexões e lê as linhas; os comandos são
+    executados por um pool de workers. Cada cliente tem sua própria sessão
+    (diretório corrente) e seus comandos são executados em ordem.
+  - Comandos de leitura rodam em paralelo; comandos que alteram a imagem
+    rodam com exclusividade.
+*/
+int server_run(ext2_fs *fs, const char *socket_path, int workers);
+
+/*
+função: Conecta a um servidor e repassa os comandos lidos da entrada padrão.
+parâmetros:
+  - socket_path: Caminho do socket do servidor.
+retorno:
+  - 0 em sucesso, 1 se não foi possível conectar.
+*/
+int server_client(const char *socket_path);
+
+#endif
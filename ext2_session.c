@@ -0,0 +1,340 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ext2_session.h"
+#include "ext2_commands.h"
+#include "ext2_journal.h"
+#include "ext2_stats.h"
+#include "ext2_overlay.h"
+#include "ext2_trace.h"
+#include "ext2_internal.h"
+
+void session_init(ext2_session *s) {
+    s->current_inode = EXT2_ROOT_INO;
+    strcpy(s->current_path, "/");
+}
+
+// Função para atualizar o string do caminho (simplificada)
+static void update_path(ext2_session *s, const char *new_dir) {
+    if (strcmp(new_dir, "/") == 0 && strcmp(s->current_path, "/") == 0) {
+        return; // Não faz nada
+    }
+    
+    if (strcmp(new_dir, "/") == 0) {
+        strcpy(s->current_path, "/");
+        return;
+    }
+    if (strcmp(new_dir, "..") == 0) {
+        // Lógica para subir um diretório
+        if (strcmp(s->current_path, "/") != 0) {
+            char *last_slash = strrchr(s->current_path, '/');
+            if (last_slash == s->current_path) {
+                s->current_path[1] = '\0';
+            } else {
+                *last_slash = '\0';
+            }
+        }
+        return;
+    }
+
+    if (strcmp(new_dir, ".") == 0) {
+        return;
+    }
+
+    if (strcmp(s->current_path, "/") != 0) {
+        strcat(s->current_path, "/");
+    }
+    strcat(s->current_path, new_dir);
+}
+
+
+// Comandos que alteram a imagem (no servidor, executam com exclusividade).
+// check só altera com -r; verify grava apenas o manifesto ao lado da imagem.
+static const char *write_commands[] = {
+    "touch", "mkdir", "rm", "rmdir", "rename", "mv", "append", "truncate", "defrag", "import", "overlay", NULL
+};
+
+int session_command_modifies(const char *line) {
+    char cmd[32] = {0};
+    int pos = 0;
+    sscanf(line, "%31s%n", cmd, &pos);
+    if (strcmp(cmd, "check") == 0) {
+        char arg[32];
+        for (int n = 0; sscanf(line + pos, "%31s%n", arg, &n) == 1; pos += n) {
+            if (strcmp(arg, "-r") == 0) return 1;
+        }
+        return 0;
+    }
+    for (int i = 0; write_commands[i]; i++) {
+        if (strcmp(cmd, write_commands[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static int execute_line(ext2_fs *fs, ext2_session *s, const char *input, FILE *out, FILE *err) {
+    char line[1024];
+    char cmd[32], arg1[128], arg2[128];
+
+    snprintf(line, sizeof(line), "%s", input);
+    commands_set_output(out, err);
+
+    memset(cmd, 0, sizeof(cmd)); memset(arg1, 0, sizeof(arg1)); memset(arg2, 0, sizeof(arg2));
+    sscanf(line, "%31s %127s %127s", cmd, arg1, arg2);
+
+    if (strcmp(cmd, "exit") == 0 || strcmp(cmd, "quit") == 0 || strcmp(cmd, "sair") == 0) return 1;
+    else if (strcmp(cmd, "info") == 0) do_info(fs);
+    else if (strcmp(cmd, "ls") == 0) do_ls(fs, s->current_inode);
+    else if (strcmp(cmd, "pwd") == 0) fprintf(out, "%s\n", s->current_path);
+    else if (strcmp(cmd, "attr") == 0) {
+        if (!*arg1) fprintf(out, "Uso: attr <arquivo|diretorio>\n");
+        else {
+            unsigned int ino = find_inode_by_path(fs, arg1, s->current_inode);
+            if (ino) do_attr(fs, ino);
+            else fprintf(out, "attr: '%s' não encontrado.\n", arg1);
+        }
+    }
+    else if (strcmp(cmd, "cat") == 0) {
+        if (!*arg1) fprintf(out, "Uso: cat <arquivo>\n");
+        else {
+            unsigned int ino = find_inode_by_path(fs, arg1, s->current_inode);
+            if(ino) do_cat(fs, ino);
+            else fprintf(out, "cat: '%s' não encontrado.\n", arg1);
+        }
+    }
+
+    else if (strcmp(cmd, "cd") == 0) {
+        if (!*arg1) { 
+            // cd sem argumentos - vai para raiz
+            s->current_inode = EXT2_ROOT_INO; 
+            strcpy(s->current_path, "/"); 
+        }
+        else if (strcmp(arg1, "/") == 0 && strcmp(s->current_path, "/") == 0) {
+            // Já está na raiz, não faz nada
+            return 0;
+        }
+        else {
+            unsigned int ino = find_inode_by_path(fs, arg1, s->current_inode);
+            if (ino) {
+                ext2_inode new_dir_inode;
+                get_inode(fs, ino, &new_dir_inode);
+                if (new_dir_inode.i_mode & EXT2_S_IFDIR) {
+                    s->current_inode = ino;
+                    update_path(s, arg1);
+                } else {
+                    fprintf(out, "cd: '%s' não é um diretório\n", arg1);
+                }
+            } else {
+                fprintf(out, "cd: '%s' não encontrado\n", arg1);
+            }
+        }
+    }
+
+    else if (strcmp(cmd, "touch") == 0) {
+        if (!*arg1) fprintf(out, "Uso: touch <nome_arquivo>\n");
+        else do_touch(fs, s->current_inode, arg1);
+    }
+    else if (strcmp(cmd, "mkdir") == 0) {
+        if (!*arg1) fprintf(out, "Uso: mkdir <nome_diretorio>\n");
+        else do_mkdir(fs, s->current_inode, arg1);
+    }
+    else if (strcmp(cmd, "rm") == 0) {
+        if (!*arg1) fprintf(out, "Uso: rm [-r] <nome>\n");
+        else if (strcmp(arg1, "-r") == 0) {
+            if (!*arg2) fprintf(out, "Uso: rm -r <nome>\n");
+            else do_rm_recursive(fs, s->current_inode, arg2);
+        }
+        else do_rm(fs, s->current_inode, arg1);
+    }
+    else if (strcmp(cmd, "rmdir") == 0) {
+        if (!*arg1) fprintf(out, "Uso: rmdir <nome_diretorio>\n");
+        else do_rmdir(fs, s->current_inode, arg1);
+    }
+    else if (strcmp(cmd, "rename") == 0 || strcmp(cmd, "mv") == 0) {
+        if (!*arg1 || !*arg2) fprintf(out, "Uso: rename <nome_antigo> <nome_novo>\n");
+        else do_rename(fs, s->current_inode, arg1, arg2);
+    }
+    else if (strcmp(cmd, "append") == 0) {
+        // O texto é o restante da linha após o nome do arquivo
+        char *text = line;
+        for (int skip = 0; skip < 2; skip++) {
+            text += strspn(text, " \t");
+            text += strcspn(text, " \t\n");
+        }
+        text += strspn(text, " \t");
+        text[strcspn(text, "\n")] = '\0';
+        if (!*arg1 || !*text) fprintf(out, "Uso: append <arquivo> <texto>\n");
+        else do_append(fs, s->current_inode, arg1, text);
+    }
+    else if (strcmp(cmd, "truncate") == 0) {
+        if (!*arg1 || !*arg2) fprintf(out, "Uso: truncate <arquivo> <tamanho_em_bytes>\n");
+        else do_truncate(fs, s->current_inode, arg1, strtoull(arg2, NULL, 10));
+    }
+    else if (strcmp(cmd, "cp") == 0) {
+         if (!*arg1 || !*arg2) fprintf(out, "Uso: cp <origem_na_imagem> <destino_no_host>\n");
+         else do_cp(fs, s->current_inode, arg1, arg2);
+    }
+    else if (strcmp(cmd, "check") == 0) {
+        int repair = 0, threads = 0, bad = 0;
+        char *save = NULL;
+        strtok_r(line, " \t\n", &save); // Nome do comando
+        for (char *tok; (tok = strtok_r(NULL, " \t\n", &save));) {
+            if (strcmp(tok, "-r") == 0) repair = 1;
+            else if (strcmp(tok, "-j") == 0 && (tok = strtok_r(NULL, " \t\n", &save))) threads = atoi(tok);
+            else bad = 1;
+        }
+        if (bad) fprintf(out, "Uso: check [-r] [-j <threads>]\n");
+        else do_check(fs, repair, threads);
+    }
+    else if (strcmp(cmd, "defrag") == 0) {
+        int dry_run = strcmp(arg1, "-n") == 0;
+        const char *path = dry_run ? arg2 : arg1;
+        if (!*path) do_defrag(fs, s->current_inode, s->current_path, dry_run);
+        else {
+            unsigned int ino = find_inode_by_path(fs, path, s->current_inode);
+            if (ino) do_defrag(fs, ino, path, dry_run);
+            else fprintf(out, "defrag: '%s' não encontrado.\n", path);
+        }
+    }
+    else if (strcmp(cmd, "du") == 0) {
+        int threads = 0, bad = 0;
+        const char *path = NULL;
+        char *save = NULL;
+        strtok_r(line, " \t\n", &save); // Nome do comando
+        for (char *tok; (tok = strtok_r(NULL, " \t\n", &save));) {
+            if (strcmp(tok, "-j") == 0 && (tok = strtok_r(NULL, " \t\n", &save))) threads = atoi(tok);
+            else if (!path && tok[0] != '-') path = tok;
+            else bad = 1;
+        }
+        unsigned int ino = path ? find_inode_by_path(fs, path, s->current_inode) : s->current_inode;
+        if (bad) fprintf(out, "Uso: du [-j <threads>] [caminho]\n");
+        else if (!ino) fprintf(out, "du: '%s' não encontrado.\n", path);
+        else do_du(fs, ino, path ? path : s->current_path, threads);
+    }
+    else if (strcmp(cmd, "find") == 0) {
+        struct ext2_find_query q = {0};
+        enum ext2_find_mode mode = EXT2_FIND_AUTO;
+        int threads = 0, bad = 0;
+        const char *path = NULL;
+        char *save = NULL;
+        strtok_r(line, " \t\n", &save); // Nome do comando
+        for (char *tok; (tok = strtok_r(NULL, " \t\n", &save));) {
+            if (strcmp(tok, "-j") == 0 && (tok = strtok_r(NULL, " \t\n", &save))) threads = atoi(tok);
+            else if (strcmp(tok, "-walk") == 0) mode = EXT2_FIND_WALK;
+            else if (strcmp(tok, "-scan") == 0) mode = EXT2_FIND_SCAN;
+            else if (tok[0] == '-') bad |= ext2_find_predicate(&q, tok, strtok_r(NULL, " \t\n", &save)) != 0;
+            else if (!path) path = tok;
+            else bad = 1;
+        }
+        unsigned int ino = path ? find_inode_by_path(fs, path, s->current_inode) : s->current_inode;
+        if (bad) {
+            fprintf(out, "Uso: find [caminho] [-name <padrão>] [-type f|d|l] [-size [+-]N[k|M|G]] [-mtime [+-]N]\n"
+                         "            [-j <threads>] [-walk|-scan]\n");
+        }
+        else if (!ino) fprintf(out, "find: '%s' não encontrado.\n", path);
+        else do_find(fs, ino, path ? path : s->current_path, &q, mode, threads);
+    }
+    else if (strcmp(cmd, "verify") == 0) {
+        enum ext2_verify_mode mode = EXT2_VERIFY_FULL;
+        int threads = 0, bad = 0;
+        char *save = NULL;
+        strtok_r(line, " \t\n", &save); // Nome do comando
+        for (char *tok; (tok = strtok_r(NULL, " \t\n", &save));) {
+            if (strcmp(tok, "-i") == 0) mode = EXT2_VERIFY_INCREMENTAL;
+            else if (strcmp(tok, "-n") == 0) mode = EXT2_VERIFY_REBUILD;
+            else if (strcmp(tok, "-j") == 0 && (tok = strtok_r(NULL, " \t\n", &save))) threads = atoi(tok);
+            else bad = 1;
+        }
+        if (bad) fprintf(out, "Uso: verify [-i|-n] [-j <threads>]\n");
+        else do_verify(fs, mode, threads);
+    }
+    else if (strcmp(cmd, "freefrag") == 0) {
+        int per_group = strcmp(arg1, "-g") == 0;
+        const char *size = per_group ? arg2 : arg1;
+        if (*size && atoi(size) <= 0) fprintf(out, "Uso: freefrag [-g] [blocos_por_alocação]\n");
+        else do_freefrag(fs, *size ? atoi(size) : 0, per_group);
+    }
+    else if (strcmp(cmd, "import") == 0) {
+        if (!*arg1) fprintf(out, "Uso: import <diretório_no_host> [destino_na_imagem]\n");
+        else if (!*arg2) do_import(fs, s->current_inode, arg1, s->current_path);
+        else {
+            unsigned int ino = find_inode_by_path(fs, arg2, s->current_inode);
+            if (ino) do_import(fs, ino, arg1, arg2);
+            else fprintf(out, "import: '%s' não encontrado.\n", arg2);
+        }
+    }
+    else if (strcmp(cmd, "overlay") == 0) {
+        if (!*arg1) ext2_overlay_print(fs, out);
+        else if (strcmp(arg1, "commit") == 0 || strcmp(arg1, "discard") == 0) {
+            int commit = strcmp(arg1, "commit") == 0;
+            long long n = commit ? ext2_overlay_commit(fs) : ext2_overlay_discard(fs);
+            if (n < 0) fprintf(err, "overlay: %s falhou (a imagem foi aberta com -O?)\n", arg1);
+            else fprintf(out, "%lld blocos %s\n", n, commit ? "gravados na base" : "descartados");
+            // O diretório corrente pode não existir mais na base
+            if (n >= 0 && !commit) session_init(s);
+        }
+        else fprintf(out, "Uso: overlay [commit | discard]\n");
+    }
+    else if (strcmp(cmd, "stats") == 0) {
+        if (!*arg1) ext2_stats_print(fs, out);
+        else if (strcmp(arg1, "json") == 0) ext2_stats_json(fs, out);
+        else if (strcmp(arg1, "reset") == 0) ext2_stats_reset(fs);
+        else fprintf(out, "Uso: stats [json | reset]\n");
+    }
+    else if (strcmp(cmd, "trace") == 0) {
+        if (!*arg1) fprintf(out, "Uso: trace <arquivo_no_host> | trace off\n");
+        else if (strcmp(arg1, "off") == 0) {
+            long long n = ext2_trace_stop(fs);
+            if (n < 0) fprintf(out, "trace: nenhum trace aberto.\n");
+            else fprintf(out, "trace: %lld acessos gravados.\n", n);
+        }
+        else if (ext2_trace_start(fs, arg1) == 0) fprintf(out, "trace: gravando acessos em %s\n", arg1);
+    }
+    else if (strcmp(cmd, "print") == 0) {
+        sscanf(line, "%*s %127s %127s", arg1, arg2);
+
+        if (strcmp(arg1, "superblock") == 0) cmd_print_superblock(fs);
+        else if (strcmp(arg1, "groups") == 0) cmd_print_groups(fs);
+        else if (strcmp(arg1, "inode") == 0 && *arg2) {
+            uint32_t ino = atoi(arg2);
+            cmd_print_inode(fs, ino);
+        } else {
+            fprintf(out, "Uso: print [superblock | groups | inode <número>]\n");
+        }
+    }
+    else if (strlen(cmd) > 0) {
+        fprintf(out, "Comando não encontrado: %s\n", cmd);
+    }
+
+    fflush(out);
+    return 0;
+}
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+int session_execute(ext2_fs *fs, ext2_session *s, const char *input, FILE *out, FILE *err) {
+    uint64_t start = now_ns();
+    char cmd[32] = {0};
+    int named = sscanf(input, "%31s", cmd) == 1;
+    if (named) ext2_trace_command(fs, cmd);
+
+    // Cada comando de escrita é uma operação atômica no journal (se houver);
+    // consultas não seguram o commit enquanto leem
+    int modifies = session_command_modifies(input);
+    if (modifies) ext2_journal_begin(fs);
+    int ret = execute_line(fs, s, input, out, err);
+    if (modifies) ext2_journal_end(fs);
+    // Sem journal nem adiamento, contadores do superbloco e da GDT vão ao
+    // disco ao fim de cada comando (só os blocos marcados)
+    if (!fs->defer_metadata && !fs->journal) ext2_flush_metadata(fs);
+
+    // A latência inclui o fim da transação (espera pelo commit do journal)
+    if (named) {
+        ext2_stats_command(fs, cmd, now_ns() - start);
+        ext2_trace_command(fs, NULL);
+    }
+    return ret;
+}
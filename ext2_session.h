@@ -0,0 +1,46 @@
+#ifndef _EXT2_SESSION_H_
+#define _EXT2_SESSION_H_
+
+#include <stdio.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Estado de uma sessão do shell (um terminal interativo ou um cliente do servidor)
+typedef struct {
+    unsigned int current_inode;
+    char current_path[1024];
+} ext2_session;
+
+/*
+função: Inicializa a sessão no diretório raiz.
+parâmetros:
+  - s: Sessão a ser inicializada.
+*/
+void session_init(ext2_session *s);
+
+/*
+função: Interpreta e executa uma linha de comando do shell.
+parâmetros:
+  - s: Sessão (diretório corrente).
+  - line: Linha digitada (pode terminar em '\n').
+  - out: Destino da saída normal.
+  - err: Destino das mensagens de erro.
+retorno:
+  - 1 se a linha pediu para encerrar a sessão (exit/quit/sair), 0 caso contrário.
+observações:
+  - Sem journal e sem ext2_set_deferred_flush(), grava superbloco e
+    descritores alterados pelo comando (ext2_flush_metadata()).
+*/
+int session_execute(ext2_fs *fs, ext2_session *s, const char *line, FILE *out, FILE *err);
+
+/*
+função: Indica se a linha contém um comando que altera a imagem.
+parâmetros:
+  - line: Linha de comando.
+retorno:
+  - 1 para comandos de escrita (touch, mkdir, rm, check -r, ...), 0 para os
+    de leitura (inclusive check sem -r e verify, que só grava o manifesto).
+*/
+int session_command_modifies(const char *line);
+
+#endif
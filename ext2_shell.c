@@ -3,156 +3,118 @@
 #include <string.h>
 #include "ext2_fs.h"
 #include "ext2_lib.h"
-#include "ext2_commands.h"
+#include "ext2_session.h"
+#include "ext2_server.h"
+#include "ext2_batch.h"
+#include "ext2_journal.h"
+#include "ext2_overlay.h"
+#include "ext2_populate.h"
+#include "ext2_stats.h"
+#include "ext2_trace.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [-J] [-B] [-S <estatísticas.json>] [-T <trace>] [-O <delta>] <arquivo_de_imagem_ext2>\n", prog);
+    fprintf(stderr, "     %s -s <socket> [-w <threads>] <arquivo_de_imagem_ext2>   (servidor)\n", prog);
+    fprintf(stderr, "     %s -c <socket>                                          (cliente)\n", prog);
+    fprintf(stderr, "     %s -b <script|-> [-j <threads>] [-t] <arquivo_de_imagem_ext2>  (lote)\n", prog);
+    fprintf(stderr, "     %s -p <diretório_no_host> [-J] <arquivo_de_imagem_ext2>        (copia para a raiz)\n", prog);
+}
 
-// Estado do Shell
-static unsigned int current_inode = EXT2_ROOT_INO;
-static char current_path[1024] = "/";
+int main(int argc, char *argv[]) {
+    const char *socket_path = NULL;
+    const char *image_path = NULL;
+    const char *batch_path = NULL;
+    const char *populate_dir = NULL;
+    const char *stats_path = NULL;
+    const char *trace_path = NULL;
+    const char *overlay_path = NULL;
+    int workers = 0, jobs = 1, timing = 0, journal = 0, barriers = 0;
+
+    if (argc == 3 && strcmp(argv[1], "-c") == 0) {
+        return server_client(argv[2]);
+    }
 
-// Função para atualizar o string do caminho (simplificada)
-void update_path(const char *new_dir) {
-    if (strcmp(new_dir, "/") == 0 && strcmp(current_path, "/") == 0) {
-        return; // Não faz nada
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) socket_path = argv[++i];
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) workers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) batch_path = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) jobs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) populate_dir = argv[++i];
+        else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) stats_path = argv[++i];
+        else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) trace_path = argv[++i];
+        else if (strcmp(argv[i], "-O") == 0 && i + 1 < argc) overlay_path = argv[++i];
+        else if (strcmp(argv[i], "-t") == 0) timing = 1;
+        else if (strcmp(argv[i], "-J") == 0) journal = 1;
+        else if (strcmp(argv[i], "-B") == 0) barriers = 1;
+        else if (!image_path && argv[i][0] != '-') image_path = argv[i];
+        else {
+            usage(argv[0]);
+            return 1;
+        }
     }
-    
-    if (strcmp(new_dir, "/") == 0) {
-        strcpy(current_path, "/");
-        return;
+    if (!image_path) {
+        usage(argv[0]);
+        return 1;
     }
-    if (strcmp(new_dir, "..") == 0) {
-        // Lógica para subir um diretório
-        if (strcmp(current_path, "/") != 0) {
-            char *last_slash = strrchr(current_path, '/');
-            if (last_slash == current_path) {
-                current_path[1] = '\0';
-            } else {
-                *last_slash = '\0';
-            }
+
+    FILE *script = NULL;
+    if (batch_path) {
+        script = strcmp(batch_path, "-") == 0 ? stdin : fopen(batch_path, "r");
+        if (!script) {
+            perror(batch_path);
+            return 1;
         }
-        return;
     }
 
-    if (strcmp(new_dir, ".") == 0) {
-        return;
+    // Com -O, a imagem é só a base: as gravações vão para o delta
+    ext2_fs *fs = overlay_path ? ext2_init_overlay(image_path, overlay_path) : ext2_init(image_path);
+    if (!fs) return 1;
+    ext2_set_write_barriers(fs, barriers);
+    if (stats_path) ext2_stats_dump_on_exit(fs, stats_path);
+    if (trace_path && ext2_trace_start(fs, trace_path) != 0) {
+        ext2_exit(fs);
+        return 1;
     }
-
-    if (strcmp(current_path, "/") != 0) {
-        strcat(current_path, "/");
+    if (journal && ext2_journal_enable(fs) != 0) {
+        ext2_exit(fs);
+        return 1;
     }
-    strcat(current_path, new_dir);
-}
 
+    if (populate_dir) {
+        // Cópia de uma árvore do host para a raiz da imagem
+        int ret = ext2_populate(fs, populate_dir, EXT2_ROOT_INO, stdout);
+        ext2_exit(fs);
+        return ret < 0 ? 1 : 0;
+    }
 
-int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        fprintf(stderr, "Uso: %s <arquivo_de_imagem_ext2>\n", argv[0]);
-        return 1;
+    if (script) {
+        // Modo lote: sem prompt, metadados gravados só no fim
+        long executed = batch_run(fs, script, jobs < 1 ? 1 : jobs, timing);
+        if (script != stdin) fclose(script);
+        ext2_exit(fs);
+        return executed < 0 ? 1 : 0;
     }
 
-    if (ext2_init(argv[1]) != 0) return 1;
+    if (socket_path) {
+        // Modo servidor: a imagem fica aberta e é compartilhada por todos os clientes
+        int ret = server_run(fs, socket_path, workers);
+        ext2_exit(fs);
+        return ret == 0 ? 0 : 1;
+    }
 
+    ext2_session session;
+    session_init(&session);
     char line[256];
-    char cmd[32], arg1[128], arg2[128];
 
     while (1) {
-        printf("ext2shell:[%s] $ ", current_path);
+        printf("ext2shell:[%s] $ ", session.current_path);
         fflush(stdout);
 
         if (fgets(line, sizeof(line), stdin) == NULL) break;
-
-        memset(cmd, 0, sizeof(cmd)); memset(arg1, 0, sizeof(arg1)); memset(arg2, 0, sizeof(arg2));
-        sscanf(line, "%31s %127s %127s", cmd, arg1, arg2);
-
-        if (strcmp(cmd, "exit") == 0 || strcmp(cmd, "quit") == 0 || strcmp(cmd, "sair") == 0) break;
-        else if (strcmp(cmd, "info") == 0) do_info();
-        else if (strcmp(cmd, "ls") == 0) do_ls(current_inode);
-        else if (strcmp(cmd, "pwd") == 0) printf("%s\n", current_path);
-        else if (strcmp(cmd, "attr") == 0) {
-            if (!*arg1) printf("Uso: attr <arquivo|diretorio>\n");
-            else {
-                unsigned int ino = find_inode_by_path(arg1, current_inode);
-                if (ino) do_attr(ino);
-                else printf("attr: '%s' não encontrado.\n", arg1);
-            }
-        }
-        else if (strcmp(cmd, "cat") == 0) {
-            if (!*arg1) printf("Uso: cat <arquivo>\n");
-            else {
-                unsigned int ino = find_inode_by_path(arg1, current_inode);
-                if(ino) do_cat(ino);
-                else printf("cat: '%s' não encontrado.\n", arg1);
-            }
-        }
-
-        else if (strcmp(cmd, "cd") == 0) {
-            if (!*arg1) { 
-                // cd sem argumentos - vai para raiz
-                current_inode = EXT2_ROOT_INO; 
-                strcpy(current_path, "/"); 
-            }
-            else if (strcmp(arg1, "/") == 0 && strcmp(current_path, "/") == 0) {
-                // Já está na raiz, não faz nada
-                continue;
-            }
-            else {
-                unsigned int ino = find_inode_by_path(arg1, current_inode);
-                if (ino) {
-                    ext2_inode new_dir_inode;
-                    get_inode(ino, &new_dir_inode);
-                    if (new_dir_inode.i_mode & EXT2_S_IFDIR) {
-                        current_inode = ino;
-                        update_path(arg1);
-                    } else {
-                        printf("cd: '%s' não é um diretório\n", arg1);
-                    }
-                } else {
-                    printf("cd: '%s' não encontrado\n", arg1);
-                }
-            }
-        }
-
-        else if (strcmp(cmd, "touch") == 0) {
-            if (!*arg1) printf("Uso: touch <nome_arquivo>\n");
-            else do_touch(current_inode, arg1);
-        }
-        else if (strcmp(cmd, "mkdir") == 0) {
-            if (!*arg1) printf("Uso: mkdir <nome_diretorio>\n");
-            else do_mkdir(current_inode, arg1);
-        }
-        else if (strcmp(cmd, "rm") == 0) {
-            if (!*arg1) printf("Uso: rm <nome_arquivo>\n");
-            else do_rm(current_inode, arg1);
-        }
-        else if (strcmp(cmd, "rmdir") == 0) {
-            if (!*arg1) printf("Uso: rmdir <nome_diretorio>\n");
-            else do_rmdir(current_inode, arg1);
-        }
-        else if (strcmp(cmd, "rename") == 0 || strcmp(cmd, "mv") == 0) {
-            if (!*arg1 || !*arg2) printf("Uso: rename <nome_antigo> <nome_novo>\n");
-            else do_rename(current_inode, arg1, arg2);
-        }
-        else if (strcmp(cmd, "cp") == 0) {
-             if (!*arg1 || !*arg2) printf("Uso: cp <origem_na_imagem> <destino_no_host>\n");
-             else do_cp(current_inode, arg1, arg2);
-        }
-        else if (strcmp(cmd, "print") == 0) {
-            sscanf(line, "%*s %127s %127s", arg1, arg2);
-
-            if (strcmp(arg1, "superblock") == 0) cmd_print_superblock();
-            else if (strcmp(arg1, "groups") == 0) cmd_print_groups();
-            else if (strcmp(arg1, "inode") == 0 && *arg2) {
-                uint32_t ino = atoi(arg2);
-                cmd_print_inode(ino);
-            } else {
-                printf("Uso: print [superblock | groups | inode <número>]\n");
-            }
-        }
-        else if (strlen(cmd) > 0) {
-            printf("Comando não encontrado: %s\n", cmd);
-        }
+        if (session_execute(fs, &session, line, stdout, stderr)) break;
     }
 
-    ext2_exit();
+    ext2_exit(fs);
     printf("\nSaindo do ext2shell.\n");
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,191 @@
+#include <time.h>
+#include "ext2_stats.h"
+#include "ext2_internal.h"
+
+static const char *cat_names[EXT2_IO_NCATS] = {
+    "superblock", "gdt", "bitmap", "inode_table", "directory", "data", "indirect", "journal"
+};
+
+static const char *op_names[EXT2_OP_COUNT] = {
+    "get_inode", "write_inode", "search_directory", "alloc_inode", "free_inode",
+    "alloc_block", "free_block", "journal_hit", "page_hit", "map_hit",
+    "journal_commit", "checkpoint", "sync"
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+enum ext2_io_cat stats_block_cat(ext2_fs *fs, uint32_t block, enum ext2_io_cat fallback) {
+    uint32_t first = fs->sb.s_first_data_block;
+    if (block < first) return EXT2_IO_SUPER; // Bloco 0 com blocos de 1 KiB (boot + nada mais)
+    uint32_t group = (block - first) / fs->sb.s_blocks_per_group;
+    uint32_t offset = (block - first) % fs->sb.s_blocks_per_group;
+    if (group >= fs->group_count) return fallback;
+
+    // Posições fixas depois de mkfs: lidas sem lock
+    const ext2_group_desc *gd = &fs->gd[group];
+    if (block == gd->bg_block_bitmap || block == gd->bg_inode_bitmap) return EXT2_IO_BITMAP;
+    if (block >= gd->bg_inode_table && block < gd->bg_inode_table + fs->stats.itable_blocks) return EXT2_IO_INODE;
+    if (offset < fs->stats.super_area && group_has_super(fs, group)) {
+        return offset == 0 ? EXT2_IO_SUPER : EXT2_IO_GDT;
+    }
+    return fallback;
+}
+
+void stats_init(ext2_fs *fs) {
+    struct ext2_stats *st = &fs->stats;
+    pthread_mutex_init(&st->lock, NULL);
+    st->itable_blocks = (fs->sb.s_inodes_per_group + fs->inodes_per_block - 1) / fs->inodes_per_block;
+    st->super_area = 1 + (fs->group_count * sizeof(ext2_group_desc) + fs->block_size - 1) / fs->block_size +
+                     fs->sb.s_reserved_gdt_blocks;
+    st->start_ns = now_ns();
+}
+
+void stats_destroy(ext2_fs *fs) {
+    struct ext2_stats *st = &fs->stats;
+    if (st->exit_path) {
+        FILE *out = fopen(st->exit_path, "w");
+        if (out) {
+            ext2_stats_json(fs, out);
+            fclose(out);
+        } else {
+            perror(st->exit_path);
+        }
+        free(st->exit_path);
+    }
+    pthread_mutex_destroy(&st->lock);
+}
+
+void ext2_stats_dump_on_exit(ext2_fs *fs, const char *path) {
+    pthread_mutex_lock(&fs->stats.lock);
+    free(fs->stats.exit_path);
+    fs->stats.exit_path = path ? strdup(path) : NULL;
+    pthread_mutex_unlock(&fs->stats.lock);
+}
+
+void ext2_stats_reset(ext2_fs *fs) {
+    struct ext2_stats *st = &fs->stats;
+    pthread_mutex_lock(&st->lock);
+    for (int c = 0; c < EXT2_IO_NCATS; c++) {
+        __atomic_store_n(&st->reads[c], 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&st->writes[c], 0, __ATOMIC_RELAXED);
+    }
+    for (int o = 0; o < EXT2_OP_COUNT; o++) __atomic_store_n(&st->ops[o], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->read_calls, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->write_calls, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->bytes_read, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&st->bytes_written, 0, __ATOMIC_RELAXED);
+    memset(st->cmds, 0, sizeof(st->cmds));
+    st->ncmds = 0;
+    st->start_ns = now_ns();
+    pthread_mutex_unlock(&st->lock);
+}
+
+void ext2_stats_command(ext2_fs *fs, const char *cmd, uint64_t ns) {
+    struct ext2_stats *st = &fs->stats;
+    uint64_t us = ns / 1000;
+    unsigned int bucket = 0;
+    while (bucket + 1 < EXT2_STATS_BUCKETS && us >= (2ull << bucket)) bucket++;
+
+    pthread_mutex_lock(&st->lock);
+    struct ext2_cmd_stats *c = NULL;
+    for (unsigned int i = 0; i < st->ncmds && !c; i++) {
+        if (strcmp(st->cmds[i].name, cmd) == 0) c = &st->cmds[i];
+    }
+    if (!c) {
+        // O último lugar fica reservado para os nomes que não couberem
+        c = &st->cmds[st->ncmds < EXT2_STATS_MAX_COMMANDS ? st->ncmds : EXT2_STATS_MAX_COMMANDS - 1];
+        if (st->ncmds < EXT2_STATS_MAX_COMMANDS) st->ncmds++;
+        snprintf(c->name, sizeof(c->name), "%s", st->ncmds == EXT2_STATS_MAX_COMMANDS ? "(outros)" : cmd);
+    }
+    c->count++;
+    c->total_ns += ns;
+    if (ns > c->max_ns) c->max_ns = ns;
+    c->hist[bucket]++;
+    pthread_mutex_unlock(&st->lock);
+}
+
+// Limite superior (µs) da faixa que contém o percentil `pct`
+static uint64_t percentile_us(const struct ext2_cmd_stats *c, unsigned int pct) {
+    uint64_t target = (c->count * pct + 99) / 100, seen = 0;
+    for (unsigned int b = 0; b < EXT2_STATS_BUCKETS; b++) {
+        seen += c->hist[b];
+        if (seen >= target) return 2ull << b;
+    }
+    return 2ull << (EXT2_STATS_BUCKETS - 1);
+}
+
+static uint64_t load(const uint64_t *counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+void ext2_stats_print(ext2_fs *fs, FILE *out) {
+    struct ext2_stats *st = &fs->stats;
+    fprintf(out, "Tempo de contagem: %.1f ms\n", (now_ns() - st->start_ns) / 1e6);
+    fprintf(out, "%-12s %12s %12s\n", "Categoria", "Lidos", "Gravados");
+    for (int c = 0; c < EXT2_IO_NCATS; c++) {
+        fprintf(out, "%-12s %12llu %12llu\n", cat_names[c],
+                (unsigned long long)load(&st->reads[c]), (unsigned long long)load(&st->writes[c]));
+    }
+    fprintf(out, "Chamadas: %llu leituras, %llu gravações; %.1f KiB lidos, %.1f KiB gravados\n",
+            (unsigned long long)load(&st->read_calls), (unsigned long long)load(&st->write_calls),
+            load(&st->bytes_read) / 1024.0, load(&st->bytes_written) / 1024.0);
+    fprintf(out, "Operações:");
+    for (int o = 0; o < EXT2_OP_COUNT; o++) {
+        fprintf(out, "%s%s=%llu", o % 5 == 0 ? "\n  " : "  ", op_names[o], (unsigned long long)load(&st->ops[o]));
+    }
+    fprintf(out, "\n");
+
+    pthread_mutex_lock(&st->lock);
+    if (st->ncmds > 0) {
+        fprintf(out, "%-12s %8s %12s %12s %10s %10s\n", "Comando", "Vezes", "Média (µs)", "Máx (µs)", "p50 <", "p99 <");
+    }
+    for (unsigned int i = 0; i < st->ncmds; i++) {
+        const struct ext2_cmd_stats *c = &st->cmds[i];
+        fprintf(out, "%-12s %8llu %12.1f %12.1f %10llu %10llu\n", c->name, (unsigned long long)c->count,
+                c->total_ns / 1e3 / c->count, c->max_ns / 1e3,
+                (unsigned long long)percentile_us(c, 50), (unsigned long long)percentile_us(c, 99));
+    }
+    pthread_mutex_unlock(&st->lock);
+}
+
+void ext2_stats_json(ext2_fs *fs, FILE *out) {
+    struct ext2_stats *st = &fs->stats;
+    fprintf(out, "{\"elapsed_ns\":%llu,\"block_size\":%u,\"blocks\":{",
+            (unsigned long long)(now_ns() - st->start_ns), fs->block_size);
+    for (int c = 0; c < EXT2_IO_NCATS; c++) {
+        fprintf(out, "%s\"%s\":{\"read\":%llu,\"written\":%llu}", c ? "," : "", cat_names[c],
+                (unsigned long long)load(&st->reads[c]), (unsigned long long)load(&st->writes[c]));
+    }
+    fprintf(out, "},\"read_calls\":%llu,\"write_calls\":%llu,\"bytes_read\":%llu,\"bytes_written\":%llu,\"ops\":{",
+            (unsigned long long)load(&st->read_calls), (unsigned long long)load(&st->write_calls),
+            (unsigned long long)load(&st->bytes_read), (unsigned long long)load(&st->bytes_written));
+    for (int o = 0; o < EXT2_OP_COUNT; o++) {
+        fprintf(out, "%s\"%s\":%llu", o ? "," : "", op_names[o], (unsigned long long)load(&st->ops[o]));
+    }
+    fprintf(out, "},\"commands\":{");
+
+    pthread_mutex_lock(&st->lock);
+    for (unsigned int i = 0; i < st->ncmds; i++) {
+        const struct ext2_cmd_stats *c = &st->cmds[i];
+        // Nomes vêm da linha digitada: escapa o que o JSON não aceita cru
+        fprintf(out, "%s\"", i ? "," : "");
+        for (const char *p = c->name; *p; p++) {
+            if (*p == '"' || *p == '\\') fprintf(out, "\\%c", *p);
+            else if ((unsigned char)*p < 0x20) fprintf(out, "\\u%04x", *p);
+            else fputc(*p, out);
+        }
+        fprintf(out, "\":{\"count\":%llu,\"total_ns\":%llu,\"max_ns\":%llu,\"hist_log2_us\":[",
+                (unsigned long long)c->count, (unsigned long long)c->total_ns, (unsigned long long)c->max_ns);
+        // Faixas vazias do fim são omitidas
+        int last = EXT2_STATS_BUCKETS - 1;
+        while (last > 0 && c->hist[last] == 0) last--;
+        for (int b = 0; b <= last; b++) fprintf(out, "%s%llu", b ? "," : "", (unsigned long long)c->hist[b]);
+        fprintf(out, "]}");
+    }
+    pthread_mutex_unlock(&st->lock);
+    fprintf(out, "}}\n");
+}
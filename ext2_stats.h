@@ -0,0 +1,88 @@
+#ifndef _EXT2_STATS_H_
+#define _EXT2_STATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Operações contadas pela biblioteca
+enum ext2_op {
+    EXT2_OP_GET_INODE,
+    EXT2_OP_WRITE_INODE,
+    EXT2_OP_SEARCH_DIR,
+    EXT2_OP_ALLOC_INODE,      // Inodes alocados
+    EXT2_OP_FREE_INODE,       // Inodes liberados
+    EXT2_OP_ALLOC_BLOCK,      // Blocos alocados
+    EXT2_OP_FREE_BLOCK,       // Blocos liberados
+    EXT2_OP_JOURNAL_HIT,      // read_block atendido pelo journal em memória
+    EXT2_OP_PAGE_HIT,         // Escrita em página suja já em memória (ext2_file)
+    EXT2_OP_MAP_HIT,          // Indireto já carregado no flush (ext2_file)
+    EXT2_OP_JOURNAL_COMMIT,
+    EXT2_OP_CHECKPOINT,
+    EXT2_OP_SYNC,             // fdatasync/fsync da imagem
+    EXT2_OP_COUNT
+};
+
+// Faixas do histograma de latência: a faixa i conta comandos com duração
+// em [2^i, 2^(i+1)) µs (a primeira inclui < 1 µs, a última tudo acima)
+#define EXT2_STATS_BUCKETS 32
+#define EXT2_STATS_MAX_COMMANDS 48
+
+// Latência de um comando do shell
+struct ext2_cmd_stats {
+    char name[32];
+    uint64_t count;
+    uint64_t total_ns, max_ns;
+    uint64_t hist[EXT2_STATS_BUCKETS];
+};
+
+/*
+function: Registra a execução de um comando do shell.
+param:
+  - cmd: Nome do comando.
+  - ns: Duração em nanossegundos.
+return: void.
+observações:
+  - Até EXT2_STATS_MAX_COMMANDS nomes; os demais são somados em "(outros)".
+*/
+void ext2_stats_command(ext2_fs *fs, const char *cmd, uint64_t ns);
+
+/*
+function: Escreve as estatísticas do handle em texto (comando stats).
+param:
+  - out: Destino do relatório.
+return: void.
+observações:
+  - Blocos lidos e gravados por categoria, chamadas de sistema, bytes,
+    acertos em memória, contadores de operações e, por comando, quantidade,
+    média, máximo e percentis (p50/p99, pelo limite superior da faixa).
+*/
+void ext2_stats_print(ext2_fs *fs, FILE *out);
+
+/*
+function: Escreve as estatísticas do handle como um objeto JSON.
+param:
+  - out: Destino do JSON (um objeto, terminado por '\n').
+return: void.
+*/
+void ext2_stats_json(ext2_fs *fs, FILE *out);
+
+/*
+function: Pede que as estatísticas sejam gravadas em JSON ao fechar o handle.
+param:
+  - path: Arquivo de saída (sobrescrito) ou NULL para cancelar.
+return: void.
+observações:
+  - A gravação acontece em ext2_exit(), depois do último checkpoint do
+    journal e do fsync, então o JSON inclui todas as gravações da sessão.
+*/
+void ext2_stats_dump_on_exit(ext2_fs *fs, const char *path);
+
+/*
+function: Zera todas as estatísticas do handle.
+return: void.
+*/
+void ext2_stats_reset(ext2_fs *fs);
+
+#endif
@@ -0,0 +1,145 @@
+#include <time.h>
+#include <fcntl.h>
+#include "ext2_trace.h"
+#include "ext2_internal.h"
+
+// Registros acumulados antes de cada write() no arquivo de trace
+#define TRACE_BUFFER 4096
+
+// Comando em execução na thread (índice na tabela de nomes do trace)
+static __thread uint16_t current_cmd;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void trace_init(ext2_fs *fs) {
+    fs->trace.fd = -1;
+    pthread_mutex_init(&fs->trace.lock, NULL);
+}
+
+void trace_destroy(ext2_fs *fs) {
+    ext2_trace_stop(fs);
+    pthread_mutex_destroy(&fs->trace.lock);
+}
+
+// Grava os registros pendentes (com o lock)
+static int flush_records(struct ext2_trace *t) {
+    size_t len = (size_t)t->nbuf * sizeof(struct ext2_trace_record);
+    if (len > 0 && write(t->fd, t->buf, len) != (ssize_t)len) {
+        perror("trace");
+        return -1;
+    }
+    t->records += t->nbuf;
+    t->nbuf = 0;
+    return 0;
+}
+
+void trace_record(ext2_fs *fs, unsigned int flags, uint32_t block, unsigned int count, enum ext2_io_cat cat) {
+    struct ext2_trace *t = &fs->trace;
+    uint64_t ns = now_ns();
+    pthread_mutex_lock(&t->lock);
+    for (unsigned int i = 0; t->fd >= 0 && i < count; i++) {
+        struct ext2_trace_record *r = &t->buf[t->nbuf++];
+        r->ns = ns - t->start_ns;
+        r->block = block + i;
+        r->cmd = current_cmd < t->ncmds ? current_cmd : 0;
+        r->flags = flags;
+        r->cat = cat;
+        if (t->nbuf == TRACE_BUFFER) flush_records(t);
+    }
+    pthread_mutex_unlock(&t->lock);
+}
+
+int ext2_trace_start(ext2_fs *fs, const char *path) {
+    struct ext2_trace *t = &fs->trace;
+    pthread_mutex_lock(&t->lock);
+    if (t->fd >= 0) {
+        pthread_mutex_unlock(&t->lock);
+        fprintf(stderr, "trace: já existe um trace aberto\n");
+        return -1;
+    }
+
+    // Cabeçalho provisório: records = 0 até o fechamento
+    struct ext2_trace_header h = {0};
+    memcpy(h.magic, EXT2_TRACE_MAGIC, sizeof(h.magic));
+    h.block_size = fs->block_size;
+    h.blocks_count = fs->sb.s_blocks_count;
+    t->buf = malloc(TRACE_BUFFER * sizeof(struct ext2_trace_record));
+    t->names = calloc(EXT2_TRACE_MAX_COMMANDS, EXT2_TRACE_NAME_LEN);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || !t->buf || !t->names || write(fd, &h, sizeof(h)) != sizeof(h)) {
+        perror(path);
+        if (fd >= 0) close(fd);
+        free(t->buf);
+        free(t->names);
+        t->buf = NULL;
+        t->names = NULL;
+        pthread_mutex_unlock(&t->lock);
+        return -1;
+    }
+
+    snprintf(t->names[0], EXT2_TRACE_NAME_LEN, "(nenhum)");
+    t->ncmds = 1;
+    t->nbuf = 0;
+    t->records = 0;
+    t->start_ns = now_ns();
+    t->fd = fd;
+    __atomic_store_n(&t->active, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&t->lock);
+    return 0;
+}
+
+long long ext2_trace_stop(ext2_fs *fs) {
+    struct ext2_trace *t = &fs->trace;
+    pthread_mutex_lock(&t->lock);
+    if (t->fd < 0) {
+        pthread_mutex_unlock(&t->lock);
+        return -1;
+    }
+    __atomic_store_n(&t->active, 0, __ATOMIC_RELAXED);
+
+    flush_records(t);
+    struct ext2_trace_header h;
+    memcpy(h.magic, EXT2_TRACE_MAGIC, sizeof(h.magic));
+    h.block_size = fs->block_size;
+    h.blocks_count = fs->sb.s_blocks_count;
+    h.records = t->records;
+    h.names_offset = sizeof(h) + t->records * sizeof(struct ext2_trace_record);
+    h.ncmds = t->ncmds;
+    h.reserved = 0;
+    size_t names_len = (size_t)t->ncmds * EXT2_TRACE_NAME_LEN;
+    if (write(t->fd, t->names, names_len) != (ssize_t)names_len ||
+        pwrite(t->fd, &h, sizeof(h), 0) != sizeof(h)) {
+        perror("trace");
+    }
+    close(t->fd);
+    long long records = t->records;
+    t->fd = -1;
+    free(t->buf);
+    free(t->names);
+    t->buf = NULL;
+    t->names = NULL;
+    pthread_mutex_unlock(&t->lock);
+    return records;
+}
+
+void ext2_trace_command(ext2_fs *fs, const char *cmd) {
+    struct ext2_trace *t = &fs->trace;
+    current_cmd = 0;
+    if (!cmd || !__atomic_load_n(&t->active, __ATOMIC_RELAXED)) return;
+
+    pthread_mutex_lock(&t->lock);
+    unsigned int i = 1;
+    while (i < t->ncmds && strncmp(t->names[i], cmd, EXT2_TRACE_NAME_LEN - 1) != 0) i++;
+    if (t->fd >= 0 && i == t->ncmds) {
+        // O último lugar fica reservado para os nomes que não couberem
+        if (t->ncmds < EXT2_TRACE_MAX_COMMANDS) t->ncmds++;
+        else i = EXT2_TRACE_MAX_COMMANDS - 1;
+        snprintf(t->names[i], EXT2_TRACE_NAME_LEN, "%s", t->ncmds == EXT2_TRACE_MAX_COMMANDS ? "(outros)" : cmd);
+    }
+    current_cmd = i;
+    pthread_mutex_unlock(&t->lock);
+}
@@ -0,0 +1,75 @@
+#ifndef _EXT2_TRACE_H_
+#define _EXT2_TRACE_H_
+
+#include <stdint.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Formato do arquivo de trace (binário, little-endian da máquina):
+//   struct ext2_trace_header
+//   records x struct ext2_trace_record
+//   ncmds x char[EXT2_TRACE_NAME_LEN] em names_offset (nomes dos comandos)
+// O cabeçalho é regravado ao fechar o trace; se o processo cair antes,
+// records e names_offset ficam zerados e os registros vão até o fim do arquivo.
+
+#define EXT2_TRACE_MAGIC "E2TRACE1"
+#define EXT2_TRACE_NAME_LEN 32
+#define EXT2_TRACE_MAX_COMMANDS 256
+
+// Bits de ext2_trace_record.flags
+#define EXT2_TRACE_WRITE  1   // Gravação (senão leitura)
+#define EXT2_TRACE_MEMORY 2   // Atendida pelo journal em memória, sem E/S na imagem
+
+struct ext2_trace_header {
+    char magic[8];
+    uint32_t block_size;
+    uint32_t blocks_count;
+    uint64_t records;        // 0 = trace não fechado
+    uint64_t names_offset;
+    uint32_t ncmds;
+    uint32_t reserved;
+};
+
+struct ext2_trace_record {
+    uint64_t ns;             // Desde o início do trace (relógio monotônico)
+    uint32_t block;
+    uint16_t cmd;            // Índice na tabela de nomes; 0 = fora de comando
+    uint8_t flags;
+    uint8_t cat;             // enum ext2_io_cat
+};
+
+/*
+function: Começa a gravar cada acesso a bloco da imagem em um arquivo de trace.
+param:
+  - path: Arquivo de saída (sobrescrito).
+return:
+  - 0 em sucesso, -1 em erro (ou se já houver um trace aberto).
+observações:
+  - Cada bloco lido ou gravado na imagem gera um registro de 16 bytes
+    (momento, bloco, leitura/gravação, categoria e comando em execução),
+    inclusive as leituras atendidas pelo journal em memória. As gravações
+    no arquivo do journal não entram: só blocos da imagem.
+  - Os registros são acumulados em memória e gravados em lotes.
+*/
+int ext2_trace_start(ext2_fs *fs, const char *path);
+
+/*
+function: Fecha o trace: grava os registros pendentes, a tabela de nomes e o cabeçalho.
+return:
+  - Quantidade de registros gravados ou -1 se não havia trace aberto.
+observações:
+  - Chamada também por ext2_exit(), depois do último checkpoint.
+*/
+long long ext2_trace_stop(ext2_fs *fs);
+
+/*
+function: Define o comando da thread atual, usado nos registros seguintes.
+param:
+  - cmd: Nome do comando ou NULL ao terminar (acessos fora de comando).
+return: void.
+observações:
+  - Chamada por session_execute(); só custa algo com o trace aberto.
+*/
+void ext2_trace_command(ext2_fs *fs, const char *cmd);
+
+#endif
@@ -0,0 +1,434 @@
+#include <fcntl.h>
+#include <time.h>
+#include "ext2_verify.h"
+#include "ext2_internal.h"
+
+// Blocos lidos por pread ao calcular o CRC de um grupo
+#define VERIFY_RUN_BLOCKS 256
+
+// --- CRC32C ---
+
+static uint32_t crc_table[8][256];
+static uint32_t (*crc_impl)(uint32_t crc, const uint8_t *p, size_t len);
+static const char *crc_impl_name;
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+// Slicing-by-8: oito bytes por passo, um acesso a cada tabela
+static uint32_t crc32c_table(uint32_t c, const uint8_t *p, size_t len) {
+    for (; len && ((uintptr_t)p & 7); len--) c = crc_table[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t w;
+        memcpy(&w, p, sizeof(w));
+        w ^= c;
+        c = crc_table[7][w & 0xFF] ^ crc_table[6][(w >> 8) & 0xFF] ^ crc_table[5][(w >> 16) & 0xFF] ^
+            crc_table[4][(w >> 24) & 0xFF] ^ crc_table[3][(w >> 32) & 0xFF] ^ crc_table[2][(w >> 40) & 0xFF] ^
+            crc_table[1][(w >> 48) & 0xFF] ^ crc_table[0][w >> 56];
+    }
+    for (; len; len--) c = crc_table[0][(c ^ *p++) & 0xFF] ^ (c >> 8);
+    return c;
+}
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <nmmintrin.h>
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t c, const uint8_t *p, size_t len) {
+    for (; len && ((uintptr_t)p & 7); len--) c = _mm_crc32_u8(c, *p++);
+    uint64_t c64 = c;
+    for (; len >= 8; p += 8, len -= 8) {
+        uint64_t w;
+        memcpy(&w, p, sizeof(w));
+        c64 = _mm_crc32_u64(c64, w);
+    }
+    c = (uint32_t)c64;
+    for (; len; len--) c = _mm_crc32_u8(c, *p++);
+    return c;
+}
+#endif
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c >> 1) ^ (0x82F63B78 & -(c & 1)); // Polinômio refletido
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) crc_table[t][i] = (crc_table[t - 1][i] >> 8) ^ crc_table[0][crc_table[t - 1][i] & 0xFF];
+    }
+    crc_impl = crc32c_table;
+    crc_impl_name = "tabela";
+#if defined(__x86_64__) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc_impl = crc32c_sse42;
+        crc_impl_name = "sse4.2";
+    }
+#endif
+}
+
+uint32_t ext2_crc32c(uint32_t crc, const void *data, size_t len) {
+    pthread_once(&crc_once, crc_init);
+    return ~crc_impl(~crc, data, len);
+}
+
+// --- Estado ---
+
+struct verify_state {
+    ext2_fs *fs;
+    enum ext2_verify_mode mode;
+    int have_old;                   // Manifesto anterior lido
+    uint64_t since;                 // Datas a partir desta indicam alteração
+    struct ext2_verify_group *old, *cur;
+    uint8_t *dirty;                 // Indício de alteração por grupo (escrita atômica)
+    uint8_t *hashed;                // CRC do grupo calculado nesta execução
+    uint8_t *failed;                // Erro de leitura no grupo
+    uint32_t itb, super_area, first_ino;
+    unsigned int next;
+    void (*pass)(struct verify_state *, unsigned int);
+    uint64_t bytes;                 // Lidos para CRC (atômico)
+    uint64_t changed_inodes;        // Inodes com datas recentes (atômico)
+};
+
+// Lê `count` blocos seguidos com um único pread (versões do journal têm prioridade)
+static int read_run(ext2_fs *fs, uint32_t first, uint32_t count, char *buf, enum ext2_io_cat cat) {
+    size_t len = (size_t)count * fs->block_size;
+    stats_calls(fs, 0, 1);
+    if (image_pread(fs, buf, len, (off_t)first * fs->block_size) != 0) return -1;
+    stats_blocks(fs, 0, first, count, cat);
+    if (fs->journal) {
+        for (uint32_t i = 0; i < count; i++) journal_read(fs, first + i, buf + (size_t)i * fs->block_size);
+    }
+    return 0;
+}
+
+static uint32_t group_first_block(ext2_fs *fs, unsigned int group) {
+    return fs->sb.s_first_data_block + group * fs->sb.s_blocks_per_group;
+}
+
+static uint32_t group_blocks(ext2_fs *fs, unsigned int group) {
+    uint32_t n = fs->sb.s_blocks_count - group_first_block(fs, group);
+    return n < fs->sb.s_blocks_per_group ? n : fs->sb.s_blocks_per_group;
+}
+
+static void mark_block(struct verify_state *st, uint32_t block) {
+    ext2_fs *fs = st->fs;
+    if (block < fs->sb.s_first_data_block || block >= fs->sb.s_blocks_count) return;
+    unsigned int group = (block - fs->sb.s_first_data_block) / fs->sb.s_blocks_per_group;
+    __atomic_store_n(&st->dirty[group], 1, __ATOMIC_RELAXED);
+}
+
+// Marca os grupos de um bloco indireto e de tudo que ele referencia
+static void mark_indirect(struct verify_state *st, uint32_t block, int level) {
+    ext2_fs *fs = st->fs;
+    if (block == 0 || block >= fs->sb.s_blocks_count) return;
+    mark_block(st, block);
+    uint32_t *ptrs = malloc(fs->block_size);
+    if (!ptrs) return;
+    if (read_block_as(fs, block, ptrs, EXT2_IO_INDIRECT) == 0) {
+        for (unsigned int i = 0; i < fs->block_size / sizeof(uint32_t); i++) {
+            if (ptrs[i] == 0) continue;
+            if (level == 1) mark_block(st, ptrs[i]);
+            else mark_indirect(st, ptrs[i], level - 1);
+        }
+    }
+    free(ptrs);
+}
+
+static void mark_inode_blocks(struct verify_state *st, const ext2_inode *inode) {
+    ext2_fs *fs = st->fs;
+    uint16_t type = inode->i_mode & EXT2_S_IFMT;
+    uint32_t acl_sectors = inode->i_file_acl ? fs->block_size / 512 : 0;
+    if (inode->i_file_acl) mark_block(st, inode->i_file_acl);
+    // Links simbólicos rápidos guardam o destino em i_block; dispositivos, o número
+    int has_map = type == EXT2_S_IFREG || type == EXT2_S_IFDIR ||
+                  (type == EXT2_S_IFLNK && inode->i_blocks > acl_sectors);
+    if (!has_map) return;
+    for (int b = 0; b < EXT2_NDIR_BLOCKS; b++) {
+        if (inode->i_block[b]) mark_block(st, inode->i_block[b]);
+    }
+    for (int level = 1; level <= 3; level++) mark_indirect(st, inode->i_block[EXT2_IND_BLOCK + level - 1], level);
+}
+
+// --- Passada 1: bitmaps, tabela de inodes e indícios de alteração ---
+
+static void pass_deltas(struct verify_state *st, unsigned int group) {
+    ext2_fs *fs = st->fs;
+    uint32_t bs = fs->block_size;
+    char *buf = malloc((size_t)(st->itb > 2 ? st->itb : 2) * bs);
+    if (!buf || read_block_as(fs, fs->gd[group].bg_block_bitmap, buf, EXT2_IO_BITMAP) != 0 ||
+        read_block_as(fs, fs->gd[group].bg_inode_bitmap, buf + bs, EXT2_IO_BITMAP) != 0) {
+        st->failed[group] = 1;
+        free(buf);
+        return;
+    }
+    uint8_t inode_bitmap[bs];
+    memcpy(inode_bitmap, buf + bs, bs);
+    st->cur[group].bitmap_crc = ext2_crc32c(0, buf, 2 * (size_t)bs);
+
+    if (read_run(fs, fs->gd[group].bg_inode_table, st->itb, buf, EXT2_IO_INODE) != 0) {
+        st->failed[group] = 1;
+        free(buf);
+        return;
+    }
+    st->cur[group].itable_crc = ext2_crc32c(0, buf, (size_t)st->itb * bs);
+
+    if (st->have_old) {
+        if (st->cur[group].bitmap_crc != st->old[group].bitmap_crc) __atomic_store_n(&st->dirty[group], 1, __ATOMIC_RELAXED);
+
+        // Tabela inalterada: nenhum inode do grupo tem data nova
+        if (st->cur[group].itable_crc != st->old[group].itable_crc) {
+            uint32_t ipg = fs->sb.s_inodes_per_group;
+            for (uint32_t i = 0; i < ipg; i++) {
+                uint32_t ino = group * ipg + i + 1;
+                if (ino > fs->sb.s_inodes_count) break;
+                const ext2_inode *inode = (const ext2_inode *)(buf + (size_t)i * sizeof(ext2_inode));
+                uint32_t t = inode->i_mtime;
+                if (inode->i_ctime > t) t = inode->i_ctime;
+                if (inode->i_dtime > t) t = inode->i_dtime;
+                if (t < st->since) continue;
+
+                __atomic_store_n(&st->dirty[group], 1, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&st->changed_inodes, 1, __ATOMIC_RELAXED);
+                int used = (inode_bitmap[i / 8] >> (i % 8)) & 1;
+                if (used && inode->i_links_count > 0 && (ino >= st->first_ino || ino == EXT2_ROOT_INO)) {
+                    mark_inode_blocks(st, inode);
+                }
+            }
+        }
+    }
+    free(buf);
+}
+
+// --- Passada 2: CRC dos blocos em uso ---
+
+static void pass_hash(struct verify_state *st, unsigned int group) {
+    ext2_fs *fs = st->fs;
+    if (st->failed[group]) return;
+    if (st->mode == EXT2_VERIFY_INCREMENTAL && st->have_old && !st->dirty[group]) {
+        st->cur[group].crc = st->old[group].crc;
+        return;
+    }
+
+    uint32_t bs = fs->block_size;
+    uint8_t *bitmap = malloc(bs);
+    char *buf = malloc((size_t)VERIFY_RUN_BLOCKS * bs);
+    if (!bitmap || !buf || read_block_as(fs, fs->gd[group].bg_block_bitmap, bitmap, EXT2_IO_BITMAP) != 0) {
+        st->failed[group] = 1;
+        free(bitmap);
+        free(buf);
+        return;
+    }
+
+    uint32_t first = group_first_block(fs, group), nblocks = group_blocks(fs, group);
+    uint32_t crc = 0;
+    uint64_t bytes = 0;
+    for (uint32_t i = group_has_super(fs, group) ? st->super_area : 0; i < nblocks;) {
+        if (!((bitmap[i / 8] >> (i % 8)) & 1)) {
+            i++;
+            continue;
+        }
+        uint32_t n = 1;
+        while (i + n < nblocks && n < VERIFY_RUN_BLOCKS && ((bitmap[(i + n) / 8] >> ((i + n) % 8)) & 1)) n++;
+        if (read_run(fs, first + i, n, buf, EXT2_IO_DATA) != 0) {
+            st->failed[group] = 1;
+            break;
+        }
+        crc = ext2_crc32c(crc, buf, (size_t)n * bs);
+        bytes += (uint64_t)n * bs;
+        i += n;
+    }
+    if (!st->failed[group]) {
+        st->cur[group].crc = crc;
+        st->hashed[group] = 1;
+    }
+    __atomic_add_fetch(&st->bytes, bytes, __ATOMIC_RELAXED);
+    free(bitmap);
+    free(buf);
+}
+
+// --- Execução ---
+
+static void *pass_worker(void *arg) {
+    struct verify_state *st = arg;
+    for (;;) {
+        unsigned int group = __atomic_fetch_add(&st->next, 1, __ATOMIC_RELAXED);
+        if (group >= st->fs->group_count) break;
+        st->pass(st, group);
+    }
+    return NULL;
+}
+
+static void run_pass(struct verify_state *st, void (*pass)(struct verify_state *, unsigned int), int threads) {
+    pthread_t tids[threads];
+    int started = 0;
+    st->pass = pass;
+    st->next = 0;
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&tids[started], NULL, pass_worker, st) == 0) started++;
+    }
+    pass_worker(st); // A thread principal também trabalha
+    for (int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+}
+
+// --- Manifesto ---
+
+static uint32_t header_crc(const struct ext2_verify_header *h) {
+    struct ext2_verify_header copy = *h;
+    copy.header_crc = 0;
+    return ext2_crc32c(0, &copy, sizeof(copy));
+}
+
+// Retorna 1 se leu, 0 se não existe, -1 se inválido ou de outra geometria
+static int load_manifest(ext2_fs *fs, const char *path, struct ext2_verify_header *h,
+                         struct ext2_verify_group *groups, FILE *out) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+    size_t len = fs->group_count * sizeof(struct ext2_verify_group);
+    int ok = fread(h, sizeof(*h), 1, f) == 1 && memcmp(h->magic, EXT2_VERIFY_MAGIC, 8) == 0 &&
+             h->version == EXT2_VERIFY_VERSION && h->header_crc == header_crc(h);
+    if (ok && (h->block_size != fs->block_size || h->blocks_count != fs->sb.s_blocks_count ||
+               h->group_count != fs->group_count)) {
+        fprintf(out, "verify: o manifesto %s é de outra geometria (use verify -n)\n", path);
+        fclose(f);
+        return -1;
+    }
+    ok = ok && fread(groups, len, 1, f) == 1 && h->records_crc == ext2_crc32c(0, groups, len);
+    fclose(f);
+    if (!ok) {
+        fprintf(out, "verify: manifesto %s inválido ou corrompido (use verify -n)\n", path);
+        return -1;
+    }
+    return 1;
+}
+
+// Grava em um temporário e renomeia: um manifesto interrompido nunca substitui o anterior
+static int save_manifest(ext2_fs *fs, const char *path, uint64_t created, const struct ext2_verify_group *groups) {
+    size_t len = fs->group_count * sizeof(struct ext2_verify_group);
+    struct ext2_verify_header h = {0};
+    memcpy(h.magic, EXT2_VERIFY_MAGIC, 8);
+    h.version = EXT2_VERIFY_VERSION;
+    h.block_size = fs->block_size;
+    h.blocks_count = fs->sb.s_blocks_count;
+    h.group_count = fs->group_count;
+    h.created = created;
+    h.records_crc = ext2_crc32c(0, groups, len);
+    h.header_crc = header_crc(&h);
+
+    size_t tmp_len = strlen(path) + 5;
+    char tmp[tmp_len];
+    snprintf(tmp, tmp_len, "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) return -1;
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1 && fwrite(groups, len, 1, f) == 1 && fflush(f) == 0 &&
+             fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+long long ext2_verify(ext2_fs *fs, const char *manifest, enum ext2_verify_mode mode, int threads, FILE *out) {
+    double start = now_ms();
+    uint64_t created = (uint64_t)time(NULL);
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    if ((unsigned int)threads > fs->group_count) threads = (int)fs->group_count;
+
+    size_t path_len = strlen(fs->image_path) + sizeof(EXT2_VERIFY_SUFFIX);
+    char default_path[path_len];
+    snprintf(default_path, path_len, "%s%s", fs->image_path, EXT2_VERIFY_SUFFIX);
+    const char *path = manifest ? manifest : default_path;
+
+    struct verify_state st = {0};
+    st.fs = fs;
+    st.mode = mode;
+    st.itb = (fs->sb.s_inodes_per_group + fs->inodes_per_block - 1) / fs->inodes_per_block;
+    st.super_area = fs->stats.super_area;
+    st.first_ino = fs->sb.s_rev_level >= 1 ? fs->sb.s_first_ino : 11;
+    st.old = calloc(fs->group_count, sizeof(struct ext2_verify_group));
+    st.cur = calloc(fs->group_count, sizeof(struct ext2_verify_group));
+    st.dirty = calloc(fs->group_count, 1);
+    st.hashed = calloc(fs->group_count, 1);
+    st.failed = calloc(fs->group_count, 1);
+
+    long long ret = -1;
+    if (!st.old || !st.cur || !st.dirty || !st.hashed || !st.failed) {
+        fprintf(out, "verify: memória insuficiente\n");
+        goto out;
+    }
+
+    if (mode != EXT2_VERIFY_REBUILD) {
+        struct ext2_verify_header h;
+        int loaded = load_manifest(fs, path, &h, st.old, out);
+        if (loaded < 0) goto out;
+        st.have_old = loaded;
+        // Margem de um segundo: alterações no mesmo segundo do manifesto anterior
+        if (loaded) st.since = h.created > 0 ? h.created - 1 : 0;
+    }
+    if (!st.have_old) st.mode = EXT2_VERIFY_REBUILD;
+
+    run_pass(&st, pass_deltas, threads);
+    run_pass(&st, pass_hash, threads);
+
+    // Classificação dos grupos e registros do novo manifesto
+    unsigned int same = 0, changed = 0, corrupted = 0, skipped = 0, failed = 0;
+    struct ext2_verify_group *next = st.cur;
+    for (unsigned int g = 0; g < fs->group_count; g++) {
+        if (st.failed[g]) {
+            failed++;
+            fprintf(out, "Grupo %u: erro de leitura\n", g);
+            if (st.have_old) next[g] = st.old[g];
+            continue;
+        }
+        if (st.mode == EXT2_VERIFY_REBUILD) continue;
+        if (!st.hashed[g]) {
+            skipped++;
+            continue;
+        }
+        if (st.cur[g].crc == st.old[g].crc) {
+            same++;
+        } else if (st.dirty[g]) {
+            changed++;
+            fprintf(out, "Grupo %u: alterado desde o manifesto (atualizado)\n", g);
+        } else {
+            corrupted++;
+            fprintf(out, "Grupo %u: CORROMPIDO (CRC %08x, esperado %08x)\n", g, st.cur[g].crc, st.old[g].crc);
+            next[g] = st.old[g];
+        }
+    }
+
+    double secs = (now_ms() - start) / 1000.0;
+    double mib = st.bytes / (1024.0 * 1024.0);
+    if (st.mode == EXT2_VERIFY_REBUILD) {
+        fprintf(out, "Manifesto %s criado: %u grupos", path, fs->group_count - failed);
+    } else {
+        fprintf(out, "%u grupos: %u conferidos, %u alterados, %u corrompidos", fs->group_count, same, changed, corrupted);
+        if (skipped) fprintf(out, ", %u sem indício de alteração (não lidos)", skipped);
+        if (st.changed_inodes) fprintf(out, "; %llu inodes alterados", (unsigned long long)st.changed_inodes);
+    }
+    if (failed) fprintf(out, ", %u com erro de leitura", failed);
+    fprintf(out, "\n%.1f MiB em %.2f s (%.0f MiB/s), %d threads, CRC32C %s\n", mib, secs, secs > 0 ? mib / secs : 0.0,
+            threads, crc_impl_name);
+
+    if (save_manifest(fs, path, created, next) != 0) {
+        fprintf(out, "verify: falha ao gravar o manifesto %s\n", path);
+        goto out;
+    }
+    ret = corrupted + failed;
+
+out:
+    free(st.old);
+    free(st.cur);
+    free(st.dirty);
+    free(st.hashed);
+    free(st.failed);
+    return ret;
+}
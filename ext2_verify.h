@@ -0,0 +1,85 @@
+#ifndef _EXT2_VERIFY_H_
+#define _EXT2_VERIFY_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Manifesto ao lado da imagem: <imagem>.crc
+#define EXT2_VERIFY_SUFFIX ".crc"
+#define EXT2_VERIFY_MAGIC "E2CRC32C"
+#define EXT2_VERIFY_VERSION 1
+
+// Formato do manifesto: o cabeçalho e um registro por grupo. header_crc
+// cobre o cabeçalho (com header_crc = 0) e records_crc, os registros.
+struct ext2_verify_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t blocks_count;
+    uint32_t group_count;
+    uint64_t created;           // Início da execução que gravou o manifesto (Unix)
+    uint32_t records_crc;
+    uint32_t header_crc;
+};
+
+struct ext2_verify_group {
+    uint32_t crc;               // Blocos em uso do grupo, fora superbloco/GDT
+    uint32_t bitmap_crc;        // Bitmap de blocos seguido do bitmap de inodes
+    uint32_t itable_crc;        // Tabela de inodes inteira
+    uint32_t reserved;
+};
+
+enum ext2_verify_mode {
+    EXT2_VERIFY_FULL,           // Todos os grupos; sem manifesto, cria
+    EXT2_VERIFY_INCREMENTAL,    // Só os grupos com indícios de alteração
+    EXT2_VERIFY_REBUILD,        // Recalcula tudo e grava um manifesto novo
+};
+
+/*
+function: CRC32C (Castagnoli) de `len` bytes, continuando de `crc`.
+param:
+  - crc: 0 no início; o valor anterior para continuar (crc(a + b) =
+    ext2_crc32c(ext2_crc32c(0, a), b)).
+return:
+  - O CRC.
+observações:
+  - Usa a instrução crc32 do SSE4.2 quando a CPU tem (escolhida no primeiro
+    uso) e, nas demais, tabelas de 8 bytes por passo (slicing-by-8).
+*/
+uint32_t ext2_crc32c(uint32_t crc, const void *data, size_t len);
+
+/*
+function: Confere a imagem contra o manifesto de CRC32C por grupo de blocos.
+param:
+  - manifest: Caminho do manifesto (NULL = <imagem>.crc).
+  - mode: Ver enum ext2_verify_mode.
+  - threads: Quantidade de threads (0 = uma por CPU).
+  - out: Onde o relatório é escrito.
+return:
+  - Quantidade de grupos corrompidos (0 = íntegra) ou -1 em erro.
+observações:
+  - O CRC de um grupo cobre só os blocos marcados no bitmap, lidos em
+    trechos contíguos (vários blocos por pread), em paralelo por grupo.
+    Superbloco e GDT ficam de fora: mudam a cada gravação e o check já os
+    confere.
+  - Indícios de alteração legítima desde o manifesto: bitmaps diferentes e
+    inodes com i_mtime, i_ctime ou i_dtime a partir da data do manifesto
+    (o próprio grupo e os grupos de todos os blocos do inode, inclusive
+    indiretos). Só as tabelas de inodes cujo CRC mudou são percorridas.
+  - FULL: grupo diferente com indício é "alterado" e atualizado no
+    manifesto; sem indício é "corrompido" e o registro antigo é mantido
+    (volta a ser relatado na próxima execução).
+  - INCREMENTAL: lê só bitmaps, tabelas de inodes e os grupos com indício,
+    e atualiza o manifesto; não detecta corrupção nos demais grupos.
+  - Alterações que não mudam datas nem bitmaps (check -r, ferramentas
+    externas que não atualizam ctime) aparecem como corrupção: depois delas,
+    gere o manifesto de novo com EXT2_VERIFY_REBUILD.
+  - Não deve rodar junto com comandos que alteram a imagem (no servidor e no
+    modo lote é executado com exclusividade).
+*/
+long long ext2_verify(ext2_fs *fs, const char *manifest, enum ext2_verify_mode mode, int threads, FILE *out);
+
+#endif
@@ -0,0 +1,229 @@
+#include <sched.h>
+#include "ext2_walk.h"
+#include "ext2_internal.h"
+
+// Fila de uma thread: a dona empilha e retira do fim, as outras roubam do início
+struct walk_deque {
+    pthread_mutex_t lock;
+    struct walk_task *items;
+    size_t head, tail, cap;
+};
+
+struct ext2_walk {
+    ext2_fs *fs;
+    int nthreads;
+    walk_fn fn;
+    void *arg;
+    struct walk_deque *deques;
+    uint64_t pending;           // Tarefas empilhadas e ainda não concluídas
+    uint64_t steals;
+};
+
+struct walk_worker {
+    ext2_walk *w;
+    int id;
+};
+
+// --- Leitura de diretórios ---
+
+static int dir_walk_cb(ext2_fs *fs, uint32_t block_num, uint64_t lblk, void *ctx) {
+    (void)lblk;
+    struct walk_dir *d = ctx;
+    if (block_num == 0 || block_num >= fs->sb.s_blocks_count) return 0;
+    if (read_block_as(fs, block_num, d->buf, EXT2_IO_DIR) != 0) return 0;
+
+    for (unsigned int off = 0; off + 8 <= fs->block_size;) {
+        ext2_dir_entry_2 *e = (ext2_dir_entry_2 *)(d->buf + off);
+        if (e->rec_len < 8 || off + e->rec_len > fs->block_size) break;
+        off += e->rec_len;
+        if (e->inode == 0 || e->inode > fs->sb.s_inodes_count) continue;
+        if (e->name_len == 1 && e->name[0] == '.') continue;
+        if (e->name_len == 2 && e->name[0] == '.' && e->name[1] == '.') continue;
+
+        if (d->n == d->cap) {
+            size_t cap = d->cap ? d->cap * 2 : 64;
+            struct walk_entry *grown = realloc(d->e, cap * sizeof(struct walk_entry));
+            if (!grown) return -1;
+            d->e = grown;
+            d->cap = cap;
+        }
+        if (d->strs_len + e->name_len + 1 > d->strs_cap) {
+            size_t cap = d->strs_cap ? d->strs_cap * 2 : 4096;
+            char *grown = realloc(d->strs, cap);
+            if (!grown) return -1;
+            d->strs = grown;
+            d->strs_cap = cap;
+        }
+        struct walk_entry *ent = &d->e[d->n++];
+        ent->ino = e->inode;
+        ent->name_off = d->strs_len;
+        memcpy(d->strs + d->strs_len, e->name, e->name_len);
+        d->strs[d->strs_len + e->name_len] = '\0';
+        d->strs_len += e->name_len + 1;
+    }
+    return 0;
+}
+
+static int cmp_entry_ino(const void *a, const void *b) {
+    uint32_t x = ((const struct walk_entry *)a)->ino, y = ((const struct walk_entry *)b)->ino;
+    return (x > y) - (x < y);
+}
+
+int walk_read_dir(ext2_fs *fs, const ext2_inode *dir, struct walk_dir *d) {
+    d->n = 0;
+    d->strs_len = 0;
+    if (!d->buf && !(d->buf = malloc(fs->block_size))) return -1;
+    uint64_t nblocks = (inode_file_size(fs, dir) + fs->block_size - 1) / fs->block_size;
+    if (walk_file_blocks(fs, dir, nblocks, dir_walk_cb, d) < 0) return -1;
+
+    qsort(d->e, d->n, sizeof(struct walk_entry), cmp_entry_ino);
+    uint32_t loaded = 0;
+    for (size_t i = 0; i < d->n; i++) {
+        unsigned int group, offset;
+        uint32_t block;
+        inode_location(fs, d->e[i].ino, &group, &block, &offset);
+        if (block != loaded) {
+            if (read_block_as(fs, block, d->buf, EXT2_IO_INODE) != 0) return -1;
+            loaded = block;
+        }
+        memcpy(&d->e[i].inode, d->buf + offset, sizeof(ext2_inode));
+    }
+    stats_op(fs, EXT2_OP_GET_INODE, d->n);
+    return 0;
+}
+
+void walk_dir_free(struct walk_dir *d) {
+    free(d->e);
+    free(d->strs);
+    free(d->buf);
+    memset(d, 0, sizeof(*d));
+}
+
+// --- Filas ---
+
+static int deque_push(struct walk_deque *d, struct walk_task t) {
+    pthread_mutex_lock(&d->lock);
+    if (d->tail == d->cap) {
+        // Desloca para o início antes de crescer
+        if (d->head > 0) {
+            memmove(d->items, d->items + d->head, (d->tail - d->head) * sizeof(struct walk_task));
+            d->tail -= d->head;
+            d->head = 0;
+        }
+        if (d->tail == d->cap) {
+            size_t cap = d->cap ? d->cap * 2 : 256;
+            struct walk_task *items = realloc(d->items, cap * sizeof(struct walk_task));
+            if (!items) {
+                pthread_mutex_unlock(&d->lock);
+                return -1;
+            }
+            d->items = items;
+            d->cap = cap;
+        }
+    }
+    d->items[d->tail++] = t;
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+static int deque_pop(struct walk_deque *d, struct walk_task *t, int steal) {
+    int got = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->tail > d->head) {
+        *t = steal ? d->items[d->head++] : d->items[--d->tail];
+        got = 1;
+        if (d->head == d->tail) d->head = d->tail = 0;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return got;
+}
+
+// --- Percurso ---
+
+ext2_walk *walk_create(ext2_fs *fs, int threads, walk_fn fn, void *arg) {
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads <= 0) threads = 1;
+    ext2_walk *w = calloc(1, sizeof(ext2_walk));
+    if (!w) return NULL;
+    w->deques = calloc(threads, sizeof(struct walk_deque));
+    if (!w->deques) {
+        free(w);
+        return NULL;
+    }
+    w->fs = fs;
+    w->nthreads = threads;
+    w->fn = fn;
+    w->arg = arg;
+    for (int i = 0; i < threads; i++) pthread_mutex_init(&w->deques[i].lock, NULL);
+    return w;
+}
+
+int walk_push(ext2_walk *w, int thread, struct walk_task task) {
+    __atomic_add_fetch(&w->pending, 1, __ATOMIC_RELAXED);
+    if (deque_push(&w->deques[thread % w->nthreads], task) == 0) return 0;
+    __atomic_sub_fetch(&w->pending, 1, __ATOMIC_RELAXED);
+    free(task.path);
+    return -1;
+}
+
+static void *walk_worker(void *arg) {
+    struct walk_worker *me = arg;
+    ext2_walk *w = me->w;
+    struct walk_dir d = {0};
+
+    while (__atomic_load_n(&w->pending, __ATOMIC_ACQUIRE) > 0) {
+        struct walk_task t;
+        int got = deque_pop(&w->deques[me->id], &t, 0);
+        for (int k = 1; !got && k < w->nthreads; k++) {
+            got = deque_pop(&w->deques[(me->id + k) % w->nthreads], &t, 1);
+            if (got) __atomic_add_fetch(&w->steals, 1, __ATOMIC_RELAXED);
+        }
+        if (!got) {
+            sched_yield();
+            continue;
+        }
+
+        // Os filhos são empilhados pelo callback antes de a tarefa ser dada
+        // como concluída: pending só chega a zero no fim do percurso
+        ext2_inode dir;
+        if (get_inode(w->fs, t.ino, &dir) == 0 && walk_read_dir(w->fs, &dir, &d) == 0) {
+            w->fn(w, me->id, &t, &d, w->arg);
+        }
+        free(t.path);
+        __atomic_sub_fetch(&w->pending, 1, __ATOMIC_RELEASE);
+    }
+    walk_dir_free(&d);
+    return NULL;
+}
+
+void walk_run(ext2_walk *w) {
+    pthread_t tids[w->nthreads];
+    struct walk_worker workers[w->nthreads];
+    int started = 0;
+    for (int t = 0; t < w->nthreads; t++) workers[t] = (struct walk_worker){ w, t };
+    for (int t = 1; t < w->nthreads; t++) {
+        if (pthread_create(&tids[started], NULL, walk_worker, &workers[t]) == 0) started++;
+    }
+    walk_worker(&workers[0]); // A thread chamadora também trabalha
+    for (int t = 0; t < started; t++) pthread_join(tids[t], NULL);
+}
+
+int walk_threads(const ext2_walk *w) {
+    return w->nthreads;
+}
+
+unsigned long long walk_steals(const ext2_walk *w) {
+    return w->steals;
+}
+
+void walk_destroy(ext2_walk *w) {
+    if (!w) return;
+    for (int i = 0; i < w->nthreads; i++) {
+        // Tarefas que sobraram (percurso não executado)
+        for (size_t k = w->deques[i].head; k < w->deques[i].tail; k++) free(w->deques[i].items[k].path);
+        free(w->deques[i].items);
+        pthread_mutex_destroy(&w->deques[i].lock);
+    }
+    free(w->deques);
+    free(w);
+}
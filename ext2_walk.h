@@ -0,0 +1,92 @@
+#ifndef _EXT2_WALK_H_
+#define _EXT2_WALK_H_
+
+#include "ext2_fs.h"
+#include "ext2_lib.h"
+
+// Percurso paralelo de árvores de diretórios (du, find). Uso interno dos
+// módulos da biblioteca.
+//
+// Cada diretório é uma tarefa. Cada thread tem a sua fila: empilha os
+// subdiretórios que encontra e retira do fim; sem tarefas, rouba do início
+// da fila de outra thread (os diretórios mais próximos da raiz, que tendem a
+// ter as maiores subárvores).
+
+// Diretório a percorrer. `tag` e `path` são do chamador; `path` (malloc) é
+// liberado pelo percurso depois do callback.
+struct walk_task {
+    uint32_t ino;
+    uint32_t tag;
+    char *path;
+};
+
+// Entrada de diretório com o seu inode
+struct walk_entry {
+    uint32_t ino;
+    uint32_t name_off;        // Em walk_dir.strs (terminado em '\0')
+    ext2_inode inode;
+};
+
+// Entradas de um diretório (sem "." e ".."), reaproveitado entre leituras
+struct walk_dir {
+    struct walk_entry *e;
+    size_t n, cap;
+    char *strs;
+    size_t strs_len, strs_cap;
+    char *buf;                // Um bloco
+};
+
+static inline const char *walk_name(const struct walk_dir *d, size_t i) {
+    return d->strs + d->e[i].name_off;
+}
+
+static inline int walk_is_dir(const struct walk_entry *e) {
+    return (e->inode.i_mode & EXT2_S_IFMT) == EXT2_S_IFDIR;
+}
+
+/*
+function: Lê as entradas de um diretório e os inodes de todas elas.
+param:
+  - dir: Inode do diretório.
+  - d: Destino (zerado antes do primeiro uso; liberado com walk_dir_free).
+return:
+  - 0 em sucesso, -1 em erro.
+observações:
+  - Todos os blocos do diretório são lidos (diretos e indiretos).
+  - As entradas ficam ordenadas por número de inode: cada bloco da tabela
+    de inodes é lido uma única vez para todos os inodes que contém.
+*/
+int walk_read_dir(ext2_fs *fs, const ext2_inode *dir, struct walk_dir *d);
+void walk_dir_free(struct walk_dir *d);
+
+typedef struct ext2_walk ext2_walk;
+
+// Chamado para cada tarefa com as entradas do diretório já lidas; novos
+// diretórios são empilhados com walk_push(w, thread, ...)
+typedef void (*walk_fn)(ext2_walk *w, int thread, const struct walk_task *task, struct walk_dir *d, void *arg);
+
+/*
+function: Cria um percurso com `threads` filas (0 = uma por CPU).
+return: O percurso ou NULL sem memória.
+*/
+ext2_walk *walk_create(ext2_fs *fs, int threads, walk_fn fn, void *arg);
+
+/*
+function: Empilha um diretório na fila da thread `thread`.
+return: 0 em sucesso, -1 sem memória (a tarefa é descartada e path liberado).
+*/
+int walk_push(ext2_walk *w, int thread, struct walk_task task);
+
+/*
+function: Executa as tarefas empilhadas e as que elas gerarem, até o fim.
+return: void.
+observações:
+  - A thread chamadora é a thread 0; as demais são criadas e terminadas aqui.
+*/
+void walk_run(ext2_walk *w);
+
+int walk_threads(const ext2_walk *w);
+unsigned long long walk_steals(const ext2_walk *w);
+void walk_destroy(ext2_walk *w);
+
+#endif